@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+
+/**
+ * 基准测试共用的服务端线程 在一个EventLoopThread里运行被测的服务器 客户端在其他线程里压测
+ *
+ *   BenchServerThread server;
+ *   server.start([](EventLoop *loop) {
+ *       std::shared_ptr<TcpServer> s(new TcpServer(loop, InetAddress(kPort), "EchoServer"));
+ *       s->setMessageCallback(...);
+ *       s->start();
+ *       return s;
+ *   });
+ *   ...
+ *   server.stop();
+ *
+ * setup在loop线程中创建并start服务器 返回持有服务器的对象(多个服务器时放进一个结构体)
+ * start()等setup返回后才返回 此时已经在监听 stop()在loop线程中析构这个对象 然后退出loop并join
+ * TcpServer/UdpServer只能在自己的baseLoop线程中析构 所以不能在调用stop()的线程里直接释放
+ **/
+class BenchServerThread : noncopyable
+{
+public:
+    using Setup = std::function<std::shared_ptr<void>(EventLoop *loop)>;
+
+    explicit BenchServerThread(const std::string &name = "BenchServer") : name_(name), loop_(nullptr) {}
+    ~BenchServerThread() { stop(); }
+
+    void start(const Setup &setup)
+    {
+        thread_.reset(new EventLoopThread(EventLoopThread::ThreadInitCallback(), name_));
+        loop_ = thread_->startLoop();
+        runInLoopAndWait([this, &setup]() { servers_ = setup(loop_); });
+    }
+
+    void stop()
+    {
+        if (!thread_)
+        {
+            return;
+        }
+        runInLoopAndWait([this]() { servers_.reset(); });
+        thread_.reset(); // ~EventLoopThread退出loop并join
+        loop_ = nullptr;
+    }
+
+    // 在loop线程中运行f并等它返回 用来读取只在loop线程中访问的状态
+    void runInLoopAndWait(const std::function<void()> &f)
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool done = false;
+        loop_->runInLoop([&]() {
+            f();
+            std::unique_lock<std::mutex> lock(mutex);
+            done = true;
+            cond.notify_one();
+        });
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&done]() { return done; });
+    }
+
+    EventLoop *loop() const { return loop_; }
+
+private:
+    const std::string name_;
+    std::unique_ptr<EventLoopThread> thread_;
+    EventLoop *loop_;
+    std::shared_ptr<void> servers_; // 只在loop线程中创建和释放
+};
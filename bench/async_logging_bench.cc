@@ -0,0 +1,217 @@
+/**
+ * 异步日志基准测试
+ * 1. 8个线程同时写LOG_INFO 比较同步写文件(stdio自带的锁)和AsyncLogging的吞吐 以及丢弃的行数
+ * 2. 回显服务器每条消息写一行日志 比较两种后端下的回显吞吐(库内部每次poll的LOG_INFO同样会走所选后端)
+ *
+ * 用法: async_logging_bench [linesPerThread] [echoSeconds] [logDir]
+ **/
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "AsyncLogging.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+using namespace std::placeholders;
+
+static const int kThreads = 8;
+static const uint16_t kPort = 9982;
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 同步后端: 所有线程共享一个FILE* fwrite内部会加锁
+static FILE *g_syncFile = nullptr;
+static void syncOutput(const char *msg, size_t len) { ::fwrite(msg, 1, len, g_syncFile); }
+static void syncFlush() { ::fflush(g_syncFile); }
+
+static void useSyncFile(const std::string &path)
+{
+    g_syncFile = ::fopen(path.c_str(), "w");
+    Logger::instance().setOutput(syncOutput);
+    Logger::instance().setFlush(syncFlush);
+}
+
+static void closeSyncFile()
+{
+    Logger::instance().setOutput([](const char *, size_t) {});
+    Logger::instance().setFlush(Logger::FlushFunc());
+    ::fclose(g_syncFile);
+    g_syncFile = nullptr;
+}
+
+static void useAsync(AsyncLogging *log)
+{
+    Logger::instance().setOutput(std::bind(&AsyncLogging::append, log, _1, _2));
+    Logger::instance().setFlush(std::bind(&AsyncLogging::flush, log));
+}
+
+// 所有线程同时开始写 返回前端耗时
+static double logFromThreads(int linesPerThread)
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool go = false;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return go; });
+            }
+            for (int i = 0; i < linesPerThread; ++i)
+            {
+                LOG_INFO("bench thread=%d seq=%d payload=%s", t, i, "abcdefghijklmnopqrstuvwxyz0123456789");
+            }
+        });
+    }
+    double start = nowSeconds();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        go = true;
+        cond.notify_all();
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    return nowSeconds() - start;
+}
+
+// 回显服务器 每条消息打一行INFO日志 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startEchoServer(EventLoop *loop)
+{
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "LogEcho"));
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        LOG_INFO("echo %lu bytes on %s", buffer->readableBytes(), conn->name().c_str());
+        conn->send(buffer->retrieveAllAsString());
+    });
+    server->setConnectionCallback([](const TcpConnectionPtr &) {});
+    server->start();
+    return server;
+}
+
+// 阻塞式ping-pong客户端 返回每秒完成的往返次数
+static double echoThroughput(int seconds, int connections)
+{
+    std::atomic<int64_t> roundTrips(0);
+    std::atomic_bool stop(false);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < connections; ++c)
+    {
+        clients.emplace_back([&]() {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof addr);
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(kPort);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            while (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            char msg[64];
+            ::memset(msg, 'p', sizeof msg);
+            char reply[64];
+            while (!stop)
+            {
+                if (::write(fd, msg, sizeof msg) != sizeof msg)
+                {
+                    break;
+                }
+                size_t got = 0;
+                while (got < sizeof reply)
+                {
+                    ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+                    if (n <= 0)
+                    {
+                        break;
+                    }
+                    got += n;
+                }
+                roundTrips.fetch_add(1);
+            }
+            ::close(fd);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    return static_cast<double>(roundTrips.load()) / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    int linesPerThread = argc > 1 ? atoi(argv[1]) : 200000;
+    int echoSeconds = argc > 2 ? atoi(argv[2]) : 3;
+    std::string dir = argc > 3 ? argv[3] : "/tmp";
+    const int64_t totalLines = static_cast<int64_t>(linesPerThread) * kThreads;
+
+    // 1. 多线程写日志
+    useSyncFile(dir + "/bench_sync.log");
+    double syncSeconds = logFromThreads(linesPerThread);
+    closeSyncFile();
+    printf("sync  file : %d threads %ld lines %.3fs %.0f lines/s\n",
+           kThreads, totalLines, syncSeconds, totalLines / syncSeconds);
+
+    {
+        AsyncLogging log(dir + "/bench_async", 512 * 1024 * 1024);
+        log.start();
+        useAsync(&log);
+        double frontSeconds = logFromThreads(linesPerThread);
+        log.flush();
+        double totalSeconds = frontSeconds;
+        Logger::instance().setOutput([](const char *, size_t) {});
+        Logger::instance().setFlush(Logger::FlushFunc());
+        log.stop();
+        printf("async file : %d threads %ld lines front-end %.3fs %.0f lines/s, dropped %ld (%.2f%%), written %ldMB\n",
+               kThreads, totalLines, totalSeconds, totalLines / totalSeconds, log.droppedLines(),
+               100.0 * log.droppedLines() / totalLines, log.writtenBytes() / (1024 * 1024));
+    }
+
+    // 2. 日志后端对回显吞吐的影响
+    BenchServerThread server;
+
+    useSyncFile(dir + "/bench_echo_sync.log");
+    server.start(startEchoServer);
+    double syncRate = echoThroughput(echoSeconds, 4);
+    server.stop();
+    closeSyncFile();
+
+    AsyncLogging log(dir + "/bench_echo_async", 512 * 1024 * 1024);
+    log.start();
+    useAsync(&log);
+    server.start(startEchoServer);
+    double asyncRate = echoThroughput(echoSeconds, 4);
+    server.stop();
+    Logger::instance().setOutput([](const char *, size_t) {});
+    log.stop();
+
+    printf("echo with sync  file logging: %.0f round trips/s\n", syncRate);
+    printf("echo with async file logging: %.0f round trips/s (dropped %ld lines)\n", asyncRate, log.droppedLines());
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * 二进制日志基准测试 比较同一条日志用文本LOG_INFO和二进制BLOG_INFO写入AsyncLogging时前端每次调用的耗时
+ * 两种日志各自写一个AsyncLogging 暂存区足够大 测出来的是前端开销(格式化/编码 + 拷贝进暂存区)
+ * 结束后可以用 logdecoder 把二进制文件还原成文本对照
+ *
+ * 用法: binary_logging_bench [callsPerThread] [threads] [logDir]
+ **/
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "AsyncLogging.h"
+#include "BinaryLog.h"
+#include "Logger.h"
+
+using namespace std::placeholders;
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 每个线程写callsPerThread次 返回所有调用的平均纳秒数
+template <typename Func>
+static double nanosPerCall(int threads, int callsPerThread, Func func)
+{
+    std::vector<std::thread> workers;
+    std::vector<double> seconds(threads);
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            double start = nowSeconds();
+            for (int i = 0; i < callsPerThread; ++i)
+            {
+                func(t, i);
+            }
+            seconds[t] = nowSeconds() - start;
+        });
+    }
+    double total = 0;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers[t].join();
+        total += seconds[t];
+    }
+    return total * 1e9 / (static_cast<double>(threads) * callsPerThread);
+}
+
+int main(int argc, char *argv[])
+{
+    int callsPerThread = argc > 1 ? atoi(argv[1]) : 1000000;
+    int threads = argc > 2 ? atoi(argv[2]) : 1;
+    std::string dir = argc > 3 ? argv[3] : "/tmp";
+    const std::string payload = "abcdefghijklmnopqrstuvwxyz";
+    const size_t stagingBytes = 16 * 1024 * 1024;
+
+    AsyncLogging textLog(dir + "/bench_text", 1024 * 1024 * 1024, 3, stagingBytes);
+    textLog.start();
+    Logger::instance().setOutput(std::bind(&AsyncLogging::append, &textLog, _1, _2));
+    Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &textLog));
+
+    AsyncLogging binaryLog(dir + "/bench_binary", 1024 * 1024 * 1024, 3, stagingBytes);
+    BinaryLog::attach(&binaryLog);
+    binaryLog.start();
+
+    double textNs = nanosPerCall(threads, callsPerThread, [&](int t, int i) {
+        LOG_INFO("conn %s#%d recv %d bytes seq=%ld ratio=%.3f", payload.c_str(), t, i & 4095, (long)i, i * 0.001);
+    });
+    double binaryNs = nanosPerCall(threads, callsPerThread, [&](int t, int i) {
+        BLOG_INFO("conn %s#%d recv %d bytes seq=%ld ratio=%.3f", payload, t, i & 4095, (long)i, i * 0.001);
+    });
+    double binaryIntNs = nanosPerCall(threads, callsPerThread, [&](int t, int i) {
+        BLOG_INFO("fd=%d events=%d seq=%ld", t, i & 7, (long)i);
+    });
+    // 被级别过滤掉的调用
+    double disabledNs = nanosPerCall(threads, callsPerThread, [&](int t, int i) {
+        BLOG_DEBUG("fd=%d events=%d", t, i);
+    });
+
+    textLog.flush();
+    binaryLog.flush();
+    Logger::instance().setOutput([](const char *, size_t) {});
+    Logger::instance().setFlush(Logger::FlushFunc());
+    BinaryLog::instance().setOutput(BinaryLog::OutputFunc());
+    textLog.stop();
+    binaryLog.stop();
+
+    const double calls = static_cast<double>(threads) * callsPerThread;
+    printf("%d threads x %d calls\n", threads, callsPerThread);
+    printf("text   LOG_INFO  (5 args, string) : %7.1f ns/call  written %6.1fMB  dropped %ld\n",
+           textNs, textLog.writtenBytes() / 1048576.0, textLog.droppedLines());
+    printf("binary BLOG_INFO (5 args, string) : %7.1f ns/call\n", binaryNs);
+    printf("binary BLOG_INFO (3 int args)     : %7.1f ns/call\n", binaryIntNs);
+    printf("binary BLOG_DEBUG (disabled)      : %7.1f ns/call\n", disabledNs);
+    printf("binary file written %.1fMB (%.1f bytes/record)  dropped %ld\n",
+           binaryLog.writtenBytes() / 1048576.0, binaryLog.writtenBytes() / (2 * calls), binaryLog.droppedLines());
+    printf("decode with: logdecoder %s/bench_binary.*.log\n", dir.c_str());
+    return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * 短连接建立速率
+ * 服务端: TcpServer 连接建立后发送1字节问候然后shutdown 相当于一个最短的请求
+ * 客户端: clientThreads个线程 每个线程循环 阻塞connect -> 读到问候 -> 读到EOF -> close
+ *         connect延迟从调用connect()算到读到问候为止 包括服务端accept、创建TcpConnection和第一次send
+ *
+ * 服务端先关闭 TIME_WAIT留在服务端一侧(四元组以服务端端口开头) 不会占用客户端的临时端口
+ * 对每个服务端线程数输出 accepts/s 和connect延迟的p50/p99/max
+ *
+ * 用法: connection_churn_bench [seconds] [serverThreads] [clientThreads]
+ *       serverThreads是逗号分隔的列表 例如 connection_churn_bench 3 0,1,2,4 4
+ **/
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "EventLoop.h"
+#include "Histogram.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9991;
+
+static std::atomic<int64_t> g_accepted(0);
+
+// 每个连接回一个字节就关闭 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startChurnServer(EventLoop *loop, int threads)
+{
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "ChurnServer"));
+    server->setThreadNum(threads);
+    server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            g_accepted.fetch_add(1, std::memory_order_relaxed);
+            conn->send("+", 1);
+            conn->shutdown();
+        }
+    });
+    server->start();
+    return server;
+}
+
+// 一个客户端线程 measuring为true之后的连接才计入直方图
+static void churn(const std::atomic<bool> *running, const std::atomic<bool> *measuring, Histogram *latency,
+                  int64_t *failures)
+{
+    struct sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    while (running->load(std::memory_order_relaxed))
+    {
+        int64_t start = MonotonicTime::now().nanoSeconds();
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            ++*failures;
+            continue;
+        }
+        char byte;
+        bool ok = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0 &&
+                  ::read(fd, &byte, 1) == 1;
+        int64_t end = MonotonicTime::now().nanoSeconds();
+        if (ok)
+        {
+            ok = ::read(fd, &byte, 1) == 0; // 等服务端关闭 保证TIME_WAIT在服务端
+        }
+        ::close(fd);
+        if (!measuring->load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+        if (ok)
+        {
+            latency->record(end - start);
+        }
+        else
+        {
+            ++*failures;
+        }
+    }
+}
+
+static void runPoint(int seconds, int serverThreads, int clientThreads)
+{
+    BenchServerThread server;
+    server.start([serverThreads](EventLoop *loop) { return startChurnServer(loop, serverThreads); });
+
+    std::atomic<bool> running(true);
+    std::atomic<bool> measuring(false);
+    std::vector<Histogram> latencies(static_cast<size_t>(clientThreads));
+    std::vector<int64_t> failures(static_cast<size_t>(clientThreads), 0);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < clientThreads; ++i)
+    {
+        clients.emplace_back(churn, &running, &measuring, &latencies[static_cast<size_t>(i)],
+                             &failures[static_cast<size_t>(i)]);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // 预热
+    int64_t acceptedBefore = g_accepted.load(std::memory_order_relaxed);
+    MonotonicTime start = MonotonicTime::now();
+    measuring = true;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    measuring = false;
+    int64_t accepted = g_accepted.load(std::memory_order_relaxed) - acceptedBefore;
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+    running = false;
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    server.stop();
+
+    Histogram latency;
+    int64_t failed = 0;
+    for (int i = 0; i < clientThreads; ++i)
+    {
+        latency.merge(latencies[static_cast<size_t>(i)]);
+        failed += failures[static_cast<size_t>(i)];
+    }
+    printf("%14d %14d %12.0f %10.1f %10.1f %10.1f %10lld\n", serverThreads, clientThreads,
+           static_cast<double>(accepted) / elapsed, static_cast<double>(latency.percentile(0.50)) / 1000,
+           static_cast<double>(latency.percentile(0.99)) / 1000, static_cast<double>(latency.max()) / 1000,
+           static_cast<long long>(failed));
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    const char *threadList = argc > 2 ? argv[2] : "0,1,2,4";
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 4;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    printf("%14s %14s %12s %10s %10s %10s %10s\n", "server threads", "client threads", "accepts/s", "p50 us",
+           "p99 us", "max us", "failures");
+    for (const char *p = threadList; p != nullptr && *p != '\0';)
+    {
+        runPoint(seconds, atoi(p), clientThreads);
+        p = strchr(p, ',');
+        p = p != nullptr ? p + 1 : nullptr;
+    }
+    return 0;
+}
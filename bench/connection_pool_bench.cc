@@ -0,0 +1,228 @@
+/**
+ * 连接池请求/响应延迟测试 客户端和服务端都在本进程内
+ * 服务端: TcpServer回显 每个请求msgSize字节 响应同样大小
+ * 客户端: clientThreads个loop 每个loop上concurrency个请求链 每条链 借连接 -> 发请求 -> 收完响应 -> 归还 -> 下一个请求
+ *
+ * 同样的流程跑两遍:
+ *   pooled              maxIdle = concurrency 连接一直复用
+ *   connect-per-request maxIdle = 0 且不限制maxTotal 每次归还都关闭 下一次请求重新建连
+ * 延迟从acquire开始计时 包含等待连接建立的时间
+ *
+ * 用法: connection_pool_bench [requestsPerLoop] [concurrency] [msgSize] [clientThreads] [serverThreads]
+ * connect-per-request会在客户端留下大量TIME_WAIT 请求数不要超过本机临时端口的数量
+ **/
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#include "ConnectionPool.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9984;
+
+// 回显服务器 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startEchoServer(EventLoop *loop, int threads)
+{
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "EchoServer"));
+    server->setThreadNum(threads);
+    server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        conn->send(buffer->retrieveAllAsString());
+    });
+    server->start();
+    return server;
+}
+
+// 一个客户端loop上的所有请求链 只在该loop线程中访问
+struct Runner
+{
+    EventLoop *loop = nullptr;
+    std::shared_ptr<LoopConnectionPool> pool;
+    int remaining = 0;     // 还没有发出的请求数
+    int activeChains = 0;
+    int failures = 0;
+    std::vector<int64_t> latencies; // ns
+};
+
+struct Shared
+{
+    InetAddress serverAddr{kPort};
+    std::string message;
+    std::mutex mutex;
+    std::condition_variable cond;
+    int runnersLeft = 0;
+};
+
+static void startRequest(Runner *r, Shared *shared);
+
+static void finishChain(Runner *r, Shared *shared)
+{
+    if (--r->activeChains == 0)
+    {
+        std::unique_lock<std::mutex> lock(shared->mutex);
+        --shared->runnersLeft;
+        shared->cond.notify_one();
+    }
+}
+
+static void startRequest(Runner *r, Shared *shared)
+{
+    if (r->remaining == 0)
+    {
+        finishChain(r, shared);
+        return;
+    }
+    --r->remaining;
+    MonotonicTime start = MonotonicTime::now();
+    const size_t size = shared->message.size();
+    r->pool->acquire(
+        shared->serverAddr,
+        [r, shared](const TcpConnectionPtr &conn) {
+            if (!conn)
+            {
+                // 不要在失败回调里直接递归 后端挂掉时会一直失败
+                ++r->failures;
+                r->loop->queueInLoop([r, shared]() { startRequest(r, shared); });
+                return;
+            }
+            conn->send(shared->message);
+        },
+        [r, shared, start, size](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            if (buffer->readableBytes() < size)
+            {
+                return;
+            }
+            buffer->retrieve(size);
+            r->latencies.push_back(MonotonicTime::now() - start);
+            r->pool->release(conn);
+            startRequest(r, shared);
+        },
+        [r, shared](const TcpConnectionPtr &) {
+            // 借用期间连接断开 当前请求作废
+            ++r->failures;
+            r->loop->queueInLoop([r, shared]() { startRequest(r, shared); });
+        });
+}
+
+static void runMode(const char *mode, EventLoopThreadPool &threads, size_t maxIdle, size_t maxTotal,
+                    int requestsPerLoop, int concurrency, int msgSize)
+{
+    ConnectionPool::Options options;
+    options.maxIdle = maxIdle;
+    options.maxTotal = maxTotal;
+    ConnectionPool pool("bench", options);
+
+    std::vector<EventLoop *> loops = threads.getAllLoops();
+    std::vector<std::unique_ptr<Runner>> runners;
+    Shared shared;
+    shared.message.assign(static_cast<size_t>(msgSize), 'x');
+    shared.runnersLeft = static_cast<int>(loops.size());
+
+    MonotonicTime start = MonotonicTime::now();
+    for (EventLoop *loop : loops)
+    {
+        Runner *r = new Runner;
+        r->loop = loop;
+        r->pool = pool.poolFor(loop);
+        r->remaining = requestsPerLoop;
+        r->activeChains = concurrency;
+        r->latencies.reserve(static_cast<size_t>(requestsPerLoop));
+        runners.emplace_back(r);
+        Shared *s = &shared;
+        loop->runInLoop([r, s, concurrency]() {
+            for (int i = 0; i < concurrency; ++i)
+            {
+                startRequest(r, s);
+            }
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(shared.mutex);
+        shared.cond.wait(lock, [&shared]() { return shared.runnersLeft == 0; });
+    }
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+
+    std::vector<int64_t> all;
+    int failures = 0;
+    for (std::unique_ptr<Runner> &r : runners)
+    {
+        all.insert(all.end(), r->latencies.begin(), r->latencies.end());
+        failures += r->failures;
+    }
+    std::sort(all.begin(), all.end());
+    double sum = 0;
+    for (int64_t ns : all)
+    {
+        sum += static_cast<double>(ns);
+    }
+    auto pct = [&all](double p) -> double {
+        if (all.empty())
+        {
+            return 0;
+        }
+        size_t index = std::min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())));
+        return static_cast<double>(all[index]) / 1000.0;
+    };
+    ConnectionPool::Stats stats = pool.stats();
+    printf("%-20s %8zu req %9.0f req/s  mean %7.1f us  p50 %7.1f us  p99 %7.1f us  max %8.1f us  "
+           "created %ld reused %ld failures %d\n",
+           mode, all.size(), static_cast<double>(all.size()) / elapsed,
+           all.empty() ? 0.0 : sum / static_cast<double>(all.size()) / 1000.0,
+           pct(0.50), pct(0.99), pct(1.0), stats.created, stats.reused, failures);
+
+    // 连接池在loop线程中关闭空闲连接 等它执行完再析构Runner
+    for (std::unique_ptr<Runner> &r : runners)
+    {
+        r->pool.reset();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int requestsPerLoop = argc > 1 ? atoi(argv[1]) : 10000;
+    int concurrency = argc > 2 ? atoi(argv[2]) : 4;
+    int msgSize = argc > 3 ? atoi(argv[3]) : 128;
+    int clientThreads = argc > 4 ? atoi(argv[4]) : 1;
+    int serverThreads = argc > 5 ? atoi(argv[5]) : 1;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    BenchServerThread server;
+    server.start([serverThreads](EventLoop *serverLoop) { return startEchoServer(serverLoop, serverThreads); });
+
+    EventLoop loop;
+    EventLoopThreadPool threads(&loop, "client");
+    threads.setThreadNum(clientThreads);
+    threads.start();
+
+    printf("%d requests per loop, concurrency %d, %d bytes, client threads %d, server threads %d\n",
+           requestsPerLoop, concurrency, msgSize, clientThreads, serverThreads);
+    runMode("pooled", threads, static_cast<size_t>(concurrency), static_cast<size_t>(concurrency),
+            requestsPerLoop, concurrency, msgSize);
+    // 不限制总数 否则正在关闭的连接占着名额 新请求会排队拿到别人归还的连接 不是真正的每次新建
+    runMode("connect-per-request", threads, 0, 1 << 20, requestsPerLoop, concurrency, msgSize);
+
+    // 等待各个loop中关闭连接的任务执行完
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    server.stop();
+    return 0;
+}
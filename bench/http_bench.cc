@@ -0,0 +1,293 @@
+/**
+ * HttpServer的吞吐和延迟 自带负载生成器
+ * 服务端: HttpServer对GET /hello返回13字节的文本
+ * 客户端: 一个loop线程 connections个keep-alive连接 每个连接保持pipeline个请求在途
+ *         收到一个完整响应就补发一个请求 记录每个请求从发出到收到响应的时间
+ *
+ * 统计稳定阶段整个进程的operator new次数 换算成每个请求的堆分配次数
+ * 负载生成器本身也不分配内存(请求预先拼好 响应就地解析) 结果应该接近0
+ *
+ * 用法: http_bench [seconds] [connections] [pipeline] [serverThreads] [port]
+ *       给出port时不启动内置服务器 只对127.0.0.1:port发起负载 例如example/http/http_server
+ **/
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "EventLoop.h"
+#include "HttpParser.h"
+#include "HttpServer.h"
+#include "Logger.h"
+#include "TcpClient.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9993;
+static const int kMaxPipeline = 256;
+static const int kMaxLatencyUs = 100 * 1000; // 直方图按1us分桶 超过100ms的记在最后一个桶
+
+static std::atomic<int64_t> g_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+// 被测的HttpServer 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startHttpServer(EventLoop *loop, int threads)
+{
+    std::shared_ptr<HttpServer> server(new HttpServer(loop, InetAddress(kPort), "HttpBench"));
+    server->setThreadNum(threads);
+    server->setHttpCallback([](const HttpRequest &req, HttpResponse *resp) {
+        if (req.path() == "/hello")
+        {
+            resp->setContentType("text/plain");
+            resp->setBody("hello, world\n");
+        }
+        else
+        {
+            resp->setStatusCode(404);
+        }
+    });
+    server->start();
+    return server;
+}
+
+// 负载生成器的一个连接
+struct ClientConn
+{
+    TcpConnectionPtr conn;
+    int64_t sentNs[kMaxPipeline]; // 在途请求的发送时间 环形队列
+    int head = 0;
+    int inflight = 0;
+};
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(EventLoop *loop, uint16_t port, int connections, int pipeline)
+        : loop_(loop)
+        , pipeline_(std::min(pipeline, kMaxPipeline))
+        , histogram_(kMaxLatencyUs + 1, 0)
+        , conns_(connections)
+    {
+        const std::string request = "GET /hello HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\n\r\n";
+        requestLen_ = request.size();
+        for (int i = 0; i < pipeline_; ++i)
+        {
+            requests_ += request; // 连续pipeline个请求 补发时发送前n个
+        }
+        for (int i = 0; i < connections; ++i)
+        {
+            clients_.emplace_back(new TcpClient(loop, InetAddress(port, "127.0.0.1"), "HttpLoad"));
+            ClientConn *state = &conns_[i];
+            clients_.back()->setConnectionCallback([this, state](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    state->conn = conn;
+                    sendRequests(state, pipeline_);
+                }
+                else
+                {
+                    state->conn.reset();
+                }
+            });
+            clients_.back()->setMessageCallback(
+                [this, state](const TcpConnectionPtr &, Buffer *buf, Timestamp) { onResponse(state, buf); });
+        }
+    }
+
+    void start()
+    {
+        for (auto &client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    void stop()
+    {
+        for (size_t i = 0; i < clients_.size(); ++i)
+        {
+            conns_[i].conn.reset();
+            clients_[i]->disconnect();
+        }
+    }
+
+    // 开始一个统计窗口
+    void resetStats()
+    {
+        completed_ = 0;
+        errors_ = 0;
+        std::fill(histogram_.begin(), histogram_.end(), 0);
+    }
+
+    int64_t completed() const { return completed_; }
+    int64_t errors() const { return errors_; }
+
+    double percentileMs(double p) const
+    {
+        int64_t target = static_cast<int64_t>(p * static_cast<double>(completed_));
+        int64_t seen = 0;
+        for (size_t us = 0; us < histogram_.size(); ++us)
+        {
+            seen += histogram_[us];
+            if (seen > target)
+            {
+                return static_cast<double>(us) / 1000.0;
+            }
+        }
+        return static_cast<double>(kMaxLatencyUs) / 1000.0;
+    }
+
+private:
+    void sendRequests(ClientConn *state, int n)
+    {
+        int64_t now = MonotonicTime::now().nanoSeconds();
+        for (int i = 0; i < n; ++i)
+        {
+            state->sentNs[(state->head + state->inflight) % kMaxPipeline] = now;
+            ++state->inflight;
+        }
+        // 在loop线程中直接发送 不构造std::string
+        state->conn->send(requests_.data(), requestLen_ * static_cast<size_t>(n));
+    }
+
+    void onResponse(ClientConn *state, Buffer *buf)
+    {
+        int64_t now = MonotonicTime::now().nanoSeconds();
+        int done = 0;
+        for (;;)
+        {
+            const char *begin = buf->peek();
+            const char *end = begin + buf->readableBytes();
+            const char *headerEnd = HttpParser::findHeaderEnd(begin, end);
+            if (headerEnd == nullptr)
+            {
+                break;
+            }
+            static const char kLength[] = "Content-Length: ";
+            const char *field = static_cast<const char *>(
+                ::memmem(begin, headerEnd - begin, kLength, sizeof kLength - 1));
+            size_t bodyLen = field != nullptr ? static_cast<size_t>(::atol(field + sizeof kLength - 1)) : 0;
+            size_t total = static_cast<size_t>(headerEnd + 4 - begin) + bodyLen;
+            if (buf->readableBytes() < total)
+            {
+                break;
+            }
+            if (::memcmp(begin, "HTTP/1.1 200", 12) != 0)
+            {
+                ++errors_;
+            }
+            int64_t us = (now - state->sentNs[state->head]) / 1000;
+            ++histogram_[static_cast<size_t>(std::min<int64_t>(std::max<int64_t>(us, 0), kMaxLatencyUs))];
+            state->head = (state->head + 1) % kMaxPipeline;
+            --state->inflight;
+            ++completed_;
+            ++done;
+            buf->retrieve(total);
+        }
+        if (done > 0 && state->conn)
+        {
+            sendRequests(state, done);
+        }
+    }
+
+    EventLoop *loop_;
+    const int pipeline_;
+    std::string requests_;
+    size_t requestLen_;
+    std::vector<int64_t> histogram_;
+    std::vector<ClientConn> conns_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+    int64_t completed_ = 0;
+    int64_t errors_ = 0;
+};
+
+static void runLoad(const char *label, uint16_t port, int seconds, int connections, int pipeline)
+{
+    EventLoop loop;
+    LoadGenerator load(&loop, port, connections, pipeline);
+    load.start();
+
+    // 先跑0.5秒预热 让连接建好、各个Buffer长到稳定大小 之后才开始统计
+    int64_t allocBefore = 0;
+    MonotonicTime start;
+    loop.runAfter(0.5, [&]() {
+        load.resetStats();
+        allocBefore = g_allocations.load(std::memory_order_relaxed);
+        start = MonotonicTime::now();
+    });
+    int64_t allocations = 0;
+    double elapsed = 0;
+    loop.runAfter(0.5 + seconds, [&]() {
+        allocations = g_allocations.load(std::memory_order_relaxed) - allocBefore;
+        elapsed = (MonotonicTime::now() - start) / 1e9;
+        loop.quit();
+    });
+    loop.loop();
+
+    int64_t completed = load.completed();
+    load.stop();
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+
+    if (completed == 0)
+    {
+        printf("%-12s no response\n", label);
+        return;
+    }
+    printf("%-12s conns %4d  pipeline %3d  %9.0f req/s  p50 %6.3f ms  p99 %6.3f ms  p99.9 %6.3f ms"
+           "  errors %lld  allocs/req %.4f\n",
+           label, connections, pipeline, static_cast<double>(completed) / elapsed,
+           load.percentileMs(0.50), load.percentileMs(0.99), load.percentileMs(0.999),
+           static_cast<long long>(load.errors()),
+           static_cast<double>(allocations) / static_cast<double>(completed));
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int connections = argc > 2 ? atoi(argv[2]) : 32;
+    int pipeline = argc > 3 ? atoi(argv[3]) : 16;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 1;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 0);
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    BenchServerThread server; // 指定了port时压测外部的服务器 不启动
+    if (port == 0)
+    {
+        port = kPort;
+        server.start([serverThreads](EventLoop *loop) { return startHttpServer(loop, serverThreads); });
+    }
+
+    runLoad("keep-alive", port, seconds, connections, 1);
+    if (pipeline > 1)
+    {
+        runLoad("pipelined", port, seconds, connections, pipeline);
+    }
+
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,285 @@
+/**
+ * 空闲连接密度
+ * 服务端: TcpServer 什么也不做 只统计在线连接数
+ * 客户端: 主线程用阻塞connect依次建立connections个连接 之后保持不动
+ *         每个源地址(127.0.0.x)最多kConnectionsPerSource个连接 超过后换下一个地址
+ *         配合IP_BIND_ADDRESS_NO_PORT 连接数不受单个源地址临时端口范围的限制 可以扩展到百万级
+ *
+ * 对每个服务端线程数输出:
+ *   建连速率
+ *   每个连接的进程RSS增量(客户端只多一个fd 基本都是服务端TcpConnection、Channel和两个Buffer的开销)
+ *   每个连接占用的内核TCP缓冲内存(/proc/net/sockstat的mem 两端一起算 只统计收发缓冲 完全空闲时应该接近0)
+ *   空闲idleSeconds秒内各个loop线程的CPU占用
+ *
+ * 客户端和服务端在同一个进程 每个连接占两个fd 会先把RLIMIT_NOFILE提到硬上限 不够时减少连接数
+ * 百万连接还需要调大 fs.nr_open、net.core.somaxconn 以及内存
+ *
+ * 用法: idle_connections_bench [connections] [serverThreads] [idleSeconds]
+ *       serverThreads是逗号分隔的列表 例如 idle_connections_bench 100000 1,4 5
+ **/
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9992;
+static const int kConnectionsPerSource = 20000; // 小于默认临时端口范围(约28000)
+
+#ifndef IP_BIND_ADDRESS_NO_PORT
+#define IP_BIND_ADDRESS_NO_PORT 24
+#endif
+
+class IdleServerThread
+{
+public:
+    explicit IdleServerThread(int threads) : threads_(threads), online_(0) {}
+
+    void start()
+    {
+        thread_.start([this](EventLoop *loop) {
+            addLoopClock(); // baseLoop只负责accept
+            std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "IdleServer"));
+            server->setThreadNum(threads_);
+            server->setThreadInitCallback([this](EventLoop *) { addLoopClock(); });
+            server->setConnectionCallback([this](const TcpConnectionPtr &conn) {
+                online_.fetch_add(conn->connected() ? 1 : -1, std::memory_order_relaxed);
+            });
+            server->start();
+            return server;
+        });
+    }
+
+    void stop() { thread_.stop(); }
+
+    int64_t online() const { return online_.load(std::memory_order_relaxed); }
+
+    // 各个loop线程已经用掉的CPU时间 第一个是baseLoop
+    std::vector<int64_t> loopCpuNs()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::vector<int64_t> ns;
+        for (clockid_t clock : clocks_)
+        {
+            struct timespec ts;
+            ::clock_gettime(clock, &ts);
+            ns.push_back(static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec);
+        }
+        return ns;
+    }
+
+private:
+    void addLoopClock()
+    {
+        clockid_t clock;
+        if (::pthread_getcpuclockid(::pthread_self(), &clock) == 0)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            clocks_.push_back(clock);
+        }
+    }
+
+    int threads_;
+    std::atomic<int64_t> online_;
+    BenchServerThread thread_;
+    std::mutex mutex_; // 保护clocks_ loop线程启动时添加
+    std::vector<clockid_t> clocks_;
+};
+
+static int64_t residentBytes()
+{
+    long pages = 0;
+    long resident = 0;
+    FILE *fp = ::fopen("/proc/self/statm", "r");
+    if (fp != nullptr)
+    {
+        if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        ::fclose(fp);
+    }
+    return static_cast<int64_t>(resident) * ::sysconf(_SC_PAGESIZE);
+}
+
+// /proc/net/sockstat中"TCP: ... mem N"的N 单位是页
+static int64_t kernelTcpBytes()
+{
+    int64_t pages = 0;
+    char line[256];
+    FILE *fp = ::fopen("/proc/net/sockstat", "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        const char *mem = strstr(line, " mem ");
+        if (strncmp(line, "TCP:", 4) == 0 && mem != nullptr)
+        {
+            pages = atoll(mem + 5);
+        }
+    }
+    ::fclose(fp);
+    return pages * ::sysconf(_SC_PAGESIZE);
+}
+
+// 从第source个源地址(127.0.0.1起)连接服务端 失败返回-1
+static int connectFrom(int source)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof on); // 端口推迟到connect时按四元组分配
+
+    struct sockaddr_in local;
+    ::memset(&local, 0, sizeof local);
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + static_cast<uint32_t>(source) % 250 +
+                                  (static_cast<uint32_t>(source) / 250 << 8));
+    struct sockaddr_in server;
+    ::memset(&server, 0, sizeof server);
+    server.sin_family = AF_INET;
+    server.sin_port = htons(kPort);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&local), sizeof local) < 0 ||
+        ::connect(fd, reinterpret_cast<struct sockaddr *>(&server), sizeof server) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool waitOnline(const IdleServerThread &server, int64_t expected)
+{
+    for (int i = 0; i < 2000 && server.online() != expected; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return server.online() == expected;
+}
+
+static void runPoint(int connections, int threads, int idleSeconds)
+{
+    IdleServerThread server(threads);
+    server.start();
+
+    std::vector<int> fds;
+    fds.reserve(static_cast<size_t>(connections));
+    int64_t rssBefore = residentBytes();
+    int64_t kernelBefore = kernelTcpBytes();
+
+    MonotonicTime start = MonotonicTime::now();
+    int savedErrno = 0;
+    for (int i = 0; i < connections; ++i)
+    {
+        int fd = connectFrom(i / kConnectionsPerSource);
+        if (fd < 0)
+        {
+            savedErrno = errno;
+            break;
+        }
+        fds.push_back(fd);
+    }
+    double connectSeconds = (MonotonicTime::now() - start) / 1e9;
+    int64_t opened = static_cast<int64_t>(fds.size());
+    if (opened < connections)
+    {
+        printf("# only %lld of %d connections opened: %s\n", static_cast<long long>(opened), connections,
+               strerror(savedErrno));
+    }
+    if (!waitOnline(server, opened))
+    {
+        printf("# server sees %lld of %lld connections\n", static_cast<long long>(server.online()),
+               static_cast<long long>(opened));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 让最后一批连接的回调和分配都完成
+    int64_t rssPerConn = opened > 0 ? (residentBytes() - rssBefore) / opened : 0;
+    int64_t kernelPerConn = opened > 0 ? (kernelTcpBytes() - kernelBefore) / opened : 0;
+
+    std::vector<int64_t> cpuBefore = server.loopCpuNs();
+    MonotonicTime idleStart = MonotonicTime::now();
+    std::this_thread::sleep_for(std::chrono::seconds(idleSeconds));
+    std::vector<int64_t> cpuAfter = server.loopCpuNs();
+    double idleNs = static_cast<double>(MonotonicTime::now() - idleStart);
+    double totalCpu = 0;
+    double maxCpu = 0;
+    for (size_t i = 0; i < cpuBefore.size() && i < cpuAfter.size(); ++i)
+    {
+        double percent = 100.0 * static_cast<double>(cpuAfter[i] - cpuBefore[i]) / idleNs;
+        totalCpu += percent;
+        maxCpu = std::max(maxCpu, percent);
+    }
+
+    printf("%7d %11lld %11.0f %13lld %16lld %12.3f %12.3f\n", threads, static_cast<long long>(opened),
+           static_cast<double>(opened) / connectSeconds, static_cast<long long>(rssPerConn),
+           static_cast<long long>(kernelPerConn), totalCpu, maxCpu);
+    fflush(stdout);
+
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    waitOnline(server, 0);
+    server.stop();
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 10000;
+    const char *threadList = argc > 2 ? argv[2] : "1,2,4";
+    int idleSeconds = argc > 3 ? atoi(argv[3]) : 3;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        // 每个连接两个fd 另外留一些给loop的epoll/eventfd/timerfd
+        int maxConnections = static_cast<int>(std::min<rlim_t>((limit.rlim_cur - 256) / 2, INT32_MAX));
+        if (connections > maxConnections)
+        {
+            printf("# RLIMIT_NOFILE %llu allows %d connections, requested %d\n",
+                   static_cast<unsigned long long>(limit.rlim_cur), maxConnections, connections);
+            connections = maxConnections;
+        }
+    }
+
+    printf("%7s %11s %11s %13s %16s %12s %12s\n", "threads", "connections", "connects/s", "rss B/conn",
+           "kbuf B/conn", "idle cpu%", "max loop%");
+    for (const char *p = threadList; p != nullptr && *p != '\0';)
+    {
+        runPoint(connections, atoi(p), idleSeconds);
+        p = strchr(p, ',');
+        p = p != nullptr ? p + 1 : nullptr;
+    }
+    return 0;
+}
@@ -0,0 +1,241 @@
+/**
+ * 新连接分发策略对比: 轮询 vs 按SO_INCOMING_CPU分发到绑定在收包CPU上的subloop
+ * 服务端: threads个subloop 依次绑定到CPU 0..n-1 回显收到的消息
+ *         每条消息在loop线程里比较sched_getcpu()和连接的SO_INCOMING_CPU 统计同CPU/跨CPU处理的消息数
+ * 客户端: threads个线程 同样依次绑定到CPU 每个线程connections个连接做ping-pong
+ *         回环上收包软中断跑在发送方的CPU上 所以连接的收包CPU就是对应客户端线程的CPU
+ *
+ * 只有一个CPU时两种策略没有区别 所有消息都是同CPU处理
+ * 用法: incoming_cpu_bench [threads] [connections] [msgSize] [seconds]
+ **/
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9987;
+
+struct LoopCounter
+{
+    std::atomic<int64_t> local{0};
+    std::atomic<int64_t> cross{0};
+    char pad[48]; // 每个loop一份 避免相邻计数器共享缓存行
+};
+
+static thread_local LoopCounter *tCounter = nullptr;
+
+static void pinThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    ::sched_setaffinity(0, sizeof set, &set);
+}
+
+// 在独立线程里运行的回显服务器
+class EchoServerThread
+{
+public:
+    EchoServerThread(int threads, int numCpus, bool incomingCpu)
+        : threads_(threads), numCpus_(numCpus), incomingCpu_(incomingCpu), counters_(threads) {}
+
+    void start()
+    {
+        for (std::unique_ptr<LoopCounter> &counter : counters_)
+        {
+            counter.reset(new LoopCounter);
+        }
+        thread_.start([this](EventLoop *loop) {
+            std::shared_ptr<TcpServer> server(
+                new TcpServer(loop, InetAddress(kPort), incomingCpu_ ? "IncomingCpu" : "RoundRobin"));
+            std::vector<int> cpus;
+            for (int i = 0; i < threads_; ++i)
+            {
+                cpus.push_back(i % numCpus_);
+            }
+            std::atomic_int nextCounter(0); // io线程在server->start()返回前都已经初始化
+            server->setThreadNum(threads_);
+            server->setThreadCpus(cpus);
+            server->setIncomingCpuDispatch(incomingCpu_);
+            server->setThreadInitCallback([this, &nextCounter](EventLoop *) {
+                tCounter = counters_[nextCounter.fetch_add(1)].get();
+            });
+            server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                }
+            });
+            server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+                int incoming = sockets::getIncomingCpu(conn->fd());
+                if (incoming < 0 || incoming == ::sched_getcpu())
+                {
+                    tCounter->local.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    tCounter->cross.fetch_add(1, std::memory_order_relaxed);
+                }
+                conn->send(buffer->retrieveAllAsString());
+            });
+            server->start();
+            server_ = server.get();
+            return server;
+        });
+    }
+
+    void stop()
+    {
+        thread_.runInLoopAndWait([this]() {
+            hits_ = server_->incomingCpuHits();
+            misses_ = server_->incomingCpuMisses();
+        });
+        thread_.stop();
+        server_ = nullptr;
+    }
+
+    int64_t local() const
+    {
+        int64_t sum = 0;
+        for (const std::unique_ptr<LoopCounter> &counter : counters_)
+        {
+            sum += counter->local.load();
+        }
+        return sum;
+    }
+
+    int64_t cross() const
+    {
+        int64_t sum = 0;
+        for (const std::unique_ptr<LoopCounter> &counter : counters_)
+        {
+            sum += counter->cross.load();
+        }
+        return sum;
+    }
+
+    int64_t hits() const { return hits_; }
+    int64_t misses() const { return misses_; }
+
+private:
+    int threads_;
+    int numCpus_;
+    bool incomingCpu_;
+    std::vector<std::unique_ptr<LoopCounter>> counters_;
+    BenchServerThread thread_;
+    TcpServer *server_ = nullptr; // 只在loop线程中访问
+    int64_t hits_ = 0;
+    int64_t misses_ = 0;
+};
+
+// 一个客户端线程 绑定到cpu connections个连接做ping-pong 返回收到的消息数
+static int64_t runClientThread(int cpu, int connections, int msgSize, int seconds)
+{
+    pinThread(cpu);
+    EventLoop loop;
+    const std::string message(static_cast<size_t>(msgSize), 'c');
+    int64_t messages = 0;
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(new TcpClient(&loop, InetAddress(kPort), "client"));
+        TcpClient *client = clients.back().get();
+        client->setConnectionCallback([&message](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                conn->send(message);
+            }
+        });
+        client->setMessageCallback([&message, &messages](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            while (buffer->readableBytes() >= message.size())
+            {
+                buffer->retrieve(message.size());
+                ++messages;
+                conn->send(message);
+            }
+        });
+        client->connect();
+    }
+    loop.runAfter(seconds, [&loop]() { loop.quit(); });
+    loop.loop();
+
+    for (std::unique_ptr<TcpClient> &client : clients)
+    {
+        client->disconnect();
+    }
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    return messages;
+}
+
+static void runMode(bool incomingCpu, int threads, int numCpus, int connections, int msgSize, int seconds)
+{
+    EchoServerThread server(threads, numCpus, incomingCpu);
+    server.start();
+
+    std::vector<int64_t> messages(threads);
+    std::vector<std::thread> clientThreads;
+    for (int i = 0; i < threads; ++i)
+    {
+        clientThreads.emplace_back([&messages, i, numCpus, connections, msgSize, seconds]() {
+            messages[i] = runClientThread(i % numCpus, connections, msgSize, seconds);
+        });
+    }
+    for (std::thread &t : clientThreads)
+    {
+        t.join();
+    }
+    server.stop();
+
+    int64_t total = 0;
+    for (int64_t n : messages)
+    {
+        total += n;
+    }
+    int64_t local = server.local();
+    int64_t cross = server.cross();
+    double handled = static_cast<double>(std::max<int64_t>(local + cross, 1));
+    printf("%-12s %10.0f msg/s  same-cpu %5.1f%%  cross-cpu %5.1f%%  dispatch hits %lld misses %lld\n",
+           incomingCpu ? "incoming-cpu" : "round-robin",
+           static_cast<double>(total) / seconds,
+           100.0 * static_cast<double>(local) / handled, 100.0 * static_cast<double>(cross) / handled,
+           static_cast<long long>(server.hits()), static_cast<long long>(server.misses()));
+}
+
+int main(int argc, char *argv[])
+{
+    int numCpus = static_cast<int>(::sysconf(_SC_NPROCESSORS_ONLN));
+    int threads = argc > 1 ? atoi(argv[1]) : std::max(numCpus, 2);
+    int connections = argc > 2 ? atoi(argv[2]) : 8;
+    int msgSize = argc > 3 ? atoi(argv[3]) : 64;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    printf("%d cpus, %d server loops, %d client threads x %d connections, %d bytes\n",
+           numCpus, threads, threads, connections, msgSize);
+    if (numCpus < 2)
+    {
+        printf("only one cpu online, both policies handle every message on the same cpu\n");
+    }
+    runMode(false, threads, numCpus, connections, msgSize, seconds);
+    runMode(true, threads, numCpus, connections, msgSize, seconds);
+    return 0;
+}
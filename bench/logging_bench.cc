@@ -0,0 +1,82 @@
+/**
+ * 日志前端开销基准测试
+ * 1. 被运行期阈值过滤掉的 LOG_DEBUG / LOG_STREAM(DEBUG) / LOG_MODULE_DEBUG 每条语句的耗时
+ * 2. 输出到空后端时 LOG_INFO(printf风格) 和 LOG_STREAM(INFO) 的格式化耗时
+ * 空后端只统计字节数 测出来的就是前端本身的开销 不包括写文件
+ *
+ * 用法: logging_bench [iterations]
+ **/
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Logger.h"
+
+static LogModule s_benchLog("LoggingBench");
+
+static int64_t g_outputBytes = 0;
+static void nullOutput(const char *, size_t len) { g_outputBytes += static_cast<int64_t>(len); }
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 防止编译器把循环体整个优化掉
+static volatile int g_sink = 0;
+
+template <typename Func>
+static void run(const char *name, int iterations, Func func)
+{
+    int64_t before = g_outputBytes;
+    double start = nowSeconds();
+    for (int i = 0; i < iterations; ++i)
+    {
+        func(i);
+    }
+    double seconds = nowSeconds() - start;
+    printf("%-40s %8.2f ns/call  %10.0f calls/s  output %ld bytes\n",
+           name, seconds * 1e9 / iterations, iterations / seconds, g_outputBytes - before);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 5000000;
+    std::string payload = "abcdefghijklmnopqrstuvwxyz";
+
+    Logger::instance().setOutput(nullOutput);
+    Logger::instance().setFlush(Logger::FlushFunc());
+    Logger::setLogLevel(INFO);
+
+    run("disabled LOG_DEBUG", iterations, [&](int i) {
+        LOG_DEBUG("seq=%d payload=%s value=%f", i, payload.c_str(), i * 0.5);
+        g_sink = i;
+    });
+    run("disabled LOG_STREAM(DEBUG)", iterations, [&](int i) {
+        LOG_STREAM(DEBUG) << "seq=" << i << " payload=" << payload << " value=" << i * 0.5;
+        g_sink = i;
+    });
+    run("disabled LOG_MODULE_DEBUG", iterations, [&](int i) {
+        LOG_MODULE_DEBUG(s_benchLog, "seq=%d payload=%s", i, payload.c_str());
+        g_sink = i;
+    });
+
+    run("enabled LOG_INFO -> null", iterations, [&](int i) {
+        LOG_INFO("seq=%d payload=%s fd=%d", i, payload.c_str(), i & 1023);
+    });
+    run("enabled LOG_STREAM(INFO) -> null", iterations, [&](int i) {
+        LOG_STREAM(INFO) << "seq=" << i << " payload=" << payload << " fd=" << (i & 1023);
+    });
+
+    // 只打开一个模块的DEBUG 全局阈值不变
+    Logger::setModuleLevel("LoggingBench", DEBUG);
+    run("enabled LOG_MODULE_DEBUG -> null", iterations, [&](int i) {
+        LOG_MODULE_DEBUG(s_benchLog, "seq=%d payload=%s", i, payload.c_str());
+    });
+    run("global LOG_DEBUG still disabled", iterations, [&](int i) {
+        LOG_DEBUG("seq=%d payload=%s", i, payload.c_str());
+        g_sink = i;
+    });
+    return 0;
+}
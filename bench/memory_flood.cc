@@ -0,0 +1,167 @@
+/**
+ * 内存预算洪水测试
+ * 服务端在收到数据后故意不取走(模拟处理不过来的业务) 客户端不断增加连接并尽可能快地发送数据
+ * 每秒打印一次全局缓存字节数、被暂停/拒绝/关闭的连接数 用来观察MemoryBudget是否把占用压在预算附近
+ *
+ * 用法: memory_flood [connections] [budgetKB] [seconds] [ioThreads] [policy]
+ *       policy: pause | close | pause+close  (都会带上拒绝新连接)
+ * 库本身的LOG_INFO输出到stdout 建议 ./memory_flood > /dev/null 只看stderr上的统计
+ **/
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 9981;
+
+static int connectNonblocking()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// 每个客户端线程负责一部分连接 在前一半时间内逐渐把连接建立起来 然后一直写
+static void floodThread(int numConns, int seconds, std::atomic_bool *stop, std::atomic<int64_t> *sent)
+{
+    std::vector<int> fds;
+    std::vector<char> chunk(16 * 1024, 'x');
+    auto start = std::chrono::steady_clock::now();
+    const double openWindow = seconds / 2.0;
+
+    while (!stop->load())
+    {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        int target = elapsed >= openWindow ? numConns : static_cast<int>(numConns * elapsed / openWindow);
+        while (static_cast<int>(fds.size()) < target)
+        {
+            int fd = connectNonblocking();
+            if (fd < 0)
+            {
+                break;
+            }
+            fds.push_back(fd);
+        }
+
+        bool progressed = false;
+        for (int &fd : fds)
+        {
+            if (fd < 0)
+            {
+                continue;
+            }
+            ssize_t n = ::write(fd, chunk.data(), chunk.size());
+            if (n > 0)
+            {
+                sent->fetch_add(n);
+                progressed = true;
+            }
+            else if (n < 0 && errno != EAGAIN)
+            {
+                ::close(fd); // 被服务器拒绝或者关闭了
+                fd = -1;
+            }
+        }
+        if (!progressed)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 200;
+    size_t budgetKB = argc > 2 ? atol(argv[2]) : 4096;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+    int ioThreads = argc > 4 ? atoi(argv[4]) : 2;
+    std::string policyName = argc > 5 ? argv[5] : "pause";
+
+    int policy = MemoryBudget::kRejectNew;
+    if (policyName.find("pause") != std::string::npos)
+    {
+        policy |= MemoryBudget::kPauseReading;
+    }
+    if (policyName.find("close") != std::string::npos)
+    {
+        policy |= MemoryBudget::kCloseLargest;
+    }
+
+    ::signal(SIGPIPE, SIG_IGN); // 服务器关闭连接后客户端继续写会收到SIGPIPE
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "MemoryFlood");
+    server.setThreadNum(ioThreads);
+    server.setMemoryBudget(budgetKB * 1024, policy);
+    // 故意不retrieve 让数据堆积在inputBuffer_中
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *, Timestamp) {});
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.start();
+
+    std::atomic_bool stop(false);
+    std::atomic<int64_t> sent(0);
+    const int clientThreads = 2;
+    std::vector<std::thread> clients;
+    for (int i = 0; i < clientThreads; ++i)
+    {
+        clients.emplace_back(floodThread, connections / clientThreads, seconds, &stop, &sent);
+    }
+
+    std::thread reporter([&]() {
+        const std::shared_ptr<MemoryBudget> &budget = server.memoryBudget();
+        int64_t peak = 0;
+        for (int i = 1; i <= seconds; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            int64_t usage = budget->usage();
+            peak = std::max(peak, usage);
+            fprintf(stderr, "t=%ds usage=%ldKB limit=%luKB sent=%ldKB paused=%ld rejected=%ld closed=%ld\n",
+                    i, usage / 1024, budget->limit() / 1024, sent.load() / 1024,
+                    budget->pausedConnections(), budget->rejectedConnections(), budget->closedConnections());
+        }
+        fprintf(stderr, "peak usage=%ldKB (%.2fx budget)\n", peak / 1024,
+                static_cast<double>(peak) / budget->limit());
+        stop = true;
+        loop.quit();
+    });
+
+    loop.loop();
+    reporter.join();
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    return 0;
+}
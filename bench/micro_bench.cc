@@ -0,0 +1,334 @@
+/**
+ * 核心组件的微基准测试 用来把性能回退定位到具体的组件
+ * 只用socketpair和eventfd 不走网络 在同一台CI机器上结果稳定
+ *
+ *   Buffer      append/retrieve 不同大小、makeSpace扩容和挪动、readFd从socketpair读
+ *   queueInLoop 跨线程投递到执行的延迟分布 批量投递的吞吐
+ *   Channel     handleEvent的分发开销 eventfd经过epoll到回调的一次完整循环
+ *   Logger      被过滤掉的LOG_DEBUG 输出到空后端的LOG_INFO
+ *
+ * 每个用例先自动标定迭代次数(单次至少kMinRunNs) 再重复repetitions次 输出中位数和最小值
+ *
+ * 用法: micro_bench [filter] [repetitions]   filter是用例名的子串 例如 micro_bench Buffer
+ **/
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Histogram.h"
+#include "Logger.h"
+
+static const int64_t kMinRunNs = 50 * 1000 * 1000;
+
+static volatile int64_t g_sink = 0; // 防止编译器把循环优化掉
+
+static std::string g_filter;
+static int g_repetitions = 5;
+
+static bool selected(const char *name)
+{
+    return g_filter.empty() || strstr(name, g_filter.c_str()) != nullptr;
+}
+
+/**
+ * body(iterations)执行iterations次被测操作
+ * 先倍增迭代次数直到单次耗时超过kMinRunNs 然后按这个次数重复测量
+ */
+static void run(const char *name, const std::function<void(int64_t)> &body)
+{
+    if (!selected(name))
+    {
+        return;
+    }
+    int64_t iterations = 1;
+    for (;;)
+    {
+        MonotonicTime start = MonotonicTime::now();
+        body(iterations);
+        int64_t elapsed = MonotonicTime::now() - start;
+        if (elapsed >= kMinRunNs / 10 || iterations >= (int64_t(1) << 40))
+        {
+            iterations = std::max<int64_t>(1, iterations * kMinRunNs / std::max<int64_t>(elapsed, 1));
+            break;
+        }
+        iterations *= 10;
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < g_repetitions; ++r)
+    {
+        MonotonicTime start = MonotonicTime::now();
+        body(iterations);
+        samples.push_back(static_cast<double>(MonotonicTime::now() - start) / static_cast<double>(iterations));
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("%-44s %10.1f ns/op  min %10.1f  (%lld iterations x %d)\n", name, samples[samples.size() / 2],
+           samples.front(), static_cast<long long>(iterations), g_repetitions);
+    fflush(stdout);
+}
+
+static void benchBuffer()
+{
+    static const size_t kSizes[] = {16, 256, 4096, 65536};
+    std::string data(65536, 'x');
+    char name[64];
+
+    for (size_t size : kSizes)
+    {
+        snprintf(name, sizeof name, "Buffer append+retrieveAll/%zu", size);
+        Buffer buf;
+        run(name, [&](int64_t n) {
+            for (int64_t i = 0; i < n; ++i)
+            {
+                buf.append(data.data(), size);
+                buf.retrieveAll();
+            }
+        });
+    }
+
+    // 每次追加3份取走2份 模拟积压了一部分数据的连接 可读区间不断后移 定期触发makeSpace把数据挪回前面
+    for (size_t size : kSizes)
+    {
+        snprintf(name, sizeof name, "Buffer append x3 retrieve x2/%zu", size);
+        Buffer buf;
+        run(name, [&](int64_t n) {
+            for (int64_t i = 0; i < n; ++i)
+            {
+                buf.append(data.data(), size);
+                buf.append(data.data(), size);
+                buf.append(data.data(), size);
+                buf.retrieve(size * 2);
+                if (buf.readableBytes() > 64 * 1024)
+                {
+                    buf.retrieveAll();
+                }
+            }
+        });
+    }
+
+    // 每次新建Buffer 1KB一块追加到64KB 包含扩容的全部开销
+    run("Buffer makeSpace grow 0->64KB in 1KB appends", [&](int64_t n) {
+        for (int64_t i = 0; i < n; ++i)
+        {
+            Buffer buf;
+            for (int k = 0; k < 64; ++k)
+            {
+                buf.append(data.data(), 1024);
+            }
+            g_sink = static_cast<int64_t>(buf.readableBytes());
+        }
+    });
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        LOG_ERROR("micro_bench socketpair error:%d\n", errno);
+        return;
+    }
+    int sndbuf = 1024 * 1024;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof sndbuf);
+    char scratch[65536];
+    for (size_t size : kSizes)
+    {
+        // write+readFd 对照组是write+read到栈上的数组 两者的差就是Buffer::readFd本身的开销
+        snprintf(name, sizeof name, "Buffer readFd socketpair/%zu", size);
+        Buffer buf;
+        run(name, [&](int64_t n) {
+            int savedErrno = 0;
+            for (int64_t i = 0; i < n; ++i)
+            {
+                g_sink = ::write(fds[0], data.data(), size);
+                size_t got = 0;
+                while (got < size)
+                {
+                    got += static_cast<size_t>(buf.readFd(fds[1], &savedErrno));
+                }
+                buf.retrieveAll();
+            }
+        });
+        snprintf(name, sizeof name, "Buffer readFd baseline write+read/%zu", size);
+        run(name, [&](int64_t n) {
+            for (int64_t i = 0; i < n; ++i)
+            {
+                g_sink = ::write(fds[0], data.data(), size);
+                size_t got = 0;
+                while (got < size)
+                {
+                    got += static_cast<size_t>(::read(fds[1], scratch, sizeof scratch));
+                }
+            }
+        });
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+static void benchQueueInLoop()
+{
+    EventLoopThread thread(EventLoopThread::ThreadInitCallback(), "MicroBench");
+    EventLoop *loop = thread.startLoop();
+
+    // 投递一个任务 等它执行完再投递下一个 每次loop都在epoll_wait里睡着 包含唤醒的全部开销
+    if (selected("queueInLoop cross-thread latency"))
+    {
+        Histogram latency;
+        std::atomic<int64_t> ranAt(0);
+        for (int i = 0; i < 100000; ++i)
+        {
+            ranAt.store(0, std::memory_order_relaxed);
+            int64_t postedAt = MonotonicTime::now().nanoSeconds();
+            loop->queueInLoop([&ranAt]() { ranAt.store(MonotonicTime::now().nanoSeconds(), std::memory_order_release); });
+            int64_t done;
+            while ((done = ranAt.load(std::memory_order_acquire)) == 0)
+            {
+                ::sched_yield(); // 只有一个CPU时让loop线程有机会运行
+            }
+            latency.record(done - postedAt);
+        }
+        printf("%-44s p50 %8.0f ns  p99 %8.0f ns  p99.9 %8.0f ns  max %8.0f ns\n",
+               "queueInLoop cross-thread latency", static_cast<double>(latency.percentile(0.50)),
+               static_cast<double>(latency.percentile(0.99)), static_cast<double>(latency.percentile(0.999)),
+               static_cast<double>(latency.max()));
+    }
+
+    // 连续投递n个任务 等最后一个执行完 平均到每个任务 大部分投递不需要唤醒
+    run("queueInLoop cross-thread throughput", [&](int64_t n) {
+        std::atomic<int64_t> executed(0);
+        for (int64_t i = 0; i < n; ++i)
+        {
+            loop->queueInLoop([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (executed.load(std::memory_order_relaxed) < n)
+        {
+            ::sched_yield();
+        }
+    });
+}
+
+static void benchChannel()
+{
+    EventLoop loop;
+    int efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // 只测handleEvent本身: 标志判断加上std::function调用
+    {
+        Channel channel(&loop, efd);
+        int64_t calls = 0;
+        channel.setReadCallback([&calls](Timestamp) { ++calls; });
+        channel.set_revents(EPOLLIN);
+        Timestamp now = Timestamp::now();
+        run("Channel handleEvent read dispatch", [&](int64_t n) {
+            for (int64_t i = 0; i < n; ++i)
+            {
+                channel.handleEvent(now);
+            }
+            g_sink = calls;
+        });
+
+        std::shared_ptr<int> owner(new int(0));
+        channel.tie(owner);
+        run("Channel handleEvent tied dispatch", [&](int64_t n) {
+            for (int64_t i = 0; i < n; ++i)
+            {
+                channel.handleEvent(now);
+            }
+            g_sink = calls;
+        });
+    }
+
+    // 回调里读掉eventfd再写一次 下一轮epoll_wait立刻返回 每次迭代就是一次完整的loop循环
+    {
+        Channel channel(&loop, efd);
+        int64_t remaining = 0;
+        channel.setReadCallback([&](Timestamp) {
+            uint64_t value;
+            g_sink = ::read(efd, &value, sizeof value);
+            if (--remaining > 0)
+            {
+                value = 1;
+                g_sink = ::write(efd, &value, sizeof value);
+            }
+            else
+            {
+                loop.quit();
+            }
+        });
+        channel.enableReading();
+        run("EventLoop eventfd->epoll->Channel round", [&](int64_t n) {
+            remaining = n;
+            uint64_t one = 1;
+            g_sink = ::write(efd, &one, sizeof one);
+            loop.loop();
+        });
+        channel.disableAll();
+        channel.remove();
+    }
+
+    run("EventLoop round baseline eventfd write+read", [&](int64_t n) {
+        uint64_t value = 1;
+        for (int64_t i = 0; i < n; ++i)
+        {
+            g_sink = ::write(efd, &value, sizeof value);
+            g_sink = ::read(efd, &value, sizeof value);
+        }
+    });
+    ::close(efd);
+}
+
+static int64_t g_logBytes = 0;
+static void nullOutput(const char *, size_t len) { g_logBytes += static_cast<int64_t>(len); }
+
+static void benchLogger()
+{
+    Logger::instance().setOutput(nullOutput);
+    Logger::instance().setFlush(Logger::FlushFunc());
+    Logger::setLogLevel(INFO);
+    const char *payload = "abcdefghijklmnopqrstuvwxyz";
+    run("LOG_DEBUG filtered", [&](int64_t n) {
+        for (int64_t i = 0; i < n; ++i)
+        {
+            LOG_DEBUG("seq=%lld payload=%s", static_cast<long long>(i), payload);
+        }
+    });
+    run("LOG_INFO -> null output", [&](int64_t n) {
+        for (int64_t i = 0; i < n; ++i)
+        {
+            LOG_INFO("seq=%lld payload=%s fd=%d", static_cast<long long>(i), payload, static_cast<int>(i & 1023));
+        }
+    });
+    run("LOG_STREAM(INFO) -> null output", [&](int64_t n) {
+        for (int64_t i = 0; i < n; ++i)
+        {
+            LOG_STREAM(INFO) << "seq=" << i << " payload=" << payload << " fd=" << (i & 1023);
+        }
+    });
+    Logger::setLogLevel(ERROR);
+}
+
+int main(int argc, char *argv[])
+{
+    g_filter = argc > 1 ? argv[1] : "";
+    g_repetitions = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+
+    Logger::setLogLevel(ERROR);
+    benchBuffer();
+    benchQueueInLoop();
+    benchChannel();
+    benchLogger();
+    return 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * 大块数据传输时小消息的延迟 对比开启和不开启TCP_NOTSENT_LOWAT
+ * 服务端: 连接建立后不停地发送64KB的大块数据帧 每次WriteCompleteCallback再发下一块
+ *         收到客户端的ping帧立即回复pong帧 pong和大块数据共用一个连接 只能排在已经写进内核的数据后面
+ * 客户端: 按rateMBps限速读取(超出每毫秒的配额就stopRead) 每5ms发送一个带时间戳的ping 统计pong的往返时间
+ *
+ * 不设置notsent低水位时 服务端内核发送缓冲区会被自动调大到几MB pong要等这些数据以限速的速度发完
+ * 设置之后内核里未发出的数据不超过低水位 其余留在outputBuffer_里 pong只需要等一块数据
+ *
+ * 帧格式: 4字节长度(网络字节序 不含头) + 1字节类型('B'大块 'p'ping 'P'pong) + 负载
+ * 用法: notsent_lowat_bench [seconds] [rateMBps] [lowatBytes]
+ **/
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPlainPort = 9988;
+static const uint16_t kLowatPort = 9989;
+static const size_t kBulkPayload = 64 * 1024 - 5;
+static const size_t kHeaderLen = 5;
+
+static std::string makeFrame(char type, const void *payload, size_t len)
+{
+    std::string frame(kHeaderLen + len, '\0');
+    uint32_t be = htonl(static_cast<uint32_t>(len));
+    ::memcpy(&frame[0], &be, sizeof be);
+    frame[4] = type;
+    if (len > 0)
+    {
+        ::memcpy(&frame[kHeaderLen], payload, len);
+    }
+    return frame;
+}
+
+// 从buffer中取出一个完整的帧 不完整返回false
+static bool takeFrame(Buffer *buffer, char *type, std::string *payload)
+{
+    if (buffer->readableBytes() < kHeaderLen)
+    {
+        return false;
+    }
+    uint32_t be = 0;
+    ::memcpy(&be, buffer->peek(), sizeof be);
+    size_t len = ntohl(be);
+    if (buffer->readableBytes() < kHeaderLen + len)
+    {
+        return false;
+    }
+    *type = buffer->peek()[4];
+    buffer->retrieve(kHeaderLen);
+    *payload = buffer->retrieveAsString(len);
+    return true;
+}
+
+// 两个服务器在同一个loop线程里 只有socket参数不同
+struct BulkServers
+{
+    std::string bulk; // 回调里按引用使用 和服务器一起释放
+    std::unique_ptr<TcpServer> plain;
+    std::unique_ptr<TcpServer> lowat;
+};
+
+// 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startBulkServers(EventLoop *loop, int lowat)
+{
+    std::shared_ptr<BulkServers> servers(new BulkServers);
+    servers->bulk = makeFrame('B', std::string(kBulkPayload, 'b').data(), kBulkPayload);
+    SocketOptions plainOptions;
+    plainOptions.tcpNoDelay = true;
+    SocketOptions lowatOptions = plainOptions;
+    lowatOptions.notSentLowat = lowat;
+
+    servers->plain.reset(new TcpServer(loop, InetAddress(kPlainPort), "Plain"));
+    servers->lowat.reset(new TcpServer(loop, InetAddress(kLowatPort), "Lowat"));
+    servers->plain->setSocketOptions(plainOptions);
+    servers->lowat->setSocketOptions(lowatOptions);
+    const std::string &bulk = servers->bulk;
+    for (TcpServer *server : {servers->plain.get(), servers->lowat.get()})
+    {
+        server->setConnectionCallback([&bulk](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->send(bulk);
+            }
+        });
+        server->setWriteCompleteCallback([&bulk](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->send(bulk);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            char type;
+            std::string payload;
+            while (takeFrame(buffer, &type, &payload))
+            {
+                if (type == 'p')
+                {
+                    conn->send(makeFrame('P', payload.data(), payload.size()));
+                }
+            }
+        });
+        server->start();
+    }
+    return servers;
+}
+
+static void runClient(const char *label, uint16_t port, int seconds, double rateMBps)
+{
+    EventLoop loop;
+    TcpClient client(&loop, InetAddress(port), label);
+    SocketOptions options;
+    options.tcpNoDelay = true;
+    options.recvBufferSize = 64 * 1024; // 客户端接收窗口小一些 让数据积压在服务端
+    client.setSocketOptions(options);
+
+    const int64_t budgetPerTick = static_cast<int64_t>(rateMBps * 1024 * 1024 / 1000); // 每毫秒
+    int64_t tickBytes = 0;
+    int64_t bulkBytes = 0;
+    std::vector<int64_t> rtts;
+    TcpConnectionPtr connection;
+
+    client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        connection = conn->connected() ? conn : TcpConnectionPtr();
+    });
+    client.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        int64_t before = static_cast<int64_t>(buffer->readableBytes());
+        char type;
+        std::string payload;
+        while (takeFrame(buffer, &type, &payload))
+        {
+            if (type == 'B')
+            {
+                bulkBytes += static_cast<int64_t>(payload.size() + kHeaderLen);
+            }
+            else if (type == 'P' && payload.size() == sizeof(int64_t))
+            {
+                int64_t sentNs = 0;
+                ::memcpy(&sentNs, payload.data(), sizeof sentNs);
+                rtts.push_back(MonotonicTime::now().nanoSeconds() - sentNs);
+            }
+        }
+        tickBytes += before - static_cast<int64_t>(buffer->readableBytes());
+        if (tickBytes >= budgetPerTick && conn->isReading())
+        {
+            conn->stopRead();
+        }
+    });
+    loop.runEvery(0.001, [&]() {
+        tickBytes = 0;
+        if (connection && !connection->isReading())
+        {
+            connection->startRead();
+        }
+    });
+    loop.runEvery(0.005, [&]() {
+        if (connection)
+        {
+            int64_t now = MonotonicTime::now().nanoSeconds();
+            connection->send(makeFrame('p', &now, sizeof now));
+        }
+    });
+    client.connect();
+    MonotonicTime start = MonotonicTime::now();
+    loop.runAfter(seconds, [&loop]() { loop.quit(); });
+    loop.loop();
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+
+    connection.reset();
+    client.disconnect();
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+
+    if (rtts.empty())
+    {
+        printf("%-22s no pong received\n", label);
+        return;
+    }
+    std::sort(rtts.begin(), rtts.end());
+    auto pct = [&rtts](double p) -> double {
+        size_t index = std::min(rtts.size() - 1, static_cast<size_t>(p * static_cast<double>(rtts.size())));
+        return static_cast<double>(rtts[index]) / 1e6;
+    };
+    printf("%-22s bulk %6.1f MiB/s  pings %5zu  rtt p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n",
+           label, static_cast<double>(bulkBytes) / elapsed / 1048576.0, rtts.size(),
+           pct(0.50), pct(0.99), pct(1.0));
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    double rateMBps = argc > 2 ? atof(argv[2]) : 100.0;
+    int lowat = argc > 3 ? atoi(argv[3]) : 16 * 1024;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    BenchServerThread server;
+    server.start([lowat](EventLoop *loop) { return startBulkServers(loop, lowat); });
+
+    printf("client reads at %.0f MB/s, notsent lowat %d bytes\n", rateMBps, lowat);
+    runClient("without notsent lowat", kPlainPort, seconds, rateMBps);
+    runClient("with notsent lowat", kLowatPort, seconds, rateMBps);
+
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,403 @@
+/**
+ * 开环(open-loop)负载生成器 每个连接按固定速率发请求 不管之前的响应有没有回来
+ * 闭环测试里服务端一卡住客户端也跟着停止发送 卡住期间本该发出的请求根本没有被计时(coordinated omission)
+ * 这里每个请求都有一个按速率排好的计划发送时间 延迟从计划时间算到收到完整响应为止
+ * 所以服务端卡顿造成的排队会如实计入 发送本身被推迟也算在延迟里
+ *
+ * 每秒输出一行这一秒内完成的请求的p50/p99/p99.9/max 结束时输出整体的分布
+ * 同时给出从实际发出时刻算起的服务时间 两者的差距就是被闭环测试掩盖的排队时间
+ *
+ * 请求和响应都按顺序一一对应 支持三种协议:
+ *   echo   发送size字节 收到size字节算一个响应 (example/testserver等回显服务器)
+ *   line   发送一行文本 收到一行算一个响应     (例如memcached_server的version)
+ *   http   GET path 按Content-Length切分响应   (example/http/http_server)
+ *
+ * 用法: openloop_load [ratePerConn] [connections] [seconds] [threads] [echo|line|http] [size|line|path] [port] [host]
+ *       不给port时在本进程内启动一个回显服务器
+ *   openloop_load 1000 16 10 2 http /hello 8000
+ *   openloop_load 2000 8 10 1 line version 11211
+ **/
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Histogram.h"
+#include "HttpParser.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9998;
+static const int64_t kMaxTickNs = 1000 * 1000; // 还没有连接建立时定时器的间隔
+
+enum Protocol
+{
+    kEcho,
+    kLine,
+    kHttp,
+};
+
+// 内置的回显服务器 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startEchoServer(EventLoop *loop)
+{
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "OpenLoopEcho"));
+    server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        conn->send(buffer);
+    });
+    server->start();
+    return server;
+}
+
+// 一个连接的发送计划和在途请求
+struct OpenLoopConn
+{
+    TcpConnectionPtr conn;
+    int64_t nextSendNs = 0;            // 下一个请求的计划发送时间
+    std::deque<int64_t> intendedNs;    // 在途请求的计划发送时间 按发送顺序
+    std::deque<int64_t> actualNs;      // 在途请求的实际发送时间
+};
+
+// 一个客户端loop上的所有连接 统计结果由主线程每秒取走
+class Worker
+{
+public:
+    Worker(EventLoop *loop, const InetAddress &addr, Protocol protocol, const std::string &request,
+           size_t responseBytes, int64_t intervalNs)
+        : loop_(loop)
+        , addr_(addr)
+        , protocol_(protocol)
+        , request_(request)
+        , responseBytes_(responseBytes)
+        , intervalNs_(intervalNs)
+    {
+    }
+
+    // 在loop线程中调用
+    void addConnection(int index, int total)
+    {
+        conns_.emplace_back(new OpenLoopConn);
+        OpenLoopConn *state = conns_.back().get();
+        clients_.emplace_back(new TcpClient(loop_, addr_, "OpenLoop"));
+        // 各个连接的发送时刻错开 避免所有请求挤在同一个tick
+        int64_t phase = intervalNs_ * index / total;
+        clients_.back()->setConnectionCallback([this, state, phase](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                state->conn = conn;
+                state->nextSendNs = MonotonicTime::now().nanoSeconds() + phase;
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                errors_ += static_cast<int64_t>(state->intendedNs.size()); // 没等到响应的请求
+                state->intendedNs.clear();
+                state->actualNs.clear();
+                state->conn.reset();
+            }
+        });
+        clients_.back()->setMessageCallback(
+            [this, state](const TcpConnectionPtr &, Buffer *buf, Timestamp) { onResponse(state, buf); });
+        clients_.back()->connect();
+    }
+
+    void start()
+    {
+        loop_->runInLoop([this]() { tick(); });
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+
+    // 停止发送并断开连接 在loop线程中执行 之后还要让loop跑一会儿完成关闭
+    // 连接的回调里用到了this 所以Worker要等loop线程都退出之后再析构
+    void stop()
+    {
+        loop_->runInLoop([this]() {
+            stopped_ = true;
+            for (auto &client : clients_)
+            {
+                client->disconnect();
+            }
+            clients_.clear();
+        });
+    }
+
+    struct Snapshot
+    {
+        int64_t sent = 0;
+        int64_t errors = 0;
+        int64_t outstanding = 0;
+    };
+
+    // 主线程调用 把这段时间的直方图合并进去并清零
+    Snapshot collect(Histogram *latency, Histogram *service)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        latency->merge(latency_);
+        service->merge(service_);
+        latency_.reset();
+        service_.reset();
+        Snapshot snapshot;
+        snapshot.sent = sent_;
+        snapshot.errors = errors_;
+        snapshot.outstanding = outstanding_;
+        return snapshot;
+    }
+
+private:
+    // 发出所有到期的请求 然后把定时器设到最早的下一个计划时间
+    void tick()
+    {
+        if (stopped_)
+        {
+            return;
+        }
+        int64_t now = MonotonicTime::now().nanoSeconds();
+        int64_t next = now + kMaxTickNs;
+        int64_t sent = 0;
+        int64_t outstanding = 0;
+        for (auto &state : conns_)
+        {
+            if (!state->conn)
+            {
+                continue;
+            }
+            // 按计划补发所有到期的请求 即使之前的响应还没回来
+            while (state->nextSendNs <= now)
+            {
+                output_.append(request_.data(), request_.size());
+                state->intendedNs.push_back(state->nextSendNs);
+                state->actualNs.push_back(now);
+                state->nextSendNs += intervalNs_;
+                ++sent;
+            }
+            if (output_.readableBytes() > 0)
+            {
+                state->conn->send(&output_);
+            }
+            outstanding += static_cast<int64_t>(state->intendedNs.size());
+            next = std::min(next, state->nextSendNs);
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sent_ += sent;
+            outstanding_ = outstanding;
+        }
+        int64_t delay = next - MonotonicTime::now().nanoSeconds();
+        loop_->runAfter(static_cast<double>(std::max<int64_t>(delay, 0)) / 1e9, [this]() { tick(); });
+    }
+
+    // 返回buf开头一个完整响应的长度 不完整返回0
+    size_t responseLength(const Buffer *buf)
+    {
+        const char *begin = buf->peek();
+        const char *end = begin + buf->readableBytes();
+        if (protocol_ == kEcho)
+        {
+            return buf->readableBytes() >= responseBytes_ ? responseBytes_ : 0;
+        }
+        if (protocol_ == kLine)
+        {
+            const char *eol = static_cast<const char *>(::memchr(begin, '\n', buf->readableBytes()));
+            return eol != nullptr ? static_cast<size_t>(eol + 1 - begin) : 0;
+        }
+        const char *headerEnd = HttpParser::findHeaderEnd(begin, end);
+        if (headerEnd == nullptr)
+        {
+            return 0;
+        }
+        static const char kLength[] = "Content-Length: ";
+        const char *field = static_cast<const char *>(::memmem(begin, headerEnd - begin, kLength, sizeof kLength - 1));
+        size_t bodyLen = field != nullptr ? static_cast<size_t>(::atol(field + sizeof kLength - 1)) : 0;
+        size_t total = static_cast<size_t>(headerEnd + 4 - begin) + bodyLen;
+        return buf->readableBytes() >= total ? total : 0;
+    }
+
+    void onResponse(OpenLoopConn *state, Buffer *buf)
+    {
+        int64_t now = MonotonicTime::now().nanoSeconds();
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t len;
+        while (!state->intendedNs.empty() && (len = responseLength(buf)) > 0)
+        {
+            latency_.record(now - state->intendedNs.front());
+            service_.record(now - state->actualNs.front());
+            state->intendedNs.pop_front();
+            state->actualNs.pop_front();
+            buf->retrieve(len);
+        }
+    }
+
+    EventLoop *loop_;
+    const InetAddress addr_;
+    const Protocol protocol_;
+    const std::string request_;
+    const size_t responseBytes_;
+    const int64_t intervalNs_;
+    std::vector<std::unique_ptr<OpenLoopConn>> conns_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+    Buffer output_;
+    bool stopped_ = false;
+
+    std::mutex mutex_; // 保护下面的统计 loop线程每批响应加一次锁
+    Histogram latency_; // 从计划发送时间算起 修正了coordinated omission
+    Histogram service_; // 从实际发送时间算起
+    int64_t sent_ = 0;
+    int64_t errors_ = 0;
+    int64_t outstanding_ = 0;
+};
+
+static double ms(int64_t ns)
+{
+    return static_cast<double>(ns) / 1e6;
+}
+
+static void printDistribution(const char *label, const Histogram &h)
+{
+    printf("%-26s p50 %8.3f  p90 %8.3f  p99 %8.3f  p99.9 %8.3f  p99.99 %8.3f  max %8.3f ms\n", label,
+           ms(h.percentile(0.50)), ms(h.percentile(0.90)), ms(h.percentile(0.99)), ms(h.percentile(0.999)),
+           ms(h.percentile(0.9999)), ms(h.max()));
+}
+
+int main(int argc, char *argv[])
+{
+    double ratePerConn = argc > 1 ? atof(argv[1]) : 1000;
+    int connections = argc > 2 ? atoi(argv[2]) : 16;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+    int threads = argc > 4 ? atoi(argv[4]) : 1;
+    std::string mode = argc > 5 ? argv[5] : "echo";
+    std::string payload = argc > 6 ? argv[6] : "";
+    uint16_t port = static_cast<uint16_t>(argc > 7 ? atoi(argv[7]) : 0);
+    std::string host = argc > 8 ? argv[8] : "127.0.0.1";
+
+    if (ratePerConn <= 0 || connections <= 0 || threads <= 0)
+    {
+        fprintf(stderr, "ratePerConn, connections and threads must be positive\n");
+        return 1;
+    }
+
+    Protocol protocol = kEcho;
+    std::string request;
+    size_t responseBytes = 0;
+    if (mode == "line")
+    {
+        protocol = kLine;
+        request = (payload.empty() ? std::string("version") : payload) + "\r\n";
+    }
+    else if (mode == "http")
+    {
+        protocol = kHttp;
+        request = "GET " + (payload.empty() ? std::string("/hello") : payload) +
+                  " HTTP/1.1\r\nHost: " + host + "\r\nUser-Agent: openloop_load\r\n\r\n";
+    }
+    else
+    {
+        responseBytes = payload.empty() ? 64 : static_cast<size_t>(atoi(payload.c_str()));
+        request.assign(std::max<size_t>(responseBytes, 1), 'x');
+        responseBytes = request.size();
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    BenchServerThread server; // 指定了port时压测外部的服务器 不启动
+    if (port == 0)
+    {
+        if (protocol != kEcho)
+        {
+            fprintf(stderr, "built-in server only speaks echo, give a port for %s\n", mode.c_str());
+            return 1;
+        }
+        port = kPort;
+        server.start(startEchoServer);
+    }
+
+    EventLoop loop; // 主线程负责每秒汇总
+    std::vector<std::unique_ptr<Worker>> workers; // 在pool之前声明 loop线程退出之后才析构
+    EventLoopThreadPool pool(&loop, "OpenLoopClient");
+    pool.setThreadNum(threads);
+    pool.start();
+
+    int64_t intervalNs = static_cast<int64_t>(1e9 / ratePerConn);
+    for (EventLoop *ioLoop : pool.getAllLoops())
+    {
+        workers.emplace_back(new Worker(ioLoop, InetAddress(port, host), protocol, request, responseBytes, intervalNs));
+    }
+    for (int i = 0; i < connections; ++i)
+    {
+        Worker *worker = workers[static_cast<size_t>(i) % workers.size()].get();
+        worker->getLoop()->runInLoop([worker, i, connections]() { worker->addConnection(i, connections); });
+    }
+    for (auto &worker : workers)
+    {
+        worker->start();
+    }
+
+    printf("target %.0f req/s (%d conns x %.0f/s), %s, %zu byte requests, %d client threads\n",
+           ratePerConn * connections, connections, ratePerConn, mode.c_str(), request.size(), threads);
+    printf("%4s %10s %10s %10s %9s %9s %9s %9s\n", "sec", "req/s", "errors", "in-flight", "p50 ms", "p99 ms",
+           "p99.9 ms", "max ms");
+
+    Histogram latencyTotal;
+    Histogram serviceTotal;
+    int64_t lastSent = 0;
+    int second = 0;
+    loop.runEvery(1.0, [&]() {
+        Histogram latency;
+        Histogram service;
+        Worker::Snapshot total;
+        for (auto &worker : workers)
+        {
+            Worker::Snapshot s = worker->collect(&latency, &service);
+            total.sent += s.sent;
+            total.errors += s.errors;
+            total.outstanding += s.outstanding;
+        }
+        ++second;
+        printf("%4d %10lld %10lld %10lld %9.3f %9.3f %9.3f %9.3f\n", second, static_cast<long long>(latency.count()),
+               static_cast<long long>(total.errors), static_cast<long long>(total.outstanding),
+               ms(latency.percentile(0.50)), ms(latency.percentile(0.99)), ms(latency.percentile(0.999)),
+               ms(latency.max()));
+        fflush(stdout);
+        latencyTotal.merge(latency);
+        serviceTotal.merge(service);
+        lastSent = total.sent;
+        if (second >= seconds)
+        {
+            loop.quit();
+        }
+    });
+    loop.loop();
+
+    for (auto &worker : workers)
+    {
+        worker->stop();
+    }
+    loop.runAfter(0.1, [&loop]() { loop.quit(); });
+    loop.loop();
+
+    printf("sent %lld, completed %lld, achieved %.0f req/s\n", static_cast<long long>(lastSent),
+           static_cast<long long>(latencyTotal.count()), static_cast<double>(latencyTotal.count()) / seconds);
+    printDistribution("latency (from intended)", latencyTotal);
+    printDistribution("service time (from send)", serviceTotal);
+
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,329 @@
+/**
+ * ping-pong吞吐扫描 客户端和服务端都在本进程内 用于发现性能回退和估算部署规模
+ * 服务端: TcpServer回显 threads个subloop
+ * 客户端: EventLoopThreadPool同样threads个loop connections个TcpClient轮询分布
+ *         连接建立后发送size字节 之后把收到的数据原样发回
+ *
+ * 对threads x connections x size的每个组合跑seconds秒(之前预热0.5秒) 输出
+ *   MB/s、messages/s(按size字节一条消息换算)
+ *   每个loop线程在测量窗口内的CPU占用(CLOCK_THREAD_CPUTIME_ID 相对墙上时间的百分比)
+ *
+ * 用法: pingpong_bench [table|csv|json] [seconds] [threads] [connections] [sizes]
+ *       后三个参数是逗号分隔的列表 例如 pingpong_bench json 2 1,2,4 1,10,100 16,1024,65536
+ **/
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9997;
+
+// loop线程的CPU时间 线程初始化回调里记下clockid 主线程随时可以读
+class LoopCpuClocks
+{
+public:
+    void add()
+    {
+        clockid_t clock;
+        if (::pthread_getcpuclockid(::pthread_self(), &clock) != 0)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        clocks_.push_back(clock);
+    }
+
+    std::vector<int64_t> snapshot()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::vector<int64_t> ns;
+        for (clockid_t clock : clocks_)
+        {
+            struct timespec ts;
+            ::clock_gettime(clock, &ts);
+            ns.push_back(static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec);
+        }
+        return ns;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<clockid_t> clocks_;
+};
+
+// 回显服务器 在BenchServerThread的loop线程里构造和析构 io线程启动时登记到clocks
+static std::shared_ptr<void> startEchoServer(EventLoop *loop, int threads, LoopCpuClocks *clocks)
+{
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "PingPongServer"));
+    server->setThreadNum(threads);
+    server->setThreadInitCallback([clocks](EventLoop *) { clocks->add(); });
+    server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        conn->send(buffer);
+    });
+    server->start();
+    return server;
+}
+
+// 每个客户端loop一个计数器 避免所有连接争用同一个原子变量
+struct LoopCounter
+{
+    std::atomic<int64_t> bytes{0};
+    char padding[64 - sizeof(std::atomic<int64_t>)]; // 各占一个cache line
+};
+
+struct Result
+{
+    int threads;
+    int connections;
+    int size;
+    int connected;
+    double mbps;
+    double messagesPerSecond;
+    std::vector<double> serverCpu; // 每个loop的CPU占用百分比
+    std::vector<double> clientCpu;
+};
+
+static std::vector<double> cpuPercent(const std::vector<int64_t> &before, const std::vector<int64_t> &after,
+                                      double elapsedNs)
+{
+    std::vector<double> percent;
+    for (size_t i = 0; i < before.size() && i < after.size(); ++i)
+    {
+        percent.push_back(100.0 * static_cast<double>(after[i] - before[i]) / elapsedNs);
+    }
+    return percent;
+}
+
+static Result runPoint(EventLoop *loop, int seconds, int threads, int connections, int size)
+{
+    LoopCpuClocks serverClocks;
+    BenchServerThread server;
+    server.start([threads, &serverClocks](EventLoop *serverLoop) {
+        return startEchoServer(serverLoop, threads, &serverClocks);
+    });
+
+    LoopCpuClocks clientClocks;
+    std::unique_ptr<EventLoopThreadPool> pool(new EventLoopThreadPool(loop, "PingPongClient"));
+    pool->setThreadNum(threads);
+    pool->start([&clientClocks](EventLoop *) { clientClocks.add(); });
+
+    std::vector<std::unique_ptr<LoopCounter>> counters;
+    for (int i = 0; i < threads; ++i)
+    {
+        counters.emplace_back(new LoopCounter);
+    }
+    const std::string message(static_cast<size_t>(size), 'x');
+    std::atomic<int> connected(0);
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        LoopCounter *counter = counters[static_cast<size_t>(i % threads)].get();
+        clients.emplace_back(new TcpClient(pool->getNextLoop(), InetAddress(kPort), "PingPongClient"));
+        clients.back()->setConnectionCallback([&message, &connected](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                ++connected;
+                conn->send(message.data(), message.size());
+            }
+        });
+        clients.back()->setMessageCallback([counter](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            counter->bytes.fetch_add(static_cast<int64_t>(buffer->readableBytes()), std::memory_order_relaxed);
+            conn->send(buffer);
+        });
+        clients.back()->connect();
+    }
+
+    auto totalBytes = [&counters]() {
+        int64_t total = 0;
+        for (auto &counter : counters)
+        {
+            total += counter->bytes.load(std::memory_order_relaxed);
+        }
+        return total;
+    };
+
+    int64_t bytesBefore = 0;
+    std::vector<int64_t> serverBefore;
+    std::vector<int64_t> clientBefore;
+    MonotonicTime start;
+    Result result;
+    result.threads = threads;
+    result.connections = connections;
+    result.size = size;
+    loop->runAfter(0.5, [&]() {
+        bytesBefore = totalBytes();
+        serverBefore = serverClocks.snapshot();
+        clientBefore = clientClocks.snapshot();
+        start = MonotonicTime::now();
+    });
+    loop->runAfter(0.5 + seconds, [&]() {
+        int64_t bytes = totalBytes() - bytesBefore;
+        std::vector<int64_t> serverAfter = serverClocks.snapshot();
+        std::vector<int64_t> clientAfter = clientClocks.snapshot();
+        double elapsedNs = static_cast<double>(MonotonicTime::now() - start);
+        result.connected = connected.load();
+        result.mbps = static_cast<double>(bytes) / (elapsedNs / 1e9) / (1024 * 1024);
+        result.messagesPerSecond = static_cast<double>(bytes) / static_cast<double>(size) / (elapsedNs / 1e9);
+        result.serverCpu = cpuPercent(serverBefore, serverAfter, elapsedNs);
+        result.clientCpu = cpuPercent(clientBefore, clientAfter, elapsedNs);
+        loop->quit();
+    });
+    loop->loop();
+
+    for (auto &client : clients)
+    {
+        client->disconnect();
+    }
+    loop->runAfter(0.1, [loop]() { loop->quit(); });
+    loop->loop();
+    clients.clear();
+    pool.reset();
+    server.stop();
+    return result;
+}
+
+static std::vector<int> parseList(const char *arg)
+{
+    std::vector<int> values;
+    const char *p = arg;
+    while (*p != '\0')
+    {
+        int value = atoi(p);
+        if (value > 0)
+        {
+            values.push_back(value);
+        }
+        const char *comma = strchr(p, ',');
+        if (comma == nullptr)
+        {
+            break;
+        }
+        p = comma + 1;
+    }
+    return values;
+}
+
+static double average(const std::vector<double> &values)
+{
+    double sum = 0;
+    for (double v : values)
+    {
+        sum += v;
+    }
+    return values.empty() ? 0 : sum / static_cast<double>(values.size());
+}
+
+static double maximum(const std::vector<double> &values)
+{
+    return values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+}
+
+static std::string joinList(const std::vector<double> &values, const char *separator)
+{
+    std::string text;
+    char number[32];
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        snprintf(number, sizeof number, "%s%.1f", i > 0 ? separator : "", values[i]);
+        text += number;
+    }
+    return text;
+}
+
+static void printHeader(const std::string &format)
+{
+    if (format == "csv")
+    {
+        printf("threads,connections,size,connected,mb_per_sec,messages_per_sec,"
+               "server_cpu_avg,server_cpu_max,client_cpu_avg,client_cpu_max,server_cpu_loops,client_cpu_loops\n");
+    }
+    else if (format == "json")
+    {
+        printf("[\n");
+    }
+    else
+    {
+        printf("%7s %6s %7s %10s %12s %16s %16s\n", "threads", "conns", "size", "MB/s", "messages/s",
+               "server cpu% avg/max", "client cpu% avg/max");
+    }
+}
+
+static void printResult(const std::string &format, const Result &r, bool first)
+{
+    if (format == "csv")
+    {
+        printf("%d,%d,%d,%d,%.2f,%.0f,%.1f,%.1f,%.1f,%.1f,%s,%s\n", r.threads, r.connections, r.size, r.connected,
+               r.mbps, r.messagesPerSecond, average(r.serverCpu), maximum(r.serverCpu), average(r.clientCpu),
+               maximum(r.clientCpu), joinList(r.serverCpu, ";").c_str(), joinList(r.clientCpu, ";").c_str());
+    }
+    else if (format == "json")
+    {
+        printf("%s  {\"threads\": %d, \"connections\": %d, \"size\": %d, \"connected\": %d, "
+               "\"mb_per_sec\": %.2f, \"messages_per_sec\": %.0f, "
+               "\"server_cpu\": [%s], \"client_cpu\": [%s]}",
+               first ? "" : ",\n", r.threads, r.connections, r.size, r.connected, r.mbps, r.messagesPerSecond,
+               joinList(r.serverCpu, ", ").c_str(), joinList(r.clientCpu, ", ").c_str());
+    }
+    else
+    {
+        printf("%7d %6d %7d %10.1f %12.0f %9.1f/%6.1f %9.1f/%6.1f%s\n", r.threads, r.connections, r.size, r.mbps,
+               r.messagesPerSecond, average(r.serverCpu), maximum(r.serverCpu), average(r.clientCpu),
+               maximum(r.clientCpu), r.connected < r.connections ? "  (not all connected)" : "");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string format = argc > 1 ? argv[1] : "table";
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    std::vector<int> threadList = parseList(argc > 3 ? argv[3] : "1,2,4");
+    std::vector<int> connectionList = parseList(argc > 4 ? argv[4] : "1,10,100");
+    std::vector<int> sizeList = parseList(argc > 5 ? argv[5] : "16,1024,16384");
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop; // 主线程只负责定时器
+    printHeader(format);
+    bool first = true;
+    for (int threads : threadList)
+    {
+        for (int connections : connectionList)
+        {
+            for (int size : sizeList)
+            {
+                printResult(format, runPoint(&loop, seconds, threads, connections, size), first);
+                first = false;
+            }
+        }
+    }
+    if (format == "json")
+    {
+        printf("\n]\n");
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+/**
+ * RPC的QPS和延迟
+ * 服务端: RpcServer注册两个方法
+ *         echo       同步返回请求负载
+ *         echo_async 返回kRpcDeferred 这一轮loop结束时按收到的逆序统一RpcServer::reply 响应乱序到达客户端
+ * 客户端: 一个loop线程 connections个RpcClient 一共保持concurrency个调用在途
+ *         每个调用完成就在同一个连接上补发一个 负载里带序号 校验响应和请求对得上
+ *
+ * 用法: rpc_bench [seconds] [connections] [concurrency] [payloadBytes] [serverThreads]
+ **/
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "RpcClient.h"
+#include "RpcServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9995;
+
+// 每个subloop攒一轮的延迟调用 在这一轮的pendingFunctors里逆序回复
+struct DeferredCalls
+{
+    std::vector<std::tuple<TcpConnectionPtr, uint64_t, std::string>> calls;
+    bool scheduled = false;
+};
+
+// echo同步回复 echo_async延迟到本轮pendingFunctors回复 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startRpcServer(EventLoop *loop, int threads)
+{
+    std::shared_ptr<RpcServer> server(new RpcServer(loop, InetAddress(kPort), "RpcBench"));
+    server->setThreadNum(threads);
+    server->registerMethod("echo", [](const RpcCall &call, Buffer *response) {
+        response->append(call.request.data(), call.request.size());
+        return static_cast<int>(kRpcOk);
+    });
+    server->registerMethod("echo_async", [](const RpcCall &call, Buffer *) {
+        thread_local DeferredCalls t_deferred;
+        t_deferred.calls.emplace_back(call.conn, call.id, call.request.toString());
+        if (!t_deferred.scheduled)
+        {
+            t_deferred.scheduled = true;
+            call.conn->getLoop()->queueInLoop([]() {
+                DeferredCalls &deferred = t_deferred;
+                for (auto it = deferred.calls.rbegin(); it != deferred.calls.rend(); ++it)
+                {
+                    RpcServer::reply(std::get<0>(*it), std::get<1>(*it), kRpcOk, std::get<2>(*it));
+                }
+                deferred.calls.clear();
+                deferred.scheduled = false;
+            });
+        }
+        return static_cast<int>(kRpcDeferred);
+    });
+    server->start();
+    return server;
+}
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(EventLoop *loop, const char *method, int connections, int concurrency, size_t payloadBytes)
+        : method_(method)
+        , concurrency_(concurrency)
+        , payload_(std::max(payloadBytes, sizeof(uint64_t)), 'x')
+        , connected_(0)
+    {
+        for (int i = 0; i < connections; ++i)
+        {
+            clients_.emplace_back(new RpcClient(loop, InetAddress(kPort, "127.0.0.1"), "RpcLoad"));
+            RpcClient *client = clients_.back().get();
+            client->setConnectionCallback([this](const TcpConnectionPtr &conn) {
+                if (conn->connected() && ++connected_ == static_cast<int>(clients_.size()))
+                {
+                    // 全部连上之后把在途调用平均分到各个连接
+                    for (int j = 0; j < concurrency_; ++j)
+                    {
+                        issue(clients_[j % clients_.size()].get());
+                    }
+                }
+            });
+        }
+    }
+
+    void start()
+    {
+        for (auto &client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    void stop()
+    {
+        stopped_ = true;
+        for (auto &client : clients_)
+        {
+            client->disconnect();
+        }
+    }
+
+    void resetStats()
+    {
+        latencies_.clear();
+        mismatches_ = 0;
+        failures_ = 0;
+    }
+
+    std::vector<int64_t> &latencies() { return latencies_; }
+    int64_t mismatches() const { return mismatches_; }
+    int64_t failures() const { return failures_; }
+    int64_t timeouts() const
+    {
+        int64_t total = 0;
+        for (auto &client : clients_)
+        {
+            total += client->timeouts();
+        }
+        return total;
+    }
+
+private:
+    void issue(RpcClient *client)
+    {
+        uint64_t seq = nextSeq_++;
+        ::memcpy(&payload_[0], &seq, sizeof seq);
+        int64_t sentNs = MonotonicTime::now().nanoSeconds();
+        client->call(method_, payload_, 1000, [this, client, seq, sentNs](int status, const StringPiece &response) {
+            if (status != kRpcOk)
+            {
+                ++failures_;
+                return;
+            }
+            uint64_t echoed = 0;
+            if (response.size() != payload_.size() || (::memcpy(&echoed, response.data(), sizeof echoed), echoed != seq))
+            {
+                ++mismatches_;
+            }
+            latencies_.push_back(MonotonicTime::now().nanoSeconds() - sentNs);
+            if (!stopped_)
+            {
+                issue(client);
+            }
+        });
+    }
+
+    const char *method_;
+    const int concurrency_;
+    std::string payload_;
+    int connected_;
+    bool stopped_ = false;
+    uint64_t nextSeq_ = 0;
+    std::vector<std::unique_ptr<RpcClient>> clients_;
+    std::vector<int64_t> latencies_;
+    int64_t mismatches_ = 0;
+    int64_t failures_ = 0;
+};
+
+static void runLoad(const char *method, int seconds, int connections, int concurrency, size_t payloadBytes)
+{
+    EventLoop loop;
+    std::unique_ptr<LoadGenerator> load(new LoadGenerator(&loop, method, connections, concurrency, payloadBytes));
+    load->latencies().reserve(8 * 1024 * 1024);
+    load->start();
+
+    MonotonicTime start;
+    loop.runAfter(0.5, [&]() {
+        load->resetStats();
+        start = MonotonicTime::now();
+    });
+    double elapsed = 0;
+    loop.runAfter(0.5 + seconds, [&]() {
+        elapsed = (MonotonicTime::now() - start) / 1e9;
+        loop.quit();
+    });
+    loop.loop();
+
+    std::vector<int64_t> latencies;
+    latencies.swap(load->latencies());
+    int64_t mismatches = load->mismatches();
+    int64_t failures = load->failures();
+    int64_t timeouts = load->timeouts();
+    load->stop();
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    load.reset(); // RpcClient必须在loop线程中析构
+
+    if (latencies.empty())
+    {
+        printf("%-11s no response\n", method);
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&latencies](double p) -> double {
+        size_t index = std::min(latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(latencies.size())));
+        return static_cast<double>(latencies[index]) / 1e6;
+    };
+    printf("%-11s conns %3d  in-flight %4d  %9.0f calls/s  p50 %6.3f ms  p99 %6.3f ms  p99.9 %6.3f ms"
+           "  mismatched %lld  failed %lld  timeouts %lld\n",
+           method, connections, concurrency, static_cast<double>(latencies.size()) / elapsed,
+           pct(0.50), pct(0.99), pct(0.999), static_cast<long long>(mismatches),
+           static_cast<long long>(failures), static_cast<long long>(timeouts));
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int concurrency = argc > 3 ? atoi(argv[3]) : 256;
+    size_t payloadBytes = static_cast<size_t>(argc > 4 ? atoi(argv[4]) : 64);
+    int serverThreads = argc > 5 ? atoi(argv[5]) : 1;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    BenchServerThread server;
+    server.start([serverThreads](EventLoop *serverLoop) { return startRpcServer(serverLoop, serverThreads); });
+
+    printf("payload %zu bytes, server threads %d\n", payloadBytes, serverThreads);
+    runLoad("echo", seconds, connections, concurrency, payloadBytes);
+    runLoad("echo_async", seconds, connections, concurrency, payloadBytes);
+
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,224 @@
+/**
+ * 接收延迟分解 SocketOptions::rxTimestamps
+ * 服务端: TcpServer开启SO_TIMESTAMPING 回显每条消息 回显前忙等workUs微秒模拟处理耗时
+ *         每个MessageCallback按TcpConnection::receiveTimes()记录三段时间 按io loop分开统计:
+ *           kernel->poll     数据进入socket接收队列到epoll_wait返回 loop忙于其他连接的回调时变长
+ *           poll->callback   epoll_wait返回到本连接的回调开始 前面排着同一轮其他连接的回调
+ *           handler          回调本身(包括workUs)
+ * 客户端: connections个线程 每个线程一个阻塞连接 做64字节的ping-pong
+ *
+ * 同一个loop上的连接越多、workUs越大 排队就越明显地落在kernel->poll和poll->callback上
+ * 输出每个workUs下每个loop的消息数和三段时间的p50/p99(微秒)
+ *
+ * 用法: rx_latency_bench [seconds] [serverThreads] [connections] [workUs]
+ *       workUs是逗号分隔的列表 例如 rx_latency_bench 3 2 8 0,20,100
+ **/
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "EventLoop.h"
+#include "Histogram.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9980;
+static const size_t kMessageSize = 64;
+
+// 一个io loop的统计 只在这个loop线程中写 停止服务端之后再读
+struct LoopStats
+{
+    Histogram kernelToPoll;
+    Histogram pollToCallback;
+    Histogram handler;
+    int64_t missingTimestamps = 0;
+};
+
+static void spin(int64_t us)
+{
+    int64_t end = MonotonicTime::now().nanoSeconds() + us * 1000;
+    while (MonotonicTime::now().nanoSeconds() < end)
+    {
+    }
+}
+
+class RxServerThread
+{
+public:
+    RxServerThread(int threads, int workUs) : threads_(threads), workUs_(workUs) {}
+
+    void start()
+    {
+        thread_.start([this](EventLoop *loop) {
+            std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "RxServer"));
+            SocketOptions options;
+            options.tcpNoDelay = true;
+            options.rxTimestamps = true;
+            server->setSocketOptions(options);
+            server->setThreadNum(threads_);
+            server->setThreadInitCallback([this](EventLoop *ioLoop) {
+                addLoop(ioLoop);
+            });
+            server->setConnectionCallback([](const TcpConnectionPtr &) {});
+            server->setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                int64_t start = MonotonicTime::now().nanoSeconds();
+                LoopStats *stats = stats_.find(conn->getLoop())->second.get(); // start()之后只读
+                const ReceiveTimes &times = conn->receiveTimes();
+                if (times.kernelNs > 0)
+                {
+                    stats->kernelToPoll.record(std::max<int64_t>(0, times.pollNs - times.kernelNs));
+                }
+                else
+                {
+                    ++stats->missingTimestamps;
+                }
+                stats->pollToCallback.record(std::max<int64_t>(0, times.callbackNs - times.pollNs));
+                spin(workUs_);
+                conn->send(buf);
+                stats->handler.record(MonotonicTime::now().nanoSeconds() - start);
+            });
+            if (threads_ == 0)
+            {
+                addLoop(loop); // 没有io线程时连接在baseLoop上
+            }
+            server->start();
+            return server;
+        });
+    }
+
+    void stop() { thread_.stop(); }
+
+    // 按loop的创建顺序
+    const std::vector<LoopStats *> &stats() const { return order_; }
+
+private:
+    void addLoop(EventLoop *loop)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_ptr<LoopStats> &stats = stats_[loop];
+        stats.reset(new LoopStats);
+        order_.push_back(stats.get());
+    }
+
+    int threads_;
+    int workUs_;
+    BenchServerThread thread_;
+    std::mutex mutex_; // 保护stats_和order_ io线程启动时添加
+    std::map<EventLoop *, std::unique_ptr<LoopStats>> stats_;
+    std::vector<LoopStats *> order_;
+};
+
+// 一个客户端连接 阻塞的ping-pong
+static void pingpong(const std::atomic<bool> *running)
+{
+    struct sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) != 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    char message[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    while (running->load(std::memory_order_relaxed))
+    {
+        if (::write(fd, message, sizeof message) != static_cast<ssize_t>(sizeof message))
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof message)
+        {
+            ssize_t n = ::read(fd, message + got, sizeof message - got);
+            if (n <= 0)
+            {
+                ::close(fd);
+                return;
+            }
+            got += static_cast<size_t>(n);
+        }
+    }
+    ::close(fd);
+}
+
+static double us(int64_t ns)
+{
+    return static_cast<double>(ns) / 1000;
+}
+
+static void runPoint(int seconds, int serverThreads, int connections, int workUs)
+{
+    RxServerThread server(serverThreads, workUs);
+    server.start();
+
+    std::atomic<bool> running(true);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(pingpong, &running);
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    server.stop();
+
+    int index = 0;
+    for (LoopStats *stats : server.stats())
+    {
+        printf("%8d %6d %10lld %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9lld\n", workUs, index++,
+               static_cast<long long>(stats->handler.count()), us(stats->kernelToPoll.percentile(0.50)),
+               us(stats->kernelToPoll.percentile(0.99)), us(stats->pollToCallback.percentile(0.50)),
+               us(stats->pollToCallback.percentile(0.99)), us(stats->handler.percentile(0.50)),
+               us(stats->handler.percentile(0.99)), static_cast<long long>(stats->missingTimestamps));
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int serverThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int connections = argc > 3 ? atoi(argv[3]) : 8;
+    const char *workList = argc > 4 ? argv[4] : "0,20,100";
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    printf("%d io loops, %d connections, %zu-byte ping-pong, latency in us\n", serverThreads, connections,
+           kMessageSize);
+    printf("%8s %6s %10s %9s %9s %9s %9s %9s %9s %9s\n", "work us", "loop", "messages", "k->p p50", "k->p p99",
+           "p->cb p50", "p->cb p99", "hdl p50", "hdl p99", "no tstamp");
+    for (const char *p = workList; p != nullptr && *p != '\0';)
+    {
+        runPoint(seconds, serverThreads, connections, atoi(p));
+        p = strchr(p, ',');
+        p = p != nullptr ? p + 1 : nullptr;
+    }
+    return 0;
+}
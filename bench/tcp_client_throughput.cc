@@ -0,0 +1,127 @@
+/**
+ * TcpClient回环吞吐测试 客户端和服务端都在本进程内
+ * 服务端: TcpServer回显
+ * 客户端: clients个TcpClient分布在clientThreads个loop上 连接建立后发送blockSize字节 之后把收到的数据原样发回(ping-pong)
+ *
+ * 客户端先于服务端启动 第一次连接会被拒绝 走Connector的退避重试 输出所有连接建立所用的时间
+ *
+ * 用法: tcp_client_throughput [clients] [blockSize] [seconds] [clientThreads] [serverThreads]
+ **/
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9983;
+
+static std::atomic<int64_t> g_bytesRead(0);
+static std::atomic<int64_t> g_messagesRead(0);
+static std::atomic<int> g_connected(0);
+
+// 回显服务器 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startEchoServer(EventLoop *loop, int threads)
+{
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "EchoServer"));
+    server->setThreadNum(threads);
+    server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        conn->send(buffer->retrieveAllAsString());
+    });
+    server->start();
+    return server;
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 16;
+    int blockSize = argc > 2 ? atoi(argv[2]) : 16384;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    int clientThreads = argc > 4 ? atoi(argv[4]) : 2;
+    int serverThreads = argc > 5 ? atoi(argv[5]) : 2;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR); // 重试时的INFO日志不影响测量
+
+    EventLoop loop; // 主线程只负责定时器
+    EventLoopThreadPool pool(&loop, "client");
+    pool.setThreadNum(clientThreads);
+    pool.start();
+
+    const std::string message(blockSize, 'x');
+    MonotonicTime startConnect = MonotonicTime::now();
+    std::atomic<int64_t> allConnectedNs(0);
+
+    std::vector<std::unique_ptr<TcpClient>> clientList;
+    for (int i = 0; i < clients; ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof name, "client%d", i);
+        TcpClient *client = new TcpClient(pool.getNextLoop(), InetAddress(kPort), name);
+        client->setRetryDelay(50, 1000);
+        client->setConnectionCallback([&, clients](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                if (g_connected.fetch_add(1) + 1 == clients)
+                {
+                    allConnectedNs = MonotonicTime::now() - startConnect;
+                }
+                conn->send(message);
+            }
+        });
+        client->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            g_bytesRead.fetch_add(static_cast<int64_t>(buffer->readableBytes()), std::memory_order_relaxed);
+            g_messagesRead.fetch_add(1, std::memory_order_relaxed);
+            conn->send(buffer->retrieveAllAsString());
+        });
+        client->connect();
+        clientList.emplace_back(client);
+    }
+
+    // 服务端晚一点启动 客户端的第一次连接会失败并重试
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    BenchServerThread server;
+    server.start([serverThreads](EventLoop *serverLoop) { return startEchoServer(serverLoop, serverThreads); });
+
+    int64_t bytesAtStart = 0;
+    MonotonicTime measureStart;
+    loop.runAfter(1.0, [&]() { // 给连接建立留1秒
+        bytesAtStart = g_bytesRead.load();
+        measureStart = MonotonicTime::now();
+    });
+    loop.runAfter(1.0 + seconds, [&]() { loop.quit(); });
+    loop.loop();
+
+    int64_t bytes = g_bytesRead.load() - bytesAtStart;
+    double elapsed = (MonotonicTime::now() - measureStart) / 1e9;
+    printf("%d clients x %d bytes, client threads %d, server threads %d\n", clients, blockSize, clientThreads, serverThreads);
+    printf("connected %d/%d, all connected after %.1f ms (server started at ~200 ms)\n",
+           g_connected.load(), clients, allConnectedNs.load() / 1e6);
+    printf("throughput %.1f MiB/s, %.0f messages/s\n", bytes / elapsed / 1048576.0, g_messagesRead.load() / (elapsed + 1));
+
+    for (std::unique_ptr<TcpClient> &client : clientList)
+    {
+        client->disconnect();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    clientList.clear();
+    server.stop();
+    return 0;
+}
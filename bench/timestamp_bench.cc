@@ -0,0 +1,86 @@
+/**
+ * 时间戳微基准测试
+ * 1. Timestamp::now() / MonotonicTime::now() 和旧实现用的 time(NULL) 每次调用的耗时
+ * 2. toString() / formatTo() 和 每次都调用localtime_r + snprintf 的对比
+ * 3. 连续两次now()之间的最小间隔 确认时间戳确实有微秒/纳秒分辨率
+ *
+ * 用法: timestamp_bench [iterations]
+ **/
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Timestamp.h"
+
+static volatile int64_t g_sink = 0; // 防止编译器把循环优化掉
+
+template <typename Func>
+static void run(const char *name, int iterations, Func func)
+{
+    MonotonicTime start = MonotonicTime::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        func(i);
+    }
+    int64_t nanos = MonotonicTime::now() - start;
+    printf("%-36s %8.2f ns/call\n", name, static_cast<double>(nanos) / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000000;
+
+    run("time(NULL)", iterations, [](int) { g_sink = ::time(NULL); });
+    run("Timestamp::now()", iterations, [](int) { g_sink = Timestamp::now().microSecondsSinceEpoch(); });
+    run("MonotonicTime::now()", iterations, [](int) { g_sink = MonotonicTime::now().nanoSeconds(); });
+    run("std::chrono::steady_clock::now()", iterations, [](int) {
+        g_sink = std::chrono::steady_clock::now().time_since_epoch().count();
+    });
+
+    Timestamp base = Timestamp::now();
+    char buf[64];
+    // 每次换一秒 缓存全部失效 相当于旧实现每次都调用localtime
+    run("localtime_r + snprintf", iterations, [&](int i) {
+        time_t seconds = base.secondsSinceEpoch() + i;
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        g_sink = snprintf(buf, sizeof buf, "%4d/%02d/%02d %02d:%02d:%02d",
+                          tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                          tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    });
+    run("formatTo() same second", iterations, [&](int i) {
+        g_sink = (base + i % Timestamp::kMicroSecondsPerSecond).formatTo(buf, sizeof buf);
+    });
+    run("formatTo() new second every call", iterations, [&](int i) {
+        g_sink = (base + static_cast<int64_t>(i) * Timestamp::kMicroSecondsPerSecond).formatTo(buf, sizeof buf);
+    });
+    run("toString() same second", iterations, [&](int i) {
+        g_sink = static_cast<int64_t>((base + i % Timestamp::kMicroSecondsPerSecond).toString().size());
+    });
+
+    // 分辨率: 连续调用直到值发生变化 取最小的跳变
+    int64_t minStepUs = INT64_MAX;
+    int64_t minStepNs = INT64_MAX;
+    for (int i = 0; i < 1000; ++i)
+    {
+        Timestamp t0 = Timestamp::now();
+        Timestamp t1;
+        while ((t1 = Timestamp::now()) == t0)
+        {
+        }
+        minStepUs = std::min(minStepUs, t1 - t0);
+
+        MonotonicTime m0 = MonotonicTime::now();
+        MonotonicTime m1;
+        while ((m1 = MonotonicTime::now()) == m0)
+        {
+        }
+        minStepNs = std::min(minStepNs, m1 - m0);
+    }
+    printf("Timestamp resolution: %ld us, MonotonicTime resolution: %ld ns\n", minStepUs, minStepNs);
+    printf("sample: %s\n", Timestamp::now().toString().c_str());
+    return 0;
+}
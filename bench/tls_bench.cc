@@ -0,0 +1,360 @@
+/**
+ * TLS的吞吐和握手开销 客户端和服务端都在本进程内 证书在启动时临时生成(自签名 P-256)
+ *   echo       connections个连接做ping-pong 对比明文、TLS(SSL_write)、TLS+kTLS
+ *   sendfile   服务端对每个连接sendFile一个fileMB大小的临时文件 对比明文sendfile、TLS(pread+SSL_write)、kTLS(sendfile)
+ *   handshake  依次建立连接 握手完成即断开 对比有没有会话缓存(服务端关闭ticket 用按会话ID的per-loop缓存)
+ *
+ * 内核没有tls模块(TCP_ULP "tls")或者OpenSSL不支持kTLS时 kTLS那一行会回退到SSL_write 输出中ktls=0
+ * 用法: tls_bench [seconds] [connections] [blockSize] [fileMB] [handshakes]
+ **/
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "TlsContext.h"
+#include "TlsStream.h"
+
+#include "BenchServerThread.h"
+
+#ifdef MUDUO_HAS_OPENSSL
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+static const uint16_t kPort = 9990;
+
+// 生成自签名证书和私钥 写到同一个PEM文件里
+static bool writeSelfSignedPem(const std::string &path)
+{
+    EVP_PKEY *pkey = EVP_EC_gen("P-256");
+    X509 *x509 = X509_new();
+    if (pkey == nullptr || x509 == nullptr)
+    {
+        return false;
+    }
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 86400);
+    X509_set_pubkey(x509, pkey);
+    X509_NAME *name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    X509_sign(x509, pkey, EVP_sha256());
+
+    FILE *fp = ::fopen(path.c_str(), "w");
+    bool ok = fp != nullptr && PEM_write_PrivateKey(fp, pkey, nullptr, nullptr, 0, nullptr, nullptr) == 1 &&
+              PEM_write_X509(fp, x509) == 1;
+    if (fp != nullptr)
+    {
+        ::fclose(fp);
+    }
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+// 在BenchServerThread的loop线程里构造TcpServer 由configure设置TLS和回调之后start
+static BenchServerThread::Setup benchServer(const std::function<void(TcpServer &)> &configure)
+{
+    return [configure](EventLoop *loop) {
+        std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kPort), "TlsBench"));
+        configure(*server);
+        server->start();
+        return server;
+    };
+}
+
+// 断开所有客户端 再跑一小会儿loop让连接正常关闭
+static void closeClients(EventLoop &loop, std::vector<std::unique_ptr<TcpClient>> &clients)
+{
+    for (std::unique_ptr<TcpClient> &client : clients)
+    {
+        client->disconnect();
+    }
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    clients.clear();
+}
+
+static std::shared_ptr<TlsContext> serverContext(const std::string &pem, bool ktls, bool tickets, size_t cacheSize)
+{
+    TlsContext::Options options;
+    options.certFile = pem;
+    options.ktls = ktls;
+    options.sessionTickets = tickets;
+    options.sessionCacheSize = cacheSize;
+    return std::make_shared<TlsContext>(TlsContext::kServer, options);
+}
+
+static std::shared_ptr<TlsContext> clientContext(size_t cacheSize)
+{
+    TlsContext::Options options;
+    options.ktls = false; // 客户端的开销保持不变 只比较服务端
+    options.sessionCacheSize = cacheSize;
+    return std::make_shared<TlsContext>(TlsContext::kClient, options);
+}
+
+static void printTls(const std::shared_ptr<TlsContext> &context)
+{
+    if (context)
+    {
+        printf("  handshakes %lld resumed %lld ktls %lld\n",
+               static_cast<long long>(context->stats().handshakes.load()),
+               static_cast<long long>(context->stats().resumed.load()),
+               static_cast<long long>(context->stats().ktlsSend.load()));
+    }
+    else
+    {
+        printf("\n");
+    }
+}
+
+static void runEcho(const char *label, const std::shared_ptr<TlsContext> &serverCtx,
+                    int connections, int blockSize, int seconds)
+{
+    BenchServerThread server;
+    server.start(benchServer([&serverCtx](TcpServer &s) {
+        if (serverCtx)
+        {
+            s.setTlsContext(serverCtx);
+        }
+        s.setConnectionCallback([](const TcpConnectionPtr &) {});
+        s.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            conn->send(buffer->retrieveAllAsString());
+        });
+    }));
+
+    EventLoop loop;
+    std::shared_ptr<TlsContext> clientCtx = serverCtx ? clientContext(0) : nullptr;
+    const std::string block(static_cast<size_t>(blockSize), 'e');
+    int64_t bytesRead = 0;
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(new TcpClient(&loop, InetAddress(kPort), "echo"));
+        TcpClient *client = clients.back().get();
+        if (clientCtx)
+        {
+            client->setTlsContext(clientCtx, "localhost");
+        }
+        client->setConnectionCallback([&block](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                conn->send(block);
+            }
+        });
+        client->setMessageCallback([&bytesRead](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            bytesRead += static_cast<int64_t>(buffer->readableBytes());
+            conn->send(buffer->retrieveAllAsString());
+        });
+        client->connect();
+    }
+    MonotonicTime start = MonotonicTime::now();
+    loop.runAfter(seconds, [&loop]() { loop.quit(); });
+    loop.loop();
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+    closeClients(loop, clients);
+    server.stop();
+
+    printf("echo      %-14s %8.1f MiB/s", label, static_cast<double>(bytesRead) / elapsed / 1048576.0);
+    printTls(serverCtx);
+}
+
+static void runSendFile(const char *label, const std::shared_ptr<TlsContext> &serverCtx,
+                        const std::string &file, size_t fileSize, int connections, int seconds)
+{
+    BenchServerThread server;
+    server.start(benchServer([&serverCtx, &file, fileSize](TcpServer &s) {
+        if (serverCtx)
+        {
+            s.setTlsContext(serverCtx);
+        }
+        // 每个连接打开一次文件 发完由客户端关闭连接
+        auto fds = std::make_shared<std::unordered_map<TcpConnection *, int>>();
+        s.setConnectionCallback([fds, &file, fileSize](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+                (*fds)[conn.get()] = fd;
+                conn->sendFile(fd, 0, fileSize);
+            }
+            else
+            {
+                auto it = fds->find(conn.get());
+                if (it != fds->end())
+                {
+                    ::close(it->second);
+                    fds->erase(it);
+                }
+            }
+        });
+        s.setMessageCallback([](const TcpConnectionPtr &, Buffer *buffer, Timestamp) { buffer->retrieveAll(); });
+    }));
+
+    EventLoop loop;
+    std::shared_ptr<TlsContext> clientCtx = serverCtx ? clientContext(0) : nullptr;
+    int64_t bytesRead = 0;
+    int files = 0;
+    bool running = true;
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    // 每个客户端收完一个文件就断开 断开后重新连接再收一个
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(new TcpClient(&loop, InetAddress(kPort), "file"));
+        TcpClient *client = clients.back().get();
+        if (clientCtx)
+        {
+            client->setTlsContext(clientCtx, "localhost");
+        }
+        auto received = std::make_shared<size_t>(0);
+        client->setConnectionCallback([received, client, &running, &loop](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                *received = 0;
+            }
+            else if (running)
+            {
+                loop.queueInLoop([client]() { client->connect(); });
+            }
+        });
+        client->setMessageCallback([received, fileSize, &bytesRead, &files](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            *received += buffer->readableBytes();
+            bytesRead += static_cast<int64_t>(buffer->readableBytes());
+            buffer->retrieveAll();
+            if (*received >= fileSize)
+            {
+                ++files;
+                conn->shutdown();
+            }
+        });
+        client->connect();
+    }
+    MonotonicTime start = MonotonicTime::now();
+    loop.runAfter(seconds, [&loop, &running]() {
+        running = false;
+        loop.quit();
+    });
+    loop.loop();
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+    closeClients(loop, clients);
+    server.stop();
+
+    printf("sendfile  %-14s %8.1f MiB/s  %d files", label, static_cast<double>(bytesRead) / elapsed / 1048576.0, files);
+    printTls(serverCtx);
+}
+
+static void runHandshakes(const char *label, const std::string &pem, bool sessionCache, int count)
+{
+    std::shared_ptr<TlsContext> serverCtx = serverContext(pem, false, false, sessionCache ? 1024 : 0);
+    BenchServerThread server;
+    server.start(benchServer([&serverCtx](TcpServer &s) {
+        s.setTlsContext(serverCtx);
+        s.setConnectionCallback([](const TcpConnectionPtr &) {});
+        s.setMessageCallback([](const TcpConnectionPtr &, Buffer *buffer, Timestamp) { buffer->retrieveAll(); });
+    }));
+
+    EventLoop loop;
+    std::shared_ptr<TlsContext> clientCtx = clientContext(sessionCache ? 16 : 0);
+    int done = 0;
+    std::unique_ptr<TcpClient> client(new TcpClient(&loop, InetAddress(kPort), "handshake"));
+    client->setTlsContext(clientCtx, "localhost");
+    client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->send("x"); // 让服务端的NewSessionTicket先于关闭到达客户端
+        }
+        else if (++done < count)
+        {
+            loop.queueInLoop([&client]() { client->connect(); });
+        }
+        else
+        {
+            loop.quit();
+        }
+    });
+    client->setMessageCallback([](const TcpConnectionPtr &, Buffer *buffer, Timestamp) { buffer->retrieveAll(); });
+    client->setWriteCompleteCallback([](const TcpConnectionPtr &conn) { conn->shutdown(); });
+    MonotonicTime start = MonotonicTime::now();
+    client->connect();
+    loop.loop();
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+    client.reset();
+    server.stop();
+
+    printf("handshake %-14s %8.0f conn/s", label, static_cast<double>(done) / elapsed);
+    printTls(serverCtx);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int blockSize = argc > 3 ? atoi(argv[3]) : 16384;
+    int fileMB = argc > 4 ? atoi(argv[4]) : 16;
+    int handshakes = argc > 5 ? atoi(argv[5]) : 500;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    char pem[64];
+    snprintf(pem, sizeof pem, "/tmp/muduo-tls-bench-%d.pem", ::getpid());
+    char file[64];
+    snprintf(file, sizeof file, "/tmp/muduo-tls-bench-%d.dat", ::getpid());
+    if (!writeSelfSignedPem(pem))
+    {
+        fprintf(stderr, "failed to create a self-signed certificate\n");
+        return 1;
+    }
+    size_t fileSize = static_cast<size_t>(fileMB) * 1024 * 1024;
+    {
+        int fd = ::open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        std::string chunk(1024 * 1024, 'f');
+        for (int i = 0; i < fileMB; ++i)
+        {
+            if (::write(fd, chunk.data(), chunk.size()) != static_cast<ssize_t>(chunk.size()))
+            {
+                fprintf(stderr, "failed to write %s\n", file);
+                return 1;
+            }
+        }
+        ::close(fd);
+    }
+
+    runEcho("plain", nullptr, connections, blockSize, seconds);
+    runEcho("tls", serverContext(pem, false, true, 1024), connections, blockSize, seconds);
+    runEcho("tls+ktls", serverContext(pem, true, true, 1024), connections, blockSize, seconds);
+
+    runSendFile("plain", nullptr, file, fileSize, connections, seconds);
+    runSendFile("tls", serverContext(pem, false, true, 1024), file, fileSize, connections, seconds);
+    runSendFile("tls+ktls", serverContext(pem, true, true, 1024), file, fileSize, connections, seconds);
+
+    runHandshakes("full", pem, false, handshakes);
+    runHandshakes("session cache", pem, true, handshakes);
+
+    ::unlink(pem);
+    ::unlink(file);
+    return 0;
+}
+
+#else // MUDUO_HAS_OPENSSL
+
+int main()
+{
+    printf("muduo was built without OpenSSL, nothing to benchmark\n");
+    return 0;
+}
+
+#endif // MUDUO_HAS_OPENSSL
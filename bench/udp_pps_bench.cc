@@ -0,0 +1,137 @@
+/**
+ * UDP回环收包速率测试 发送端和UdpServer都在本进程内
+ * 服务端: UdpServer serverThreads个loop 每个loop一个SO_REUSEPORT socket recvmmsg批量收取 只计数不回复
+ * 发送端: senders个线程 每个线程一个UdpSocket(源端口不同 内核会把它们哈希到不同的服务端socket上)
+ *
+ * 三种发送方式各跑seconds秒:
+ *   sendto    每个数据报一次系统调用
+ *   sendmmsg  queueSendTo攒满一批(64个)后一次sendmmsg
+ *   gso       sendSegmented 一次sendmsg发出64个分段 服务端开启GRO时内核也按合并后的大包交付
+ * 输出发送端和服务端各自的包速率 两者之差是内核丢弃的(接收缓冲区满)
+ *
+ * 用法: udp_pps_bench [seconds] [msgSize] [senders] [serverThreads] [gro 0/1]
+ **/
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "UdpServer.h"
+#include "UdpSocket.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9985;
+
+// UDP接收端 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<UdpServer> startUdpServer(EventLoop *loop, int threads, bool gro)
+{
+    std::shared_ptr<UdpServer> server(new UdpServer(loop, InetAddress(kPort), "UdpSink"));
+    server->setThreadNum(threads);
+    server->setRecvBufferSize(8 * 1024 * 1024);
+    server->enableGro(gro);
+    server->start();
+    return server;
+}
+
+enum Mode
+{
+    kSendTo,
+    kSendMmsg,
+    kGso
+};
+
+static void runMode(const char *name, Mode mode, const UdpServer *server, int seconds, int msgSize, int senders)
+{
+    std::atomic<bool> running(true);
+    std::atomic<int64_t> sent(0);
+    std::atomic<int64_t> dropped(0);
+    std::atomic<int64_t> calls(0);
+    const InetAddress serverAddr(kPort);
+
+    int64_t receivedBefore = server->receivedPackets();
+    MonotonicTime start = MonotonicTime::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < senders; ++t)
+    {
+        threads.emplace_back([&]() {
+            UdpSocket socket(UdpSocket::kDefaultBatchSize, static_cast<size_t>(msgSize));
+            socket.setSendBufferSize(4 * 1024 * 1024);
+            const int batch = UdpSocket::kDefaultBatchSize;
+            std::string block(static_cast<size_t>(batch * msgSize), 'u');
+            while (running.load(std::memory_order_relaxed))
+            {
+                switch (mode)
+                {
+                case kSendTo:
+                    for (int i = 0; i < batch; ++i)
+                    {
+                        socket.sendTo(block.data(), static_cast<size_t>(msgSize), serverAddr);
+                    }
+                    break;
+                case kSendMmsg:
+                    for (int i = 0; i < batch; ++i)
+                    {
+                        socket.queueSendTo(block.data() + i * msgSize, static_cast<size_t>(msgSize), serverAddr);
+                    }
+                    socket.flush();
+                    break;
+                case kGso:
+                    socket.sendSegmented(block.data(), block.size(), static_cast<size_t>(msgSize), serverAddr);
+                    break;
+                }
+            }
+            const UdpSocket::Stats &stats = socket.stats();
+            sent += stats.sent;
+            dropped += stats.sendDropped;
+            calls += stats.sendCalls;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    // 给服务端一点时间收完缓冲区里剩下的数据报
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+    int64_t received = server->receivedPackets() - receivedBefore;
+
+    printf("%-9s sent %10.0f pps (%5.1f pkts/syscall, %ld send drops)  received %10.0f pps (%.1f%%)\n",
+           name, sent.load() / elapsed, calls.load() ? static_cast<double>(sent.load()) / calls.load() : 0.0,
+           dropped.load(), received / elapsed, sent.load() ? 100.0 * received / sent.load() : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int msgSize = argc > 2 ? atoi(argv[2]) : 64;
+    int senders = argc > 3 ? atoi(argv[3]) : 2;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 2;
+    bool gro = argc > 5 ? atoi(argv[5]) != 0 : true;
+
+    Logger::setLogLevel(ERROR);
+    BenchServerThread server;
+    const UdpServer *sink = nullptr; // 统计是原子计数 可以在其他线程读
+    server.start([serverThreads, gro, &sink](EventLoop *loop) {
+        std::shared_ptr<UdpServer> udpServer(startUdpServer(loop, serverThreads, gro));
+        sink = udpServer.get();
+        return udpServer;
+    });
+
+    printf("%d bytes datagrams, %d senders, %d server threads, GRO %s\n",
+           msgSize, senders, serverThreads, gro ? "on" : "off");
+    runMode("sendto", kSendTo, sink, seconds, msgSize, senders);
+    runMode("sendmmsg", kSendMmsg, sink, seconds, msgSize, senders);
+    runMode("gso", kGso, sink, seconds, msgSize, senders);
+
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * 同一台机器上 Unix域socket 和 回环TCP 的回显对比 客户端和服务端都在本进程内
+ * 服务端: 两个TcpServer 一个监听127.0.0.1 一个监听抽象命名的Unix域地址 都是回显 TcpConnection的代码完全相同
+ * 客户端:
+ *   延迟   一个连接 发msgSize字节 收完回显再发下一个 共rounds次 统计往返时间
+ *   吞吐   connections个连接 每个连接发blockSize字节后把收到的数据原样发回(ping-pong) 持续seconds秒
+ *
+ * 用法: uds_vs_tcp_bench [rounds] [msgSize] [connections] [blockSize] [seconds]
+ **/
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include "BenchServerThread.h"
+
+static const uint16_t kPort = 9986;
+
+// 同一个loop上同时监听TCP和Unix域地址的回显服务器
+struct EchoServers
+{
+    std::unique_ptr<TcpServer> tcp;
+    std::unique_ptr<TcpServer> uds;
+};
+
+// 在BenchServerThread的loop线程里构造和析构
+static std::shared_ptr<void> startEchoServers(EventLoop *loop, const InetAddress &tcpAddr, const InetAddress &unixAddr)
+{
+    std::shared_ptr<EchoServers> servers(new EchoServers);
+    servers->tcp.reset(new TcpServer(loop, tcpAddr, "EchoTcp"));
+    servers->uds.reset(new TcpServer(loop, unixAddr, "EchoUnix"));
+    for (TcpServer *server : {servers->tcp.get(), servers->uds.get()})
+    {
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true); // Unix域socket上设置失败 没有影响
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            conn->send(buffer->retrieveAllAsString());
+        });
+        server->start();
+    }
+    return servers;
+}
+
+// 断开所有客户端 再跑一小会儿loop让连接正常关闭
+static void closeClients(EventLoop &loop, std::vector<std::unique_ptr<TcpClient>> &clients)
+{
+    for (std::unique_ptr<TcpClient> &client : clients)
+    {
+        client->disconnect();
+    }
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    clients.clear();
+}
+
+static void runLatency(const char *label, const InetAddress &addr, int rounds, int msgSize)
+{
+    EventLoop loop;
+    const std::string message(static_cast<size_t>(msgSize), 'l');
+    std::vector<int64_t> samples;
+    samples.reserve(static_cast<size_t>(rounds));
+    MonotonicTime sentAt;
+
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    clients.emplace_back(new TcpClient(&loop, addr, "latency"));
+    TcpClient *client = clients.back().get();
+    client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            sentAt = MonotonicTime::now();
+            conn->send(message);
+        }
+    });
+    client->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+        if (buffer->readableBytes() < message.size())
+        {
+            return;
+        }
+        buffer->retrieve(message.size());
+        samples.push_back(MonotonicTime::now() - sentAt);
+        if (static_cast<int>(samples.size()) == rounds)
+        {
+            loop.quit();
+            return;
+        }
+        sentAt = MonotonicTime::now();
+        conn->send(message);
+    });
+    client->connect();
+    loop.loop();
+    closeClients(loop, clients);
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (int64_t ns : samples)
+    {
+        sum += static_cast<double>(ns);
+    }
+    auto pct = [&samples](double p) -> double {
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())));
+        return static_cast<double>(samples[index]) / 1000.0;
+    };
+    printf("%-5s latency     %d x %d bytes  mean %6.1f us  p50 %6.1f us  p99 %6.1f us  max %7.1f us\n",
+           label, rounds, msgSize, sum / static_cast<double>(samples.size()) / 1000.0,
+           pct(0.50), pct(0.99), pct(1.0));
+}
+
+static void runThroughput(const char *label, const InetAddress &addr, int connections, int blockSize, int seconds)
+{
+    EventLoop loop;
+    const std::string block(static_cast<size_t>(blockSize), 't');
+    int64_t bytesRead = 0;
+
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(new TcpClient(&loop, addr, "throughput"));
+        TcpClient *client = clients.back().get();
+        client->setConnectionCallback([&block](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                conn->send(block);
+            }
+        });
+        client->setMessageCallback([&bytesRead](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp) {
+            bytesRead += static_cast<int64_t>(buffer->readableBytes());
+            conn->send(buffer->retrieveAllAsString());
+        });
+        client->connect();
+    }
+    MonotonicTime start = MonotonicTime::now();
+    loop.runAfter(seconds, [&loop]() { loop.quit(); });
+    loop.loop();
+    double elapsed = (MonotonicTime::now() - start) / 1e9;
+    closeClients(loop, clients);
+
+    printf("%-5s throughput  %d conns x %d bytes  %8.1f MiB/s\n",
+           label, connections, blockSize, static_cast<double>(bytesRead) / elapsed / 1048576.0);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    int msgSize = argc > 2 ? atoi(argv[2]) : 64;
+    int connections = argc > 3 ? atoi(argv[3]) : 4;
+    int blockSize = argc > 4 ? atoi(argv[4]) : 16384;
+    int seconds = argc > 5 ? atoi(argv[5]) : 3;
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    char name[64];
+    snprintf(name, sizeof name, "muduo-uds-bench-%d", ::getpid());
+    InetAddress tcpAddr(kPort);
+    InetAddress unixAddr = InetAddress::fromAbstract(name);
+    BenchServerThread server;
+    server.start([&tcpAddr, &unixAddr](EventLoop *loop) { return startEchoServers(loop, tcpAddr, unixAddr); });
+
+    printf("tcp %s vs %s\n", tcpAddr.toIpPort().c_str(), unixAddr.toIpPort().c_str());
+    runLatency("tcp", tcpAddr, rounds, msgSize);
+    runLatency("unix", unixAddr, rounds, msgSize);
+    runThroughput("tcp", tcpAddr, connections, blockSize, seconds);
+    runThroughput("unix", unixAddr, connections, blockSize, seconds);
+
+    server.stop();
+    return 0;
+}
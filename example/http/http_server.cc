@@ -0,0 +1,149 @@
+/**
+ * HTTP/1.1服务器示例
+ *
+ *   ./http_server [port] [docroot] [threads] [metricsPort]
+ *
+ *   GET  /hello          固定的小响应
+ *   GET  /files/<path>   docroot下的静态文件 用sendFile零拷贝发送
+ *   GET  /stream?n=5     每100ms发送一个chunked数据块 共n块 演示延迟响应
+ *   POST /echo           原样返回请求体(支持chunked请求体)
+ *
+ *   curl -v http://127.0.0.1:8000/hello
+ *   curl -v --data-binary @file -H 'Transfer-Encoding: chunked' http://127.0.0.1:8000/echo
+ *   curl http://127.0.0.1:9100/metrics   指定了metricsPort时 管理端口只监听127.0.0.1
+ **/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HttpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "MetricsServer.h"
+
+class HttpExample
+{
+public:
+    HttpExample(EventLoop *loop, const InetAddress &addr, const std::string &docroot, int threads)
+        : server_(loop, addr, "HttpExample")
+        , docroot_(docroot)
+    {
+        server_.setHttpCallback(
+            std::bind(&HttpExample::onRequest, this, std::placeholders::_1, std::placeholders::_2));
+        server_.setThreadNum(threads);
+    }
+
+    void start() { server_.start(); }
+
+private:
+    void onRequest(const HttpRequest &req, HttpResponse *resp)
+    {
+        StringPiece path = req.path();
+        if (path == "/hello")
+        {
+            resp->setContentType("text/plain");
+            resp->setBody("hello, world\n");
+        }
+        else if (path.startsWith("/files/") && (req.method() == HttpRequest::kGet || req.method() == HttpRequest::kHead))
+        {
+            serveFile(StringPiece(path.data() + 7, path.size() - 7), resp);
+        }
+        else if (path == "/stream")
+        {
+            stream(req, resp);
+        }
+        else if (path == "/echo" && req.method() == HttpRequest::kPost)
+        {
+            StringPiece type = req.getHeader("Content-Type");
+            resp->setContentType(type.empty() ? StringPiece("application/octet-stream") : type);
+            resp->setBody(req.body());
+        }
+        else
+        {
+            resp->setStatusCode(404);
+            resp->setContentType("text/plain");
+            resp->setBody("Not Found\n");
+        }
+    }
+
+    void serveFile(const StringPiece &relative, HttpResponse *resp)
+    {
+        // 示例只做最简单的检查: 不允许".."出现在路径里
+        std::string name = relative.toString();
+        if (name.empty() || name.find("..") != std::string::npos)
+        {
+            resp->setStatusCode(403);
+            resp->setBody("Forbidden\n");
+            return;
+        }
+        std::string file = docroot_ + "/" + name;
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            resp->setStatusCode(404);
+            resp->setBody("Not Found\n");
+            return;
+        }
+        resp->setContentType("application/octet-stream");
+        resp->setFile(fd, 0, static_cast<size_t>(st.st_size)); // 发完后由框架关闭fd
+    }
+
+    void stream(const HttpRequest &req, HttpResponse *resp)
+    {
+        int count = 5;
+        StringPiece query = req.query();
+        if (query.startsWith("n="))
+        {
+            count = atoi(query.toString().c_str() + 2);
+        }
+        resp->setContentType("text/plain");
+        resp->setChunked(true);
+        std::shared_ptr<HttpResponseWriter> writer = resp->defer();
+        sendChunk(writer, 0, count);
+    }
+
+    static void sendChunk(const std::shared_ptr<HttpResponseWriter> &writer, int i, int count)
+    {
+        if (i >= count || !writer->connected())
+        {
+            writer->finish();
+            return;
+        }
+        char line[64];
+        int n = snprintf(line, sizeof line, "chunk %d of %d\n", i + 1, count);
+        writer->write(StringPiece(line, static_cast<size_t>(n)));
+        writer->getLoop()->runAfter(0.1, [writer, i, count]() { sendChunk(writer, i + 1, count); });
+    }
+
+    HttpServer server_;
+    std::string docroot_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 8000);
+    std::string docroot = argc > 2 ? argv[2] : ".";
+    int threads = argc > 3 ? atoi(argv[3]) : 2;
+    int metricsPort = argc > 4 ? atoi(argv[4]) : 0;
+
+    EventLoop loop;
+    InetAddress addr(port);
+    HttpExample server(&loop, addr, docroot, threads);
+    server.start();
+    std::unique_ptr<MetricsServer> admin;
+    if (metricsPort > 0)
+    {
+        admin.reset(new MetricsServer(&loop, InetAddress(static_cast<uint16_t>(metricsPort))));
+        admin->start();
+    }
+    loop.loop();
+    return 0;
+}
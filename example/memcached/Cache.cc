@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Cache.h"
+#include "Buffer.h"
+
+const int SlabAllocator::kMaxClasses;
+const size_t SlabAllocator::kPageSize;
+
+SlabAllocator::SlabAllocator(size_t memoryLimit, size_t minChunk, double factor)
+    : memoryLimit_(memoryLimit)
+{
+    // chunk大小按8字节对齐 最后一级就是整页
+    size_t size = minChunk;
+    while (size < kPageSize / 2 && static_cast<int>(chunkSizes_.size()) < kMaxClasses - 1)
+    {
+        chunkSizes_.push_back(size);
+        size = (static_cast<size_t>(static_cast<double>(size) * factor) + 7) & ~static_cast<size_t>(7);
+    }
+    chunkSizes_.push_back(kPageSize);
+    freeLists_.assign(chunkSizes_.size(), nullptr);
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    for (char *page : pages_)
+    {
+        ::free(page);
+    }
+}
+
+int SlabAllocator::classFor(size_t size) const
+{
+    // 级数不多 二分查找
+    size_t lo = 0;
+    size_t hi = chunkSizes_.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (chunkSizes_[mid] < size)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo < chunkSizes_.size() ? static_cast<int>(lo) : -1;
+}
+
+bool SlabAllocator::grow(int cls)
+{
+    if ((pages_.size() + 1) * kPageSize > memoryLimit_ && !pages_.empty())
+    {
+        return false;
+    }
+    char *page = static_cast<char *>(::malloc(kPageSize));
+    if (page == nullptr)
+    {
+        return false;
+    }
+    pages_.push_back(page);
+    size_t chunk = chunkSizes_[cls];
+    for (size_t offset = 0; offset + chunk <= kPageSize; offset += chunk)
+    {
+        FreeChunk *free = reinterpret_cast<FreeChunk *>(page + offset);
+        free->next = freeLists_[cls];
+        freeLists_[cls] = free;
+    }
+    return true;
+}
+
+void *SlabAllocator::allocate(int cls)
+{
+    if (freeLists_[cls] == nullptr && !grow(cls))
+    {
+        return nullptr;
+    }
+    FreeChunk *chunk = freeLists_[cls];
+    freeLists_[cls] = chunk->next;
+    return chunk;
+}
+
+void SlabAllocator::deallocate(void *chunk, int cls)
+{
+    FreeChunk *free = static_cast<FreeChunk *>(chunk);
+    free->next = freeLists_[cls];
+    freeLists_[cls] = free;
+}
+
+CacheShard::CacheShard(size_t memoryLimit)
+    : slabs_(memoryLimit)
+    , buckets_(1024, nullptr)
+    , lruHead_(slabs_.classCount(), nullptr)
+    , lruTail_(slabs_.classCount(), nullptr)
+{
+}
+
+CacheShard::~CacheShard() = default; // 数据都在slab页里 随SlabAllocator一起释放
+
+CacheItem **CacheShard::findSlot(const StringPiece &key, uint64_t hash)
+{
+    CacheItem **slot = &buckets_[hash & (buckets_.size() - 1)];
+    while (*slot != nullptr)
+    {
+        CacheItem *item = *slot;
+        if (item->keyLen == key.size() && ::memcmp(item->key(), key.data(), key.size()) == 0)
+        {
+            return slot;
+        }
+        slot = &item->hashNext;
+    }
+    return slot;
+}
+
+void CacheShard::lruPushFront(CacheItem *item)
+{
+    int cls = item->slabClass;
+    item->lruPrev = nullptr;
+    item->lruNext = lruHead_[cls];
+    if (lruHead_[cls] != nullptr)
+    {
+        lruHead_[cls]->lruPrev = item;
+    }
+    lruHead_[cls] = item;
+    if (lruTail_[cls] == nullptr)
+    {
+        lruTail_[cls] = item;
+    }
+}
+
+void CacheShard::lruRemove(CacheItem *item)
+{
+    int cls = item->slabClass;
+    if (item->lruPrev != nullptr)
+    {
+        item->lruPrev->lruNext = item->lruNext;
+    }
+    else
+    {
+        lruHead_[cls] = item->lruNext;
+    }
+    if (item->lruNext != nullptr)
+    {
+        item->lruNext->lruPrev = item->lruPrev;
+    }
+    else
+    {
+        lruTail_[cls] = item->lruPrev;
+    }
+}
+
+// 从哈希表和LRU中摘下slot指向的项并释放内存
+void CacheShard::unlinkItem(CacheItem **slot)
+{
+    CacheItem *item = *slot;
+    *slot = item->hashNext;
+    lruRemove(item);
+    slabs_.deallocate(item, item->slabClass);
+    --stats_.items;
+}
+
+void CacheShard::rehash()
+{
+    std::vector<CacheItem *> buckets(buckets_.size() * 2, nullptr);
+    for (CacheItem *head : buckets_)
+    {
+        while (head != nullptr)
+        {
+            CacheItem *next = head->hashNext;
+            uint64_t h = Cache::hash(StringPiece(head->key(), head->keyLen));
+            CacheItem *&bucket = buckets[h & (buckets.size() - 1)];
+            head->hashNext = bucket;
+            bucket = head;
+            head = next;
+        }
+    }
+    buckets_.swap(buckets);
+}
+
+bool CacheShard::get(const StringPiece &key, time_t now, Buffer *output)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++stats_.gets;
+    CacheItem **slot = findSlot(key, Cache::hash(key));
+    CacheItem *item = *slot;
+    if (item == nullptr)
+    {
+        return false;
+    }
+    if (item->expireAt != 0 && item->expireAt <= now)
+    {
+        unlinkItem(slot); // 过期的数据在访问时删除
+        return false;
+    }
+    ++stats_.hits;
+    lruRemove(item);
+    lruPushFront(item);
+
+    char line[64];
+    int n = snprintf(line, sizeof line, " %u %u\r\n", item->flags, item->valueLen);
+    output->append("VALUE ", 6);
+    output->append(item->key(), item->keyLen);
+    output->append(line, static_cast<size_t>(n));
+    output->append(item->value(), item->valueLen + 2);
+    return true;
+}
+
+CacheShard::SetResult CacheShard::set(const StringPiece &key, uint32_t flags, time_t expireAt,
+                                      const char *data, size_t len)
+{
+    size_t total = sizeof(CacheItem) + key.size() + len + 2;
+    int cls = slabs_.classFor(total);
+    if (cls < 0)
+    {
+        return kTooLarge;
+    }
+    uint64_t hash = Cache::hash(key);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++stats_.sets;
+    CacheItem **slot = findSlot(key, hash);
+    if (*slot != nullptr)
+    {
+        unlinkItem(slot); // 先删掉旧值 释放的chunk可能正好给新值用
+        slot = findSlot(key, hash);
+    }
+    void *chunk = slabs_.allocate(cls);
+    while (chunk == nullptr && lruTail_[cls] != nullptr)
+    {
+        // 没有内存了 淘汰同级别最久没用的一项
+        CacheItem *victim = lruTail_[cls];
+        CacheItem **victimSlot = findSlot(StringPiece(victim->key(), victim->keyLen),
+                                          Cache::hash(StringPiece(victim->key(), victim->keyLen)));
+        unlinkItem(victimSlot);
+        ++stats_.evictions;
+        chunk = slabs_.allocate(cls);
+    }
+    if (chunk == nullptr)
+    {
+        return kOutOfMemory; // 内存都被其他级别占用了
+    }
+    slot = findSlot(key, hash); // 淘汰可能改动了同一条哈希链
+
+    CacheItem *item = static_cast<CacheItem *>(chunk);
+    item->expireAt = expireAt;
+    item->flags = flags;
+    item->valueLen = static_cast<uint32_t>(len);
+    item->keyLen = static_cast<uint8_t>(key.size());
+    item->slabClass = static_cast<uint8_t>(cls);
+    ::memcpy(item->key(), key.data(), key.size());
+    ::memcpy(item->value(), data, len);
+    item->value()[len] = '\r';
+    item->value()[len + 1] = '\n';
+    item->hashNext = nullptr;
+    *slot = item;
+    lruPushFront(item);
+    ++stats_.items;
+    if (static_cast<size_t>(stats_.items) > buckets_.size() + buckets_.size() / 2)
+    {
+        rehash();
+    }
+    return kStored;
+}
+
+bool CacheShard::remove(const StringPiece &key)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    CacheItem **slot = findSlot(key, Cache::hash(key));
+    if (*slot == nullptr)
+    {
+        return false;
+    }
+    unlinkItem(slot);
+    return true;
+}
+
+CacheShard::Stats CacheShard::stats()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.pages = static_cast<int64_t>(slabs_.pagesAllocated());
+    return stats;
+}
+
+Cache::Cache(int shards, size_t memoryLimit)
+{
+    int n = shards > 0 ? shards : 1;
+    for (int i = 0; i < n; ++i)
+    {
+        shards_.emplace_back(new CacheShard(memoryLimit / static_cast<size_t>(n)));
+    }
+}
+
+uint64_t Cache::hash(const StringPiece &key)
+{
+    // FNV-1a 分片用高位 哈希桶用低位
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+#include "noncopyable.h"
+#include "StringPiece.h"
+
+class Buffer;
+
+/**
+ * slab风格的内存分配 按chunk大小分级(每级乘factor) 每级从1MB的页里切chunk
+ * 释放的chunk挂回本级的空闲链表 不还给系统 总页数受memoryLimit限制
+ * 不是线程安全的 由所属的CacheShard加锁
+ **/
+class SlabAllocator : noncopyable
+{
+public:
+    static const int kMaxClasses = 64;
+    static const size_t kPageSize = 1024 * 1024;
+
+    SlabAllocator(size_t memoryLimit, size_t minChunk = 64, double factor = 1.25);
+    ~SlabAllocator();
+
+    // 能放下size字节的最小级别 超过一页返回-1
+    int classFor(size_t size) const;
+    size_t chunkSize(int cls) const { return chunkSizes_[cls]; }
+    int classCount() const { return static_cast<int>(chunkSizes_.size()); }
+
+    // 没有空闲chunk并且不能再分配新页时返回nullptr 由调用者淘汰同级别的数据
+    void *allocate(int cls);
+    void deallocate(void *chunk, int cls);
+
+    size_t pagesAllocated() const { return pages_.size(); }
+
+private:
+    struct FreeChunk
+    {
+        FreeChunk *next;
+    };
+
+    bool grow(int cls);
+
+    const size_t memoryLimit_;
+    std::vector<size_t> chunkSizes_;
+    std::vector<FreeChunk *> freeLists_;
+    std::vector<char *> pages_;
+};
+
+// 缓存中的一项 key和value紧跟在结构体后面 value后面带"\r\n" get时和VALUE行一起直接拷贝出去
+struct CacheItem
+{
+    CacheItem *hashNext;
+    CacheItem *lruPrev;
+    CacheItem *lruNext;
+    time_t expireAt; // 0表示不过期
+    uint32_t flags;
+    uint32_t valueLen;
+    uint8_t keyLen;
+    uint8_t slabClass;
+
+    char *key() { return reinterpret_cast<char *>(this + 1); }
+    char *value() { return key() + keyLen; }
+    size_t totalSize() const { return sizeof(CacheItem) + keyLen + valueLen + 2; }
+};
+
+/**
+ * 一个分片: 链式哈希表 + slab内存 + 每个slab级别一条LRU链表 一把锁保护
+ * get在锁内把数据拷贝到连接的输出缓冲 不需要引用计数
+ **/
+class CacheShard : noncopyable
+{
+public:
+    enum SetResult
+    {
+        kStored,
+        kTooLarge,
+        kOutOfMemory,
+    };
+
+    explicit CacheShard(size_t memoryLimit);
+    ~CacheShard();
+
+    // 命中时追加"VALUE <key> <flags> <bytes>\r\n<data>\r\n"
+    bool get(const StringPiece &key, time_t now, Buffer *output);
+    SetResult set(const StringPiece &key, uint32_t flags, time_t expireAt, const char *data, size_t len);
+    bool remove(const StringPiece &key);
+
+    struct Stats
+    {
+        int64_t items = 0;
+        int64_t gets = 0;
+        int64_t hits = 0;
+        int64_t sets = 0;
+        int64_t evictions = 0;
+        int64_t pages = 0;
+    };
+    Stats stats();
+
+private:
+    CacheItem **findSlot(const StringPiece &key, uint64_t hash);
+    void unlinkItem(CacheItem **slot);
+    void lruPushFront(CacheItem *item);
+    void lruRemove(CacheItem *item);
+    void rehash();
+
+    std::mutex mutex_;
+    SlabAllocator slabs_;
+    std::vector<CacheItem *> buckets_; // 大小是2的幂
+    std::vector<CacheItem *> lruHead_;
+    std::vector<CacheItem *> lruTail_;
+    Stats stats_;
+};
+
+// 按key的哈希选分片 分片数通常等于loop数 降低锁竞争
+class Cache : noncopyable
+{
+public:
+    Cache(int shards, size_t memoryLimit);
+
+    CacheShard &shardFor(const StringPiece &key) { return *shards_[(hash(key) >> 40) % shards_.size()]; }
+    int shardCount() const { return static_cast<int>(shards_.size()); }
+    CacheShard &shard(int i) { return *shards_[i]; }
+
+    static uint64_t hash(const StringPiece &key);
+
+private:
+    std::vector<std::unique_ptr<CacheShard>> shards_;
+};
@@ -0,0 +1,376 @@
+/**
+ * memcached文本协议的负载生成器 配合memcached_server做端到端的读/解析/写路径测试
+ *
+ *   ./memcached_load [seconds] [connections] [pipeline] [keys] [getPercent] [port]
+ *
+ * 先用set noreply把keys个key全部写一遍 然后每个连接保持pipeline个命令在途
+ * 命令按getPercent混合get和set 八分之一的get是8个key的multi-get
+ * value大小按key固定: 70%是32B~512B 25%是1KB~16KB 5%是64KB~256KB
+ * 响应按发送顺序就地解析 统计ops/s、命中率、延迟分位数和接收带宽
+ **/
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "StringPiece.h"
+#include "TcpClient.h"
+
+static const int kMaxPipeline = 1024;
+static const int kMultiGetKeys = 8;
+static const size_t kMaxValueLen = 256 * 1024;
+
+// 在途命令 响应按这个顺序返回
+struct PendingOp
+{
+    int64_t sentNs;
+    int keys; // get的key个数 set为0
+};
+
+struct ClientConn
+{
+    TcpConnectionPtr conn;
+    PendingOp pending[kMaxPipeline]; // 环形队列
+    int head = 0;
+    int inflight = 0;
+    bool loaded = false; // 预先写入已经完成
+    uint64_t rand = 0;
+    Buffer output{64 * 1024};
+};
+
+class MemcacheLoad
+{
+public:
+    MemcacheLoad(EventLoop *loop, const InetAddress &addr, int connections, int pipeline, int keys, int getPercent)
+        : pipeline_(std::min(pipeline, kMaxPipeline))
+        , keys_(keys)
+        , getPercent_(getPercent)
+        , value_(kMaxValueLen, 'v')
+        , conns_(connections)
+    {
+        for (int i = 0; i < connections; ++i)
+        {
+            ClientConn *state = &conns_[i];
+            state->rand = 0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(i + 1);
+            clients_.emplace_back(new TcpClient(loop, addr, "MemcacheLoad"));
+            clients_.back()->setConnectionCallback([this, state, i](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    state->conn = conn;
+                    preload(state, i);
+                }
+                else
+                {
+                    state->conn.reset();
+                }
+            });
+            clients_.back()->setMessageCallback(
+                [this, state](const TcpConnectionPtr &, Buffer *buf, Timestamp) { onResponse(state, buf); });
+        }
+    }
+
+    void start()
+    {
+        for (auto &client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    void stop()
+    {
+        for (size_t i = 0; i < clients_.size(); ++i)
+        {
+            conns_[i].conn.reset();
+            clients_[i]->disconnect();
+        }
+    }
+
+    bool loaded() const { return loadedConns_ == static_cast<int>(conns_.size()); }
+
+    void resetStats()
+    {
+        latencies_.clear();
+        hits_ = 0;
+        misses_ = 0;
+        errors_ = 0;
+        bytesReceived_ = 0;
+    }
+
+    std::vector<int64_t> &latencies() { return latencies_; }
+    int64_t hits() const { return hits_; }
+    int64_t misses() const { return misses_; }
+    int64_t errors() const { return errors_; }
+    int64_t bytesReceived() const { return bytesReceived_; }
+
+private:
+    static uint64_t nextRandom(ClientConn *state)
+    {
+        uint64_t x = state->rand; // xorshift64
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        state->rand = x;
+        return x;
+    }
+
+    // 每个key的value长度固定 读到的长度不一致说明数据错了
+    static size_t valueLen(int key)
+    {
+        uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+        uint64_t bucket = (h >> 32) % 100;
+        uint64_t r = h >> 8;
+        if (bucket < 70)
+        {
+            return 32 + r % 481;
+        }
+        if (bucket < 95)
+        {
+            return 1024 + r % (15 * 1024 + 1);
+        }
+        return 64 * 1024 + r % (192 * 1024 + 1);
+    }
+
+    static int formatKey(char *out, int key) { return snprintf(out, 32, "key:%010d", key); }
+
+    void appendSet(ClientConn *state, int key, bool noreply)
+    {
+        char line[96];
+        char name[32];
+        formatKey(name, key);
+        size_t len = valueLen(key);
+        int n = snprintf(line, sizeof line, "set %s 0 0 %zu%s\r\n", name, len, noreply ? " noreply" : "");
+        state->output.append(line, static_cast<size_t>(n));
+        state->output.append(value_.data(), len);
+        state->output.append("\r\n", 2);
+    }
+
+    // 连接i写入i, i+N, i+2N...这些key 最后的version作为完成的标记
+    void preload(ClientConn *state, int index)
+    {
+        for (int key = index; key < keys_; key += static_cast<int>(conns_.size()))
+        {
+            appendSet(state, key, true);
+            if (state->output.readableBytes() > 1024 * 1024)
+            {
+                state->conn->send(&state->output);
+            }
+        }
+        state->output.append("version\r\n", 9);
+        state->conn->send(&state->output);
+    }
+
+    void issue(ClientConn *state, int n)
+    {
+        int64_t now = MonotonicTime::now().nanoSeconds();
+        for (int i = 0; i < n; ++i)
+        {
+            int count = 0;
+            if (static_cast<int>(nextRandom(state) % 100) < getPercent_)
+            {
+                count = nextRandom(state) % 8 == 0 ? kMultiGetKeys : 1;
+                state->output.append("get", 3);
+                for (int k = 0; k < count; ++k)
+                {
+                    char name[32];
+                    // 一部分key超出预先写入的范围 产生未命中
+                    int key = static_cast<int>(nextRandom(state) % static_cast<uint64_t>(keys_ + keys_ / 10));
+                    int len = formatKey(name, key);
+                    state->output.append(" ", 1);
+                    state->output.append(name, static_cast<size_t>(len));
+                }
+                state->output.append("\r\n", 2);
+            }
+            else
+            {
+                appendSet(state, static_cast<int>(nextRandom(state) % static_cast<uint64_t>(keys_)), false);
+            }
+            PendingOp &op = state->pending[(state->head + state->inflight) % kMaxPipeline];
+            op.sentNs = now;
+            op.keys = count;
+            ++state->inflight;
+        }
+        state->conn->send(&state->output);
+    }
+
+    /**
+     * 解析一个完整的响应 返回它的长度 数据不完整返回0
+     * get的响应是若干个VALUE块加END 其他命令是一行
+     */
+    size_t parseResponse(const char *begin, const char *end, bool isGet, int *hits)
+    {
+        const char *p = begin;
+        for (;;)
+        {
+            const char *eol = static_cast<const char *>(::memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (eol == nullptr)
+            {
+                return 0;
+            }
+            StringPiece line(p, static_cast<size_t>(eol - p));
+            if (!isGet || !line.startsWith("VALUE "))
+            {
+                if (!line.startsWith(isGet ? "END" : "STORED"))
+                {
+                    ++errors_;
+                }
+                return static_cast<size_t>(eol + 1 - begin);
+            }
+            // VALUE <key> <flags> <bytes>
+            const char *bytes = eol;
+            while (bytes > p && bytes[-1] != ' ')
+            {
+                --bytes;
+            }
+            size_t len = static_cast<size_t>(::strtoul(bytes, nullptr, 10));
+            const char *next = eol + 1 + len + 2;
+            if (next > end)
+            {
+                return 0;
+            }
+            ++*hits;
+            p = next;
+        }
+    }
+
+    void onResponse(ClientConn *state, Buffer *buf)
+    {
+        if (!state->loaded)
+        {
+            // 预先写入都是noreply 只等version的响应
+            const char *eol = static_cast<const char *>(::memchr(buf->peek(), '\n', buf->readableBytes()));
+            if (eol == nullptr)
+            {
+                return;
+            }
+            buf->retrieve(static_cast<size_t>(eol + 1 - buf->peek()));
+            state->loaded = true;
+            ++loadedConns_;
+            issue(state, pipeline_);
+        }
+
+        int64_t now = MonotonicTime::now().nanoSeconds();
+        int done = 0;
+        while (state->inflight > 0 && buf->readableBytes() > 0)
+        {
+            PendingOp &op = state->pending[state->head];
+            int hits = 0;
+            size_t len = parseResponse(buf->peek(), buf->peek() + buf->readableBytes(), op.keys > 0, &hits);
+            if (len == 0)
+            {
+                break;
+            }
+            hits_ += hits;
+            misses_ += op.keys - hits;
+            latencies_.push_back(now - op.sentNs);
+            bytesReceived_ += static_cast<int64_t>(len);
+            buf->retrieve(len);
+            state->head = (state->head + 1) % kMaxPipeline;
+            --state->inflight;
+            ++done;
+        }
+        if (done > 0 && state->conn)
+        {
+            issue(state, done);
+        }
+    }
+
+    const int pipeline_;
+    const int keys_;
+    const int getPercent_;
+    std::string value_;
+    std::vector<ClientConn> conns_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+    int loadedConns_ = 0;
+    std::vector<int64_t> latencies_;
+    int64_t hits_ = 0;
+    int64_t misses_ = 0;
+    int64_t errors_ = 0;
+    int64_t bytesReceived_ = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    int connections = argc > 2 ? atoi(argv[2]) : 16;
+    int pipeline = argc > 3 ? atoi(argv[3]) : 8;
+    int keys = argc > 4 ? atoi(argv[4]) : 20000;
+    int getPercent = argc > 5 ? atoi(argv[5]) : 90;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 11211);
+
+    ::signal(SIGPIPE, SIG_IGN);
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    std::unique_ptr<MemcacheLoad> load(
+        new MemcacheLoad(&loop, InetAddress(port, "127.0.0.1"), connections, pipeline, keys, getPercent));
+    load->latencies().reserve(16 * 1024 * 1024);
+    load->start();
+
+    // 所有连接预先写入完成后 再预热0.5秒开始统计
+    MonotonicTime start;
+    double elapsed = 0;
+    bool measuring = false;
+    int waited = 0;
+    TimerId waitLoaded = loop.runEvery(0.05, [&]() {
+        if (measuring)
+        {
+            return;
+        }
+        if (!load->loaded())
+        {
+            if (++waited == 200)
+            {
+                loop.quit(); // 10秒还没连上或者没写完 放弃
+            }
+            return;
+        }
+        measuring = true;
+        loop.runAfter(0.5, [&]() {
+            load->resetStats();
+            start = MonotonicTime::now();
+        });
+        loop.runAfter(0.5 + seconds, [&]() {
+            elapsed = (MonotonicTime::now() - start) / 1e9;
+            loop.quit();
+        });
+    });
+    loop.loop();
+    loop.cancel(waitLoaded);
+
+    std::vector<int64_t> latencies;
+    latencies.swap(load->latencies());
+    int64_t hits = load->hits();
+    int64_t misses = load->misses();
+    int64_t errors = load->errors();
+    int64_t bytes = load->bytesReceived();
+    load->stop();
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    load.reset(); // TcpClient必须在loop线程中析构
+
+    if (latencies.empty())
+    {
+        printf("no response\n");
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&latencies](double p) -> double {
+        size_t index = std::min(latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(latencies.size())));
+        return static_cast<double>(latencies[index]) / 1e6;
+    };
+    printf("keys %d  get %d%%  conns %d  pipeline %d\n", keys, getPercent, connections, pipeline);
+    printf("%9.0f ops/s  hit ratio %.3f  p50 %6.3f ms  p99 %6.3f ms  p99.9 %6.3f ms  recv %.1f MB/s  errors %lld\n",
+           static_cast<double>(latencies.size()) / elapsed,
+           hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0,
+           pct(0.50), pct(0.99), pct(0.999), static_cast<double>(bytes) / elapsed / (1024 * 1024),
+           static_cast<long long>(errors));
+    return 0;
+}
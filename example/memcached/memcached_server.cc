@@ -0,0 +1,318 @@
+/**
+ * memcached文本协议的缓存服务器示例
+ *
+ *   ./memcached_server [port] [threads] [memoryMB]
+ *
+ *   get <key>*                                    命中的项依次返回VALUE 最后END
+ *   set <key> <flags> <exptime> <bytes> [noreply] 后面跟<bytes>字节数据和"\r\n"
+ *   delete <key> [noreply]
+ *   stats / version / quit
+ *
+ * 每个loop一个分片 分片按key的哈希选择 自带一把锁 连接在自己的loop里直接读写任何分片
+ * 一次onMessage处理Buffer中所有完整的命令 响应攒在连接自己的Buffer里 最后一次send发出
+ *
+ *   printf 'set a 0 0 5\r\nhello\r\nget a\r\n' | nc 127.0.0.1 11211
+ **/
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Cache.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+class MemcacheServer
+{
+public:
+    static const size_t kMaxKeyLen = 250;
+    static const size_t kMaxLineLen = 2048;
+    static const int kMaxRelativeExptime = 60 * 60 * 24 * 30; // 超过30天按绝对时间处理
+
+    MemcacheServer(EventLoop *loop, const InetAddress &addr, int threads, size_t memoryLimit)
+        : server_(loop, addr, "MemcacheServer")
+        , cache_(threads > 0 ? threads : 1, memoryLimit)
+        , connections_(0)
+        , startTime_(::time(nullptr))
+    {
+        server_.setConnectionCallback(std::bind(&MemcacheServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(std::bind(&MemcacheServer::onMessage, this, std::placeholders::_1,
+                                             std::placeholders::_2, std::placeholders::_3));
+        server_.setThreadNum(threads);
+    }
+
+    void start() { server_.start(); }
+
+private:
+    // 每个连接的状态
+    struct Session
+    {
+        Buffer output{16 * 1024};
+        bool closing = false;
+    };
+
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->setContext(std::make_shared<Session>());
+            ++connections_;
+        }
+        else
+        {
+            --connections_;
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        Session *session = static_cast<Session *>(conn->getContext().get());
+        if (session->closing)
+        {
+            buf->retrieveAll();
+            return;
+        }
+        time_t now = ::time(nullptr);
+        while (!session->closing && buf->readableBytes() > 0)
+        {
+            const char *begin = buf->peek();
+            const char *eol = static_cast<const char *>(::memchr(begin, '\n', buf->readableBytes()));
+            if (eol == nullptr)
+            {
+                if (buf->readableBytes() > kMaxLineLen)
+                {
+                    reply(session, "CLIENT_ERROR line too long\r\n");
+                    session->closing = true;
+                }
+                break;
+            }
+            const char *lineEnd = (eol > begin && eol[-1] == '\r') ? eol - 1 : eol;
+            size_t consumed = static_cast<size_t>(eol + 1 - begin);
+            if (!processCommand(session, buf, begin, lineEnd, &consumed, now))
+            {
+                break; // set的数据还没收全
+            }
+            buf->retrieve(consumed);
+        }
+        if (session->output.readableBytes() > 0)
+        {
+            conn->send(&session->output);
+        }
+        if (session->closing)
+        {
+            buf->retrieveAll();
+            conn->shutdown();
+        }
+    }
+
+    // 取下一个以空格分隔的字段
+    static StringPiece nextToken(const char *&p, const char *end)
+    {
+        while (p < end && *p == ' ')
+        {
+            ++p;
+        }
+        const char *start = p;
+        while (p < end && *p != ' ')
+        {
+            ++p;
+        }
+        return StringPiece(start, static_cast<size_t>(p - start));
+    }
+
+    static bool parseNumber(const StringPiece &token, uint64_t *value)
+    {
+        if (token.empty() || token.size() > 20)
+        {
+            return false;
+        }
+        uint64_t result = 0;
+        for (size_t i = 0; i < token.size(); ++i)
+        {
+            if (token[i] < '0' || token[i] > '9')
+            {
+                return false;
+            }
+            result = result * 10 + static_cast<uint64_t>(token[i] - '0');
+        }
+        *value = result;
+        return true;
+    }
+
+    static void reply(Session *session, const char *text) { session->output.append(text, strlen(text)); }
+
+    /**
+     * 处理[begin, lineEnd)这一行命令 consumed是这一行(含换行)的长度 set时加上数据块的长度
+     * 数据块还没收全时返回false 命令留在Buffer里等下次
+     */
+    bool processCommand(Session *session, Buffer *buf, const char *begin, const char *lineEnd,
+                        size_t *consumed, time_t now)
+    {
+        const char *p = begin;
+        StringPiece command = nextToken(p, lineEnd);
+        if (command == "get" || command == "gets")
+        {
+            StringPiece key = nextToken(p, lineEnd);
+            if (key.empty())
+            {
+                reply(session, "ERROR\r\n");
+                return true;
+            }
+            for (; !key.empty(); key = nextToken(p, lineEnd))
+            {
+                if (key.size() > kMaxKeyLen)
+                {
+                    reply(session, "CLIENT_ERROR bad command line format\r\n");
+                    return true;
+                }
+                cache_.shardFor(key).get(key, now, &session->output);
+            }
+            reply(session, "END\r\n");
+        }
+        else if (command == "set")
+        {
+            StringPiece key = nextToken(p, lineEnd);
+            uint64_t flags = 0;
+            uint64_t exptime = 0;
+            uint64_t bytes = 0;
+            bool ok = parseNumber(nextToken(p, lineEnd), &flags);
+            ok = parseNumber(nextToken(p, lineEnd), &exptime) && ok;
+            ok = parseNumber(nextToken(p, lineEnd), &bytes) && ok;
+            bool noreply = nextToken(p, lineEnd) == "noreply";
+            if (!ok || key.empty() || key.size() > kMaxKeyLen || flags > UINT32_MAX)
+            {
+                reply(session, "CLIENT_ERROR bad command line format\r\n");
+                session->closing = true; // 不知道后面的数据块有多长 无法继续
+                return true;
+            }
+            if (bytes > SlabAllocator::kPageSize)
+            {
+                reply(session, "SERVER_ERROR object too large for cache\r\n");
+                session->closing = true; // 不缓存这么大的数据块 直接断开
+                return true;
+            }
+            size_t total = *consumed + static_cast<size_t>(bytes) + 2;
+            if (buf->readableBytes() < total)
+            {
+                return false;
+            }
+            const char *data = begin + *consumed;
+            *consumed = total;
+            if (data[bytes] != '\r' || data[bytes + 1] != '\n')
+            {
+                reply(session, "CLIENT_ERROR bad data chunk\r\n");
+                session->closing = true;
+                return true;
+            }
+            time_t expireAt = 0;
+            if (exptime > 0)
+            {
+                expireAt = exptime <= static_cast<uint64_t>(kMaxRelativeExptime)
+                               ? now + static_cast<time_t>(exptime)
+                               : static_cast<time_t>(exptime);
+            }
+            CacheShard::SetResult result =
+                cache_.shardFor(key).set(key, static_cast<uint32_t>(flags), expireAt, data, static_cast<size_t>(bytes));
+            if (result == CacheShard::kTooLarge)
+            {
+                reply(session, "SERVER_ERROR object too large for cache\r\n");
+            }
+            else if (result == CacheShard::kOutOfMemory)
+            {
+                reply(session, "SERVER_ERROR out of memory storing object\r\n");
+            }
+            else if (!noreply)
+            {
+                reply(session, "STORED\r\n");
+            }
+        }
+        else if (command == "delete")
+        {
+            StringPiece key = nextToken(p, lineEnd);
+            bool noreply = nextToken(p, lineEnd) == "noreply";
+            if (key.empty() || key.size() > kMaxKeyLen)
+            {
+                reply(session, "CLIENT_ERROR bad command line format\r\n");
+                return true;
+            }
+            bool deleted = cache_.shardFor(key).remove(key);
+            if (!noreply)
+            {
+                reply(session, deleted ? "DELETED\r\n" : "NOT_FOUND\r\n");
+            }
+        }
+        else if (command == "stats")
+        {
+            appendStats(session, now);
+        }
+        else if (command == "version")
+        {
+            reply(session, "VERSION 1.6.0-muduo\r\n");
+        }
+        else if (command == "quit")
+        {
+            session->closing = true;
+        }
+        else if (!command.empty())
+        {
+            reply(session, "ERROR\r\n");
+        }
+        return true;
+    }
+
+    void appendStats(Session *session, time_t now)
+    {
+        CacheShard::Stats total;
+        for (int i = 0; i < cache_.shardCount(); ++i)
+        {
+            CacheShard::Stats stats = cache_.shard(i).stats();
+            total.items += stats.items;
+            total.gets += stats.gets;
+            total.hits += stats.hits;
+            total.sets += stats.sets;
+            total.evictions += stats.evictions;
+            total.pages += stats.pages;
+        }
+        char text[512];
+        int n = snprintf(text, sizeof text,
+                         "STAT uptime %lld\r\n"
+                         "STAT curr_connections %d\r\n"
+                         "STAT curr_items %lld\r\n"
+                         "STAT cmd_get %lld\r\n"
+                         "STAT cmd_set %lld\r\n"
+                         "STAT get_hits %lld\r\n"
+                         "STAT get_misses %lld\r\n"
+                         "STAT evictions %lld\r\n"
+                         "STAT bytes_allocated %lld\r\n"
+                         "STAT threads %d\r\n"
+                         "END\r\n",
+                         static_cast<long long>(now - startTime_), connections_.load(),
+                         static_cast<long long>(total.items), static_cast<long long>(total.gets),
+                         static_cast<long long>(total.sets), static_cast<long long>(total.hits),
+                         static_cast<long long>(total.gets - total.hits), static_cast<long long>(total.evictions),
+                         static_cast<long long>(total.pages * static_cast<int64_t>(SlabAllocator::kPageSize)),
+                         cache_.shardCount());
+        session->output.append(text, static_cast<size_t>(n));
+    }
+
+    TcpServer server_;
+    Cache cache_;
+    std::atomic<int> connections_;
+    const time_t startTime_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 11211);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    size_t memoryMB = static_cast<size_t>(argc > 3 ? atoi(argv[3]) : 256);
+
+    EventLoop loop;
+    MemcacheServer server(&loop, InetAddress(port), threads, memoryMB * 1024 * 1024);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -3,11 +3,14 @@
 #include <functional>
 
 #include "noncopyable.h"
+#include "InetAddress.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "Metrics.h"
 
 class EventLoop;
-class InetAddress;
+
+// listenAddr可以是IPv4、IPv6或Unix域地址 Unix域路径地址在bind前和析构时删除socket文件
 
 class Acceptor : noncopyable
 {
@@ -20,6 +23,10 @@ public:
     void setNewConnectionCallback(const NewConnectionCallback &cb) { NewConnectionCallback_ = cb; }
     // 判断是否在监听
     bool listenning() const { return listenning_; }
+    // 监听socket的参数 必须在listen()之前设置
+    void setSocketOptions(const SocketOptions &options) { options_ = options; }
+    // 按labels(例如 server="echo")注册accept相关的指标 TcpServer在构造时调用
+    void setMetricLabels(const std::string &labels);
     // 监听本地端口
     void listen();
 
@@ -27,8 +34,12 @@ private:
     void handleRead();//处理新用户的连接事件
 
     EventLoop *loop_; // Acceptor用的就是用户定义的那个baseLoop 也称作mainLoop
+    const InetAddress listenAddr_;
     Socket acceptSocket_;//专门用于接收新连接的socket
     Channel acceptChannel_;//专门用于监听新连接的channel
     NewConnectionCallback NewConnectionCallback_;//新连接的回调函数
     bool listenning_;//是否在监听
+    SocketOptions options_;
+    metrics::Counter acceptsMetric_;      // accept成功的次数
+    metrics::Counter acceptErrorsMetric_; // accept失败的次数 包括fd用完
 };
\ No newline at end of file
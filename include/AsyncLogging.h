@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+/**
+ * 日志文件的格式 默认按文本行写入 二进制日志(BinaryLog)用它在文件中写入文件头和调用点定义
+ * 所有函数都只在AsyncLogging的后台线程中调用
+ **/
+class LogFormat : noncopyable
+{
+public:
+    virtual ~LogFormat() = default;
+
+    // 写入一批数据之前调用 追加需要出现在这批数据前面的内容 newFile表示这是一个新文件的开头
+    virtual void beforeBatch(bool newFile, std::vector<char> *out) = 0;
+    // 追加一条"前端因为暂存区满丢弃了dropped条日志"的记录
+    virtual void droppedNote(int64_t dropped, std::vector<char> *out) = 0;
+};
+
+/**
+ * 异步日志后端
+ * 前端: 每个写日志的线程有一块自己的暂存环形缓冲区(单生产者单消费者 无锁) append只是一次memcpy
+ * 后端: 一个后台线程定期把所有线程的暂存区搬到自己的大批量缓冲区里 再一次性写入滚动日志文件LogFile
+ *
+ * 内存有上限: 每个线程的暂存区大小固定 写满时直接丢弃这一行并计数 而不是阻塞业务线程
+ * 后台线程会把丢弃的行数写进日志文件 方便事后发现日志不完整
+ *
+ * 用法:
+ *   AsyncLogging log("/tmp/server", 500 * 1024 * 1024);
+ *   log.start();
+ *   Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, _1, _2));
+ *   Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+ *
+ * 同一个线程可以同时向多个AsyncLogging写(例如一个文本日志加一个二进制日志) 每个实例各有一块暂存区
+ * 一个线程同时最多保留4个实例的暂存区 超过时替换最早的一块 旧暂存区里的日志仍然先于新暂存区写出
+ **/
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string &basename,
+                 off_t rollSize,
+                 int flushInterval = 3,
+                 size_t stagingBytes = 1024 * 1024,
+                 int rollInterval = 60 * 60 * 24);
+    ~AsyncLogging();
+
+    // 任意线程调用 写入本线程的暂存区
+    void append(const char *logline, size_t len);
+
+    // 替换文件格式 必须在start()之前调用
+    void setFormat(std::shared_ptr<LogFormat> format) { format_ = std::move(format); }
+
+    void start();
+    void stop();
+    // 阻塞直到调用前写入的日志都已经交给文件 LOG_FATAL退出前会调用
+    void flush();
+
+    int64_t droppedLines() const { return droppedLines_.load(std::memory_order_relaxed); }
+    int64_t writtenBytes() const { return writtenBytes_.load(std::memory_order_relaxed); }
+
+private:
+    class StagingBuffer;
+    using StagingBufferPtr = std::shared_ptr<StagingBuffer>;
+
+    StagingBuffer *localBuffer();
+    void threadFunc();
+    // 把所有暂存区的数据收集到batch_中 返回收集到的字节数
+    size_t collect(std::vector<StagingBufferPtr> &buffers);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const size_t stagingBytes_;
+    const int rollInterval_;
+    const int id_; // 区分不同的AsyncLogging实例 线程局部变量里记录的暂存区属于哪一个实例
+    std::shared_ptr<LogFormat> format_;
+
+    std::atomic_bool running_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;          // 唤醒后台线程
+    std::condition_variable flushedCond_;   // 通知flush()的调用者
+    std::vector<StagingBufferPtr> buffers_; // 所有线程的暂存区 由mutex_保护
+    std::atomic_bool wakeupPending_;        // 已经有前端通知过后台线程了 避免每一行都去notify
+    int64_t flushRequested_;                // 由mutex_保护
+    int64_t flushCompleted_;                // 由mutex_保护
+
+    std::vector<char> batch_; // 后台线程的批量写缓冲区
+
+    std::atomic<int64_t> droppedLines_;
+    std::atomic<int64_t> writtenBytes_;
+};
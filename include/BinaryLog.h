@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "noncopyable.h"
+#include "CurrentThread.h"
+#include "Logger.h"
+
+class AsyncLogging;
+
+/**
+ * 二进制结构化日志 热路径上不做任何格式化
+ * 每个调用点第一次执行时把 级别/文件/行号/格式串/参数类型 注册一次 得到一个调用点id
+ * 之后每次调用只写 调用点id + 纳秒时间戳 + 线程id + 参数的原始字节 到AsyncLogging的线程暂存区
+ * 日志文件由 tools/logdecoder 离线还原成文本 程序里可以直接用BinaryLogDecoder
+ *
+ * 用法:
+ *   AsyncLogging binlog("/tmp/server.bin", 500 * 1024 * 1024);
+ *   BinaryLog::attach(&binlog); // 设置二进制文件格式并把输出指向binlog
+ *   binlog.start();
+ *   BLOG_INFO("conn %s recv %lu bytes", conn->name(), n); // 和LOG_INFO共用同一套级别阈值
+ *
+ * 支持的参数类型: 整数、bool、char、浮点数、字符串(const char* 或 std::string 按字节拷贝) 和指针(按地址记录)
+ **/
+
+// BLOG_INFO("%s %d", arg1, arg2) 每个调用点一个静态的id 0表示还没有注册
+#define MUDUO_BLOG(level, logmsgFormat, ...)                                                              \
+    do                                                                                                    \
+    {                                                                                                     \
+        if (MUDUO_LOG_ENABLED(level))                                                                     \
+        {                                                                                                 \
+            static std::atomic<uint32_t> muduoBlogSite(0);                                                \
+            BinaryLog::instance().log(&muduoBlogSite, level, __FILE__, __LINE__, logmsgFormat, ##__VA_ARGS__); \
+        }                                                                                                 \
+    } while (0)
+
+#define BLOG_DEBUG(logmsgFormat, ...) MUDUO_BLOG(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define BLOG_INFO(logmsgFormat, ...) MUDUO_BLOG(INFO, logmsgFormat, ##__VA_ARGS__)
+#define BLOG_ERROR(logmsgFormat, ...) MUDUO_BLOG(ERROR, logmsgFormat, ##__VA_ARGS__)
+
+namespace binlog
+{
+/**
+ * 文件格式(按本机字节序):
+ * 文件头: kMagic 8字节
+ * 之后是一条条记录 每条记录都以kRecordHeaderSize字节的记录头开始:
+ *   uint32 siteId | uint32 payloadLen | uint64 时间戳(纳秒 CLOCK_REALTIME) | int32 tid
+ * siteId == kSiteDefinition: 调用点定义 payload = uint32 id | int32 level | int32 line | str file | str fmt | str 参数类型
+ * siteId == kDroppedNote:    payload = int64 丢弃的条数
+ * 其他: 日志 payload按参数类型依次排列 str = uint32 长度 + 字节
+ **/
+const char kMagic[8] = {'M', 'U', 'D', 'U', 'O', 'B', 'L', '1'};
+const uint32_t kSiteDefinition = 0;
+const uint32_t kDroppedNote = 1;
+const uint32_t kFirstSiteId = 2;
+const size_t kRecordHeaderSize = 20;
+const size_t kMaxRecordSize = 4096; // 超出的字符串参数被截断
+
+// 参数类型编码 写在调用点定义里 解码时决定每个参数占多少字节
+enum ArgType : char
+{
+    kInt32 = 'i',
+    kUInt32 = 'u',
+    kInt64 = 'l',
+    kUInt64 = 'U',
+    kDouble = 'd',
+    kString = 's',
+    kPointer = 'p',
+};
+
+template <typename Stored, char Code>
+struct ScalarArg
+{
+    static const char code = Code;
+    template <typename T>
+    static size_t encode(char *p, size_t avail, T v)
+    {
+        if (avail < sizeof(Stored))
+        {
+            return 0;
+        }
+        Stored s = static_cast<Stored>(v);
+        ::memcpy(p, &s, sizeof s);
+        return sizeof s;
+    }
+};
+
+struct StringArg
+{
+    static const char code = kString;
+    static size_t encode(char *p, size_t avail, const char *s, size_t len)
+    {
+        if (avail < sizeof(uint32_t))
+        {
+            return 0;
+        }
+        len = std::min(len, avail - sizeof(uint32_t));
+        uint32_t n = static_cast<uint32_t>(len);
+        ::memcpy(p, &n, sizeof n);
+        ::memcpy(p + sizeof n, s, len);
+        return sizeof n + len;
+    }
+    static size_t encode(char *p, size_t avail, const char *s)
+    {
+        return s ? encode(p, avail, s, ::strlen(s)) : encode(p, avail, "(null)", 6);
+    }
+    static size_t encode(char *p, size_t avail, const std::string &s) { return encode(p, avail, s.data(), s.size()); }
+};
+
+struct PointerArg
+{
+    static const char code = kPointer;
+    static size_t encode(char *p, size_t avail, const void *ptr)
+    {
+        return ScalarArg<uint64_t, kPointer>::encode(p, avail, reinterpret_cast<uintptr_t>(ptr));
+    }
+};
+
+// 按参数的类型选择编码方式 没有列出的类型编译报错
+template <typename T, typename Enable = void>
+struct ArgTraits;
+
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value && sizeof(T) <= 4>::type>
+    : ScalarArg<int32_t, kInt32> {};
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value && sizeof(T) <= 4>::type>
+    : ScalarArg<uint32_t, kUInt32> {};
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value && sizeof(T) == 8>::type>
+    : ScalarArg<int64_t, kInt64> {};
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value && sizeof(T) == 8>::type>
+    : ScalarArg<uint64_t, kUInt64> {};
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    : ScalarArg<double, kDouble> {};
+template <typename T>
+struct ArgTraits<T, typename std::enable_if<std::is_enum<T>::value>::type>
+    : ScalarArg<int64_t, kInt64> {};
+template <>
+struct ArgTraits<const char *> : StringArg {};
+template <>
+struct ArgTraits<char *> : StringArg {};
+template <>
+struct ArgTraits<std::string> : StringArg {};
+template <typename T>
+struct ArgTraits<T *, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    : PointerArg {};
+
+template <typename T>
+using Traits = ArgTraits<typename std::decay<T>::type>;
+
+// 参数类型串 每个模板实例化一份静态存储
+template <typename... Args>
+const char *signature()
+{
+    static const char sig[] = {Traits<Args>::code..., '\0'};
+    return sig;
+}
+
+inline size_t encodeArgs(char *, size_t) { return 0; }
+
+template <typename T, typename... Rest>
+size_t encodeArgs(char *p, size_t avail, const T &v, const Rest &... rest)
+{
+    size_t n = Traits<T>::encode(p, avail, v);
+    return n + encodeArgs(p + n, avail - n, rest...);
+}
+
+inline void encodeHeader(char *p, uint32_t siteId, uint32_t payloadLen, uint64_t timestamp, int32_t tid)
+{
+    ::memcpy(p, &siteId, 4);
+    ::memcpy(p + 4, &payloadLen, 4);
+    ::memcpy(p + 8, &timestamp, 8);
+    ::memcpy(p + 16, &tid, 4);
+}
+
+inline uint64_t nowNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+}
+} // namespace binlog
+
+class BinaryLog : noncopyable
+{
+public:
+    using OutputFunc = Logger::OutputFunc;
+
+    // 注册过的调用点 字符串都指向静态存储(字面量)
+    struct Site
+    {
+        uint32_t id;
+        int level;
+        int line;
+        const char *file;
+        const char *format;
+        const char *signature;
+    };
+
+    static BinaryLog &instance();
+
+    // 让log使用二进制文件格式 并把BinaryLog的输出指向它 需要在log.start()之前调用
+    static void attach(AsyncLogging *log);
+
+    // 在程序启动、开始写日志之前设置 没有设置输出时二进制日志被直接丢弃
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+
+    template <typename... Args>
+    void log(std::atomic<uint32_t> *site, int level, const char *file, int line, const char *fmt, const Args &... args)
+    {
+        uint32_t id = site->load(std::memory_order_acquire);
+        if (__builtin_expect(id == 0, 0))
+        {
+            id = registerSite(site, level, file, line, fmt, binlog::signature<Args...>());
+        }
+        if (!output_)
+        {
+            return;
+        }
+        char record[binlog::kMaxRecordSize];
+        size_t payload = binlog::encodeArgs(record + binlog::kRecordHeaderSize,
+                                            sizeof record - binlog::kRecordHeaderSize, args...);
+        binlog::encodeHeader(record, id, static_cast<uint32_t>(payload), binlog::nowNanos(), CurrentThread::tid());
+        output_(record, binlog::kRecordHeaderSize + payload);
+    }
+
+    // 返回id从kFirstSiteId + from开始的调用点 后台线程写调用点定义时使用
+    std::vector<Site> sitesFrom(size_t from) const;
+
+    // 把调用点定义编码成一条记录追加到out
+    static void encodeSite(const Site &site, std::vector<char> *out);
+
+private:
+    BinaryLog() = default;
+
+    uint32_t registerSite(std::atomic<uint32_t> *site, int level, const char *file, int line,
+                          const char *fmt, const char *signature);
+
+    OutputFunc output_;
+    mutable std::mutex mutex_;
+    std::vector<Site> sites_; // sites_[i].id == kFirstSiteId + i
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "noncopyable.h"
+
+/**
+ * BinaryLog文件的解码器 把记录还原成和Logger相同格式的文本行
+ * [INFO]2024/01/01 12:00:00.123456789 12345 : msg
+ * 时间后面是写日志的线程id 时间精确到纳秒
+ *
+ * 调用点id只在同一个进程写出的文件中有效 每个文件都以文件头和全部调用点定义开始
+ * 所以每个文件用一个新的解码器单独解码 tools/logdecoder和tests里的滚动检查共用这份代码
+ **/
+class BinaryLogDecoder : noncopyable
+{
+public:
+    // 每还原出一行回调一次 line以换行结尾
+    using LineCallback = std::function<void(const std::string &line)>;
+    // 文件格式错误 或者跳过了无法解码的记录 message不带换行
+    using ErrorCallback = std::function<void(const std::string &message)>;
+
+    explicit BinaryLogDecoder(const LineCallback &lineCb, const ErrorCallback &errorCb = ErrorCallback());
+
+    // 解码一个完整的文件 不是二进制日志或者记录被截断时返回false
+    // 未知调用点的记录和末尾不完整的字节只报告给errorCb 不算失败
+    bool decode(const char *data, size_t len);
+
+    int64_t lines() const { return lines_; }             // 回调过的行数
+    int64_t unknownSites() const { return unknownSites_; } // 找不到调用点定义而跳过的记录
+
+private:
+    struct SiteInfo
+    {
+        int level;
+        int line;
+        std::string file;
+        std::string format;
+        std::string signature;
+    };
+    class Reader;
+
+    void defineSite(Reader &payload);
+    void formatMessage(const SiteInfo &site, Reader &args, std::string *out) const;
+    void error(const char *fmt, ...) const __attribute__((format(printf, 2, 3)));
+
+    LineCallback lineCallback_;
+    ErrorCallback errorCallback_;
+    std::map<uint32_t, SiteInfo> sites_; // 同一个id的定义是一致的
+    int64_t lines_;
+    int64_t unknownSites_;
+};
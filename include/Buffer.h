@@ -12,10 +12,12 @@ public:
     static const size_t kCheapPrepend = 8;//初始预留的prependabel空间大小
     static const size_t kInitialSize = 1024;
 
-    explicit Buffer(size_t initalSize = kInitialSize)
-        : buffer_(kCheapPrepend + initalSize)
-        , readerIndex_(kCheapPrepend)
-        , writerIndex_(kCheapPrepend)
+    // prependSize: 头部预留的空间 协议编码时先写负载 再把长度等帧头prepend到前面 不需要搬移数据
+    explicit Buffer(size_t initalSize = kInitialSize, size_t prependSize = kCheapPrepend)
+        : buffer_(prependSize + initalSize)
+        , readerIndex_(prependSize)
+        , writerIndex_(prependSize)
+        , cheapPrepend_(prependSize)
     {
     }
 
@@ -39,8 +41,8 @@ public:
     }
     void retrieveAll()
     {
-        readerIndex_ = kCheapPrepend;
-        writerIndex_ = kCheapPrepend;
+        readerIndex_ = cheapPrepend_;
+        writerIndex_ = cheapPrepend_;
     }
 
     // 把onMessage函数上报的Buffer数据 转成string类型的数据返回
@@ -70,9 +72,31 @@ public:
     }
     char *beginWrite() { return begin() + writerIndex_; }
     const char *beginWrite() const { return begin() + writerIndex_; }
+    // 直接往beginWrite()写入数据之后调用 例如SSL_read
+    void hasWritten(size_t len) { writerIndex_ += len; }
+
+    // 把数据放到可读区域的前面 预留空间不够时整体后移
+    void prepend(const void *data, size_t len)
+    {
+        if (len > readerIndex_)
+        {
+            size_t extra = len - readerIndex_ + cheapPrepend_;
+            buffer_.insert(buffer_.begin(), extra, '\0');
+            readerIndex_ += extra;
+            writerIndex_ += extra;
+        }
+        readerIndex_ -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
 
     // 从fd上读取数据
     ssize_t readFd(int fd, int *saveErrno);
+    /**
+     * 同上 用recvmsg读取 同时取回SO_TIMESTAMPING的软件接收时间戳(CLOCK_REALTIME纳秒)存到*rxTimeNs
+     * TCP一次读到多个段时 内核给出的是最后一个被读取的段的时间 没有时间戳时*rxTimeNs为0
+     */
+    ssize_t readFd(int fd, int *saveErrno, int64_t *rxTimeNs);
     // 通过fd发送数据
     ssize_t writeFd(int fd, int *saveErrno);
 
@@ -88,7 +112,7 @@ private:
          * | kCheapPrepend |xxx| reader | writer |                     // xxx标示reader中已读的部分
          * | kCheapPrepend | reader ｜          len          |
          **/
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend) // 也就是说 len > xxx前面剩余的空间 + writer的部分
+        if (writableBytes() + prependableBytes() < len + cheapPrepend_) // 也就是说 len > xxx前面剩余的空间 + writer的部分
         {
             buffer_.resize(writerIndex_ + len);
         }
@@ -99,8 +123,8 @@ private:
             // 拷贝到缓冲区起始位置kCheapPrepend处，以便腾出更多的可写空间
             std::copy(begin() + readerIndex_,
                       begin() + writerIndex_,
-                      begin() + kCheapPrepend);
-            readerIndex_ = kCheapPrepend;
+                      begin() + cheapPrepend_);
+            readerIndex_ = cheapPrepend_;
             writerIndex_ = readerIndex_ + readable;
         }
     }
@@ -108,4 +132,5 @@ private:
     std::vector<char> buffer_; //堆空间
     size_t readerIndex_;
     size_t writerIndex_;
+    size_t cheapPrepend_; // retrieveAll和makeSpace之后保留的预留空间
 };
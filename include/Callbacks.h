@@ -6,12 +6,18 @@
 class Buffer;
 class TcpConnection;
 class Timestamp;
+struct TcpInfo;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
 using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
+using TimerCallback = std::function<void()>;
+// TcpConnection::sendFile发送完成(true)或者放弃(false)
+using SendFileCallback = std::function<void(bool)>;
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+// 发送队列长时间积压的连接 参数是触发时的TCP_INFO采样
+using SlowConsumerCallback = std::function<void(const TcpConnectionPtr &, const TcpInfo &)>;
 
 using MessageCallback = std::function<void(const TcpConnectionPtr &,
                                            Buffer *,
@@ -34,6 +34,12 @@ public:
     void tie(const std::shared_ptr<void> &);
 
     int fd() const { return fd_; }
+    // 给LoopWatchdog报告用的名字 例如连接名 指向的字符串由调用者保证和Channel活得一样久
+    void setLabel(const char *label) { label_ = label; }
+    const char *label() const { return label_; }
+    // 开启CPU统计时本Channel的回调记到哪个标签下(CpuAccounting::tag)
+    void setCpuTag(int tag) { cpuTag_ = tag; }
+    int cpuTag() const { return cpuTag_; }
     int events() const { return events_; }
     void set_revents(int revt) { revents_ = revt; }
 
@@ -69,6 +75,8 @@ private:
     int events_;      // 注册fd感兴趣的事件
     int revents_;     // Poller返回的具体发生的事件
     int index_; //kNew, kAdded, kDeleted 用于标识channel在Poller中的状态
+    const char *label_;
+    int cpuTag_;
 
     std::weak_ptr<void> tie_;
     bool tied_; //
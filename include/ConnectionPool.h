@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "TcpConnection.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+
+class Connector;
+class EventLoop;
+class LoopConnectionPool;
+
+/**
+ * 访问后端服务的客户端连接池 按后端地址(InetAddress)分组 用完的连接保持长连接放回池中复用
+ *
+ * 每个EventLoop有一个独立的LoopConnectionPool 连接只在创建它的loop上借出和归还 不跨线程
+ * 所以池内的数据结构都不需要加锁 ConnectionPool本身只负责保存配置、按loop创建子池和汇总统计
+ *
+ * 限制都是针对 (loop, 后端地址) 这一组的:
+ *   maxTotal  同时存在的连接数上限(空闲 + 借出 + 正在连接) 达到上限后acquire进入等待队列
+ *   maxIdle   池中保留的空闲连接数上限 超过的连接归还时直接关闭 maxIdle为0相当于每次请求都新建连接
+ * 等待队列中的请求在acquireTimeout后以空连接回调 队列长度超过maxWaiters时直接拒绝
+ *
+ * 健康检查:
+ *   空闲连接仍然监听读事件 对端关闭或者空闲期间收到数据(协议错乱)都会立即从池中移除
+ *   每隔healthCheckInterval检查一次空闲连接 超过idleTimeout的关闭 设置了HealthCheck回调时逐个调用
+ **/
+class ConnectionPool : noncopyable
+{
+public:
+    // conn为空表示获取失败(等待超时、等待队列已满、连接失败或者池已关闭)
+    using AcquireCallback = std::function<void(const TcpConnectionPtr &conn)>;
+    // 检查空闲连接是否可用 返回false则关闭该连接 在loop线程中同步调用
+    // 空闲连接上收到的任何数据都会导致连接被关闭 所以不能在这里发送需要对端回复的探测请求
+    using HealthCheck = std::function<bool(const TcpConnectionPtr &conn)>;
+
+    struct Options
+    {
+        size_t maxTotal = 64;
+        size_t maxIdle = 16;
+        size_t maxWaiters = 4096;
+        double acquireTimeout = 3.0;      // 秒
+        double idleTimeout = 60.0;        // 秒
+        double healthCheckInterval = 5.0; // 秒 小于等于0表示不做定期检查
+        bool tcpNoDelay = true;
+    };
+
+    struct Stats
+    {
+        int64_t created = 0;        // 新建的连接数
+        int64_t reused = 0;         // 从空闲连接中借出的次数
+        int64_t closed = 0;         // 关闭的连接数
+        int64_t connectFailed = 0;  // 连接失败次数
+        int64_t waitTimeouts = 0;   // 等待超时次数
+        int64_t rejected = 0;       // 等待队列已满被拒绝的次数
+        int64_t healthEvicted = 0;  // 健康检查或空闲超时关闭的连接数
+    };
+
+    ConnectionPool(const std::string &nameArg, const Options &options);
+    // 必须在所有loop退出之前析构 析构时在每个loop中关闭空闲连接并让等待者失败
+    ~ConnectionPool();
+
+    const std::string &name() const { return name_; }
+    const Options &options() const { return options_; }
+    void setHealthCheck(const HealthCheck &cb) { healthCheck_ = cb; }
+
+    // 获取loop对应的子池 不存在则创建 线程安全
+    std::shared_ptr<LoopConnectionPool> poolFor(EventLoop *loop);
+
+    // 在loop中为addr借一个连接 onMessage是本次借用期间连接上的消息回调 onClose在借用期间连接被断开时回调
+    // 在loop线程中调用时可能直接回调cb 其他线程调用时转到loop线程执行
+    // 每次调用都要查找子池 热路径上应该先用poolFor()取得子池 再在loop线程中直接调用子池的acquire
+    void acquire(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb,
+                 const MessageCallback &onMessage, const ConnectionCallback &onClose = ConnectionCallback());
+    // 归还连接 reusable为false(例如请求出错、协议状态不确定)时关闭连接 可以在任意线程调用
+    void release(const TcpConnectionPtr &conn, bool reusable = true);
+
+    // 所有子池的统计之和
+    Stats stats() const;
+
+private:
+    friend class LoopConnectionPool;
+
+    struct AtomicStats
+    {
+        std::atomic<int64_t> created{0};
+        std::atomic<int64_t> reused{0};
+        std::atomic<int64_t> closed{0};
+        std::atomic<int64_t> connectFailed{0};
+        std::atomic<int64_t> waitTimeouts{0};
+        std::atomic<int64_t> rejected{0};
+        std::atomic<int64_t> healthEvicted{0};
+    };
+
+    const std::string name_;
+    const Options options_;
+    HealthCheck healthCheck_;
+    std::shared_ptr<AtomicStats> stats_; // 子池可能比ConnectionPool活得久(还有借出的连接)
+
+    std::mutex mutex_;
+    std::map<EventLoop *, std::shared_ptr<LoopConnectionPool>> pools_;
+};
+
+/**
+ * 一个EventLoop上的连接池 所有方法都只能在loop线程中调用
+ * 生命周期由shared_ptr管理 连接的回调和定时器里都通过weak_ptr访问 子池析构后借出的连接仍然可以安全关闭
+ **/
+class LoopConnectionPool : noncopyable, public std::enable_shared_from_this<LoopConnectionPool>
+{
+public:
+    LoopConnectionPool(EventLoop *loop, const std::string &name,
+                       const ConnectionPool::Options &options,
+                       const ConnectionPool::HealthCheck &healthCheck,
+                       const std::shared_ptr<ConnectionPool::AtomicStats> &stats);
+    ~LoopConnectionPool();
+
+    EventLoop *getLoop() const { return loop_; }
+
+    void acquire(const InetAddress &addr, const ConnectionPool::AcquireCallback &cb,
+                 const MessageCallback &onMessage, const ConnectionCallback &onClose = ConnectionCallback());
+    void release(const TcpConnectionPtr &conn, bool reusable = true);
+
+    // 当前 空闲/借出/正在连接 的连接数和等待者数量(所有后端之和)
+    size_t idleCount() const;
+    size_t busyCount() const;
+    size_t connectingCount() const;
+    size_t waiterCount() const;
+
+    // 关闭所有空闲连接、停止正在进行的连接 让所有等待者失败 之后的acquire都直接失败
+    void shutdown();
+
+private:
+    // 一次借用期间的回调 连接上调用时先拷贝shared_ptr 回调内部归还连接、换成下一个借用者都是安全的
+    struct Borrow
+    {
+        MessageCallback onMessage;
+        ConnectionCallback onClose;
+    };
+    using BorrowPtr = std::shared_ptr<Borrow>;
+
+    struct Waiter
+    {
+        uint64_t id;
+        ConnectionPool::AcquireCallback cb;
+        BorrowPtr borrow;
+        TimerId timeout;
+    };
+
+    // 一个后端地址对应的连接集合
+    struct HostPool
+    {
+        explicit HostPool(const InetAddress &a) : addr(a) {}
+        InetAddress addr;
+        std::vector<TcpConnectionPtr> idle; // 末尾是最近归还的 优先复用(LIFO) 连接更可能是热的
+        size_t busy = 0;
+        std::vector<std::shared_ptr<Connector>> connecting;
+        std::list<Waiter> waiters; // FIFO
+        size_t total() const { return idle.size() + busy + connecting.size(); }
+    };
+
+    // 池中每个连接的状态 池持有连接直到关闭回调 借用者不需要保存TcpConnectionPtr
+    struct Entry
+    {
+        TcpConnectionPtr conn;
+        HostPool *host;
+        bool idle;
+        Timestamp idleSince;
+        BorrowPtr borrow; // 空闲时为空
+    };
+
+    HostPool *hostFor(const InetAddress &addr);
+    void startConnect(HostPool *host);
+    void newConnection(HostPool *host, Connector *connector, int sockfd);
+    void connectFailed(HostPool *host, Connector *connector);
+    // 把connector从正在连接的列表中移除 返回它的shared_ptr 让它活到本次回调结束
+    std::shared_ptr<Connector> takeConnector(HostPool *host, Connector *connector);
+    void removeConnection(const TcpConnectionPtr &conn);
+    void handleMessage(const TcpConnectionPtr &conn, Buffer *buffer, Timestamp receiveTime);
+    // 把已经计入busy的连接交给借用者
+    void handOut(const TcpConnectionPtr &conn, Entry &entry, const ConnectionPool::AcquireCallback &cb, const BorrowPtr &borrow);
+    // 把已经计入busy的连接交给最早的等待者 没有等待者返回false
+    bool serveWaiter(HostPool *host, const TcpConnectionPtr &conn, Entry &entry);
+    // 借出的连接放回空闲列表 超过maxIdle则关闭
+    void putIdle(HostPool *host, const TcpConnectionPtr &conn, Entry &entry);
+    // 让最早的等待者以空连接失败
+    void failWaiter(HostPool *host);
+    void waiterTimeout(HostPool *host, uint64_t id);
+    void checkIdle();
+    // 从空闲列表中取出并关闭 关闭完成前按借出计数 不会再被借出
+    void evictIdle(HostPool *host, const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    const std::string name_;
+    const ConnectionPool::Options options_;
+    ConnectionPool::HealthCheck healthCheck_;
+    std::shared_ptr<ConnectionPool::AtomicStats> stats_;
+
+    std::unordered_map<std::string, std::unique_ptr<HostPool>> hosts_; // key: ip:port
+    std::unordered_map<TcpConnection *, Entry> entries_;
+    TimerId healthTimer_;
+    uint64_t nextWaiterId_;
+    int nextConnId_;
+    bool shutdown_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+class Channel;
+class EventLoop;
+
+/**
+ * 主动发起连接 对应服务端的Acceptor
+ * 非阻塞connect返回EINPROGRESS后 把socket注册为可写 可写时用SO_ERROR判断连接结果
+ * 连接失败(包括自连接)时按指数退避重试 重试间隔从initRetryDelayMs开始翻倍 最多maxRetryDelayMs
+ * 连接成功后把sockfd交给newConnectionCallback_ Connector不再管理这个fd
+ *
+ * 只在loop线程中使用 生命周期由TcpClient通过shared_ptr管理 定时器回调里用weak_ptr判断是否还存在
+ **/
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+    // 每次连接尝试失败时回调 在安排重试之前调用 回调里stop()可以放弃重试
+    using ConnectFailedCallback = std::function<void()>;
+
+    static const int kInitRetryDelayMs = 500;
+    static const int kMaxRetryDelayMs = 30 * 1000;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    void setConnectFailedCallback(const ConnectFailedCallback &cb) { connectFailedCallback_ = cb; }
+    // 设置重试间隔的初始值和上限 必须在start()之前调用
+    void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs)
+    {
+        initRetryDelayMs_ = initRetryDelayMs;
+        maxRetryDelayMs_ = maxRetryDelayMs;
+        retryDelayMs_ = initRetryDelayMs;
+    }
+
+    const InetAddress &serverAddress() const { return serverAddr_; }
+    int retryDelayMs() const { return retryDelayMs_; }
+
+    // 可以在任意线程调用
+    void start();
+    void stop();
+    // 只能在loop线程调用 重置重试间隔后立即重新连接 TcpClient断线重连时使用
+    void restart();
+
+private:
+    enum States
+    {
+        kDisconnected,
+        kConnecting,
+        kConnected
+    };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    // 把socket从poller中移除 返回sockfd 之后由调用者决定关闭还是交出去
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_; // 用户是否希望连接 stop()之后为false
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_; // 只在连接进行中存在
+    NewConnectionCallback newConnectionCallback_;
+    ConnectFailedCallback connectFailedCallback_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Metrics.h"
+
+/**
+ * 按用户给的标签统计loop线程花在回调上的CPU时间 用来回答"同一组loop上跑着几种协议 CPU都花在谁身上"
+ *
+ * 标签是一个小整数 由CpuAccounting::tag("http")取得 可以打在:
+ *   TcpServer::setCpuTag     这个服务器所有的连接
+ *   TcpConnection::setCpuTag 单个连接
+ *   EventLoop::queueInLoop(cb, tag) 投递的任务
+ *   EventLoop::setCpuTag     回调执行中途改记到另一个标签 例如按请求类型分发之后
+ * Acceptor和TimerQueue自带"accept"和"timers"标签 其余记在"untagged"下
+ *
+ * 统计由EventLoop::setCpuAccounting(sampleEvery)按loop开启 每sampleEvery轮循环抽一轮
+ * 在这一轮里每个回调前后读一次CLOCK_THREAD_CPUTIME_ID(不走vDSO 一次系统调用) 按sampleEvery倍计入
+ * 回调次数每轮都统计 没有开启的loop只多一次判断
+ *
+ * 结果写到metrics::Registry(muduo_cpu_nanoseconds_total/muduo_cpu_callbacks_total{tag=...})
+ * 所以在任何线程都可以读 也会出现在/metrics里
+ **/
+class CpuAccounting
+{
+public:
+    static const int kMaxTags = 64;
+    static const int kUntagged = 0;
+
+    struct Row
+    {
+        std::string tag;
+        int64_t cpuNs;  // 估计值 抽样时是样本乘以sampleEvery
+        int64_t calls;  // 开启统计以来的回调次数
+    };
+
+    // 取得名字对应的标签 第一次使用时创建 超过kMaxTags个之后都返回kUntagged 线程安全
+    static int tag(const std::string &name);
+    static std::string tagName(int tag);
+
+    // 所有loop合计 按CPU时间从多到少
+    static std::vector<Row> snapshot();
+    // snapshot()的文本表格 每行: 标签 CPU毫秒 占比 回调次数 平均每次纳秒
+    static std::string table();
+
+    // EventLoop调用 只写本线程的计数单元
+    static void add(int tag, int64_t cpuNs, int64_t calls)
+    {
+        const Counters &c = counters_[static_cast<unsigned>(tag) < kMaxTags ? tag : kUntagged];
+        c.cpuNs.inc(cpuNs);
+        c.calls.inc(calls);
+    }
+
+    // 当前线程已经用掉的CPU时间
+    static int64_t threadCpuNs();
+
+private:
+    struct Counters
+    {
+        metrics::Counter cpuNs;
+        metrics::Counter calls;
+    };
+
+    // 在tag()里持锁写入 标签id交给其他线程之前已经写好
+    static Counters counters_[kMaxTags];
+};
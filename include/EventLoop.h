@@ -6,13 +6,101 @@
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <string.h>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "Metrics.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
+
+/**
+ * loop线程当前在执行什么 给LoopWatchdog从别的线程读取
+ * 只有loop线程写 按seqlock的方式: seq先加一变成奇数 写各个字段 再加一变成偶数
+ * 读的一方读到偶数seq 读完字段后seq没变 说明读到的是同一次enter写下的完整内容
+ * 两次检查读到相同的seq 说明这段时间loop一直停在同一个回调里
+ * Channel的名字拷贝一份保存在这里(最多kLabelSize-1字节) 回调返回后连接被销毁也不影响读取
+ **/
+struct LoopActivity
+{
+    enum Kind
+    {
+        kNotLooping,     // 不在loop()里
+        kPolling,        // 在epoll_wait里 空闲
+        kChannelEvent,   // Channel::handleEvent 还没有进入具体的回调
+        kReadCallback,
+        kWriteCallback,
+        kCloseCallback,
+        kErrorCallback,
+        kPendingFunctor, // queueInLoop投递的任务
+    };
+
+    static const size_t kLabelWords = 6;
+    static const size_t kLabelSize = kLabelWords * sizeof(uint64_t);
+
+    explicit LoopActivity(int threadId)
+        : tid(threadId), seq(0), kind(kNotLooping), fd(-1)
+    {
+        for (std::atomic<uint64_t> &word : label)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // 只在loop线程中调用 l只需要在调用期间有效
+    void enter(Kind k, int f, const char *l)
+    {
+        uint64_t s = seq.load(std::memory_order_relaxed) + 1;
+        seq.store(s, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // 下面的写不会排到奇数seq之前
+        kind.store(k, std::memory_order_relaxed);
+        fd.store(f, std::memory_order_relaxed);
+        char buf[kLabelSize];
+        size_t n = 0;
+        if (l != nullptr)
+        {
+            n = ::strnlen(l, kLabelSize - 1);
+            ::memcpy(buf, l, n);
+        }
+        ::memset(buf + n, 0, kLabelSize - n);
+        for (size_t i = 0; i < kLabelWords; ++i)
+        {
+            uint64_t word;
+            ::memcpy(&word, buf + i * sizeof word, sizeof word);
+            label[i].store(word, std::memory_order_relaxed);
+        }
+        seq.store(s + 1, std::memory_order_release);
+    }
+
+    /**
+     * 其他线程调用 expectedSeq是之前用acquire读到的偶数seq
+     * 把名字拷贝到buf(至少kLabelSize字节) 拷贝期间loop写过新内容时返回false
+     */
+    bool readLabel(uint64_t expectedSeq, char *buf) const
+    {
+        for (size_t i = 0; i < kLabelWords; ++i)
+        {
+            uint64_t word = label[i].load(std::memory_order_relaxed);
+            ::memcpy(buf + i * sizeof word, &word, sizeof word);
+        }
+        buf[kLabelSize - 1] = '\0';
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq.load(std::memory_order_relaxed) == expectedSeq;
+    }
+
+    static const char *kindName(int kind);
+
+    const int tid;
+    std::atomic<uint64_t> seq;   // 奇数表示loop线程正在写
+    std::atomic<int> kind;       // noteCallback在同一次enter内细化回调类型 不改seq
+    std::atomic<int> fd;         // Channel的fd 任务为-1
+    std::atomic<uint64_t> label[kLabelWords]; // Channel::label()的拷贝 例如连接名 以'\0'结尾
+};
 
 // 事件循环类 主要包含了两个大模块 Channel Poller(epoll的抽象)
 class EventLoop : noncopyable //禁止拷贝构造和赋值构造
@@ -34,21 +122,48 @@ public:
     void runInLoop(Functor cb);
     // 把上层注册的回调函数cb放入队列中 唤醒loop所在的线程执行cb
     void queueInLoop(Functor cb);
+    // 同上 开启CPU统计时cb用掉的CPU时间记到cpuTag下(CpuAccounting::tag)
+    void queueInLoop(Functor cb, int cpuTag);
 
     // 通过eventfd唤醒loop所在的线程
     void wakeup();
 
+    // 定时器 线程安全 回调在loop线程中执行
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay秒之后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器 已经执行过的一次性定时器取消也没有副作用
+    void cancel(TimerId timerId);
+
     // EventLoop的方法 => Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
 
+    // 当前执行的活动 LoopWatchdog持有它的shared_ptr 所以loop析构后读取也是安全的
+    const std::shared_ptr<LoopActivity> &activity() const { return activity_; }
+    // Channel进入具体的回调前调用 只改kind不改seq
+    void noteCallback(LoopActivity::Kind kind) { activity_->kind.store(kind, std::memory_order_relaxed); }
+
+    /**
+     * 按标签统计回调的CPU时间 每sampleEvery轮循环抽样一轮 0表示关闭(默认) 1表示每轮都统计
+     * 线程安全 下一轮循环生效 结果见CpuAccounting
+     */
+    void setCpuAccounting(int sampleEvery) { cpuSampleEvery_.store(sampleEvery, std::memory_order_relaxed); }
+    // 当前回调剩下的CPU时间改记到tag下 只能在loop线程的回调里调用
+    void setCpuTag(int tag) { currentCpuTag_ = tag; }
+
     // 判断EventLoop对象是否在自己的线程里
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); } // threadId_为EventLoop创建时的线程id CurrentThread::tid()为当前线程id
 
 private:
     void handleRead();        // 给eventfd返回的文件描述符wakeupFd_绑定的事件回调 当wakeup()时 即有事件发生时 调用handleRead()读wakeupFd_的8字节 同时唤醒阻塞的epoll_wait
     void doPendingFunctors(); // 执行上层回调
+    // 一个回调结束 把它的CPU时间记到currentCpuTag_下
+    void accountCpu();
 
     using ChannelList = std::vector<Channel *>;
     
@@ -62,10 +177,25 @@ private:
 
     int wakeupFd_; // 作用：当mainLoop获取一个新用户的Channel 需通过轮询算法选择一个subLoop 通过该成员唤醒subLoop处理Channel
     std::unique_ptr<Channel> wakeupChannel_;
+    std::unique_ptr<TimerQueue> timerQueue_; // 依赖poller_ 必须在它之后构造
 
     ChannelList activeChannels_; // 返回Poller检测到当前有事件发生的所有Channel列表
 
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
     std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有回调操作
     std::mutex mutex_;                        // 互斥锁 用来保护上面vector容器的线程安全操作
+
+    // 所有loop共用的指标 每个loop线程只写自己的计数单元
+    metrics::Counter iterationsMetric_; // poll返回的次数
+    metrics::Counter eventsMetric_;     // 处理的Channel事件数
+    metrics::Counter functorsMetric_;   // 执行的pendingFunctors_数
+    metrics::Gauge loopsMetric_;        // 存活的EventLoop个数
+
+    std::shared_ptr<LoopActivity> activity_;
+
+    std::atomic<int> cpuSampleEvery_;
+    uint64_t cpuIterations_;
+    int64_t cpuWeight_;   // 本轮循环的抽样权重 -1表示没有开启统计 0表示本轮只计回调次数
+    int64_t cpuMark_;     // 上一个回调结束时的线程CPU时间
+    int currentCpuTag_;
 };
\ No newline at end of file
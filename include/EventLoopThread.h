@@ -21,6 +21,12 @@ public:
 
     EventLoop *startLoop();
 
+    // 在startLoop()之前调用 loop线程启动时绑定到该CPU 负数表示不绑定
+    void setCpu(int cpu) { cpu_ = cpu; }
+    // startLoop()返回后有效 线程的亲和性只包含一个CPU时返回该CPU 否则返回-1
+    // 线程初始化回调里自行绑定的CPU同样能识别出来
+    int cpu() const { return cpu_; }
+
 private:
     void threadFunc();
 
@@ -30,4 +36,5 @@ private:
     std::mutex mutex_;             // 互斥锁
     std::condition_variable cond_; // 条件变量
     ThreadInitCallback callback_;
+    int cpu_;
 };
\ No newline at end of file
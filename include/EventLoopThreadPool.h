@@ -18,6 +18,8 @@ public:
     ~EventLoopThreadPool();
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    // 第i个subloop线程绑定到cpus[i % cpus.size()] 必须在start()之前调用
+    void setThreadCpus(const std::vector<int> &cpus) { cpus_ = cpus; }
 
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
@@ -26,6 +28,13 @@ public:
 
     std::vector<EventLoop *> getAllLoops(); // 获取所有的EventLoop
 
+    /**
+     * 返回绑定在cpu上的subloop 没有时返回同一物理CPU(package)上编号最接近的绑定loop
+     * 都没有(或cpu未知、没有绑定任何loop)时返回nullptr 由调用者回退到轮询
+     * 查表在start()时建好 之后只读 可以在任意线程调用
+     */
+    EventLoop *getLoopForCpu(int cpu) const;
+
     bool started() const { return started_; } // 是否已经启动
     const std::string name() const { return name_; } // 获取名字
 
@@ -37,4 +46,6 @@ private:
     int next_; // 新连接到来，所选择EventLoop的索引
     std::vector<std::unique_ptr<EventLoopThread>> threads_;//IO线程的列表
     std::vector<EventLoop *> loops_;//线程池中EventLoop的列表，指向的是EVentLoopThread线程函数创建的EventLoop对象。
+    std::vector<int> cpus_;            // subloop线程要绑定的CPU 为空表示不绑定
+    std::vector<EventLoop *> cpuLoops_; // 下标为CPU编号 值为该CPU上收包的连接应该交给的loop
 };
\ No newline at end of file
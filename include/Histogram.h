@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * HdrHistogram风格的对数线性直方图 记录非负整数(一般是纳秒)
+ * 每个2的幂区间再等分成kSubBuckets/2个桶 相对误差不超过 2/kSubBuckets (约1.6%)
+ * 小于kSubBuckets的值精确记录 全部64位范围只需要几千个桶 record是O(1)且不分配内存
+ *
+ * 不是线程安全的 多线程统计时每个线程一个 再merge到一起
+ **/
+class Histogram
+{
+public:
+    static const int kSubBucketBits = 7;
+    static const int64_t kSubBuckets = 1 << kSubBucketBits;
+
+    Histogram();
+
+    void record(int64_t value) { recordN(value, 1); }
+    // 同一个值记录count次
+    void recordN(int64_t value, int64_t count);
+    void merge(const Histogram &other);
+    void reset();
+
+    int64_t count() const { return count_; }
+    int64_t min() const { return count_ > 0 ? min_ : 0; }
+    int64_t max() const { return max_; }
+    double mean() const { return count_ > 0 ? static_cast<double>(sum_) / static_cast<double>(count_) : 0; }
+    // p取[0, 1] 返回所在桶的上界 不会超过max()
+    int64_t percentile(double p) const;
+
+    // 桶的下标和它覆盖的区间[lowerBound(i), upperBound(i)]
+    static size_t bucketIndex(int64_t value);
+    static int64_t lowerBound(size_t index);
+    static int64_t upperBound(size_t index);
+    static size_t bucketCount();
+
+    const std::vector<int64_t> &buckets() const { return counts_; }
+
+private:
+    std::vector<int64_t> counts_;
+    int64_t count_;
+    int64_t sum_;
+    int64_t min_;
+    int64_t max_;
+};
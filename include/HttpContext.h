@@ -0,0 +1,99 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+#include "HttpParser.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+class EventLoop;
+
+using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+
+/**
+ * 一个HTTP连接的状态 由HttpServer挂在TcpConnection::setContext上 只在连接所属的loop线程中使用
+ *
+ * 流水线: 一次onMessage里按顺序处理Buffer中所有完整的请求 响应依次追加到output_ 最后一次send发出去
+ *         响应是延迟的(defer)或者带文件时 先暂停处理后面的请求 完成后从inputBuffer里接着解析
+ *         所以响应的顺序总是和请求一致
+ * keep-alive: 请求或响应要求关闭时 发完这个响应就shutdown 后面收到的数据丢弃
+ **/
+class HttpContext : noncopyable, public std::enable_shared_from_this<HttpContext>
+{
+public:
+    HttpContext(const TcpConnectionPtr &conn, const HttpCallback &callback,
+                size_t maxHeaderBytes, size_t maxBodyBytes);
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // 这个连接上处理过的请求数
+    int64_t requests() const { return requests_; }
+
+private:
+    friend class HttpResponse;
+    friend class HttpResponseWriter;
+
+    std::shared_ptr<HttpResponseWriter> makeWriter();
+    // 解析并处理buf中的请求 直到数据不完整或者需要等待
+    void process(const TcpConnectionPtr &conn, Buffer *buf);
+    // 回调里已经完成的响应写进output_ 带文件的响应发出头部后开始sendFile
+    void completeResponse(const TcpConnectionPtr &conn);
+    void sendError(int status);
+    void flush(const TcpConnectionPtr &conn);
+    // 延迟的响应或者文件发完 继续处理流水线里剩下的请求
+    void onDeferredFinished();
+    void onFileSent();
+    void resume();
+
+    std::weak_ptr<TcpConnection> conn_;
+    EventLoop *loop_;
+    HttpCallback callback_;
+    HttpParser parser_;
+    HttpRequest request_;
+    HttpResponse response_;
+    Buffer output_;         // 本轮要发送的响应 一次send发出
+    Timestamp receiveTime_;
+    int64_t requests_;
+    size_t pauseThreshold_; // 等待期间Buffer中积压超过这个值就暂停读
+    bool processing_;       // 正在process里 回调中同步完成的响应不要再递归进去
+    bool waiting_;          // 等待延迟的响应或者文件发完
+    bool deferredDone_;     // 回调返回之前延迟的响应已经finish了
+    bool closing_;          // 发完已有的响应后关闭连接
+    bool continueSent_;
+    bool headRequest_;
+    bool readPaused_;
+};
+
+/**
+ * 延迟完成的响应 由HttpResponse::defer()得到 只能在连接所属的loop线程中使用
+ * 其他线程先通过getLoop()->runInLoop()转过来
+ * 连接已经断开时写入的数据直接丢弃 析构时还没有finish会自动finish
+ **/
+class HttpResponseWriter : noncopyable
+{
+public:
+    explicit HttpResponseWriter(const std::shared_ptr<HttpContext> &context);
+    ~HttpResponseWriter();
+
+    // 第一次write或者finish之前设置状态码和头部
+    HttpResponse *response() { return &context_->response_; }
+    EventLoop *getLoop() const { return context_->loop_; }
+    bool connected() const;
+
+    // chunked响应立即发送一个数据块 第一次调用时先发出状态行和头部 非chunked响应先追加到响应体
+    void write(const StringPiece &data);
+    // 结束响应 非chunked时发出完整的响应 chunked时发出最后的空块
+    void finish();
+    bool finished() const { return finished_; }
+
+private:
+    std::shared_ptr<HttpContext> context_;
+    bool headersSent_;
+    bool finished_;
+};
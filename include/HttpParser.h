@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "HttpRequest.h"
+
+class Buffer;
+
+/**
+ * HTTP/1.1请求解析器 直接在连接的inputBuffer_上解析 每个连接一个
+ *
+ * 头部: 先用SIMD(SSE2)找到"\r\n\r\n" 数据不完整时记住已经扫描过的位置 下次从那里继续
+ *       找到之后一次性切分请求行和头部 结果是相对请求起始位置的偏移 不拷贝不分配
+ * 请求体: Content-Length直接引用 chunked编码在Buffer里就地解码(把数据块往前搬 去掉块头)
+ *
+ * 用法:
+ *   Result r = parser.parse(buf, &request);
+ *   kComplete:   处理request 然后buf->retrieve(parser.consumed()); parser.reset();
+ *   kIncomplete: 等更多数据 request和Buffer里的数据都不要动
+ *   kError:      errorStatus()是应该回给客户端的状态码 然后关闭连接
+ **/
+class HttpParser
+{
+public:
+    enum Result
+    {
+        kComplete,
+        kIncomplete,
+        kError,
+    };
+
+    HttpParser(size_t maxHeaderBytes, size_t maxBodyBytes);
+
+    Result parse(Buffer *buf, HttpRequest *request);
+
+    // 完整的请求(含请求体)占用的字节数 kComplete之后有效
+    size_t consumed() const { return consumed_; }
+    // 出错时应答的状态码 400/413/431/501/505
+    int errorStatus() const { return errorStatus_; }
+    // 头部已经解析完 正在等请求体 用于决定是否回100 Continue
+    bool expectingBody() const { return state_ == kExpectBody || state_ >= kExpectChunkSize; }
+
+    void reset();
+
+    // 在[begin, end)中找"\r\n\r\n" 返回它的起始位置 没有返回nullptr
+    static const char *findHeaderEnd(const char *begin, const char *end);
+    // 找"\r\n" 返回'\r'的位置 没有返回nullptr
+    static const char *findCrlf(const char *begin, const char *end);
+
+private:
+    enum State
+    {
+        kExpectHeaders,
+        kExpectBody,
+        kExpectChunkSize,
+        kExpectChunkData,
+        kExpectTrailers,
+    };
+
+    // 解析[begin, end)中的请求行和头部 end指向头部结尾的空行
+    bool parseHeaders(const char *begin, const char *end, HttpRequest *request);
+    bool parseRequestLine(const char *begin, const char *end, HttpRequest *request);
+    // 处理Content-Length/Transfer-Encoding/Connection/Expect
+    bool onHeader(const StringPiece &name, const StringPiece &value, HttpRequest *request);
+    Result parseChunked(char *base, size_t readable, HttpRequest *request);
+    Result fail(int status)
+    {
+        errorStatus_ = status;
+        return kError;
+    }
+
+    const size_t maxHeaderBytes_;
+    const size_t maxBodyBytes_;
+    State state_;
+    size_t scanned_;        // 已经确认不含头部结尾的字节数
+    size_t headerBytes_;    // 请求行+头部+空行的长度 也是请求体的起始偏移
+    size_t bodyBytes_;      // chunked: 已经解码到headerBytes_之后的字节数
+    size_t chunkScan_;      // chunked: 下一个未处理字节的偏移
+    size_t chunkRemaining_; // chunked: 当前块还没收到的字节数
+    size_t consumed_;
+    int errorStatus_;
+    bool connectionClose_;
+    bool connectionKeepAlive_;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+/**
+ * 一个解析好的HTTP请求 由HttpParser填充
+ * 请求行、头部和请求体都是指向连接inputBuffer_的视图 不拷贝也不分配内存
+ * 只在HttpServer回调期间有效 回调返回后这段数据就被retrieve了 需要保留的内容自己toString()
+ **/
+class HttpRequest
+{
+public:
+    enum Method
+    {
+        kInvalid,
+        kGet,
+        kHead,
+        kPost,
+        kPut,
+        kDelete,
+        kOptions,
+        kPatch,
+        kConnect,
+        kTrace,
+    };
+    enum Version
+    {
+        kUnknown,
+        kHttp10,
+        kHttp11,
+    };
+
+    static const int kMaxHeaders = 64; // 头部保存在定长数组里 超过时返回431
+
+    struct Header
+    {
+        StringPiece name;
+        StringPiece value;
+    };
+
+    HttpRequest() { reset(); }
+
+    void reset();
+
+    Method method() const { return method_; }
+    const char *methodString() const;
+    Version version() const { return version_; }
+    StringPiece path() const { return view(path_); }
+    StringPiece query() const { return view(query_); }  // 不含'?'
+    StringPiece body() const { return view(body_); }    // chunked的请求体已经就地解码
+    Timestamp receiveTime() const { return receiveTime_; }
+    void setReceiveTime(Timestamp t) { receiveTime_ = t; }
+
+    int headerCount() const { return headerCount_; }
+    Header header(int i) const
+    {
+        Header h;
+        h.name = view(headers_[i].name);
+        h.value = view(headers_[i].value);
+        return h;
+    }
+    // 按名字查找 不区分大小写 没有时返回空视图
+    StringPiece getHeader(const StringPiece &name) const;
+
+    // 请求处理完之后是否保持连接 HTTP/1.1默认保持 HTTP/1.0需要Connection: keep-alive
+    bool keepAlive() const { return keepAlive_; }
+    bool chunked() const { return chunked_; }
+    bool expectContinue() const { return expectContinue_; }
+    int64_t contentLength() const { return contentLength_; }
+
+private:
+    friend class HttpParser;
+
+    // 相对请求起始位置的偏移 Buffer扩容搬移数据后仍然有效 解析完成时才确定base_
+    struct Span
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+    struct HeaderSpan
+    {
+        Span name;
+        Span value;
+    };
+
+    StringPiece view(const Span &s) const { return StringPiece(base_ + s.offset, s.length); }
+
+    const char *base_;
+    Method method_;
+    Version version_;
+    Span path_;
+    Span query_;
+    Span body_;
+    int headerCount_;
+    HeaderSpan headers_[kMaxHeaders];
+    bool keepAlive_;
+    bool chunked_;
+    bool expectContinue_;
+    int64_t contentLength_;
+    Timestamp receiveTime_;
+};
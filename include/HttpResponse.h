@@ -0,0 +1,92 @@
+#pragma once
+
+#include <memory>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "StringPiece.h"
+
+class HttpContext;
+class HttpResponseWriter;
+
+/**
+ * HTTP响应 每个连接一个 处理每个请求前reset 头部和响应体的Buffer容量一直复用
+ * 小响应在稳定状态下没有任何堆分配
+ *
+ * 响应体三选一:
+ *   setBody/appendBody   内存中的数据 带Content-Length
+ *   setFile              文件的一段 头部发出后用sendFile零拷贝发送 带Content-Length
+ *   setChunked(true)     Transfer-Encoding: chunked 一般配合defer()边生成边发送
+ **/
+class HttpResponse : noncopyable
+{
+public:
+    HttpResponse();
+    ~HttpResponse();
+
+    // 开始一个新的响应 默认200 closeConnection由请求的keep-alive决定
+    void reset(bool closeConnection, bool http10);
+
+    void setStatusCode(int code) { statusCode_ = code; }
+    int statusCode() const { return statusCode_; }
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    // 头部按调用顺序写出 Content-Length/Transfer-Encoding/Connection/Date由框架生成 不要自己加
+    void addHeader(const StringPiece &name, const StringPiece &value);
+    void setContentType(const StringPiece &contentType) { addHeader("Content-Type", contentType); }
+
+    void setBody(const StringPiece &body);
+    void appendBody(const char *data, size_t len) { body_.append(data, len); }
+    Buffer *body() { return &body_; }
+
+    /**
+     * 响应体是文件fd中[offset, offset+count)的部分 由TcpConnection::sendFile发送
+     * closeFile为true时发送完成或者连接断开后关闭fd
+     * 文件发完之前同一连接上流水线后面的请求不会处理 保证响应的顺序
+     */
+    void setFile(int fd, off_t offset, size_t count, bool closeFile = true);
+    bool hasFile() const { return fileFd_ >= 0; }
+
+    void setChunked(bool on) { chunked_ = on; }
+    bool chunked() const { return chunked_; }
+
+    /**
+     * 回调返回之后再完成响应 例如等待后端的结果 或者用chunked编码流式发送
+     * 完成之前这个连接上流水线后面的请求不会处理 返回的writer只能在连接所属的loop线程中使用
+     * 请求的视图在回调返回后失效 之后还要用的内容在回调里自己拷贝
+     */
+    std::shared_ptr<HttpResponseWriter> defer();
+    bool deferred() const { return deferred_; }
+
+    // 状态码对应的标准原因短语
+    static const char *statusMessage(int code);
+
+private:
+    friend class HttpContext;
+    friend class HttpResponseWriter;
+
+    // 状态行和头部(含空行)
+    void appendHeaders(Buffer *output);
+    // 头部和内存中的响应体 文件和延迟的响应只写头部
+    void appendToBuffer(Buffer *output, bool omitBody);
+    // 一个chunked数据块
+    static void appendChunk(Buffer *output, const char *data, size_t len);
+    // 交出文件的所有权 之后由发送完成的回调负责关闭
+    void releaseFile() { fileFd_ = -1; }
+    void closeFileIfOwned();
+
+    HttpContext *context_; // 由HttpContext在处理请求前设置 defer()通过它找到连接
+    int statusCode_;
+    bool closeConnection_;
+    bool http10_;   // 请求是HTTP/1.0 不能使用chunked编码
+    bool chunked_;
+    bool deferred_;
+    Buffer headers_; // 用户添加的头部 "Name: value\r\n"
+    Buffer body_;
+    int fileFd_;
+    off_t fileOffset_;
+    size_t fileCount_;
+    bool closeFile_;
+};
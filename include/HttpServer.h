@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "HttpContext.h"
+
+/**
+ * 基于TcpServer的HTTP/1.1服务器
+ * 回调在连接所属的subloop线程中执行 同一个连接上的请求按顺序回调 响应按请求的顺序发出
+ * TLS、socket参数、内存预算等通过tcpServer()设置
+ *
+ *   HttpServer server(&loop, InetAddress(8000), "http");
+ *   server.setHttpCallback([](const HttpRequest &req, HttpResponse *resp) {
+ *       resp->setContentType("text/plain");
+ *       resp->setBody("hello\n");
+ *   });
+ *   server.start();
+ **/
+class HttpServer : noncopyable
+{
+public:
+    struct Options
+    {
+        size_t maxHeaderBytes = 64 * 1024;      // 请求行加头部的上限 超过返回431
+        size_t maxBodyBytes = 8 * 1024 * 1024;  // 请求体的上限 超过返回413
+    };
+
+    HttpServer(EventLoop *loop,
+               const InetAddress &listenAddr,
+               const std::string &name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop *getLoop() const { return loop_; }
+    TcpServer &tcpServer() { return server_; }
+
+    // 没有设置时所有请求返回404 必须在start()之前调用
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+    void setOptions(const Options &options) { options_ = options; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    EventLoop *loop_;
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    Options options_;
+};
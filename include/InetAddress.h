@@ -2,25 +2,54 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string>
 
-// 封装socket地址类型
+/**
+ * 封装socket地址类型 支持IPv4、IPv6和Unix域(AF_UNIX)
+ * Unix域地址分两种:
+ *   文件路径  fromUnixPath("/run/app.sock")   在文件系统中可见 服务端bind之前需要删除残留的文件
+ *   抽象命名  fromAbstract("app")            sun_path以'\0'开头 不占用文件系统 进程退出后自动消失
+ * getSockAddr()/getSockLen()直接交给bind/connect使用 调用方不需要关心地址族
+ **/
 class InetAddress
 {
 public:
+    // ip中含有':'时按IPv6解析 例如 InetAddress(8080, "::1")
     explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
-    explicit InetAddress(const sockaddr_in &addr)
-        : addr_(addr)
-    {
-    }
+    explicit InetAddress(const sockaddr_in &addr);
+    explicit InetAddress(const sockaddr_in6 &addr);
+    // len为accept/getsockname返回的地址长度 用来区分路径和抽象命名
+    InetAddress(const sockaddr *addr, socklen_t len);
+
+    static InetAddress fromUnixPath(const std::string &path);
+    static InetAddress fromAbstract(const std::string &name);
 
+    sa_family_t family() const { return addr_.sin_family; }
+    bool isIpv6() const { return family() == AF_INET6; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    // 抽象命名的Unix域地址 或者未命名(socketpair、客户端没有bind)的Unix域地址
+    bool isAbstract() const;
+
+    // IPv4/IPv6返回ip Unix域返回路径 抽象命名以'@'开头
     std::string toIp() const;
+    // IPv4 "ip:port" IPv6 "[ip]:port" Unix域 "unix:路径"
     std::string toIpPort() const;
+    // Unix域地址返回0
     uint16_t toPort() const;
 
-    const sockaddr_in *getSockAddr() const { return &addr_; }
-    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+    const sockaddr *getSockAddr() const { return reinterpret_cast<const sockaddr *>(&addr6_); }
+    socklen_t getSockLen() const { return len_; }
+    void setSockAddr(const sockaddr_in &addr);
+    void setSockAddr(const sockaddr *addr, socklen_t len);
 
 private:
-    sockaddr_in addr_;
-};
\ No newline at end of file
+    union
+    {
+        sockaddr_in addr_;
+        sockaddr_in6 addr6_;
+        sockaddr_un unix_;
+    };
+    socklen_t len_;
+};
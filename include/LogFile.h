@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+/**
+ * 滚动日志文件 只由AsyncLogging的后台线程使用 所以内部不加锁
+ * 满足以下任一条件时切换到新文件:
+ * 1. 当前文件写入的字节数超过rollSize
+ * 2. 距离当前文件创建已经超过rollInterval秒(默认按天滚动)
+ * 文件名: basename.20240101-120000.hostname.pid.log
+ **/
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename,
+            off_t rollSize,
+            int flushInterval = 3,
+            int rollInterval = 60 * 60 * 24);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    // 立即切换到新文件 返回是否真的创建了新文件(同一秒内不会重复滚动)
+    bool rollFile();
+
+    off_t writtenBytes() const { return writtenBytes_; }
+    // 成功打开过的文件个数 变化说明刚切换到了新文件
+    int fileCount() const { return fileCount_; }
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_; // 多少秒fflush一次
+    const int rollInterval_;  // 多少秒滚动一次
+
+    FILE *fp_;
+    char fileBuffer_[64 * 1024]; // 交给setvbuf 减少write系统调用
+    off_t writtenBytes_;
+    int fileCount_;
+
+    time_t startOfPeriod_; // 当前文件所属周期的起点 按rollInterval_对齐
+    time_t lastRoll_;
+    time_t lastFlush_;
+};
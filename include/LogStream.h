@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+/**
+ * 流式日志格式化 LOG_STREAM(INFO) << "fd=" << fd << " bytes=" << n;
+ * 直接写进调用者提供的定长缓冲区(Logger用线程局部缓冲区) 整个过程不构造std::string 不分配内存
+ * 缓冲区写满后多余的内容直接截断
+ **/
+class LogStream : noncopyable
+{
+public:
+    LogStream(char *buf, size_t size)
+        : buf_(buf)
+        , cur_(buf)
+        , end_(buf + size)
+    {
+    }
+
+    LogStream &operator<<(bool v) { return append(v ? "1" : "0", 1); }
+    LogStream &operator<<(char v) { return append(&v, 1); }
+    LogStream &operator<<(short v) { return *this << static_cast<int>(v); }
+    LogStream &operator<<(unsigned short v) { return *this << static_cast<unsigned int>(v); }
+    LogStream &operator<<(int v);
+    LogStream &operator<<(unsigned int v);
+    LogStream &operator<<(long v);
+    LogStream &operator<<(unsigned long v);
+    LogStream &operator<<(long long v);
+    LogStream &operator<<(unsigned long long v);
+    LogStream &operator<<(double v);
+    LogStream &operator<<(float v) { return *this << static_cast<double>(v); }
+    LogStream &operator<<(const void *p); // 按0x十六进制输出
+    LogStream &operator<<(const char *s) { return s ? append(s, ::strlen(s)) : append("(null)", 6); }
+    LogStream &operator<<(const std::string &s) { return append(s.data(), s.size()); }
+
+    LogStream &append(const char *data, size_t len)
+    {
+        size_t avail = static_cast<size_t>(end_ - cur_);
+        if (len > avail)
+        {
+            len = avail;
+        }
+        ::memcpy(cur_, data, len);
+        cur_ += len;
+        return *this;
+    }
+
+    const char *data() const { return buf_; }
+    size_t length() const { return static_cast<size_t>(cur_ - buf_); }
+    size_t avail() const { return static_cast<size_t>(end_ - cur_); }
+    char *current() { return cur_; }
+    void add(size_t len) { cur_ += len; } // 调用者直接写了current()之后推进写位置
+    void reset() { cur_ = buf_; }
+
+private:
+    template <typename T>
+    LogStream &formatInteger(T v);
+
+    char *buf_;
+    char *cur_;
+    char *end_;
+};
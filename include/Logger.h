@@ -1,76 +1,197 @@
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <functional>
+#include <stdlib.h>
 
 #include "noncopyable.h"
+#include "LogStream.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...)                       \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(INFO);                         \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// 定义日志的级别 数值越大越严重 低于阈值的日志在格式化之前就被过滤掉
+enum LogLevel
+{
+    DEBUG, // 调试信息
+    INFO,  // 普通信息
+    ERROR, // 错误信息
+    FATAL, // core dump信息
+    NUM_LOG_LEVELS,
+};
+
+/**
+ * 编译期最低级别 低于它的日志语句整个被编译器删掉 连参数都不会求值
+ * 默认跟随MUDEBUG: 定义了MUDEBUG才编译LOG_DEBUG 也可以在编译选项中直接指定 -DMUDUO_MIN_LOG_LEVEL=2
+ **/
+#ifndef MUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_MIN_LOG_LEVEL 0
+#else
+#define MUDUO_MIN_LOG_LEVEL 1
+#endif
+#endif
+
+// 运行期的全局阈值 默认INFO 启动时可以用环境变量 MUDUO_LOG_LEVEL=DEBUG 修改
+extern std::atomic<int> g_logLevel;
+
+/**
+ * 按模块设置日志阈值
+ * static LogModule s_pollerLog("EPollPoller");
+ * LOG_MODULE_DEBUG(s_pollerLog, "%d events happend", n);
+ * Logger::setModuleLevel("EPollPoller", DEBUG); // 只打开这个模块的DEBUG日志
+ *
+ * level_里保存的是生效的阈值(没有单独设置时等于全局阈值) 所以判断是否输出只需要一次原子读
+ **/
+class LogModule : noncopyable
+{
+public:
+    explicit LogModule(const char *name);
+    ~LogModule();
+
+    const char *name() const { return name_; }
+    int level() const { return level_.load(std::memory_order_relaxed); }
+    bool enabled(int level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // 单独设置本模块的阈值 之后不再跟随全局阈值
+    void setLevel(int level);
+    // 恢复跟随全局阈值
+    void followGlobal();
+
+private:
+    friend class Logger;
+
+    const char *name_;
+    std::atomic<int> level_;
+    std::atomic_bool overridden_;
+};
+
+#define MUDUO_LOG_ENABLED(level) \
+    ((level) >= MUDUO_MIN_LOG_LEVEL && (level) >= g_logLevel.load(std::memory_order_relaxed))
+#define MUDUO_MODULE_LOG_ENABLED(module, level) \
+    ((level) >= MUDUO_MIN_LOG_LEVEL && (module).enabled(level))
+
+// LOG_INFO("%s %d", arg1, arg2) 先判断级别 被过滤掉的语句只有一次比较
+#define LOG_INFO(logmsgFormat, ...)                                          \
+    do                                                                       \
+    {                                                                        \
+        if (MUDUO_LOG_ENABLED(INFO))                                         \
+            Logger::instance().logf(INFO, logmsgFormat, ##__VA_ARGS__);      \
     } while (0)
 
-#define LOG_ERROR(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+#define LOG_ERROR(logmsgFormat, ...)                                         \
+    do                                                                       \
+    {                                                                        \
+        if (MUDUO_LOG_ENABLED(ERROR))                                        \
+            Logger::instance().logf(ERROR, logmsgFormat, ##__VA_ARGS__);     \
     } while (0)
 
-#define LOG_FATAL(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
+// FATAL不受运行期阈值影响
+#define LOG_FATAL(logmsgFormat, ...)                                         \
+    do                                                                       \
+    {                                                                        \
+        Logger::instance().logf(FATAL, logmsgFormat, ##__VA_ARGS__);         \
+        Logger::instance().flush();                                          \
+        exit(-1);                                                            \
     } while (0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+#define LOG_DEBUG(logmsgFormat, ...)                                         \
+    do                                                                       \
+    {                                                                        \
+        if (MUDUO_LOG_ENABLED(DEBUG))                                        \
+            Logger::instance().logf(DEBUG, logmsgFormat, ##__VA_ARGS__);     \
     } while (0)
-#else
-#define LOG_DEBUG(logmsgFormat, ...)
-#endif
 
-// 定义日志的级别 INFO ERROR FATAL DEBUG
-enum LogLevel
-{
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core dump信息
-    DEBUG, // 调试信息
-};
+// 按模块过滤的版本
+#define LOG_MODULE_DEBUG(module, logmsgFormat, ...)                          \
+    do                                                                       \
+    {                                                                        \
+        if (MUDUO_MODULE_LOG_ENABLED(module, DEBUG))                         \
+            Logger::instance().logf(DEBUG, logmsgFormat, ##__VA_ARGS__);     \
+    } while (0)
 
-// 输出一个日志类
+#define LOG_MODULE_INFO(module, logmsgFormat, ...)                           \
+    do                                                                       \
+    {                                                                        \
+        if (MUDUO_MODULE_LOG_ENABLED(module, INFO))                          \
+            Logger::instance().logf(INFO, logmsgFormat, ##__VA_ARGS__);      \
+    } while (0)
+
+#define LOG_MODULE_ERROR(module, logmsgFormat, ...)                          \
+    do                                                                       \
+    {                                                                        \
+        if (MUDUO_MODULE_LOG_ENABLED(module, ERROR))                         \
+            Logger::instance().logf(ERROR, logmsgFormat, ##__VA_ARGS__);     \
+    } while (0)
+
+/**
+ * 流式写法 LOG_STREAM(INFO) << "fd=" << fd;
+ * 写成 if-else 的形式 用户代码里的else不会被宏吞掉 被过滤时 << 右边的表达式都不会求值
+ **/
+#define LOG_STREAM(level) \
+    if (!MUDUO_LOG_ENABLED(level)) {} else LogMessage(level, __FILE__, __LINE__).stream()
+#define LOG_MODULE_STREAM(module, level) \
+    if (!MUDUO_MODULE_LOG_ENABLED(module, level)) {} else LogMessage(level, __FILE__, __LINE__).stream()
 
+// 输出一个日志类
 class Logger : noncopyable
 {
 public:
+    // 日志最终的输出位置 默认写到stdout 可以替换成AsyncLogging::append
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
+    // 一行日志的最大长度 超出部分截断
+    static const size_t kMaxLineSize = 4096;
+
     // 获取日志唯一的实例对象 单例
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 全局阈值 低于该级别的日志不输出
+    static int logLevel() { return g_logLevel.load(std::memory_order_relaxed); }
+    // 设置全局阈值 没有单独设置过阈值的模块同时生效
+    static void setLogLevel(int level);
+    // 按名字设置模块阈值 找不到该模块返回false
+    static bool setModuleLevel(const std::string &name, int level);
+    static const char *levelName(int level);
+
+    // printf风格写日志 直接格式化进线程局部缓冲区 不分配内存
+    void logf(int level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+    // 输出一行已经格式化好的日志 包括结尾的换行
+    void output(const char *line, size_t len) { output_(line, len); }
+    // LOG_FATAL退出进程之前调用 保证已经写入的日志落盘
+    void flush();
+
+    // 在程序启动、开始写日志之前设置
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
+
+    // 把 "[INFO]2024/01/01 12:00:00.123456 : " 写到buf中 返回写入的长度
+    static size_t formatPrefix(int level, char *buf, size_t size);
+
+private:
+    Logger();
+
+    OutputFunc output_;
+    FlushFunc flush_;
+};
+
+/**
+ * LOG_STREAM创建的临时对象 构造时写好前缀 析构时补上换行交给Logger输出
+ * 使用线程局部缓冲区 支持有限层数的嵌套(<<右边的表达式里又写了日志)
+ **/
+class LogMessage : noncopyable
+{
+public:
+    LogMessage(int level, const char *file, int line);
+    ~LogMessage();
+
+    LogStream &stream() { return stream_; }
 
 private:
-    int logLevel_;
-};
\ No newline at end of file
+    static char *acquireBuffer();
+    static void releaseBuffer();
+
+    const int level_;
+    const char *file_;
+    const int line_;
+    LogStream stream_;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "noncopyable.h"
+#include "Metrics.h"
+
+class EventLoop;
+struct LoopActivity;
+
+/**
+ * 卡住的事件循环的看门狗
+ * 一个阻塞的MessageCallback会让同一个subloop上的所有连接一起停住 客户端超时之后才知道
+ * 看门狗线程每隔interval检查一次被监视的loop: loop不在epoll_wait里 而且LoopActivity::seq一直没变
+ * 说明它停在同一个Channel回调或者pendingFunctor里 超过threshold就报告一次
+ * 报告里有loop线程、回调类型、Channel的fd和名字(TcpConnection的名字/Acceptor/TimerQueue) 可选loop线程的调用栈
+ *
+ * loop自己每切换一次回调只多几次relaxed存储 不读时钟 停顿时长是看门狗观察到的 误差不超过interval
+ *
+ *   LoopWatchdog watchdog(0.2);
+ *   server.setThreadInitCallback([&watchdog](EventLoop *loop) { watchdog.watch(loop); });
+ *   watchdog.start();
+ *
+ * 调用栈: 向loop线程发送stackSignal(默认SIGURG 内核只在设置了F_SETOWN的socket上发送 默认动作是忽略)
+ * 信号处理函数在loop线程里调用backtrace() 看门狗线程等它写完再符号化 函数名需要链接时加-rdynamic
+ * 信号会让回调中正在阻塞的nanosleep/poll/epoll_wait等调用返回EINTR(read/write等按SA_RESTART自动重启)
+ **/
+class LoopWatchdog : noncopyable
+{
+public:
+    struct Stall
+    {
+        int tid;             // loop线程
+        std::string kind;    // 回调类型 LoopActivity::kindName
+        int fd;              // Channel的fd pendingFunctor为-1
+        std::string label;   // Channel的名字 没有设置时为空 超过LoopActivity::kLabelSize-1字节的部分被截掉
+        double seconds;      // 已经停住的时间(看门狗观察到的)
+        std::vector<std::string> stack; // 开启了调用栈时loop线程的调用栈
+    };
+    using StallCallback = std::function<void(const Stall &)>;
+
+    // threshold: 停住多少秒算卡住 interval: 检查间隔 默认threshold/4
+    explicit LoopWatchdog(double threshold = 0.1, double interval = 0);
+    ~LoopWatchdog();
+
+    // 线程安全 可以在loop线程的初始化回调里调用 loop析构后自动不再监视
+    void watch(EventLoop *loop);
+
+    // 在看门狗线程中回调 没有设置时用LOG_ERROR输出 必须在start()之前设置
+    void setStallCallback(const StallCallback &cb) { stallCallback_ = cb; }
+    // 报告时抓取loop线程的调用栈 必须在start()之前设置
+    void setCaptureStack(bool on, int stackSignal = 0);
+
+    void start();
+    void stop();
+
+    // 报告过的卡顿次数 同时导出为muduo_eventloop_stalls_total
+    int64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+    struct Watched
+    {
+        std::shared_ptr<LoopActivity> activity;
+        uint64_t seq;
+        int64_t sinceNs;  // 第一次看到这个seq的时间
+        bool reported;    // 这一次停顿已经报告过
+    };
+
+    void threadFunc();
+    void check(Watched *w, int64_t nowNs);
+    std::vector<std::string> captureStack(int tid);
+
+    const double threshold_;
+    const double interval_;
+    StallCallback stallCallback_;
+    bool captureStack_;
+    int stackSignal_;
+
+    std::atomic<int64_t> stalls_;
+    metrics::Counter stallsMetric_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    std::vector<Watched> watched_;
+    std::thread thread_;
+};
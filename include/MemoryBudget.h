@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+class EventLoop;
+class TcpConnection;
+class LoopMemoryAccount;
+
+/**
+ * 服务器级别的缓冲区内存预算
+ * 单个连接的高水位回调只能限制某一个连接 当10万个连接每个都缓冲一点数据时 进程整体的内存仍然会失控
+ * MemoryBudget统计所有loop上所有TcpConnection的inputBuffer_/outputBuffer_中缓存的字节数
+ * 超过预算后按照policy执行: 暂停最大消费者的读事件 / 拒绝新连接 / 关闭最大的连接
+ *
+ * 为了避免每次读写都去竞争同一个原子变量 每个loop有一个LoopMemoryAccount在本线程内累加增量
+ * 累计超过batchBytes_后才同步到全局计数 所以usage()是一个近似值 误差最多为 loop个数 * batchBytes_
+ **/
+class MemoryBudget : noncopyable, public std::enable_shared_from_this<MemoryBudget>
+{
+public:
+    enum Policy
+    {
+        kNone = 0,
+        kPauseReading = 1 << 0, // 暂停占用最多的连接的读事件 让TCP流控把压力推回给对端
+        kRejectNew = 1 << 1,    // TcpServer::newConnection直接关闭新连接
+        kCloseLargest = 1 << 2, // 关闭占用最多的连接
+    };
+
+    static const size_t kDefaultBatchBytes = 64 * 1024;
+
+    MemoryBudget(size_t limitBytes, int policy, size_t batchBytes = kDefaultBatchBytes);
+    ~MemoryBudget();
+
+    size_t limit() const { return limit_; }
+    int policy() const { return policy_; }
+    bool hasPolicy(Policy p) const { return (policy_ & p) != 0; }
+    size_t batchBytes() const { return batchBytes_; }
+
+    // 当前所有连接缓存的字节数(近似值)
+    int64_t usage() const { return usage_.load(std::memory_order_relaxed); }
+    bool overBudget() const { return usage() > static_cast<int64_t>(limit_); }
+    // 同时开启暂停读和关闭连接时 暂停读之后仍然超过硬上限才开始关连接
+    bool overHardLimit() const { return usage() > hardLimit_; }
+    // TcpServer::newConnection调用 判断是否需要拒绝新连接
+    bool shouldReject() const { return hasPolicy(kRejectNew) && overBudget(); }
+
+    // 统计指标
+    int64_t rejectedConnections() const { return rejected_.load(std::memory_order_relaxed); }
+    int64_t pausedConnections() const { return paused_.load(std::memory_order_relaxed); }
+    int64_t closedConnections() const { return closed_.load(std::memory_order_relaxed); }
+    void countRejected() { rejected_.fetch_add(1, std::memory_order_relaxed); }
+    void countPaused(int n)
+    {
+        paused_.fetch_add(n, std::memory_order_relaxed);
+        pausing_.store(true, std::memory_order_relaxed);
+    }
+    void countClosed(int n) { closed_.fetch_add(n, std::memory_order_relaxed); }
+
+    // 为一个loop创建它的计数器 在TcpServer::start()中调用 要求MemoryBudget由shared_ptr管理
+    std::shared_ptr<LoopMemoryAccount> createAccount(EventLoop *loop);
+
+    // LoopMemoryAccount刷新批量计数时调用
+    void addUsage(int64_t delta);
+
+private:
+    int64_t resumeMark() const { return static_cast<int64_t>(limit_ - limit_ / 10); } // 回落到90%以下恢复读
+    void resumeAll();
+
+    const size_t limit_;
+    const int64_t hardLimit_;
+    const int policy_;
+    const size_t batchBytes_;
+
+    std::atomic<int64_t> usage_;
+    std::atomic_bool pausing_; // 是否有loop暂停过连接的读事件 用于只在状态翻转时广播一次恢复
+
+    std::atomic<int64_t> rejected_;
+    std::atomic<int64_t> paused_;
+    std::atomic<int64_t> closed_;
+
+    std::mutex mutex_; // 保护accounts_
+    std::vector<std::weak_ptr<LoopMemoryAccount>> accounts_;
+};
+
+/**
+ * 每个EventLoop一个 只在所属的loop线程中被访问 所以内部不需要加锁
+ * TcpConnection持有它的shared_ptr 保证TcpServer析构后排队执行的connectDestroyed仍然可以安全访问
+ **/
+class LoopMemoryAccount : noncopyable
+{
+public:
+    LoopMemoryAccount(EventLoop *loop, const std::shared_ptr<MemoryBudget> &budget);
+
+    EventLoop *loop() const { return loop_; }
+
+    // 以下方法都必须在loop_线程中调用
+    void add(TcpConnection *conn);
+    void remove(TcpConnection *conn);
+    // 本loop上某个连接缓存的字节数变化了delta
+    void update(int64_t delta);
+    // 总占用回落后 恢复本loop上被暂停的连接
+    void resumeReading();
+
+private:
+    void flush();
+    void enforce();
+
+    EventLoop *loop_;
+    std::shared_ptr<MemoryBudget> budget_;
+    int64_t pending_; // 还没有同步到budget_的增量
+
+    std::unordered_set<TcpConnection *> connections_;
+    std::unordered_set<TcpConnection *> paused_;
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+/**
+ * 进程内的指标注册表 计数器/仪表/直方图 按Prometheus文本格式导出(MetricsServer提供/metrics)
+ *
+ * 每个线程第一次更新指标时分配一块自己的计数单元(kMaxCells个int64) 每个指标占其中固定的几个下标
+ * 更新只写本线程的单元: 一次relaxed读加一次relaxed写 编译出来和普通的 ++x 一样 没有lock前缀也不共享cache line
+ * 读取(导出)时把所有线程的单元加起来 线程退出时它的值并入retired 计数器不会因为线程退出而变小
+ *
+ *   static metrics::Counter requests =
+ *       metrics::Registry::instance().counter("app_requests_total", "Requests handled.");
+ *   requests.inc();
+ *
+ * 同名同标签的指标重复注册返回同一个 句柄可以随意拷贝 在任何线程使用
+ * 默认构造的句柄指向一个不导出的空单元 更新它没有任何效果 省去了"是否开启指标"的判断
+ **/
+namespace metrics
+{
+
+// 每个线程的计数单元个数 所有指标共用 超出后新注册的指标指向空单元并打印错误日志
+static const size_t kMaxCells = 4096;
+
+namespace detail
+{
+extern thread_local std::atomic<int64_t> *t_cells;
+// 慢路径: 为当前线程分配计数单元并登记到注册表
+std::atomic<int64_t> *attachThread();
+
+inline void add(size_t slot, int64_t n)
+{
+    std::atomic<int64_t> *cells = t_cells;
+    if (cells == nullptr)
+    {
+        cells = attachThread();
+    }
+    // 只有本线程写 不需要原子的读改写 导出线程只做relaxed读
+    cells[slot].store(cells[slot].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+} // namespace detail
+
+// 只增不减的计数
+class Counter
+{
+public:
+    Counter() : slot_(0) {}
+
+    void inc() const { detail::add(slot_, 1); }
+    void inc(int64_t n) const { detail::add(slot_, n); }
+    // 所有线程的合计 需要遍历所有线程 不要在热路径上调用
+    int64_t value() const;
+
+private:
+    friend class Registry;
+    explicit Counter(size_t slot) : slot_(slot) {}
+
+    size_t slot_;
+};
+
+// 可增可减的当前值 例如在线连接数 每个线程累加自己的增量 合计才是当前值
+class Gauge
+{
+public:
+    Gauge() : slot_(0) {}
+
+    void inc() const { detail::add(slot_, 1); }
+    void dec() const { detail::add(slot_, -1); }
+    void add(int64_t n) const { detail::add(slot_, n); }
+    int64_t value() const;
+
+private:
+    friend class Registry;
+    explicit Gauge(size_t slot) : slot_(slot) {}
+
+    size_t slot_;
+};
+
+/**
+ * 固定上界的直方图 对应Prometheus的histogram类型
+ * bounds是递增的桶上界 记录的值用整数(例如微秒) 导出时乘以scale换算成Prometheus习惯的单位(例如秒)
+ * 占用bounds.size()+2个单元: 每个桶一个、+Inf一个、总和一个
+ **/
+class Histogram
+{
+public:
+    Histogram() : slot_(0), bounds_(nullptr) {}
+
+    void observe(int64_t value) const
+    {
+        if (bounds_ == nullptr)
+        {
+            return;
+        }
+        size_t i = 0;
+        size_t n = bounds_->size();
+        while (i < n && value > (*bounds_)[i]) // 桶一般不超过二十个 顺序比较比二分更快
+        {
+            ++i;
+        }
+        detail::add(slot_ + i, 1);
+        detail::add(slot_ + n + 1, value);
+    }
+
+    int64_t count() const;
+    int64_t sum() const;
+
+private:
+    friend class Registry;
+    Histogram(size_t slot, const std::vector<int64_t> *bounds) : slot_(slot), bounds_(bounds) {}
+
+    size_t slot_;
+    const std::vector<int64_t> *bounds_; // 由注册表持有 永不释放
+};
+
+class Registry : noncopyable
+{
+public:
+    using GaugeFunction = std::function<double()>;
+
+    // 进程唯一的注册表 永不析构 线程退出和静态对象析构时都可以安全访问
+    static Registry &instance();
+
+    /**
+     * name按Prometheus的命名规则(计数器以_total结尾) help是一行说明
+     * labels是不带花括号的标签 例如 server="echo" 可以用label()生成 同一个name的所有指标类型必须相同
+     */
+    Counter counter(const std::string &name, const std::string &help, const std::string &labels = std::string());
+    Gauge gauge(const std::string &name, const std::string &help, const std::string &labels = std::string());
+    Histogram histogram(const std::string &name, const std::string &help, const std::vector<int64_t> &bounds,
+                        double scale = 1.0, const std::string &labels = std::string());
+
+    /**
+     * 导出时调用fn取值的仪表 适合本来就在别处维护的值(例如内存预算的用量)
+     * fn在导出的线程中持有注册表的锁调用 不能再访问注册表
+     * 返回的id用于removeGaugeFunction 拥有fn中捕获的对象的一方析构前必须移除
+     */
+    int addGaugeFunction(const std::string &name, const std::string &help, const std::string &labels,
+                         const GaugeFunction &fn);
+    void removeGaugeFunction(int id);
+
+    // Prometheus文本格式(version 0.0.4)
+    std::string exposition();
+
+    // 生成 key="value" 并转义value中的反斜杠、双引号和换行
+    static std::string label(const std::string &key, const std::string &value);
+
+    // 所有线程中slot单元的合计 供句柄的value()使用
+    int64_t sum(size_t slot);
+
+    // 以下由detail::attachThread和线程退出时调用
+    void attach(std::atomic<int64_t> *cells);
+    void detach(std::atomic<int64_t> *cells);
+
+private:
+    enum Type
+    {
+        kCounter,
+        kGauge,
+        kHistogram,
+    };
+
+    struct Series
+    {
+        std::string labels;
+        size_t slot;  // 起始单元 回调仪表为0
+        std::unique_ptr<std::vector<int64_t>> bounds; // 直方图的桶上界
+        double scale;
+        int functionId; // 回调仪表的id 其他为0
+        GaugeFunction function;
+    };
+
+    struct Family
+    {
+        std::string name;
+        std::string help;
+        Type type;
+        std::vector<Series> series;
+    };
+
+    Registry();
+
+    Family *findFamily(const std::string &name, const std::string &help, Type type);
+    // 在family中查找或者新建一个标签为labels、占width个单元的序列 单元用完时返回nullptr
+    Series *findSeries(Family *family, const std::string &labels, size_t width);
+    int64_t sumLocked(size_t slot) const;
+    void appendFamily(std::string *out, const Family &family) const;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Family>> families_; // 按注册顺序导出
+    std::unordered_map<std::string, Family *> familyIndex_;
+    std::vector<std::atomic<int64_t> *> threads_; // 所有活着的线程的计数单元
+    std::vector<int64_t> retired_;                // 已经退出的线程留下的值
+    size_t nextSlot_;                             // 单元0是空单元
+    int nextFunctionId_;
+};
+
+} // namespace metrics
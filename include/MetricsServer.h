@@ -0,0 +1,24 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "HttpServer.h"
+
+/**
+ * 管理端口 GET /metrics 返回metrics::Registry的Prometheus文本格式
+ * 没有子线程 运行在传入的loop上(一般是baseLoop) 导出时遍历所有线程的计数单元 不会阻塞subloop
+ *
+ *   MetricsServer admin(&loop, InetAddress(9100, "127.0.0.1"));
+ *   admin.start();
+ **/
+class MetricsServer : noncopyable
+{
+public:
+    MetricsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name = "MetricsServer");
+
+    void start() { server_.start(); }
+
+private:
+    void onRequest(const HttpRequest &req, HttpResponse *resp);
+
+    HttpServer server_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ * USDT静态探针 线上出现延迟毛刺时不用重新编译 直接用bpftrace/perf挂上去 脚本在tools/bpftrace
+ *
+ * 编译时找到<sys/sdt.h>(systemtap-sdt-dev)会定义MUDUO_HAS_SDT 每个探针编译成一条nop指令
+ * 加上.note.stapsdt段里的描述 没有挂载时只多一条nop和把参数放进寄存器 挂载后nop被替换成int3
+ * 找不到头文件时宏展开为空 参数表达式也不会求值 所以参数只能是现成的变量或者没有副作用的表达式
+ *
+ *   bpftrace -l 'usdt:lib/libmuduo_core.so:muduo:*'
+ *
+ * provider都是muduo 探针和参数:
+ *   poll_enter(epollfd, timeoutMs)              EPollPoller::poll调用epoll_wait之前
+ *   poll_return(epollfd, numEvents, errno)      epoll_wait返回
+ *   channel_event_enter(fd, revents)            Channel::handleEvent开始
+ *   channel_event_return()                      Channel::handleEvent结束 同一线程上一个enter对应的返回
+ *   functor_enqueue(wakeupFd, pending)          EventLoop::queueInLoop 入队后队列长度
+ *   functor_dequeue(wakeupFd, count)            doPendingFunctors取出一批
+ *   functors_done(wakeupFd, count)              这一批执行完
+ *   accept(listenfd, connfd, errno)             Acceptor::handleRead connfd<0时errno有效
+ *   conn_established(fd)                        TcpConnection::connectEstablished
+ *   conn_read(fd, bytes, buffered)              handleRead读到bytes(<=0表示关闭或出错) buffered是inputBuffer_中的字节
+ *   conn_send(fd, len, direct, buffered)        sendInLoop len字节中直接写进内核direct字节 放进outputBuffer_ buffered字节
+ *   conn_write(fd, bytes, remaining)            handleWrite把outputBuffer_写出bytes字节 还剩remaining字节
+ *   conn_close(fd, state)                       handleClose 关闭前的状态
+ *
+ * 一个fd在连接关闭后会被复用 按fd统计的脚本在conn_close时清掉状态
+ **/
+
+#ifdef MUDUO_HAS_SDT
+
+#include <sys/sdt.h>
+
+#define MUDUO_PROBE0(name) DTRACE_PROBE(muduo, name)
+#define MUDUO_PROBE1(name, a1) DTRACE_PROBE1(muduo, name, a1)
+#define MUDUO_PROBE2(name, a1, a2) DTRACE_PROBE2(muduo, name, a1, a2)
+#define MUDUO_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(muduo, name, a1, a2, a3)
+#define MUDUO_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(muduo, name, a1, a2, a3, a4)
+
+#else
+
+#define MUDUO_PROBE0(name) do { } while (0)
+#define MUDUO_PROBE1(name, a1) do { } while (0)
+#define MUDUO_PROBE2(name, a1, a2) do { } while (0)
+#define MUDUO_PROBE3(name, a1, a2, a3) do { } while (0)
+#define MUDUO_PROBE4(name, a1, a2, a3, a4) do { } while (0)
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "TcpClient.h"
+#include "TimerId.h"
+#include "RpcCodec.h"
+
+// 调用完成 status为kRpcOk时response是响应负载 视图只在回调期间有效
+using RpcCallback = std::function<void(int status, const StringPiece &response)>;
+
+/**
+ * RPC客户端 在一个TcpConnection上复用任意多个并发调用
+ * 每个调用分配一个递增的id 响应按id匹配 服务端可以乱序完成
+ *
+ * 请求合并: 同一轮loop里发起的调用先追加到输出缓冲 这一轮结束时一起send
+ * 超时: 按截止时间放进最小堆 每timeoutResolution秒检查一次 超时的调用回调kRpcTimeout 之后到达的响应丢弃
+ * 断开: 所有在途调用回调kRpcDisconnected 没有连接时发起的调用直接回调kRpcDisconnected
+ *
+ * 回调都在loop线程中执行 RpcClient必须在loop线程中析构
+ **/
+class RpcClient : noncopyable
+{
+public:
+    RpcClient(EventLoop *loop,
+              const InetAddress &serverAddr,
+              const std::string &name,
+              double timeoutResolution = 0.005);
+    ~RpcClient();
+
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    // 断开后自动重连
+    void enableRetry() { client_.enableRetry(); }
+    EventLoop *getLoop() const { return loop_; }
+    TcpClient &tcpClient() { return client_; }
+
+    // 连接建立和断开时回调 在这之后才能发起调用
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMaxFrameBytes(size_t bytes) { maxFrameBytes_ = bytes; }
+
+    /**
+     * 发起一次调用 线程安全 timeoutMs<=0表示不超时
+     * 在loop线程中调用时不拷贝请求 其他线程调用时拷贝一份转到loop线程
+     */
+    void call(const StringPiece &method, const StringPiece &request, int timeoutMs, const RpcCallback &cb);
+
+    // 在途调用数 只在loop线程中访问
+    size_t pending() const { return pending_.size(); }
+    int64_t timeouts() const { return timeouts_.load(std::memory_order_relaxed); }
+
+private:
+    struct PendingCall
+    {
+        RpcCallback callback;
+    };
+    using Deadline = std::pair<int64_t, uint64_t>; // 截止时间(ns) 调用id
+
+    void callInLoop(const StringPiece &method, const StringPiece &request, int timeoutMs, const RpcCallback &cb);
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void flush();
+    void checkTimeouts();
+    void failAll(int status);
+
+    EventLoop *loop_;
+    TcpClient client_;
+    TcpConnectionPtr connection_; // 只在loop线程中访问
+    ConnectionCallback connectionCallback_;
+    size_t maxFrameBytes_;
+
+    uint64_t nextId_;
+    std::unordered_map<uint64_t, PendingCall> pending_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+    Buffer scratch_; // 编码一个请求
+    Buffer output_;  // 这一轮要发送的请求
+    bool flushQueued_;
+    TimerId timeoutTimer_;
+    std::atomic<int64_t> timeouts_;
+    std::shared_ptr<char> alive_; // 排队的flush通过它判断对象是否还在
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "StringPiece.h"
+
+class Buffer;
+
+// 调用的结果 由服务端返回或者客户端本地产生
+enum RpcStatus
+{
+    kRpcOk = 0,
+    kRpcNoMethod = 1,     // 服务端没有注册这个方法
+    kRpcBadRequest = 2,   // 帧格式错误
+    kRpcAppError = 3,     // 方法自己返回的错误 负载里是错误信息
+    kRpcTimeout = 4,      // 客户端本地: 超时没有收到响应
+    kRpcDisconnected = 5, // 客户端本地: 连接不可用或者在途时断开
+    kRpcDeferred = 255,   // 服务端方法的返回值: 稍后用RpcServer::reply回复
+};
+
+const char *rpcStatusString(int status);
+
+/**
+ * RPC帧格式 整数都是网络字节序:
+ *   | length u32 | id u64 | type u8 | status u8 | methodLen u16 | method | payload |
+ * length不含自身 id由客户端分配 响应带回同一个id 同一个连接上的响应可以乱序
+ * 请求的status为0 响应的methodLen为0
+ **/
+struct RpcFrame
+{
+    enum Type
+    {
+        kRequest = 1,
+        kResponse = 2,
+    };
+
+    uint64_t id;
+    uint8_t type;
+    uint8_t status;
+    StringPiece method;  // 指向Buffer 在retrieve之前有效
+    StringPiece payload; // 同上
+    size_t frameBytes;   // 整个帧的长度 处理完后retrieve这么多
+};
+
+class RpcCodec
+{
+public:
+    static const size_t kHeaderLen = 16;
+    // 给编码用的Buffer预留的头部空间 方法名不超过48字节时prepend不需要搬移数据
+    static const size_t kPrependSize = 64;
+
+    enum Result
+    {
+        kFrame,
+        kIncomplete,
+        kError,
+    };
+
+    // buf的可读区域是负载 把方法名和帧头prepend到前面 buf应该用kPrependSize构造
+    static void encode(Buffer *buf, RpcFrame::Type type, uint64_t id, int status, const StringPiece &method);
+    // 解析buf开头的一帧 不retrieve 帧长超过maxFrameBytes或者字段不合法返回kError
+    static Result decode(const Buffer *buf, size_t maxFrameBytes, RpcFrame *frame);
+};
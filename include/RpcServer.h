@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "RpcCodec.h"
+
+// 服务端收到的一次调用 视图在方法返回后失效
+struct RpcCall
+{
+    const TcpConnectionPtr &conn; // 延迟回复时保存一份 连同id交给RpcServer::reply
+    uint64_t id;
+    StringPiece method;
+    StringPiece request;
+};
+
+/**
+ * 方法把响应负载写进response 返回kRpcOk或kRpcAppError等状态
+ * 需要异步完成时返回kRpcDeferred 之后在任意线程调用RpcServer::reply
+ */
+using RpcMethod = std::function<int(const RpcCall &call, Buffer *response)>;
+
+/**
+ * RPC服务端 在MessageCallback里逐帧解析请求并分发给注册的方法 方法在连接所属的subloop线程中执行
+ *
+ * 响应合并: 同一次onMessage里的所有响应、同一轮loop里的所有延迟回复
+ *           先追加到连接自己的输出缓冲 每个连接每轮只send一次
+ **/
+class RpcServer : noncopyable
+{
+public:
+    RpcServer(EventLoop *loop,
+              const InetAddress &listenAddr,
+              const std::string &name,
+              TcpServer::Option option = TcpServer::kNoReusePort);
+
+    // 必须在start()之前调用
+    void registerMethod(const std::string &name, const RpcMethod &method);
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 超过这个长度的帧视为协议错误 直接关闭连接
+    void setMaxFrameBytes(size_t bytes) { maxFrameBytes_ = bytes; }
+    TcpServer &tcpServer() { return server_; }
+
+    void start();
+
+    // 回复一个返回了kRpcDeferred的调用 线程安全 连接已经断开时丢弃
+    static void reply(const TcpConnectionPtr &conn, uint64_t id, int status, const StringPiece &response);
+
+    int64_t calls() const { return calls_.load(std::memory_order_relaxed); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    TcpServer server_;
+    std::unordered_map<std::string, RpcMethod> methods_; // start()之后只读
+    size_t maxFrameBytes_;
+    std::atomic<int64_t> calls_;
+};
@@ -1,8 +1,8 @@
 #pragma once
 
 #include "noncopyable.h"
-
-class InetAddress;
+#include "InetAddress.h"
+#include "SocketOptions.h"
 
 // 封装socket fd
 class Socket : noncopyable
@@ -16,7 +16,7 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress &localaddr);
-    void listen();
+    void listen(int backlog = 1024); // 全连接队列最大长度
     int accept(InetAddress *peeraddr);
 
     void shutdownWrite();
@@ -29,3 +29,24 @@ public:
 private:
     const int sockfd_;
 };
+
+// 不属于某个Socket对象的socket工具函数 Connector/TcpServer等共用
+namespace sockets
+{
+// 创建非阻塞的流式socket AF_INET/AF_INET6为TCP AF_UNIX为Unix域 失败直接退出
+int createNonblockingOrDie(sa_family_t family = AF_INET);
+// 非阻塞connect 返回0或-1 错误码在errno中
+int connect(int sockfd, const InetAddress &addr);
+// 读取并清除SO_ERROR 非阻塞connect完成后用来判断是否连接成功
+int getSocketError(int sockfd);
+// SO_INCOMING_CPU 最近一次处理该连接收包的CPU 未知时返回-1
+int getIncomingCpu(int sockfd);
+InetAddress getLocalAddr(int sockfd);
+InetAddress getPeerAddr(int sockfd);
+// 连接本机端口时 内核可能把临时端口分配成目标端口 自己连上了自己
+bool isSelfConnect(int sockfd);
+// 应用SocketOptions中监听socket相关的选项 在listen之前调用
+void applyListenOptions(int sockfd, sa_family_t family, const SocketOptions &options);
+// 应用SocketOptions中已连接socket相关的选项
+void applyConnectionOptions(int sockfd, sa_family_t family, const SocketOptions &options);
+} // namespace sockets
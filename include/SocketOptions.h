@@ -0,0 +1,33 @@
+#pragma once
+
+/**
+ * TcpServer/TcpClient的socket参数配置 所有字段为0(或false)时保持内核默认值
+ *
+ * 监听socket: backlog、deferAcceptSeconds、fastOpenQueue 以及收发缓冲区(accept出来的连接会继承)
+ * 已连接socket: tcpNoDelay、quickAck、keepAlive系列、notSentLowat 以及收发缓冲区
+ *
+ * notSentLowat(TCP_NOTSENT_LOWAT): 内核发送缓冲区里尚未发出的字节数低于该值时才报告可写
+ * 写满之后write直接返回EAGAIN 剩余数据留在TcpConnection的outputBuffer_里
+ * 这样内核里排队的数据很少 后发的小消息不会被排在几MB的大块数据后面 代价是多一些EPOLLOUT唤醒
+ *
+ * rxTimestamps(SO_TIMESTAMPING软件接收时间戳): 读数据改用recvmsg 同时取回内核收到数据的时间
+ * 在MessageCallback中用TcpConnection::receiveTimes()查看 只对明文TCP连接有效
+ *
+ * Unix域socket只应用SOL_SOCKET级别的选项 TCP级别的选项被忽略
+ **/
+struct SocketOptions
+{
+    int backlog = 1024;
+    bool tcpNoDelay = false;
+    int recvBufferSize = 0;      // SO_RCVBUF 字节 要影响窗口扩大因子必须在监听/连接之前设置
+    int sendBufferSize = 0;      // SO_SNDBUF 字节 设置后内核不再自动调整
+    int deferAcceptSeconds = 0;  // TCP_DEFER_ACCEPT 收到第一段数据才唤醒accept
+    int fastOpenQueue = 0;       // TCP_FASTOPEN 等待完成的TFO请求队列长度
+    bool quickAck = false;       // TCP_QUICKACK 内核会自动关闭 每次读完都重新设置
+    bool keepAlive = true;       // SO_KEEPALIVE
+    int keepIdleSeconds = 0;     // TCP_KEEPIDLE
+    int keepIntervalSeconds = 0; // TCP_KEEPINTVL
+    int keepCount = 0;           // TCP_KEEPCNT
+    int notSentLowat = 0;        // TCP_NOTSENT_LOWAT 字节
+    bool rxTimestamps = false;   // SO_TIMESTAMPING 软件接收时间戳
+};
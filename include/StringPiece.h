@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+
+/**
+ * 不拥有内存的字符串视图 C++11没有std::string_view
+ * 只保存指针和长度 指向的内存由别人管理 常用于指向Buffer内部 避免拷贝和分配
+ **/
+class StringPiece
+{
+public:
+    StringPiece() : data_(nullptr), size_(0) {}
+    StringPiece(const char *str) : data_(str), size_(strlen(str)) {}
+    StringPiece(const char *data, size_t len) : data_(data), size_(len) {}
+    StringPiece(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+    char operator[](size_t i) const { return data_[i]; }
+
+    void clear() { data_ = nullptr; size_ = 0; }
+    void set(const char *data, size_t len) { data_ = data; size_ = len; }
+    void removePrefix(size_t n) { data_ += n; size_ -= n; }
+    void removeSuffix(size_t n) { size_ -= n; }
+
+    bool operator==(const StringPiece &other) const
+    {
+        return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+    }
+    bool operator!=(const StringPiece &other) const { return !(*this == other); }
+
+    // 忽略大小写比较 HTTP头部的名字不区分大小写
+    bool equalsIgnoreCase(const StringPiece &other) const
+    {
+        return size_ == other.size_ && strncasecmp(data_, other.data_, size_) == 0;
+    }
+    bool startsWith(const StringPiece &prefix) const
+    {
+        return size_ >= prefix.size_ && memcmp(data_, prefix.data_, prefix.size_) == 0;
+    }
+
+    std::string toString() const { return std::string(data_, size_); }
+
+private:
+    const char *data_;
+    size_t size_;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "TcpConnection.h"
+#include "TlsContext.h"
+
+class Connector;
+class EventLoop;
+
+/**
+ * 用户使用muduo编写客户端程序
+ * 通过Connector非阻塞地连接服务器 连接成功后得到一个和服务端相同的TcpConnection 运行在loop上
+ * 每个TcpClient同一时刻最多一个连接
+ *
+ * enableRetry()之后 连接断开会自动重连 重连失败按指数退避重试
+ * TcpClient必须在loop线程中析构
+ **/
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+              const InetAddress &serverAddr,
+              const std::string &nameArg);
+    ~TcpClient();
+
+    // 线程安全
+    void connect();
+    // 关闭已经建立的连接(等待发送缓冲区发完)
+    void disconnect();
+    // 停止正在进行的连接或重试 不影响已经建立的连接
+    void stop();
+
+    TcpConnectionPtr connection() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    bool retry() const { return retry_; }
+    // 连接断开后自动重连
+    void enableRetry() { retry_ = true; }
+    // 连接失败时的重试间隔 从initRetryDelayMs开始翻倍 最多maxRetryDelayMs 必须在connect()之前调用
+    void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs);
+
+    // 连接建立后应用的socket参数 只有已连接socket相关的选项生效 必须在connect()之前调用
+    void setSocketOptions(const SocketOptions &options) { socketOptions_ = options; hasSocketOptions_ = true; }
+
+    // 连接建立后做TLS握手 serverName用于SNI、证书校验和会话复用 必须在connect()之前调用
+    void setTlsContext(const std::shared_ptr<TlsContext> &context, const std::string &serverName = std::string())
+    {
+        tlsContext_ = context;
+        tlsServerName_ = serverName;
+    }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+private:
+    // Connector连接成功后在loop线程中回调
+    void newConnection(int sockfd);
+    // TcpConnection关闭时在loop线程中回调
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    std::shared_ptr<Connector> connector_;
+    const std::string name_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+
+    SocketOptions socketOptions_;
+    bool hasSocketOptions_; // 没有设置时保持TcpConnection的默认行为
+    std::shared_ptr<TlsContext> tlsContext_; // 为空表示明文
+    std::string tlsServerName_;
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_; // 只在loop线程中使用
+
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 由mutex_保护
+};
@@ -9,10 +9,40 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "SocketOptions.h"
+#include "Metrics.h"
+#include "TcpInfo.h"
 
 class Channel;
 class EventLoop;
 class Socket;
+class LoopMemoryAccount;
+class LoopTcpInfoSampler;
+class TlsContext;
+class TlsStream;
+
+// TcpServer按服务器名注册的连接指标 没有设置时(例如TcpClient的连接)更新的是不导出的空单元
+struct ConnectionMetrics
+{
+    metrics::Counter bytesReceived; // 应用层读到的字节 TLS连接是解密后的
+    metrics::Counter bytesSent;     // 写进内核的字节 包括sendfile
+    metrics::Gauge bufferedBytes;   // inputBuffer_和outputBuffer_中缓存的字节
+    // 开启SocketOptions::rxTimestamps时按loop注册 单位纳秒
+    metrics::Histogram kernelToPoll;   // 内核收到数据到epoll_wait返回
+    metrics::Histogram pollToCallback; // epoll_wait返回到开始调用MessageCallback
+};
+
+/**
+ * 一次读事件的三个时间点 都是CLOCK_REALTIME纳秒 可以直接相减
+ * kernel到poll: 数据在socket接收队列里等loop醒来的时间(loop正忙于其他回调时会变长)
+ * poll到callback: 同一轮epoll_wait返回的其他Channel的回调 加上本次recvmsg
+ **/
+struct ReceiveTimes
+{
+    int64_t kernelNs = 0;   // 内核协议栈收到数据 0表示没有拿到时间戳
+    int64_t pollNs = 0;     // epoll_wait返回 即MessageCallback的receiveTime
+    int64_t callbackNs = 0; // 开始调用MessageCallback
+};
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -33,15 +63,80 @@ public:
     const std::string &name() const { return name_; }
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
+    int fd() const; // 连接的socket 用来查询SO_INCOMING_CPU/TCP_INFO等内核状态
 
     bool connected() const { return state_ == kConnected; }
 
     // 发送数据
     void send(const std::string &buf);
+    // 在loop线程中调用时直接发送不拷贝 其他线程调用时拷贝一份再转到loop线程
+    void send(const void *data, size_t len);
+    // 发送buf中全部可读数据并清空buf 用于复用应用层的输出缓冲 避免每条消息构造std::string
+    void send(Buffer *buf);
     void sendFile(int fileDescriptor, off_t offset, size_t count); 
+    /**
+     * 同上 整段数据交给内核(用户态TLS时是放进outputBuffer_)后在loop线程回调done(true)
+     * 连接断开或者出错时回调done(false) done只回调一次 调用者可以在里面关闭文件
+     * 之后send的数据不会插到文件前面的前提是调用者等done之后再send 例如HTTP的流水线
+     */
+    void sendFile(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done);
     
     // 关闭半连接
     void shutdown();
+    // 不等待outputBuffer_发送完 直接关闭连接
+    void forceClose();
+
+    // 关闭Nagle算法 小消息立即发送
+    void setTcpNoDelay(bool on);
+    // 应用已连接socket的参数 TcpServer/TcpClient在connectEstablished之前调用 也可以在loop线程中随时调用
+    void setSocketOptions(const SocketOptions &options);
+    // 设置了TCP_NOTSENT_LOWAT时的阈值 0表示没有设置
+    int notSentLowat() const { return notSentLowat_; }
+
+    /**
+     * 开启TLS 必须在connectEstablished之前调用(TcpServer/TcpClient设置了TlsContext时自动调用)
+     * 连接建立后先做非阻塞握手 握手完成才回调ConnectionCallback 之前send的数据在握手完成后发出
+     * serverName: 客户端的SNI和证书校验用的主机名 服务端忽略
+     */
+    void startTls(const std::shared_ptr<TlsContext> &context, const std::string &serverName = std::string());
+    bool isTls() const { return tls_ != nullptr; }
+    // TLS连接的状态(版本、cipher、是否复用、kTLS) 只在loop线程中访问 非TLS连接返回nullptr
+    const TlsStream *tlsStream() const { return tls_.get(); }
+
+    // 暂停/恢复监听读事件 用于流控
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    // 接收缓冲区 只能在loop线程中使用 例如在消息回调之外继续解析已经收到的数据
+    Buffer *inputBuffer() { return &inputBuffer_; }
+
+    // 绑定在连接上的应用层状态(协议解析器等) 只在loop线程中访问
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void> &getContext() const { return context_; }
+
+    // 当前inputBuffer_和outputBuffer_中一共缓存的字节数(上一次上报给MemoryBudget和指标的值)
+    size_t bufferedBytes() const { return accountedBytes_; }
+    // outputBuffer_中还没有写进内核的字节 只在loop线程中访问
+    size_t outputBufferBytes() const { return outputBuffer_.readableBytes(); }
+
+    // 立即读取一次TCP_INFO保存到tcpInfo() 非TCP连接返回false 只在loop线程中调用
+    bool sampleTcpInfo();
+    // 最近一次采样(TcpServer::setTcpInfoSampling定期采样或者sampleTcpInfo) 只在loop线程中访问
+    const TcpInfo &tcpInfo() const { return tcpInfo_; }
+
+    // 开启SocketOptions::rxTimestamps时 本次MessageCallback对应的读事件的时间点 只在MessageCallback中有意义
+    const ReceiveTimes &receiveTimes() const { return receiveTimes_; }
+    // 由TcpServer设置 必须在connectEstablished之前调用
+    void setMetrics(const ConnectionMetrics &metrics) { metrics_ = metrics; }
+    // 这个连接的回调CPU时间记到tag下(CpuAccounting::tag) 只在loop线程中调用或者在connectEstablished之前调用
+    void setCpuTag(int tag);
+    // 由TcpServer在开启内存预算时设置 必须在connectEstablished之前调用
+    void setMemoryAccount(const std::shared_ptr<LoopMemoryAccount> &account)
+    { memoryAccount_ = account; }
+    // 由TcpServer在开启TCP_INFO采样时设置 必须在connectEstablished之前调用
+    void setTcpInfoSampler(const std::shared_ptr<LoopTcpInfoSampler> &sampler)
+    { tcpInfoSampler_ = sampler; }
 
     void setConnectionCallback(const ConnectionCallback &cb)
     { connectionCallback_ = cb; }
@@ -73,18 +168,52 @@ private:
     void handleWrite();//处理写事件
     void handleClose();
     void handleError();
+    // 推进TLS握手 完成后回调ConnectionCallback
+    void handleHandshake();
+    // 发送方向需要在用户态加密(TLS且没有kTLS)
+    bool userspaceTls() const;
+    // 和::write相同的语义 用户态TLS时经过SSL_write
+    ssize_t writeSocket(const void *data, size_t len);
 
     void sendInLoop(const void *data, size_t len);
     void shutdownInLoop();
-    void sendFileInLoop(int fileDescriptor, off_t offset, size_t count);
+    void forceCloseInLoop();
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 把缓冲区字节数的变化上报给本loop的LoopMemoryAccount和bufferedBytes指标
+    void updateMemoryUsage();
+    // 记录receiveTimes_并计入指标
+    void recordReceiveTimes(int64_t kernelNs, Timestamp receiveTime);
+    void sendFileInLoop(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done);
+    // 明文连接和kTLS 发到EAGAIN为止 剩下的交给parkFile
+    void sendFileBySendfile(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done);
+    // 没有kTLS时文件内容只能读到用户态加密
+    void sendFileThroughTls(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done);
+    // 记下没发完的文件并关注可写事件 由handleWrite继续发送
+    void parkFile(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done);
+
+    // 用户态TLS发送文件时outputBuffer_超过kTlsFileHighMark就暂停读文件 handleWrite发到kTlsFileLowMark以下再继续
+    static const size_t kTlsFileHighMark = 1024 * 1024;
+    static const size_t kTlsFileLowMark = kTlsFileHighMark / 2;
+    struct PendingFile
+    {
+        int fd;
+        off_t offset;
+        size_t count; // 还没有交给内核(用户态TLS是还没有读进outputBuffer_)的字节
+        SendFileCallback done;
+    };
     EventLoop *loop_; // 这里是baseloop还是subloop由TcpServer中创建的线程数决定 若为多Reactor 该loop_指向subloop 若为单Reactor 该loop_指向baseloop
     const std::string name_;
     std::atomic_int state_; //状态机
     bool reading_;//连接是否在监听读事件
+    bool quickAck_; // 每次读完重新设置TCP_QUICKACK
+    bool rxTimestamps_; // 用recvmsg读取接收时间戳
+    int notSentLowat_;
 
     // Socket Channel 这里和Acceptor类似    Acceptor => mainloop    TcpConnection => subloop
     std::unique_ptr<Socket> socket_;
     std::unique_ptr<Channel> channel_;
+    std::unique_ptr<TlsStream> tls_; // 为空表示明文连接
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
@@ -100,4 +229,14 @@ private:
     // 数据缓冲区
     Buffer inputBuffer_;    // 接收数据的缓冲区
     Buffer outputBuffer_;   // 发送数据的缓冲区 用户send向outputBuffer_发
+
+    std::shared_ptr<void> context_; // 应用层状态
+
+    std::shared_ptr<LoopMemoryAccount> memoryAccount_; // 为空表示没有开启服务器级别的内存预算
+    size_t accountedBytes_; // 已经上报的缓存字节数
+    ConnectionMetrics metrics_;
+    std::shared_ptr<LoopTcpInfoSampler> tcpInfoSampler_; // 为空表示不定期采样
+    TcpInfo tcpInfo_;
+    ReceiveTimes receiveTimes_;
+    std::unique_ptr<PendingFile> pendingFile_; // 暂停中的文件发送 为空表示没有
 };
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+#include "Metrics.h"
+
+class EventLoop;
+
+/**
+ * getsockopt(TCP_INFO)中常用的字段 时间单位都是微秒
+ * 较新的字段在老内核上读不到 保持为0: minRttUs/deliveryRate(4.9) notsentBytes(4.6) bytesAcked(4.1)
+ **/
+struct TcpInfo
+{
+    Timestamp when;        // 采样时间 没有采样过时无效
+    uint32_t state = 0;    // TCP_ESTABLISHED等
+    uint32_t rttUs = 0;    // 平滑RTT
+    uint32_t rttVarUs = 0;
+    uint32_t minRttUs = 0;
+    uint32_t sndMss = 0;
+    uint32_t sndCwnd = 0;      // 拥塞窗口 单位是段
+    uint32_t retransmits = 0;  // 当前这个段连续超时重传的次数 对端失联时持续增长
+    uint32_t totalRetrans = 0; // 连接建立以来重传的段数
+    uint32_t unacked = 0;      // 已经发出还没有确认的段
+    uint32_t lost = 0;
+    uint32_t notsentBytes = 0; // 内核发送队列中还没有发出的字节
+    uint64_t bytesAcked = 0;
+    uint64_t deliveryRate = 0; // 字节/秒 内核估计的最近投递速率
+
+    bool valid() const { return when.valid(); }
+    // 已经发出还没有确认的字节 按段数*MSS估算
+    uint64_t unackedBytes() const { return static_cast<uint64_t>(unacked) * sndMss; }
+};
+
+namespace sockets
+{
+// 读取sockfd的TCP_INFO 不是TCP socket(例如AF_UNIX)时返回false
+bool getTcpInfo(int sockfd, TcpInfo *info);
+} // namespace sockets
+
+/**
+ * TcpServer::setTcpInfoSampling的参数
+ * 每个loop一个定时器 每tick秒采样本loop上 连接数*tick/interval 个连接 轮流进行
+ * 所以每个连接大约interval秒采样一次 每次定时器只做少量getsockopt 不会因为连接多而卡住loop
+ */
+struct TcpInfoOptions
+{
+    double interval = 1.0; // 同一个连接两次采样的间隔(秒)
+    double tick = 0.1;     // 定时器周期(秒)
+    // 发送队列(outputBuffer_加上内核中还没有发出的字节)持续超过slowConsumerBytes达slowConsumerSeconds秒
+    // 就认为是慢消费者 0表示不检查 判断的精度是interval
+    size_t slowConsumerBytes = 0;
+    double slowConsumerSeconds = 10.0;
+};
+
+/**
+ * 每个EventLoop一个 只在所属的loop线程中被访问 和LoopMemoryAccount一样由TcpConnection持有shared_ptr
+ * 采样结果保存在TcpConnection::tcpInfo()中 同时汇总到按服务器标记的指标:
+ *   muduo_tcp_rtt_seconds(直方图) muduo_tcp_retransmits_total muduo_tcp_slow_consumers_total
+ **/
+class LoopTcpInfoSampler : noncopyable, public std::enable_shared_from_this<LoopTcpInfoSampler>
+{
+public:
+    struct Metrics
+    {
+        metrics::Histogram rtt;        // 微秒
+        metrics::Counter retransmits;  // 采样之间totalRetrans的增量
+        metrics::Counter slowConsumers;
+    };
+
+    // cb为空时关闭慢消费者
+    LoopTcpInfoSampler(EventLoop *loop, const TcpInfoOptions &options, const SlowConsumerCallback &cb,
+                       const Metrics &metrics);
+
+    EventLoop *loop() const { return loop_; }
+
+    // 以下方法都必须在loop_线程中调用
+    void add(TcpConnection *conn);
+    void remove(TcpConnection *conn);
+    // 取消定时器 TcpServer析构时调用 之后仍然可以add/remove
+    void stop();
+
+private:
+    struct Entry
+    {
+        TcpConnection *conn;
+        uint32_t totalRetrans; // 上一次采样的值
+        int64_t overSinceNs;   // 发送队列开始超过阈值的时间 0表示没有超过
+        bool reported;         // 这一次超过阈值已经回调过
+    };
+
+    void tick();
+    // 返回true表示这个连接成为了慢消费者
+    bool sample(Entry *entry, int64_t nowNs);
+
+    EventLoop *loop_;
+    const TcpInfoOptions options_;
+    SlowConsumerCallback slowConsumerCallback_;
+    Metrics metrics_;
+
+    std::vector<Entry> entries_;
+    std::unordered_map<TcpConnection *, size_t> index_; // 连接在entries_中的下标
+    size_t next_;      // 下一个要采样的下标
+    double carry_;     // 每次tick应该采样的连接数的小数部分 累积到下一次
+    TimerId timer_;
+    bool stopped_;
+};
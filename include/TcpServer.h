@@ -18,6 +18,11 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "MemoryBudget.h"
+#include "TcpInfo.h"
+#include "SocketOptions.h"
+#include "TlsContext.h"
+#include "Metrics.h"
 
 // 对外的服务器编程使用的类
 class TcpServer
@@ -44,6 +49,59 @@ public:
 
     // 设置底层subloop的个数
     void setThreadNum(int numThreads);
+    // 第i个subloop线程绑定到cpus[i % cpus.size()] 必须在start()之前调用
+    void setThreadCpus(const std::vector<int> &cpus) { threadPool_->setThreadCpus(cpus); }
+
+    /**
+     * 按SO_INCOMING_CPU分发新连接: 把连接交给绑定在内核收包CPU(或同一package上最近的CPU)上的subloop
+     * 收包软中断和loop线程在同一个CPU上 socket相关的数据一直在这个CPU的缓存里
+     * 需要subloop线程绑定了CPU(setThreadCpus或在线程初始化回调里自行绑定) 否则以及CPU未知时回退到轮询
+     */
+    void setIncomingCpuDispatch(bool on) { incomingCpuDispatch_ = on; }
+    // 按收包CPU分发成功的连接数 / 回退到轮询的连接数
+    int64_t incomingCpuHits() const { return incomingCpuHits_.load(std::memory_order_relaxed); }
+    int64_t incomingCpuMisses() const { return incomingCpuMisses_.load(std::memory_order_relaxed); }
+
+    // 监听socket和accept出来的连接使用的socket参数 必须在start()之前调用
+    void setSocketOptions(const SocketOptions &options);
+    const SocketOptions &socketOptions() const { return socketOptions_; }
+
+    // 所有accept出来的连接都做TLS 必须在start()之前调用 context的mode必须是kServer
+    void setTlsContext(const std::shared_ptr<TlsContext> &context) { tlsContext_ = context; }
+    const std::shared_ptr<TlsContext> &tlsContext() const { return tlsContext_; }
+
+    /**
+     * 开启服务器级别的缓冲区内存预算 所有连接的inputBuffer_/outputBuffer_合计超过limitBytes后按policy处理
+     * policy为MemoryBudget::Policy的组合 必须在start()之前调用
+     */
+    void setMemoryBudget(size_t limitBytes,
+                         int policy = MemoryBudget::kPauseReading | MemoryBudget::kRejectNew);
+    // 内存预算相关的指标 没有开启预算时返回空
+    const std::shared_ptr<MemoryBudget> &memoryBudget() const { return memoryBudget_; }
+    // 当前所有连接缓存的字节数(近似值) 没有开启预算时返回0
+    int64_t bufferedBytes() const { return memoryBudget_ ? memoryBudget_->usage() : 0; }
+    /**
+     * 指标按标签 server="<nameArg>" 注册到metrics::Registry 由MetricsServer导出:
+     *   muduo_tcp_connections_total / muduo_tcp_connections_rejected_total / muduo_tcp_connections_active
+     *   muduo_tcp_bytes_received_total / muduo_tcp_bytes_sent_total / muduo_tcp_buffered_bytes
+     *   muduo_acceptor_accepts_total / muduo_acceptor_errors_total
+     *   muduo_tcp_memory_budget_usage_bytes (开启内存预算时)
+     *   muduo_tcp_rx_kernel_to_poll_seconds / muduo_tcp_rx_poll_to_callback_seconds
+     *     (SocketOptions::rxTimestamps 另加标签 loop="<下标>" 按io loop分开)
+     * 同名的TcpServer共用同一组指标
+     */
+
+    /**
+     * 每个loop定期轮流读取本loop上连接的TCP_INFO 结果见TcpConnection::tcpInfo() 必须在start()之前调用
+     * 同时导出 muduo_tcp_rtt_seconds / muduo_tcp_retransmits_total / muduo_tcp_slow_consumers_total
+     * options.slowConsumerBytes非0时检查慢消费者 没有设置SlowConsumerCallback时直接forceClose
+     */
+    void setTcpInfoSampling(const TcpInfoOptions &options);
+    // 慢消费者的处理策略 在连接的loop线程中回调 可以forceClose、降级或者只记录 必须在start()之前调用
+    void setSlowConsumerCallback(const SlowConsumerCallback &cb) { slowConsumerCallback_ = cb; }
+
+    // 这个服务器所有连接的回调CPU时间记到name标签下 见CpuAccounting 必须在start()之前调用
+    void setCpuTag(const std::string &name);
     /**
      * 如果没有监听, 就启动服务器(监听).
      * 多次调用没有副作用.
@@ -57,6 +115,9 @@ private:
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using MemoryAccountMap = std::unordered_map<EventLoop *, std::shared_ptr<LoopMemoryAccount>>;
+    using TcpInfoSamplerMap = std::unordered_map<EventLoop *, std::shared_ptr<LoopTcpInfoSampler>>;
+    using LoopMetricsMap = std::unordered_map<EventLoop *, ConnectionMetrics>;
 
     EventLoop *loop_; // baseloop 用户自定义的loop
 
@@ -76,6 +137,26 @@ private:
     std::atomic_int started_;
     int nextConnId_;
     ConnectionMap connections_; // 保存所有的连接
+
+    SocketOptions socketOptions_;
+    std::shared_ptr<TlsContext> tlsContext_; // 为空表示明文
+    bool incomingCpuDispatch_;
+    std::atomic<int64_t> incomingCpuHits_;
+    std::atomic<int64_t> incomingCpuMisses_;
+    std::shared_ptr<MemoryBudget> memoryBudget_; // 为空表示不限制
+    MemoryAccountMap memoryAccounts_;             // 每个loop一个计数器 start()之后只读
+    bool tcpInfoSampling_;
+    TcpInfoOptions tcpInfoOptions_;
+    SlowConsumerCallback slowConsumerCallback_;
+    TcpInfoSamplerMap tcpInfoSamplers_;           // 每个loop一个 start()之后只读
+
+    metrics::Counter connectionsMetric_; // 交给subloop的连接
+    metrics::Counter rejectedMetric_;    // 因为内存预算拒绝的连接
+    metrics::Gauge activeMetric_;        // connections_.size() 只在baseLoop中更新
+    ConnectionMetrics connectionMetrics_;
+    LoopMetricsMap loopConnectionMetrics_; // 开启rxTimestamps时每个loop一份 start()之后只读
+    int budgetMetricId_; // 内存预算用量的回调仪表 0表示没有
+    int cpuTag_;         // CpuAccounting的标签 默认untagged
 };
 
 //TcpServer：控制面（accept + 管理连接表）在主 loop 线程
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+// 定时器 记录到期时间、回调和重复间隔 由TimerQueue管理
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(s_numCreated_.fetch_add(1) + 1)
+    {
+    }
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器从now开始重新计时
+    void restart(Timestamp now);
+
+    static int64_t numCreated() { return s_numCreated_.load(); }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_; // 重复的间隔 单位秒 <= 0表示只执行一次
+    const bool repeat_;
+    const int64_t sequence_; // 全局唯一的序号 区分地址相同的新旧Timer
+
+    static std::atomic<int64_t> s_numCreated_;
+};
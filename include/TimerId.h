@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+// runAt/runAfter/runEvery的返回值 只用于cancel 可以拷贝
+class TimerId
+{
+public:
+    TimerId()
+        : timer_(nullptr)
+        , sequence_(0)
+    {
+    }
+    TimerId(Timer *timer, int64_t seq)
+        : timer_(timer)
+        , sequence_(seq)
+    {
+    }
+
+    bool valid() const { return timer_ != nullptr; }
+
+private:
+    friend class TimerQueue;
+
+    Timer *timer_;
+    int64_t sequence_;
+};
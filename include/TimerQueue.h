@@ -0,0 +1,56 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+class EventLoop;
+class Timer;
+
+/**
+ * 定时器队列 每个EventLoop一个
+ * 所有定时器共用一个timerfd 总是设置为最早的到期时间 到期后timerfd可读 由loop线程执行到期的回调
+ * 这样定时器和IO事件走同一个epoll_wait 不需要单独的线程
+ **/
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全 可以在其他线程调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+
+private:
+    // 按到期时间排序 到期时间相同时按地址区分
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读 执行所有到期的定时器
+    void handleRead();
+    // 从timers_中取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复定时器重新插入 其余的删除 然后重新设置timerfd
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+    // 返回插入的定时器是不是最早到期的
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;           // 按到期时间排序的定时器
+    ActiveTimerSet activeTimers_; // 和timers_内容相同 按地址排序 用于cancel
+
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_; // 在自己的回调里被取消的重复定时器 不再重新插入
+};
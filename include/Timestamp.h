@@ -1,16 +1,127 @@
 #pragma once
 
-#include <iostream>
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
 
+/**
+ * 墙上时间 微秒精度 用clock_gettime(CLOCK_REALTIME)获取
+ * pollReturnTime()和MessageCallback的receiveTime都是这个类型
+ * 墙上时间可能被NTP或者手动调整 测量时间间隔请用MonotonicTime
+ **/
 class Timestamp
 {
 public:
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
     static Timestamp now();
+    static Timestamp invalid() { return Timestamp(); }
+    static Timestamp fromUnixTime(time_t t, int microseconds = 0)
+    {
+        return Timestamp(static_cast<int64_t>(t) * kMicroSecondsPerSecond + microseconds);
+    }
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+
+    // 2024/01/01 12:00:00.123456
     std::string toString() const;
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    // 格式化到调用者的缓冲区 不分配内存 返回写入的长度(不含'\0') size至少为32
+    // "年/月/日 时:分:秒"部分按秒缓存在线程局部变量中 同一秒内不再调用localtime_r
+    size_t formatTo(char *buf, size_t size, bool showMicroseconds = true) const;
+
+    Timestamp &operator+=(int64_t microseconds)
+    {
+        microSecondsSinceEpoch_ += microseconds;
+        return *this;
+    }
+    Timestamp &operator-=(int64_t microseconds)
+    {
+        microSecondsSinceEpoch_ -= microseconds;
+        return *this;
+    }
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs) { return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch(); }
+inline bool operator>(Timestamp lhs, Timestamp rhs) { return rhs < lhs; }
+inline bool operator<=(Timestamp lhs, Timestamp rhs) { return !(rhs < lhs); }
+inline bool operator>=(Timestamp lhs, Timestamp rhs) { return !(lhs < rhs); }
+inline bool operator==(Timestamp lhs, Timestamp rhs) { return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch(); }
+inline bool operator!=(Timestamp lhs, Timestamp rhs) { return !(lhs == rhs); }
+
+// 加减的单位都是微秒
+inline Timestamp operator+(Timestamp t, int64_t microseconds) { return t += microseconds; }
+inline Timestamp operator-(Timestamp t, int64_t microseconds) { return t -= microseconds; }
+inline int64_t operator-(Timestamp high, Timestamp low) { return high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch(); }
+
+// 两个时间点相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    return static_cast<double>(high - low) / Timestamp::kMicroSecondsPerSecond;
+}
+
+inline Timestamp addTime(Timestamp t, double seconds)
+{
+    return t + static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+}
+
+/**
+ * 单调时钟 纳秒精度 用clock_gettime(CLOCK_MONOTONIC)获取 不受系统时间调整的影响
+ * 只有两个时间点之间的差值有意义 用于测量耗时、计算超时
+ *   MonotonicTime start = MonotonicTime::now();
+ *   ...
+ *   int64_t costUs = (MonotonicTime::now() - start) / 1000;
+ **/
+class MonotonicTime
+{
+public:
+    static const int64_t kNanoSecondsPerSecond = 1000 * 1000 * 1000;
+
+    MonotonicTime() : nanoSeconds_(0) {}
+    explicit MonotonicTime(int64_t nanoSeconds) : nanoSeconds_(nanoSeconds) {}
+
+    static MonotonicTime now()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return MonotonicTime(static_cast<int64_t>(ts.tv_sec) * kNanoSecondsPerSecond + ts.tv_nsec);
+    }
+
+    int64_t nanoSeconds() const { return nanoSeconds_; }
+    int64_t microSeconds() const { return nanoSeconds_ / 1000; }
+    double seconds() const { return static_cast<double>(nanoSeconds_) / kNanoSecondsPerSecond; }
+
+    MonotonicTime &operator+=(int64_t nanoSeconds)
+    {
+        nanoSeconds_ += nanoSeconds;
+        return *this;
+    }
+    MonotonicTime &operator-=(int64_t nanoSeconds)
+    {
+        nanoSeconds_ -= nanoSeconds;
+        return *this;
+    }
+
+private:
+    int64_t nanoSeconds_;
+};
+
+inline bool operator<(MonotonicTime lhs, MonotonicTime rhs) { return lhs.nanoSeconds() < rhs.nanoSeconds(); }
+inline bool operator>(MonotonicTime lhs, MonotonicTime rhs) { return rhs < lhs; }
+inline bool operator<=(MonotonicTime lhs, MonotonicTime rhs) { return !(rhs < lhs); }
+inline bool operator>=(MonotonicTime lhs, MonotonicTime rhs) { return !(lhs < rhs); }
+inline bool operator==(MonotonicTime lhs, MonotonicTime rhs) { return lhs.nanoSeconds() == rhs.nanoSeconds(); }
+inline bool operator!=(MonotonicTime lhs, MonotonicTime rhs) { return !(lhs == rhs); }
+
+// 加减的单位都是纳秒
+inline MonotonicTime operator+(MonotonicTime t, int64_t nanoSeconds) { return t += nanoSeconds; }
+inline MonotonicTime operator-(MonotonicTime t, int64_t nanoSeconds) { return t -= nanoSeconds; }
+inline int64_t operator-(MonotonicTime high, MonotonicTime low) { return high.nanoSeconds() - low.nanoSeconds(); }
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "noncopyable.h"
+
+class EventLoop;
+class TlsSessionCache;
+struct ssl_session_st; // OpenSSL的SSL_SESSION
+
+/**
+ * TLS配置 一个TlsContext对应一个SSL_CTX 可以被多个TcpServer/TcpClient共享
+ * 编译时没有找到OpenSSL(没有定义MUDUO_HAS_OPENSSL)时 available()返回false 构造TlsContext直接退出
+ *
+ * 会话复用: 每个loop一个会话缓存 只在本loop线程中访问 不需要加锁
+ *   服务端: TLS1.3/TLS1.2的session ticket不需要服务端保存状态 关闭ticket(sessionTickets=false)后使用按会话ID查找的缓存
+ *           会话只在创建它的loop中能找到 客户端的重连被分到其他loop时做完整握手
+ *   客户端: 按"serverName@ip:port"保存服务端发来的会话 下次连接同一个服务端时尝试复用 每个会话只用一次
+ *
+ * kTLS: ktls=true并且内核支持(TCP_ULP "tls")时 握手完成后由OpenSSL把发送方向的密钥交给内核
+ *   之后TcpConnection的send/outputBuffer_直接write明文 sendFile直接sendfile 加密在内核中完成 没有用户态拷贝
+ *   内核或OpenSSL不支持时自动回退到SSL_write
+ **/
+class TlsContext : noncopyable
+{
+public:
+    enum Mode
+    {
+        kServer,
+        kClient,
+    };
+
+    struct Options
+    {
+        std::string certFile;            // PEM格式的证书链 服务端必须设置
+        std::string keyFile;             // PEM格式的私钥
+        std::string caFile;              // 校验对端证书用的CA 为空时使用系统默认路径
+        bool verifyPeer = false;         // 客户端校验服务端证书 服务端要求客户端证书
+        bool ktls = true;                // 握手后尝试开启kTLS
+        bool sessionTickets = true;      // 服务端是否发放session ticket
+        size_t sessionCacheSize = 1024;  // 每个loop的会话缓存容量 0表示不缓存
+        long sessionTimeoutSeconds = 300;
+        std::string cipherList;          // TLS1.2及以下的cipher 为空使用OpenSSL默认值
+        std::string cipherSuites;        // TLS1.3的ciphersuites 为空使用OpenSSL默认值
+    };
+
+    // 握手和复用的统计 所有连接共享 任意线程可读
+    struct Stats
+    {
+        std::atomic<int64_t> handshakes{0};    // 完成的握手
+        std::atomic<int64_t> resumed{0};       // 其中复用了会话的
+        std::atomic<int64_t> failed{0};        // 握手失败
+        std::atomic<int64_t> ktlsSend{0};      // 握手后发送方向开启了kTLS的连接
+        std::atomic<int64_t> ktlsRecv{0};      // 握手后接收方向开启了kTLS的连接
+    };
+
+    TlsContext(Mode mode, const Options &options);
+    ~TlsContext();
+
+    // 编译时是否带了OpenSSL
+    static bool available();
+
+    Mode mode() const { return mode_; }
+    const Options &options() const { return options_; }
+    const Stats &stats() const { return stats_; }
+    Stats &mutableStats() { return stats_; }
+
+    // SSL_CTX* 没有OpenSSL时返回nullptr
+    void *nativeHandle() const { return ctx_; }
+
+    // loop的会话缓存 第一次调用时创建 只能在该loop线程中使用返回的指针
+    TlsSessionCache *sessionCache(EventLoop *loop);
+
+private:
+    void loadCertificates();
+
+    const Mode mode_;
+    const Options options_;
+    void *ctx_; // SSL_CTX 头文件里不引入OpenSSL
+    Stats stats_;
+
+    std::mutex mutex_;
+    std::unordered_map<EventLoop *, std::unique_ptr<TlsSessionCache>> caches_;
+};
+
+// 一个loop的TLS会话缓存 LRU淘汰 只在所属loop线程中使用
+class TlsSessionCache : noncopyable
+{
+public:
+    TlsSessionCache(size_t capacity, long timeoutSeconds);
+    ~TlsSessionCache();
+
+    // 保存会话 接管session的一个引用 key已存在时替换
+    void put(const std::string &key, ssl_session_st *session);
+    // 查找未过期的会话 不转移所有权 用于服务端按会话ID查找
+    ssl_session_st *get(const std::string &key);
+    // 取出未过期的会话并从缓存中删除 调用者负责释放 用于客户端(会话只用一次)
+    ssl_session_st *take(const std::string &key);
+
+    size_t size() const { return entries_.size(); }
+    int64_t hits() const { return hits_; }
+    int64_t misses() const { return misses_; }
+
+private:
+    using Entry = std::pair<std::string, ssl_session_st *>;
+    using EntryList = std::list<Entry>;
+
+    // 查找并淘汰过期的会话 没有找到返回entries_.end()
+    EntryList::iterator find(const std::string &key);
+    void erase(EntryList::iterator it);
+
+    const size_t capacity_;
+    const long timeoutSeconds_;
+    EntryList entries_; // 头部是最近使用的
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    int64_t hits_;
+    int64_t misses_;
+};
+
+namespace tls
+{
+// 取出并清空本线程的OpenSSL错误队列 多条错误用"; "连接 TlsContext和TlsStream记录错误日志时共用
+std::string sslErrors();
+} // namespace tls
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+class Buffer;
+class EventLoop;
+class TlsContext;
+class TlsSessionCache;
+
+/**
+ * 一个TLS连接的SSL对象 由TcpConnection持有 只在连接所属的loop线程中使用
+ * 直接绑定在非阻塞socket上(SSL_set_fd) kTLS要求OpenSSL使用socket BIO
+ *
+ * 读写接口和read/write保持一致: 返回字节数 出错返回-1并设置errno
+ * 需要等待socket可读/可写时返回-1 errno为EAGAIN wantWrite()表示下一步需要等可写
+ **/
+class TlsStream : noncopyable
+{
+public:
+    // serverName用于客户端的SNI和会话缓存的key 服务端忽略
+    TlsStream(const std::shared_ptr<TlsContext> &context, EventLoop *loop, int sockfd,
+              const std::string &peerKey, const std::string &serverName);
+    ~TlsStream();
+
+    // 推进握手 完成返回1 需要等待返回0(由wantWrite()决定等读还是等写) 失败返回-1
+    int handshake();
+    bool handshakeDone() const { return handshakeDone_; }
+    bool wantWrite() const { return wantWrite_; }
+
+    // 解密数据追加到buffer 读到对端的close_notify或EOF返回0
+    ssize_t read(Buffer *buffer, int *savedErrno);
+    // 加密发送 可能只发送一部分
+    ssize_t write(const void *data, size_t len, int *savedErrno);
+    // 发送close_notify 不等待对端回复
+    void shutdown();
+
+    // 握手完成后有效
+    bool ktlsSend() const { return ktlsSend_; }
+    bool ktlsRecv() const { return ktlsRecv_; }
+    bool resumed() const { return resumed_; }
+    std::string version() const;
+    std::string cipher() const;
+
+    TlsSessionCache *sessionCache() const { return cache_; }
+    const std::string &peerKey() const { return peerKey_; }
+
+private:
+    void onHandshakeDone();
+
+    std::shared_ptr<TlsContext> context_;
+    TlsSessionCache *cache_; // 所属loop的会话缓存 不缓存时为空
+    const std::string peerKey_;
+    void *ssl_; // SSL
+    bool handshakeDone_;
+    bool wantWrite_;
+    bool ktlsSend_;
+    bool ktlsRecv_;
+    bool resumed_;
+    bool failed_; // 握手或读写出过错 关闭时不保留会话
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+#include "UdpSocket.h"
+
+class Channel;
+class EventLoop;
+class EventLoopThreadPool;
+
+/**
+ * 用户使用muduo编写UDP服务器
+ * 没有连接的概念 也就没有Acceptor: 每个loop各自创建一个UdpSocket 用SO_REUSEPORT绑定同一个地址
+ * 内核按四元组哈希把数据报分到不同的socket上 同一个对端的数据报总是落在同一个loop里
+ * setThreadNum(0)时只有一个socket 在baseLoop上收发
+ *
+ * 每次可读时用recvmmsg批量收取 逐个回调MessageCallback 回调里用socket->queueSendTo()回复
+ * 本轮收取结束后统一flush 一批回复只需要一次sendmmsg
+ **/
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+    // socket是收到该数据报的那个分片的socket 只能在回调所在的loop线程中使用
+    using MessageCallback = std::function<void(UdpSocket *socket, const char *data, size_t len,
+                                               const InetAddress &peer, Timestamp receiveTime)>;
+
+    UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg);
+    ~UdpServer();
+
+    const std::string &name() const { return name_; }
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+
+    // 以下设置必须在start()之前调用
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    void setBatchSize(int batchSize) { batchSize_ = batchSize; }
+    void setRecvBufferSize(int bytes) { recvBufferSize_ = bytes; }
+    // 开启UDP_GRO 内核不支持时退化为普通接收
+    void enableGro(bool on) { gro_ = on; }
+
+    // 线程安全 多次调用没有副作用
+    void start();
+
+    // 所有分片的统计之和 每轮收取结束后更新 近似值
+    int64_t receivedPackets() const { return receivedPackets_.load(std::memory_order_relaxed); }
+    int64_t receivedBytes() const { return receivedBytes_.load(std::memory_order_relaxed); }
+    int64_t sentPackets() const { return sentPackets_.load(std::memory_order_relaxed); }
+    int64_t droppedSends() const { return droppedSends_.load(std::memory_order_relaxed); }
+
+private:
+    // 一个loop上的socket和它的Channel 只在该loop线程中访问
+    struct Shard
+    {
+        EventLoop *loop;
+        std::unique_ptr<UdpSocket> socket;
+        std::unique_ptr<Channel> channel;
+        UdpSocket::Stats reported; // 已经累加到全局计数的值
+    };
+
+    void startShard(EventLoop *loop);
+    void handleRead(Shard *shard, Timestamp receiveTime);
+
+    EventLoop *loop_; // baseloop
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    std::vector<std::shared_ptr<Shard>> shards_; // start()之后只读
+
+    MessageCallback messageCallback_;
+    ThreadInitCallback threadInitCallback_;
+    int numThreads_;
+    int batchSize_;
+    int recvBufferSize_; // 0表示使用系统默认值
+    bool gro_;
+    std::atomic_int started_;
+
+    std::atomic<int64_t> receivedPackets_;
+    std::atomic<int64_t> receivedBytes_;
+    std::atomic<int64_t> sentPackets_;
+    std::atomic<int64_t> droppedSends_;
+};
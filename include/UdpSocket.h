@@ -0,0 +1,109 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+/**
+ * 非阻塞UDP socket 带批量收发用的预分配缓冲区(arena)
+ *
+ * 接收: recvmmsg一次系统调用收batchSize个数据报 每个数据报落在arena中固定大小的槽位里 不做额外拷贝
+ *       开启UDP_GRO后内核会把同一个流的多个数据报合并成一个消息交上来 这里再按gso_size拆开逐个回调
+ * 发送: queueSendTo把数据报拷进发送arena 攒满或者flush()时用sendmmsg一次发出
+ *       sendSegmented用UDP_SEGMENT(GSO)把一大块数据按固定大小切成多个数据报 一次系统调用发给同一个对端
+ *
+ * UDP本身不保证送达 发送时遇到EAGAIN/ENOBUFS直接丢弃并计数 不会像TcpConnection那样缓存重发
+ * 不是线程安全的 只能在一个线程(通常是所属loop线程)中使用
+ **/
+class UdpSocket : noncopyable
+{
+public:
+    // data指向接收arena 只在回调期间有效
+    using DatagramCallback = std::function<void(const char *data, size_t len, const InetAddress &peer, Timestamp receiveTime)>;
+
+    static const int kDefaultBatchSize = 64;
+    static const size_t kDefaultSlotSize = 2048;  // 以太网MTU下的数据报都放得下
+    static const size_t kGroSlotSize = 65536;     // GRO合并后的消息最大64KB
+    static const int kMaxGsoSegments = 64;        // 老内核UDP_MAX_SEGMENTS为64
+
+    struct Stats
+    {
+        int64_t received = 0;      // 收到的数据报个数(GRO拆分之后)
+        int64_t receivedBytes = 0;
+        int64_t recvCalls = 0;     // recvmmsg调用次数
+        int64_t truncated = 0;     // 槽位放不下被截断的数据报
+        int64_t sent = 0;          // 发出的数据报个数(GSO切分之后)
+        int64_t sendCalls = 0;     // sendto/sendmmsg/sendmsg调用次数
+        int64_t sendDropped = 0;   // 发送失败丢弃的数据报个数
+    };
+
+    // family为AF_INET或AF_INET6
+    explicit UdpSocket(int batchSize = kDefaultBatchSize, size_t slotSize = kDefaultSlotSize,
+                       sa_family_t family = AF_INET);
+    ~UdpSocket();
+
+    int fd() const { return sockfd_; }
+    int batchSize() const { return batchSize_; }
+    size_t slotSize() const { return slotSize_; }
+
+    void bindAddress(const InetAddress &addr);
+    void setReuseAddr(bool on);
+    void setReusePort(bool on);
+    void setRecvBufferSize(int bytes);
+    void setSendBufferSize(int bytes);
+    // 开启UDP_GRO 接收槽位扩大到kGroSlotSize 内核不支持时返回false
+    bool enableGro(bool on);
+    bool groEnabled() const { return gro_; }
+
+    // 收取已经到达的数据报 直到EAGAIN或者收满maxBatches轮 返回回调的数据报个数
+    int receive(const DatagramCallback &cb, int maxBatches = 8);
+
+    // 立即发送一个数据报 失败返回false并计入sendDropped
+    bool sendTo(const void *data, size_t len, const InetAddress &peer);
+    // 放入发送队列 队列满时自动flush 超过构造时slotSize的数据报直接sendTo
+    void queueSendTo(const void *data, size_t len, const InetAddress &peer);
+    // 用sendmmsg发出队列中所有数据报 返回发出的个数
+    int flush();
+    int pendingSends() const { return pendingSends_; }
+    // 把data按segmentSize切成多个数据报发给peer 内核支持GSO时每次系统调用最多kMaxGsoSegments个
+    // 不支持时退化成queueSendTo + flush 之前排队的数据报先发出 不算在这次的结果里
+    // 这次的分段全部交给内核才返回true len为0时返回true
+    bool sendSegmented(const void *data, size_t len, size_t segmentSize, const InetAddress &peer);
+    bool gsoSupported() const { return gsoSupported_; }
+    // 之后的sendSegmented都走queueSendTo + flush 内核不支持UDP_SEGMENT时也会自动关闭
+    void disableGso() { gsoSupported_ = false; }
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    void setupRecvArena();
+
+    const int sockfd_;
+    const int batchSize_;
+    size_t slotSize_;           // 接收槽位大小 开启GRO后变大
+    const size_t sendSlotSize_; // 发送槽位大小 固定为构造时的slotSize
+    bool gro_;
+    bool gsoSupported_;
+
+    // 接收arena: batchSize_个槽位 每个槽位一个iovec/对端地址/控制消息
+    std::vector<char> recvBuffer_;
+    std::vector<struct mmsghdr> recvMsgs_;
+    std::vector<struct iovec> recvIovecs_;
+    std::vector<sockaddr_in6> recvAddrs_; // IPv4地址也放得下
+    std::vector<char> recvControl_;
+
+    // 发送arena
+    std::vector<char> sendBuffer_;
+    std::vector<struct mmsghdr> sendMsgs_;
+    std::vector<struct iovec> sendIovecs_;
+    std::vector<sockaddr_in6> sendAddrs_;
+    int pendingSends_;
+
+    Stats stats_;
+};
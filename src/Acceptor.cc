@@ -6,10 +6,12 @@
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "Probes.h"
+#include "CpuAccounting.h"
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, family == AF_UNIX ? 0 : IPPROTO_TCP);
     if (sockfd < 0)
     {
         LOG_FATAL("%s:%s:%d listen socket create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
@@ -19,29 +21,55 @@ static int createNonblocking()
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop)
-    , acceptSocket_(createNonblocking())
+    , listenAddr_(listenAddr)
+    , acceptSocket_(createNonblocking(listenAddr.family()))
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if (listenAddr.isUnix())
+    {
+        // 上次退出时残留的socket文件会让bind失败 抽象命名没有文件
+        if (!listenAddr.isAbstract())
+        {
+            ::unlink(listenAddr.toIp().c_str());
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(true);
+    }
     acceptSocket_.bindAddress(listenAddr);
     // TcpServer::start() => Acceptor.listen() 如果有新用户连接 要执行一个回调(accept => connfd => 打包成Channel => 唤醒subloop)
     // baseloop监听到有事件发生 => acceptChannel_(listenfd) => 执行该回调函数
     acceptChannel_.setReadCallback(
         std::bind(&Acceptor::handleRead, this));
+    acceptChannel_.setLabel("Acceptor");
+    acceptChannel_.setCpuTag(CpuAccounting::tag("accept"));
 }
 
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();    // 把从Poller中感兴趣的事件删除掉
     acceptChannel_.remove();        // 调用EventLoop->removeChannel => Poller->removeChannel 把Poller的ChannelMap对应的部分删除
+    if (listenAddr_.isUnix() && !listenAddr_.isAbstract())
+    {
+        ::unlink(listenAddr_.toIp().c_str());
+    }
+}
+
+void Acceptor::setMetricLabels(const std::string &labels)
+{
+    metrics::Registry &registry = metrics::Registry::instance();
+    acceptsMetric_ = registry.counter("muduo_acceptor_accepts_total", "Sockets accepted.", labels);
+    acceptErrorsMetric_ = registry.counter("muduo_acceptor_errors_total", "Failed accept calls.", labels);
 }
 
 void Acceptor::listen()
 {
     listenning_ = true;
-    acceptSocket_.listen();         // listen
+    sockets::applyListenOptions(acceptSocket_.fd(), listenAddr_.family(), options_);
+    acceptSocket_.listen(options_.backlog); // listen
     acceptChannel_.enableReading(); // acceptChannel_注册至Poller !重要
 }
 
@@ -50,8 +78,10 @@ void Acceptor::handleRead()
 {
     InetAddress peerAddr; // 用于接收新连接的客户端地址信息
     int connfd = acceptSocket_.accept(&peerAddr);
+    MUDUO_PROBE3(accept, acceptSocket_.fd(), connfd, connfd < 0 ? errno : 0);
     if (connfd >= 0)
     {
+        acceptsMetric_.inc();
         if (NewConnectionCallback_)
         {
             NewConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop 唤醒并分发当前的新客户端的Channel
@@ -63,6 +93,7 @@ void Acceptor::handleRead()
     }
     else
     {
+        acceptErrorsMetric_.inc();
         LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
         if (errno == EMFILE)
         {
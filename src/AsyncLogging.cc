@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+
+#include "AsyncLogging.h"
+#include "LogFile.h"
+
+/**
+ * 单生产者(写日志的业务线程)单消费者(后台线程)的环形缓冲区
+ * head_/tail_是单调递增的字节位置 取模后才是数组下标 used = tail_ - head_
+ * 生产者只写tail_ 消费者只写head_ 所以不需要锁 两者之间用acquire/release同步数据
+ **/
+class AsyncLogging::StagingBuffer : noncopyable
+{
+public:
+    explicit StagingBuffer(size_t capacity)
+        : data_(new char[capacity])
+        , capacity_(capacity)
+        , head_(0)
+        , tail_(0)
+        , retired_(false)
+    {
+    }
+
+    // 生产者调用 空间不够整行丢弃 返回写入后的占用字节数 失败返回0
+    size_t write(const char *logline, size_t len)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        if (capacity_ - (tail - head) < len)
+        {
+            return 0;
+        }
+        size_t offset = tail % capacity_;
+        size_t first = std::min(len, capacity_ - offset); // 可能需要绕回数组开头
+        ::memcpy(data_.get() + offset, logline, first);
+        ::memcpy(data_.get(), logline + first, len - first);
+        tail_.store(tail + len, std::memory_order_release);
+        return tail + len - head;
+    }
+
+    // 消费者调用 把当前所有数据追加到out中
+    size_t drainTo(std::vector<char> *out)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t len = tail - head;
+        if (len > 0)
+        {
+            size_t offset = head % capacity_;
+            size_t first = std::min(len, capacity_ - offset);
+            out->insert(out->end(), data_.get() + offset, data_.get() + offset + first);
+            out->insert(out->end(), data_.get(), data_.get() + (len - first));
+            head_.store(tail, std::memory_order_release);
+        }
+        return len;
+    }
+
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+    // 线程退出时调用 后台线程把剩余数据写完后就会释放这块暂存区
+    void retire() { retired_.store(true, std::memory_order_release); }
+    bool retired() const { return retired_.load(std::memory_order_acquire); }
+
+private:
+    std::unique_ptr<char[]> data_;
+    const size_t capacity_;
+    std::atomic<size_t> head_; // 消费者的读位置
+    char pad_[64];             // 隔开head_和tail_ 避免生产者和消费者之间的伪共享
+    std::atomic<size_t> tail_; // 生产者的写位置
+    std::atomic_bool retired_;
+};
+
+namespace
+{
+std::atomic_int s_nextId(1);
+
+// 默认的文本格式 没有文件头 丢弃提示也是一行文本
+class TextLogFormat : public LogFormat
+{
+public:
+    void beforeBatch(bool, std::vector<char> *) override {}
+
+    void droppedNote(int64_t dropped, std::vector<char> *out) override
+    {
+        char msg[128];
+        int n = snprintf(msg, sizeof msg, "Dropped %ld log lines because staging buffers were full\n", dropped);
+        out->insert(out->end(), msg, msg + n);
+    }
+};
+
+// 每个线程最多同时给这么多个AsyncLogging实例保留暂存区 都占满后轮流替换
+const int kLocalSlots = 4;
+} // namespace
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                           off_t rollSize,
+                           int flushInterval,
+                           size_t stagingBytes,
+                           int rollInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , stagingBytes_(stagingBytes)
+    , rollInterval_(rollInterval)
+    , id_(s_nextId.fetch_add(1))
+    , format_(std::make_shared<TextLogFormat>())
+    , running_(false)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , wakeupPending_(false)
+    , flushRequested_(0)
+    , flushCompleted_(0)
+    , droppedLines_(0)
+    , writtenBytes_(0)
+{
+    batch_.reserve(4 * 1024 * 1024);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join(); // 后台线程退出前会把所有暂存区写完
+}
+
+AsyncLogging::StagingBuffer *AsyncLogging::localBuffer()
+{
+    struct LocalSlot
+    {
+        int owner;
+        StagingBufferPtr buffer;
+        LocalSlot() : owner(0) {}
+        ~LocalSlot()
+        {
+            if (buffer)
+            {
+                buffer->retire();
+            }
+        }
+    };
+    thread_local LocalSlot t_slots[kLocalSlots];
+    thread_local int t_nextEvict = 0;
+
+    for (LocalSlot &slot : t_slots)
+    {
+        if (__builtin_expect(slot.owner == id_, 1))
+        {
+            return slot.buffer.get();
+        }
+    }
+
+    // 本线程第一次写这个AsyncLogging(或者它的暂存区被替换过) 先找空槽 都占满时才替换
+    LocalSlot *slot = nullptr;
+    for (LocalSlot &candidate : t_slots)
+    {
+        if (candidate.owner == 0)
+        {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (slot == nullptr)
+    {
+        slot = &t_slots[t_nextEvict];
+        t_nextEvict = (t_nextEvict + 1) % kLocalSlots;
+        slot->buffer->retire();
+    }
+    slot->buffer = std::make_shared<StagingBuffer>(stagingBytes_);
+    slot->owner = id_;
+    std::unique_lock<std::mutex> lock(mutex_);
+    buffers_.push_back(slot->buffer);
+    return slot->buffer.get();
+}
+
+void AsyncLogging::append(const char *logline, size_t len)
+{
+    StagingBuffer *buffer = localBuffer();
+    size_t used = buffer->write(logline, len);
+    if (used == 0)
+    {
+        droppedLines_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // 暂存区过半才提醒后台线程 平时后台线程按flushInterval_定时醒来
+    if (used > buffer->capacity() / 2 && !wakeupPending_.load(std::memory_order_relaxed) &&
+        !wakeupPending_.exchange(true))
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.notify_one();
+    }
+}
+
+void AsyncLogging::flush()
+{
+    if (!running_)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    int64_t target = ++flushRequested_;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [this, target]() { return flushCompleted_ >= target || !running_; });
+}
+
+size_t AsyncLogging::collect(std::vector<StagingBufferPtr> &buffers)
+{
+    size_t total = 0;
+    for (const StagingBufferPtr &buffer : buffers)
+    {
+        total += buffer->drainTo(&batch_);
+    }
+    return total;
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_, rollInterval_);
+    std::vector<StagingBufferPtr> buffers;
+    int64_t reportedDrops = 0;
+    int64_t flushed = 0;
+    int filesSeen = 0;
+    std::vector<char> prefix;
+
+    while (true)
+    {
+        int64_t flushTarget = 0;
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (running_ && flushRequested_ == flushCompleted_ && !wakeupPending_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(std::max(flushInterval_, 1)));
+            }
+            wakeupPending_ = false;
+            flushTarget = flushRequested_;
+            stopping = !running_;
+            buffers = buffers_; // 拷贝一份快照 收集数据时不持有锁
+        }
+
+        collect(buffers);
+
+        int64_t dropped = droppedLines_.load(std::memory_order_relaxed);
+        if (dropped != reportedDrops)
+        {
+            format_->droppedNote(dropped - reportedDrops, &batch_);
+            reportedDrops = dropped;
+        }
+
+        // LogFile只在append之后滚动 新文件打开时还是空的
+        // 文件头和这一批数据必须用同一次append写出 分两次写的话中间可能滚动 新文件就以日志记录开头了
+        bool newFile = output.fileCount() != filesSeen;
+        if (!batch_.empty() || newFile)
+        {
+            format_->beforeBatch(newFile, &prefix);
+            filesSeen = output.fileCount();
+            if (!prefix.empty())
+            {
+                batch_.insert(batch_.begin(), prefix.begin(), prefix.end());
+                prefix.clear();
+            }
+        }
+        if (!batch_.empty())
+        {
+            output.append(batch_.data(), batch_.size());
+            writtenBytes_.fetch_add(static_cast<int64_t>(batch_.size()), std::memory_order_relaxed);
+            batch_.clear();
+        }
+        if (stopping || flushTarget != flushed)
+        {
+            output.flush();
+            flushed = flushTarget;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // 线程已经退出并且数据都写完的暂存区可以释放了
+            // 保持加入的顺序 同一个线程被替换掉的旧暂存区总排在新暂存区前面 收集时先写出
+            buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                          [](const StagingBufferPtr &buffer) {
+                                              return buffer->retired() && buffer->empty();
+                                          }),
+                           buffers_.end());
+            flushCompleted_ = flushTarget;
+        }
+        flushedCond_.notify_all();
+        buffers.clear();
+
+        if (stopping)
+        {
+            break;
+        }
+    }
+    output.flush();
+}
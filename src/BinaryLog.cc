@@ -0,0 +1,113 @@
+#include "BinaryLog.h"
+#include "AsyncLogging.h"
+
+namespace
+{
+void appendBytes(std::vector<char> *out, const void *data, size_t len)
+{
+    const char *p = static_cast<const char *>(data);
+    out->insert(out->end(), p, p + len);
+}
+
+void appendString(std::vector<char> *out, const char *s)
+{
+    uint32_t len = static_cast<uint32_t>(::strlen(s));
+    appendBytes(out, &len, sizeof len);
+    appendBytes(out, s, len);
+}
+
+void appendHeader(std::vector<char> *out, uint32_t siteId, uint32_t payloadLen)
+{
+    char header[binlog::kRecordHeaderSize];
+    binlog::encodeHeader(header, siteId, payloadLen, binlog::nowNanos(), CurrentThread::tid());
+    appendBytes(out, header, sizeof header);
+}
+
+/**
+ * 二进制日志的文件格式
+ * 新文件: 写文件头和目前所有的调用点定义 保证每个文件都能单独解码
+ * 每批数据之前: 补写上一批之后新注册的调用点 这批数据里用到的调用点一定在这之前注册好了
+ **/
+class BinaryLogFormat : public LogFormat
+{
+public:
+    BinaryLogFormat() : writtenSites_(0) {}
+
+    void beforeBatch(bool newFile, std::vector<char> *out) override
+    {
+        if (newFile)
+        {
+            appendBytes(out, binlog::kMagic, sizeof binlog::kMagic);
+            writtenSites_ = 0;
+        }
+        std::vector<BinaryLog::Site> sites = BinaryLog::instance().sitesFrom(writtenSites_);
+        for (const BinaryLog::Site &site : sites)
+        {
+            BinaryLog::encodeSite(site, out);
+        }
+        writtenSites_ += sites.size();
+    }
+
+    void droppedNote(int64_t dropped, std::vector<char> *out) override
+    {
+        appendHeader(out, binlog::kDroppedNote, sizeof dropped);
+        appendBytes(out, &dropped, sizeof dropped);
+    }
+
+private:
+    size_t writtenSites_; // 当前文件里已经写过定义的调用点个数
+};
+} // namespace
+
+BinaryLog &BinaryLog::instance()
+{
+    static BinaryLog log;
+    return log;
+}
+
+void BinaryLog::attach(AsyncLogging *log)
+{
+    log->setFormat(std::make_shared<BinaryLogFormat>());
+    instance().setOutput([log](const char *record, size_t len) { log->append(record, len); });
+}
+
+uint32_t BinaryLog::registerSite(std::atomic<uint32_t> *site, int level, const char *file, int line,
+                                 const char *fmt, const char *signature)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 多个线程可能同时第一次执行同一个调用点 只注册一次
+    uint32_t id = site->load(std::memory_order_relaxed);
+    if (id == 0)
+    {
+        id = binlog::kFirstSiteId + static_cast<uint32_t>(sites_.size());
+        sites_.push_back(Site{id, level, line, file, fmt, signature});
+        site->store(id, std::memory_order_release);
+    }
+    return id;
+}
+
+std::vector<BinaryLog::Site> BinaryLog::sitesFrom(size_t from) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (from >= sites_.size())
+    {
+        return std::vector<Site>();
+    }
+    return std::vector<Site>(sites_.begin() + from, sites_.end());
+}
+
+void BinaryLog::encodeSite(const Site &site, std::vector<char> *out)
+{
+    std::vector<char> payload;
+    int32_t level = site.level;
+    int32_t line = site.line;
+    appendBytes(&payload, &site.id, sizeof site.id);
+    appendBytes(&payload, &level, sizeof level);
+    appendBytes(&payload, &line, sizeof line);
+    appendString(&payload, site.file);
+    appendString(&payload, site.format);
+    appendString(&payload, site.signature);
+
+    appendHeader(out, binlog::kSiteDefinition, static_cast<uint32_t>(payload.size()));
+    out->insert(out->end(), payload.begin(), payload.end());
+}
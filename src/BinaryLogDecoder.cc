@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "BinaryLogDecoder.h"
+#include "BinaryLog.h"
+#include "Logger.h"
+
+// 按顺序读取payload中的字段 越界后所有读取都失败
+class BinaryLogDecoder::Reader
+{
+public:
+    Reader(const char *data, size_t len) : data_(data), len_(len), pos_(0) {}
+
+    template <typename T>
+    bool read(T *v)
+    {
+        if (len_ - pos_ < sizeof(T))
+        {
+            pos_ = len_;
+            return false;
+        }
+        ::memcpy(v, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string *s)
+    {
+        uint32_t n = 0;
+        if (!read(&n) || len_ - pos_ < n)
+        {
+            pos_ = len_;
+            return false;
+        }
+        s->assign(data_ + pos_, n);
+        pos_ += n;
+        return true;
+    }
+
+private:
+    const char *data_;
+    size_t len_;
+    size_t pos_;
+};
+
+static void formatTime(uint64_t nanos, std::string *out)
+{
+    time_t seconds = static_cast<time_t>(nanos / 1000000000);
+    struct tm tm_time;
+    ::localtime_r(&seconds, &tm_time);
+    char buf[64];
+    snprintf(buf, sizeof buf, "%4d/%02d/%02d %02d:%02d:%02d.%09lu",
+             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec,
+             static_cast<unsigned long>(nanos % 1000000000));
+    out->append(buf);
+}
+
+BinaryLogDecoder::BinaryLogDecoder(const LineCallback &lineCb, const ErrorCallback &errorCb)
+    : lineCallback_(lineCb)
+    , errorCallback_(errorCb)
+    , lines_(0)
+    , unknownSites_(0)
+{
+}
+
+bool BinaryLogDecoder::decode(const char *data, size_t len)
+{
+    if (len < sizeof binlog::kMagic || ::memcmp(data, binlog::kMagic, sizeof binlog::kMagic) != 0)
+    {
+        error("not a binary log file");
+        return false;
+    }
+    size_t pos = sizeof binlog::kMagic;
+    std::string line;
+    while (len - pos >= binlog::kRecordHeaderSize)
+    {
+        uint32_t siteId = 0;
+        uint32_t payloadLen = 0;
+        uint64_t timestamp = 0;
+        int32_t tid = 0;
+        const char *p = data + pos;
+        ::memcpy(&siteId, p, 4);
+        ::memcpy(&payloadLen, p + 4, 4);
+        ::memcpy(&timestamp, p + 8, 8);
+        ::memcpy(&tid, p + 16, 4);
+        pos += binlog::kRecordHeaderSize;
+        if (len - pos < payloadLen)
+        {
+            error("truncated record at offset %lu", pos - binlog::kRecordHeaderSize);
+            return false;
+        }
+        Reader payload(data + pos, payloadLen);
+        pos += payloadLen;
+
+        if (siteId == binlog::kSiteDefinition)
+        {
+            defineSite(payload);
+            continue;
+        }
+
+        line.clear();
+        if (siteId == binlog::kDroppedNote)
+        {
+            int64_t dropped = 0;
+            payload.read(&dropped);
+            char msg[128];
+            snprintf(msg, sizeof msg, "Dropped %ld log lines because staging buffers were full\n", dropped);
+            line = msg;
+            ++lines_;
+            lineCallback_(line);
+            continue;
+        }
+
+        std::map<uint32_t, SiteInfo>::const_iterator it = sites_.find(siteId);
+        if (it == sites_.end())
+        {
+            ++unknownSites_;
+            error("unknown site %u at offset %lu", siteId, pos - payloadLen);
+            continue;
+        }
+        const SiteInfo &site = it->second;
+        line.append(Logger::levelName(site.level));
+        formatTime(timestamp, &line);
+        char tidbuf[32];
+        snprintf(tidbuf, sizeof tidbuf, " %d : ", tid);
+        line.append(tidbuf);
+        formatMessage(site, payload, &line);
+        ++lines_;
+        lineCallback_(line);
+    }
+    if (pos != len)
+    {
+        error("%lu trailing bytes ignored", len - pos);
+    }
+    return true;
+}
+
+void BinaryLogDecoder::defineSite(Reader &payload)
+{
+    uint32_t id = 0;
+    SiteInfo site;
+    int32_t level = 0;
+    int32_t line = 0;
+    if (payload.read(&id) && payload.read(&level) && payload.read(&line) &&
+        payload.readString(&site.file) && payload.readString(&site.format) && payload.readString(&site.signature))
+    {
+        site.level = level;
+        site.line = line;
+        sites_[id] = site;
+    }
+}
+
+/**
+ * 按格式串还原消息 每遇到一个转换说明就按参数类型串取出下一个参数
+ * 长度修饰符(l/ll/z等)以参数类型串为准重新生成 所以格式串和实参类型不完全一致时也能正确输出
+ **/
+void BinaryLogDecoder::formatMessage(const SiteInfo &site, Reader &args, std::string *out) const
+{
+    const char *fmt = site.format.c_str();
+    size_t argIndex = 0;
+    char buf[256];
+    while (*fmt)
+    {
+        if (*fmt != '%')
+        {
+            out->push_back(*fmt++);
+            continue;
+        }
+        if (fmt[1] == '%')
+        {
+            out->push_back('%');
+            fmt += 2;
+            continue;
+        }
+        // 标志、宽度、精度原样保留
+        const char *start = fmt++;
+        while (*fmt && strchr("-+ #0123456789.", *fmt))
+        {
+            ++fmt;
+        }
+        std::string spec(start, fmt);
+        while (*fmt && strchr("hlqjztL", *fmt))
+        {
+            ++fmt;
+        }
+        char conv = *fmt ? *fmt++ : 's';
+
+        if (argIndex >= site.signature.size())
+        {
+            out->append(start, fmt); // 参数不够 原样输出
+            continue;
+        }
+        char type = site.signature[argIndex++];
+        int n = 0;
+        switch (type)
+        {
+        case binlog::kInt32:
+        case binlog::kInt64:
+        {
+            int64_t v = 0;
+            if (type == binlog::kInt32)
+            {
+                int32_t v32 = 0;
+                args.read(&v32);
+                v = v32;
+            }
+            else
+            {
+                args.read(&v);
+            }
+            if (strchr("diouxXc", conv))
+            {
+                n = snprintf(buf, sizeof buf, (spec + (conv == 'c' ? "" : "ll") + conv).c_str(), static_cast<long long>(v));
+            }
+            else
+            {
+                n = snprintf(buf, sizeof buf, "%lld", static_cast<long long>(v));
+            }
+            break;
+        }
+        case binlog::kUInt32:
+        case binlog::kUInt64:
+        case binlog::kPointer:
+        {
+            uint64_t v = 0;
+            if (type == binlog::kUInt32)
+            {
+                uint32_t v32 = 0;
+                args.read(&v32);
+                v = v32;
+            }
+            else
+            {
+                args.read(&v);
+            }
+            if (conv == 'p' || type == binlog::kPointer)
+            {
+                n = snprintf(buf, sizeof buf, "0x%llx", static_cast<unsigned long long>(v));
+            }
+            else if (strchr("diouxXc", conv))
+            {
+                n = snprintf(buf, sizeof buf, (spec + (conv == 'c' ? "" : "ll") + conv).c_str(), static_cast<unsigned long long>(v));
+            }
+            else
+            {
+                n = snprintf(buf, sizeof buf, "%llu", static_cast<unsigned long long>(v));
+            }
+            break;
+        }
+        case binlog::kDouble:
+        {
+            double v = 0;
+            args.read(&v);
+            n = snprintf(buf, sizeof buf, strchr("eEfFgGaA", conv) ? (spec + conv).c_str() : "%g", v);
+            break;
+        }
+        case binlog::kString:
+        {
+            std::string s;
+            args.readString(&s);
+            if (spec.size() == 1) // 没有宽度和精度 直接追加 不受buf长度限制
+            {
+                out->append(s);
+                continue;
+            }
+            n = snprintf(buf, sizeof buf, (spec + 's').c_str(), s.c_str());
+            break;
+        }
+        default:
+            n = snprintf(buf, sizeof buf, "<bad arg type %c>", type);
+            break;
+        }
+        if (n > 0)
+        {
+            out->append(buf, std::min(static_cast<size_t>(n), sizeof buf - 1));
+        }
+    }
+    if (out->empty() || out->back() != '\n')
+    {
+        out->push_back('\n');
+    }
+}
+
+void BinaryLogDecoder::error(const char *fmt, ...) const
+{
+    if (!errorCallback_)
+    {
+        return;
+    }
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof buf, fmt, args);
+    va_end(args);
+    errorCallback_(buf);
+}
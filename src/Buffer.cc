@@ -1,6 +1,9 @@
 #include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <linux/errqueue.h> // scm_timestamping
 
 #include "Buffer.h"
 
@@ -15,7 +18,7 @@
 ssize_t Buffer::readFd(int fd, int *saveErrno)
 {
     // 栈额外空间，用于从套接字往出读时，当buffer_暂时不够用时暂存数据，待buffer_重新分配足够空间后，在把数据交换给buffer_。
-    char extrabuf[65536] = {0}; // 栈上内存空间 65536/1024 = 64KB
+    char extrabuf[65536]; // 栈上内存空间 65536/1024 = 64KB 只读入不读出 不需要清零
 
     /*
     struct iovec {
@@ -58,6 +61,54 @@ ssize_t Buffer::readFd(int fd, int *saveErrno)
     return n;
 }
 
+// 和readFd(fd, saveErrno)相同的两块缓冲区 额外带上接收控制消息的空间
+ssize_t Buffer::readFd(int fd, int *saveErrno, int64_t *rxTimeNs)
+{
+    char extrabuf[65536];
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof(extrabuf);
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = (writable < sizeof(extrabuf)) ? 2 : 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    const ssize_t n = ::recvmsg(fd, &msg, 0);
+
+    *rxTimeNs = 0;
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+        {
+            struct scm_timestamping tss;
+            ::memcpy(&tss, CMSG_DATA(cmsg), sizeof tss); // CMSG_DATA不保证对齐
+            *rxTimeNs = static_cast<int64_t>(tss.ts[0].tv_sec) * 1000000000 + tss.ts[0].tv_nsec; // ts[0]是软件时间戳
+        }
+    }
+    if (static_cast<size_t>(n) <= writable)
+    {
+        writerIndex_ += n;
+    }
+    else
+    {
+        writerIndex_ = buffer_.size();
+        append(extrabuf, n - writable);
+    }
+    return n;
+}
+
 // inputBuffer_.readFd表示将对端数据读到inputBuffer_中，移动writerIndex_指针
 // 表示将 outputBuffer_ 中的数据（从 readerIndex_ 开始）发送给 Socket (Fd)，它不负责移动 readerIndex_
 ssize_t Buffer::writeFd(int fd, int *saveErrno)
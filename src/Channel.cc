@@ -3,6 +3,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "Probes.h"
 
 const int Channel::kNoneEvent = 0; //空事件
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI; //读事件、优先级读事件（带外数据）
@@ -15,6 +16,8 @@ Channel::Channel(EventLoop *loop, int fd)
     , events_(0)
     , revents_(0)
     , index_(-1)
+    , label_(nullptr)
+    , cpuTag_(0)
     , tied_(false)
 {
 }
@@ -66,6 +69,7 @@ void Channel::remove()
 
 void Channel::handleEvent(Timestamp receiveTime)
 {
+    MUDUO_PROBE2(channel_event_enter, fd_, revents_);
     if (tied_)
     {
         std::shared_ptr<void> guard = tie_.lock();
@@ -79,17 +83,19 @@ void Channel::handleEvent(Timestamp receiveTime)
     {
         handleEventWithGuard(receiveTime);
     }
+    MUDUO_PROBE0(channel_event_return); // 回调里可能已经销毁了this 不能再读成员
 }
 
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    LOG_DEBUG("channel handleEvent revents:%d\n", revents_);
     // 关闭：// 当TcpConnection对应Channel 通过shutdown 关闭写端 epoll触发EPOLLHUP，同时防止丢失数据
     // 优先级：读数据 (Read) > 处理关闭 (Close)
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)) 
     {
         if (closeCallback_)
         {
+            loop_->noteCallback(LoopActivity::kCloseCallback);
             closeCallback_();
         }
     }
@@ -98,6 +104,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if (errorCallback_)
         {
+            loop_->noteCallback(LoopActivity::kErrorCallback);
             errorCallback_();
         }
     }
@@ -106,6 +113,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if (readCallback_)
         {
+            loop_->noteCallback(LoopActivity::kReadCallback);
             readCallback_(receiveTime);
         }
     }
@@ -114,6 +122,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if (writeCallback_)
         {
+            loop_->noteCallback(LoopActivity::kWriteCallback);
             writeCallback_();
         }
     }
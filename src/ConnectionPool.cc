@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ConnectionPool.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+
+ConnectionPool::ConnectionPool(const std::string &nameArg, const Options &options)
+    : name_(nameArg)
+    , options_(options)
+    , stats_(std::make_shared<AtomicStats>())
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto &item : pools_)
+    {
+        // 子池在自己的loop中关闭 lambda持有的shared_ptr保证子池活到shutdown执行完
+        std::shared_ptr<LoopConnectionPool> pool = item.second;
+        item.first->runInLoop([pool]() { pool->shutdown(); });
+    }
+}
+
+std::shared_ptr<LoopConnectionPool> ConnectionPool::poolFor(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::shared_ptr<LoopConnectionPool> &pool = pools_[loop];
+    if (!pool)
+    {
+        pool = std::make_shared<LoopConnectionPool>(loop, name_, options_, healthCheck_, stats_);
+    }
+    return pool;
+}
+
+void ConnectionPool::acquire(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb,
+                             const MessageCallback &onMessage, const ConnectionCallback &onClose)
+{
+    std::shared_ptr<LoopConnectionPool> pool = poolFor(loop);
+    loop->runInLoop([pool, addr, cb, onMessage, onClose]() { pool->acquire(addr, cb, onMessage, onClose); });
+}
+
+void ConnectionPool::release(const TcpConnectionPtr &conn, bool reusable)
+{
+    EventLoop *loop = conn->getLoop();
+    std::shared_ptr<LoopConnectionPool> pool;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = pools_.find(loop);
+        if (it != pools_.end())
+        {
+            pool = it->second;
+        }
+    }
+    if (!pool)
+    {
+        LOG_ERROR("ConnectionPool::release[%s] - connection %s does not belong to this pool\n",
+                  name_.c_str(), conn->name().c_str());
+        return;
+    }
+    loop->runInLoop([pool, conn, reusable]() { pool->release(conn, reusable); });
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const
+{
+    Stats s;
+    s.created = stats_->created.load(std::memory_order_relaxed);
+    s.reused = stats_->reused.load(std::memory_order_relaxed);
+    s.closed = stats_->closed.load(std::memory_order_relaxed);
+    s.connectFailed = stats_->connectFailed.load(std::memory_order_relaxed);
+    s.waitTimeouts = stats_->waitTimeouts.load(std::memory_order_relaxed);
+    s.rejected = stats_->rejected.load(std::memory_order_relaxed);
+    s.healthEvicted = stats_->healthEvicted.load(std::memory_order_relaxed);
+    return s;
+}
+
+// 子池析构之后 借出的连接改用这个关闭回调 不再引用子池
+static void removeConnectionAfterPool(const TcpConnectionPtr &conn)
+{
+    conn->getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+LoopConnectionPool::LoopConnectionPool(EventLoop *loop, const std::string &name,
+                                       const ConnectionPool::Options &options,
+                                       const ConnectionPool::HealthCheck &healthCheck,
+                                       const std::shared_ptr<ConnectionPool::AtomicStats> &stats)
+    : loop_(loop)
+    , name_(name)
+    , options_(options)
+    , healthCheck_(healthCheck)
+    , stats_(stats)
+    , nextWaiterId_(1)
+    , nextConnId_(1)
+    , shutdown_(false)
+{
+}
+
+LoopConnectionPool::~LoopConnectionPool()
+{
+    // 还没有关闭的连接(用户仍持有)的回调里只有weak_ptr 这里不需要处理
+    LOG_DEBUG("LoopConnectionPool::dtor[%s] - %zu connections\n", name_.c_str(), entries_.size());
+}
+
+LoopConnectionPool::HostPool *LoopConnectionPool::hostFor(const InetAddress &addr)
+{
+    std::unique_ptr<HostPool> &host = hosts_[addr.toIpPort()];
+    if (!host)
+    {
+        host.reset(new HostPool(addr));
+        if (!healthTimer_.valid() && options_.healthCheckInterval > 0)
+        {
+            std::weak_ptr<LoopConnectionPool> weak(shared_from_this());
+            healthTimer_ = loop_->runEvery(options_.healthCheckInterval, [weak]() {
+                std::shared_ptr<LoopConnectionPool> pool(weak.lock());
+                if (pool)
+                {
+                    pool->checkIdle();
+                }
+            });
+        }
+    }
+    return host.get();
+}
+
+void LoopConnectionPool::acquire(const InetAddress &addr, const ConnectionPool::AcquireCallback &cb,
+                                 const MessageCallback &onMessage, const ConnectionCallback &onClose)
+{
+    if (shutdown_)
+    {
+        cb(TcpConnectionPtr());
+        return;
+    }
+
+    HostPool *host = hostFor(addr);
+    BorrowPtr borrow(new Borrow{onMessage, onClose});
+    while (!host->idle.empty())
+    {
+        TcpConnectionPtr conn = host->idle.back();
+        Entry &entry = entries_[conn.get()];
+        if (!conn->connected())
+        {
+            // 正常情况下断开的连接已经在关闭回调里移除了 这里只是防御
+            evictIdle(host, conn);
+            continue;
+        }
+        host->idle.pop_back();
+        ++host->busy;
+        stats_->reused.fetch_add(1, std::memory_order_relaxed);
+        handOut(conn, entry, cb, borrow);
+        return;
+    }
+
+    if (host->waiters.size() >= options_.maxWaiters)
+    {
+        stats_->rejected.fetch_add(1, std::memory_order_relaxed);
+        cb(TcpConnectionPtr());
+        return;
+    }
+
+    // 先排队再发起连接 连接可能同步失败 失败时让队首的等待者返回
+    uint64_t id = nextWaiterId_++;
+    host->waiters.push_back(Waiter{id, cb, borrow, TimerId()});
+    std::weak_ptr<LoopConnectionPool> weak(shared_from_this());
+    host->waiters.back().timeout = loop_->runAfter(options_.acquireTimeout, [weak, host, id]() {
+        std::shared_ptr<LoopConnectionPool> pool(weak.lock());
+        if (pool)
+        {
+            pool->waiterTimeout(host, id);
+        }
+    });
+
+    if (host->total() < options_.maxTotal)
+    {
+        startConnect(host);
+    }
+}
+
+void LoopConnectionPool::release(const TcpConnectionPtr &conn, bool reusable)
+{
+    auto it = entries_.find(conn.get());
+    if (it == entries_.end() || it->second.idle)
+    {
+        // 已经关闭移除的连接 或者重复归还
+        return;
+    }
+    Entry &entry = it->second;
+    entry.borrow.reset();
+    if (!reusable || shutdown_ || options_.maxIdle == 0 || !conn->connected())
+    {
+        // 关闭回调里再从busy中扣除
+        conn->forceClose();
+        return;
+    }
+    if (serveWaiter(entry.host, conn, entry))
+    {
+        stats_->reused.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        putIdle(entry.host, conn, entry);
+    }
+}
+
+void LoopConnectionPool::handOut(const TcpConnectionPtr &conn, Entry &entry,
+                                 const ConnectionPool::AcquireCallback &cb, const BorrowPtr &borrow)
+{
+    entry.idle = false;
+    entry.borrow = borrow;
+    cb(conn);
+}
+
+bool LoopConnectionPool::serveWaiter(HostPool *host, const TcpConnectionPtr &conn, Entry &entry)
+{
+    if (host->waiters.empty())
+    {
+        return false;
+    }
+    Waiter waiter = std::move(host->waiters.front());
+    host->waiters.pop_front();
+    loop_->cancel(waiter.timeout);
+    handOut(conn, entry, waiter.cb, waiter.borrow);
+    return true;
+}
+
+void LoopConnectionPool::putIdle(HostPool *host, const TcpConnectionPtr &conn, Entry &entry)
+{
+    if (host->idle.size() >= options_.maxIdle)
+    {
+        conn->forceClose();
+        return;
+    }
+    --host->busy;
+    entry.idle = true;
+    entry.idleSince = Timestamp::now();
+    host->idle.push_back(conn);
+}
+
+void LoopConnectionPool::failWaiter(HostPool *host)
+{
+    if (host->waiters.empty())
+    {
+        return;
+    }
+    Waiter waiter = std::move(host->waiters.front());
+    host->waiters.pop_front();
+    loop_->cancel(waiter.timeout);
+    waiter.cb(TcpConnectionPtr());
+}
+
+void LoopConnectionPool::waiterTimeout(HostPool *host, uint64_t id)
+{
+    for (auto it = host->waiters.begin(); it != host->waiters.end(); ++it)
+    {
+        if (it->id == id)
+        {
+            ConnectionPool::AcquireCallback cb = std::move(it->cb);
+            host->waiters.erase(it);
+            stats_->waitTimeouts.fetch_add(1, std::memory_order_relaxed);
+            LOG_DEBUG("LoopConnectionPool::waiterTimeout[%s] - %s\n", name_.c_str(), host->addr.toIpPort().c_str());
+            cb(TcpConnectionPtr());
+            return;
+        }
+    }
+}
+
+void LoopConnectionPool::startConnect(HostPool *host)
+{
+    std::shared_ptr<Connector> connector(new Connector(loop_, host->addr));
+    Connector *raw = connector.get();
+    // 回调里只用裸指针和weak_ptr 避免Connector通过自己的回调持有自己
+    std::weak_ptr<LoopConnectionPool> weak(shared_from_this());
+    connector->setNewConnectionCallback([weak, host, raw](int sockfd) {
+        std::shared_ptr<LoopConnectionPool> pool(weak.lock());
+        if (pool)
+        {
+            pool->newConnection(host, raw, sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    });
+    connector->setConnectFailedCallback([weak, host, raw]() {
+        std::shared_ptr<LoopConnectionPool> pool(weak.lock());
+        if (pool)
+        {
+            pool->connectFailed(host, raw);
+        }
+    });
+    host->connecting.push_back(connector);
+    connector->start();
+}
+
+std::shared_ptr<Connector> LoopConnectionPool::takeConnector(HostPool *host, Connector *connector)
+{
+    std::shared_ptr<Connector> result;
+    auto it = std::find_if(host->connecting.begin(), host->connecting.end(),
+                           [connector](const std::shared_ptr<Connector> &c) { return c.get() == connector; });
+    if (it != host->connecting.end())
+    {
+        result = *it;
+        host->connecting.erase(it);
+    }
+    return result;
+}
+
+void LoopConnectionPool::newConnection(HostPool *host, Connector *connector, int sockfd)
+{
+    std::shared_ptr<Connector> guard = takeConnector(host, connector);
+
+    InetAddress peerAddr(sockets::getPeerAddr(sockfd));
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    TcpConnectionPtr conn(new TcpConnection(loop_, name_ + buf, sockfd, localAddr, peerAddr));
+
+    std::weak_ptr<LoopConnectionPool> weak(shared_from_this());
+    conn->setConnectionCallback([](const TcpConnectionPtr &) {});
+    conn->setMessageCallback([weak](const TcpConnectionPtr &c, Buffer *buffer, Timestamp receiveTime) {
+        std::shared_ptr<LoopConnectionPool> pool(weak.lock());
+        if (pool)
+        {
+            pool->handleMessage(c, buffer, receiveTime);
+        }
+        else
+        {
+            buffer->retrieveAll();
+        }
+    });
+    conn->setCloseCallback([weak](const TcpConnectionPtr &c) {
+        std::shared_ptr<LoopConnectionPool> pool(weak.lock());
+        if (pool)
+        {
+            pool->removeConnection(c);
+        }
+        else
+        {
+            removeConnectionAfterPool(c);
+        }
+    });
+    if (options_.tcpNoDelay)
+    {
+        conn->setTcpNoDelay(true);
+    }
+
+    Entry &entry = entries_[conn.get()];
+    entry.conn = conn;
+    entry.host = host;
+    entry.idle = false;
+    ++host->busy;
+    stats_->created.fetch_add(1, std::memory_order_relaxed);
+    conn->connectEstablished();
+
+    if (shutdown_)
+    {
+        conn->forceClose();
+    }
+    else if (!serveWaiter(host, conn, entry))
+    {
+        // 等待者已经超时离开 连接留给下一次请求
+        putIdle(host, conn, entry);
+    }
+}
+
+void LoopConnectionPool::connectFailed(HostPool *host, Connector *connector)
+{
+    // stop()投递到loop中的任务持有Connector的shared_ptr 保证Connector::retry返回之前不会析构
+    connector->stop();
+    std::shared_ptr<Connector> guard = takeConnector(host, connector);
+    stats_->connectFailed.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO("LoopConnectionPool::connectFailed[%s] - %s\n", name_.c_str(), host->addr.toIpPort().c_str());
+    // 每次连接是为一个等待者发起的 失败时让一个等待者返回 不在池里无限重试
+    failWaiter(host);
+}
+
+void LoopConnectionPool::removeConnection(const TcpConnectionPtr &conn)
+{
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+
+    auto it = entries_.find(conn.get());
+    if (it == entries_.end())
+    {
+        return;
+    }
+    HostPool *host = it->second.host;
+    BorrowPtr borrow = it->second.borrow;
+    if (it->second.idle)
+    {
+        host->idle.erase(std::remove(host->idle.begin(), host->idle.end(), conn), host->idle.end());
+    }
+    else
+    {
+        --host->busy;
+    }
+    entries_.erase(it);
+    stats_->closed.fetch_add(1, std::memory_order_relaxed);
+
+    if (borrow && borrow->onClose)
+    {
+        borrow->onClose(conn);
+    }
+    // 空出了名额 为还在等待的请求补充连接
+    if (!shutdown_ && host->waiters.size() > host->connecting.size() && host->total() < options_.maxTotal)
+    {
+        startConnect(host);
+    }
+}
+
+void LoopConnectionPool::handleMessage(const TcpConnectionPtr &conn, Buffer *buffer, Timestamp receiveTime)
+{
+    auto it = entries_.find(conn.get());
+    BorrowPtr borrow = it != entries_.end() ? it->second.borrow : BorrowPtr();
+    if (borrow && borrow->onMessage)
+    {
+        borrow->onMessage(conn, buffer, receiveTime);
+        return;
+    }
+    // 空闲连接上收到数据 说明上一次请求的响应没有读完或者协议已经错乱 不能再复用
+    LOG_INFO("LoopConnectionPool::handleMessage[%s] - %zu unexpected bytes on idle connection %s\n",
+             name_.c_str(), buffer->readableBytes(), conn->name().c_str());
+    buffer->retrieveAll();
+    if (it != entries_.end() && it->second.idle)
+    {
+        stats_->healthEvicted.fetch_add(1, std::memory_order_relaxed);
+        evictIdle(it->second.host, conn);
+    }
+    else
+    {
+        conn->forceClose();
+    }
+}
+
+void LoopConnectionPool::evictIdle(HostPool *host, const TcpConnectionPtr &conn)
+{
+    auto it = entries_.find(conn.get());
+    if (it != entries_.end() && it->second.idle)
+    {
+        it->second.idle = false;
+        host->idle.erase(std::remove(host->idle.begin(), host->idle.end(), conn), host->idle.end());
+        ++host->busy;
+    }
+    conn->forceClose();
+}
+
+void LoopConnectionPool::checkIdle()
+{
+    Timestamp now = Timestamp::now();
+    const int64_t idleTimeoutUs = static_cast<int64_t>(options_.idleTimeout * Timestamp::kMicroSecondsPerSecond);
+    std::vector<TcpConnectionPtr> expired;
+    for (auto &item : hosts_)
+    {
+        HostPool *host = item.second.get();
+        expired.clear();
+        for (const TcpConnectionPtr &conn : host->idle)
+        {
+            const Entry &entry = entries_[conn.get()];
+            if (!conn->connected() || now - entry.idleSince > idleTimeoutUs || (healthCheck_ && !healthCheck_(conn)))
+            {
+                expired.push_back(conn);
+            }
+        }
+        for (const TcpConnectionPtr &conn : expired)
+        {
+            stats_->healthEvicted.fetch_add(1, std::memory_order_relaxed);
+            evictIdle(host, conn);
+        }
+    }
+}
+
+void LoopConnectionPool::shutdown()
+{
+    if (shutdown_)
+    {
+        return;
+    }
+    shutdown_ = true;
+    loop_->cancel(healthTimer_);
+    for (auto &item : hosts_)
+    {
+        HostPool *host = item.second.get();
+        for (const std::shared_ptr<Connector> &connector : host->connecting)
+        {
+            connector->stop();
+        }
+        host->connecting.clear();
+        while (!host->waiters.empty())
+        {
+            failWaiter(host);
+        }
+        std::vector<TcpConnectionPtr> idle(host->idle);
+        for (const TcpConnectionPtr &conn : idle)
+        {
+            evictIdle(host, conn);
+        }
+    }
+}
+
+size_t LoopConnectionPool::idleCount() const
+{
+    size_t n = 0;
+    for (const auto &item : hosts_)
+    {
+        n += item.second->idle.size();
+    }
+    return n;
+}
+
+size_t LoopConnectionPool::busyCount() const
+{
+    size_t n = 0;
+    for (const auto &item : hosts_)
+    {
+        n += item.second->busy;
+    }
+    return n;
+}
+
+size_t LoopConnectionPool::connectingCount() const
+{
+    size_t n = 0;
+    for (const auto &item : hosts_)
+    {
+        n += item.second->connecting.size();
+    }
+    return n;
+}
+
+size_t LoopConnectionPool::waiterCount() const
+{
+    size_t n = 0;
+    for (const auto &item : hosts_)
+    {
+        n += item.second->waiters.size();
+    }
+    return n;
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <mutex>
+#include <stdio.h>
+#include <time.h>
+
+#include "CpuAccounting.h"
+
+const int CpuAccounting::kMaxTags;
+const int CpuAccounting::kUntagged;
+
+CpuAccounting::Counters CpuAccounting::counters_[CpuAccounting::kMaxTags];
+
+namespace
+{
+std::mutex g_tagMutex;
+std::vector<std::string> g_tagNames; // 下标就是标签 第一个永远是"untagged"
+} // namespace
+
+int CpuAccounting::tag(const std::string &name)
+{
+    auto create = [](const std::string &tagName) {
+        int id = static_cast<int>(g_tagNames.size());
+        g_tagNames.push_back(tagName);
+        std::string labels = metrics::Registry::label("tag", tagName);
+        counters_[id].cpuNs = metrics::Registry::instance().counter(
+            "muduo_cpu_nanoseconds_total", "Loop thread CPU time spent in callbacks, by tag.", labels);
+        counters_[id].calls = metrics::Registry::instance().counter(
+            "muduo_cpu_callbacks_total", "Callbacks run while CPU accounting was on, by tag.", labels);
+        return id;
+    };
+
+    std::unique_lock<std::mutex> lock(g_tagMutex);
+    if (g_tagNames.empty())
+    {
+        create("untagged");
+    }
+    auto it = std::find(g_tagNames.begin(), g_tagNames.end(), name);
+    if (it != g_tagNames.end())
+    {
+        return static_cast<int>(it - g_tagNames.begin());
+    }
+    if (g_tagNames.size() >= static_cast<size_t>(kMaxTags))
+    {
+        return kUntagged;
+    }
+    return create(name);
+}
+
+std::string CpuAccounting::tagName(int tag)
+{
+    std::unique_lock<std::mutex> lock(g_tagMutex);
+    return tag >= 0 && static_cast<size_t>(tag) < g_tagNames.size() ? g_tagNames[static_cast<size_t>(tag)]
+                                                                     : std::string("untagged");
+}
+
+std::vector<CpuAccounting::Row> CpuAccounting::snapshot()
+{
+    std::vector<std::string> names;
+    {
+        std::unique_lock<std::mutex> lock(g_tagMutex);
+        names = g_tagNames;
+    }
+    std::vector<Row> rows;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        Row row;
+        row.tag = names[i];
+        row.cpuNs = counters_[i].cpuNs.value();
+        row.calls = counters_[i].calls.value();
+        rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) { return a.cpuNs > b.cpuNs; });
+    return rows;
+}
+
+std::string CpuAccounting::table()
+{
+    std::vector<Row> rows = snapshot();
+    int64_t total = 0;
+    for (const Row &row : rows)
+    {
+        total += row.cpuNs;
+    }
+    std::string text;
+    char line[256];
+    snprintf(line, sizeof line, "%-24s %12s %7s %14s %10s\n", "tag", "cpu ms", "share", "calls", "ns/call");
+    text += line;
+    for (const Row &row : rows)
+    {
+        snprintf(line, sizeof line, "%-24s %12.3f %6.1f%% %14lld %10.0f\n", row.tag.c_str(),
+                 static_cast<double>(row.cpuNs) / 1e6,
+                 total > 0 ? 100.0 * static_cast<double>(row.cpuNs) / static_cast<double>(total) : 0.0,
+                 static_cast<long long>(row.calls),
+                 row.calls > 0 ? static_cast<double>(row.cpuNs) / static_cast<double>(row.calls) : 0.0);
+        text += line;
+    }
+    return text;
+}
+
+int64_t CpuAccounting::threadCpuNs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
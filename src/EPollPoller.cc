@@ -5,6 +5,7 @@
 #include "EPollPoller.h"
 #include "Logger.h"
 #include "Channel.h"
+#include "Probes.h"
 
 const int kNew = -1;    // 某个channel还没添加至Poller          // channel的成员index_初始化为-1
 const int kAdded = 1;   // 某个channel已经添加至Poller
@@ -28,16 +29,18 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    // 由于频繁调用poll 实际上应该用LOG_DEBUG输出日志更为合理 当遇到并发场景 关闭DEBUG日志提升效率
-    LOG_INFO("func=%s => fd total count:%lu\n", __FUNCTION__, channels_.size());
+    // poll每轮循环都会调用 只输出DEBUG日志 默认的INFO阈值下只有一次比较
+    LOG_DEBUG("func=%s => fd total count:%lu\n", __FUNCTION__, channels_.size());
 
+    MUDUO_PROBE2(poll_enter, epollfd_, timeoutMs);
     int numEvents = ::epoll_wait(epollfd_, events_.data(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
+    MUDUO_PROBE3(poll_return, epollfd_, numEvents, saveErrno);
     Timestamp now(Timestamp::now());
 
     if (numEvents > 0)
     {
-        LOG_INFO("%d events happend\n", numEvents); // LOG_DEBUG最合理
+        LOG_DEBUG("%d events happend\n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size()) // 扩容操作:如果实际发生的事件数 大于 events_数组大小,events_会被填满
         {
@@ -64,7 +67,7 @@ void EPollPoller::updateChannel(Channel *channel)
 {
     // 记录channel在Poller中的状态，同时更新epoll_ctl
     const int index = channel->index();
-    LOG_INFO("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), index);
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), index);
 
     if (index == kNew || index == kDeleted) //kDeleted，还未从ChannelMap中删除
     {
@@ -103,7 +106,7 @@ void EPollPoller::removeChannel(Channel *channel)
     int fd = channel->fd();
     channels_.erase(fd);
 
-    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
 
     int index = channel->index();
     if (index == kAdded)
@@ -8,6 +8,9 @@
 #include "Logger.h"
 #include "Channel.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "Probes.h"
+#include "CpuAccounting.h"
 
 // 防止一个线程创建多个EventLoop
 thread_local EventLoop *t_loopInThisThread = nullptr; //one loop per thread的底层检查
@@ -48,8 +51,23 @@ EventLoop::EventLoop()
     , poller_(Poller::newDefaultPoller(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , timerQueue_(new TimerQueue(this))
     , callingPendingFunctors_(false)
     // pendingFunctors_ 与 mutex_ 会调用默认构造函数
+    , iterationsMetric_(metrics::Registry::instance().counter(
+          "muduo_eventloop_iterations_total", "Poll returns of all event loops."))
+    , eventsMetric_(metrics::Registry::instance().counter(
+          "muduo_eventloop_events_total", "Channel events dispatched by all event loops."))
+    , functorsMetric_(metrics::Registry::instance().counter(
+          "muduo_eventloop_functors_total", "Queued functors run by all event loops."))
+    , loopsMetric_(metrics::Registry::instance().gauge(
+          "muduo_eventloops", "Event loops alive."))
+    , activity_(std::make_shared<LoopActivity>(threadId_))
+    , cpuSampleEvery_(0)
+    , cpuIterations_(0)
+    , cpuWeight_(-1)
+    , cpuMark_(0)
+    , currentCpuTag_(CpuAccounting::kUntagged)
 {
     LOG_DEBUG("EventLoop created %p in thread %d\n", this, threadId_);
     if (t_loopInThisThread)
@@ -68,6 +86,8 @@ EventLoop::EventLoop()
     
     //Channel->EventLoop->Poller->EpollPoller
     wakeupChannel_->enableReading(); // 每一个EventLoop都将监听wakeupChannel_的EPOLL读事件了
+    wakeupChannel_->setLabel("EventLoop::wakeup");
+    loopsMetric_.inc();
 }
 EventLoop::~EventLoop()
 {
@@ -75,6 +95,7 @@ EventLoop::~EventLoop()
     wakeupChannel_->remove();     // 把Channel从EventLoop上删除掉：注销
     ::close(wakeupFd_);
     t_loopInThisThread = nullptr;
+    loopsMetric_.dec();
 }
 
 // 开启事件循环
@@ -87,13 +108,29 @@ void EventLoop::loop()
 
     while (!quit_)
     {
-        LOG_INFO("Wakeup fd:%d---------------------------------\n", wakeupFd_);
+        LOG_DEBUG("Wakeup fd:%d---------------------------------\n", wakeupFd_);
         activeChannels_.clear();
+        activity_->enter(LoopActivity::kPolling, -1, nullptr);
         pollRetureTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        iterationsMetric_.inc();
+        eventsMetric_.inc(static_cast<int64_t>(activeChannels_.size()));
+
+        int sampleEvery = cpuSampleEvery_.load(std::memory_order_relaxed);
+        cpuWeight_ = sampleEvery <= 0 ? -1 : (++cpuIterations_ % sampleEvery == 0 ? sampleEvery : 0);
+        if (cpuWeight_ > 0)
+        {
+            cpuMark_ = CpuAccounting::threadCpuNs();
+        }
         for (Channel *channel : activeChannels_)
         {
             // Poller监听哪些channel发生了事件 然后上报给EventLoop 通知channel处理相应的事件
+            activity_->enter(LoopActivity::kChannelEvent, channel->fd(), channel->label());
+            currentCpuTag_ = channel->cpuTag(); // 回调里channel可能被销毁 先取出来
             channel->handleEvent(pollRetureTime_);
+            if (cpuWeight_ >= 0)
+            {
+                accountCpu();
+            }
         }
         /**
          * 执行当前EventLoop事件循环需要处理的回调操作 对于线程数 >=2 的情况 IO线程 mainloop(mainReactor) 主要工作：
@@ -103,6 +140,7 @@ void EventLoop::loop()
          **/
         doPendingFunctors();
     }
+    activity_->enter(LoopActivity::kNotLooping, -1, nullptr);
     LOG_INFO("EventLoop %d stop looping.\n", threadId_);
     looping_ = false;
 }
@@ -127,6 +165,16 @@ void EventLoop::quit()
     }
 }
 
+const size_t LoopActivity::kLabelWords;
+const size_t LoopActivity::kLabelSize;
+
+const char *LoopActivity::kindName(int kind)
+{
+    static const char *kNames[] = {"not looping", "polling", "channel event", "read callback",
+                                   "write callback", "close callback", "error callback", "pending functor"};
+    return kind >= 0 && kind <= kPendingFunctor ? kNames[kind] : "unknown";
+}
+
 // 在当前loop中执行cb
 void EventLoop::runInLoop(Functor cb)
 {
@@ -147,6 +195,7 @@ void EventLoop::queueInLoop(Functor cb)
         //生产者
         std::unique_lock<std::mutex> lock(mutex_);
         pendingFunctors_.emplace_back(cb);
+        MUDUO_PROBE2(functor_enqueue, wakeupFd_, pendingFunctors_.size());
     }
 
     /** 配合doPendingFunctors使用
@@ -185,6 +234,46 @@ void EventLoop::wakeup()
     }
 }
 
+void EventLoop::queueInLoop(Functor cb, int cpuTag)
+{
+    queueInLoop([this, cpuTag, cb]() {
+        currentCpuTag_ = cpuTag;
+        cb();
+    });
+}
+
+void EventLoop::accountCpu()
+{
+    int64_t cpuNs = 0;
+    if (cpuWeight_ > 0)
+    {
+        int64_t now = CpuAccounting::threadCpuNs();
+        cpuNs = (now - cpuMark_) * cpuWeight_;
+        cpuMark_ = now;
+    }
+    CpuAccounting::add(currentCpuTag_, cpuNs, 1);
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    return runAt(addTime(Timestamp::now(), delay), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), interval), interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // EventLoop的方法 => Poller的方法
 void EventLoop::updateChannel(Channel *channel)
 {
@@ -211,11 +300,20 @@ void EventLoop::doPendingFunctors()
         std::unique_lock<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_); // 交换的方式减少了锁的临界区范围 提升效率 同时避免了死锁 如果执行functor()在临界区内 且functor()中调用queueInLoop()就会产生死锁
     }
+    MUDUO_PROBE2(functor_dequeue, wakeupFd_, functors.size());
 
     for (const Functor &functor : functors)
     {
+        activity_->enter(LoopActivity::kPendingFunctor, -1, nullptr);
+        currentCpuTag_ = CpuAccounting::kUntagged;
         functor(); // 执行当前loop需要执行的回调操作
+        if (cpuWeight_ >= 0)
+        {
+            accountCpu();
+        }
     }
+    functorsMetric_.inc(static_cast<int64_t>(functors.size()));
+    MUDUO_PROBE2(functors_done, wakeupFd_, functors.size());
 
     callingPendingFunctors_ = false;
 }
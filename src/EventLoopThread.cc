@@ -1,5 +1,28 @@
+#include <sched.h>
+#include <errno.h>
+
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "Logger.h"
+
+// 当前线程的亲和性只包含一个CPU时返回它 否则返回-1
+static int pinnedCpu()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof set, &set) != 0 || CPU_COUNT(&set) != 1)
+    {
+        return -1;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            return cpu;
+        }
+    }
+    return -1;
+}
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
                                  const std::string &name)
@@ -9,6 +32,7 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
     , mutex_()
     , cond_()
     , callback_(cb)
+    , cpu_(-1)
 {
 }
 /* 
@@ -50,6 +74,17 @@ void EventLoopThread::threadFunc()
     //one loop per thread：由新创建的线程来创建EventLoop对象，构造函数默认会绑定创建该对象的线程TID
     EventLoop loop; // 创建一个独立的EventLoop对象 和上面的线程是一一对应的
 
+    if (cpu_ >= 0 && cpu_ < CPU_SETSIZE)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_, &set);
+        if (::sched_setaffinity(0, sizeof set, &set) != 0)
+        {
+            LOG_ERROR("%s:%s:%d bind loop thread to cpu %d err:%d\n", __FILE__, __FUNCTION__, __LINE__, cpu_, errno);
+        }
+    }
+
     if (callback_)
     {
         callback_(&loop);
@@ -57,6 +92,7 @@ void EventLoopThread::threadFunc()
 
     {
         std::unique_lock<std::mutex> lock(mutex_);
+        cpu_ = pinnedCpu(); // 在notify之前写入 startLoop()返回后主线程读到的就是最终值
         loop_ = &loop;
         cond_.notify_one();
     }
@@ -1,8 +1,31 @@
+#include <algorithm>
 #include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
 #include "Logger.h"
+
+// cpu所在的物理CPU编号 读不到sysfs时返回-1(此时认为所有CPU都在同一个package)
+static int physicalPackageOf(int cpu)
+{
+    char path[96];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    FILE *fp = ::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return -1;
+    }
+    int id = -1;
+    if (::fscanf(fp, "%d", &id) != 1)
+    {
+        id = -1;
+    }
+    ::fclose(fp);
+    return id;
+}
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
     : baseLoop_(baseLoop), name_(nameArg), started_(false), numThreads_(0), next_(0)
 {
@@ -22,10 +45,55 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
         EventLoopThread *t = new EventLoopThread(cb, buf);
+        if (!cpus_.empty())
+        {
+            t->setCpu(cpus_[i % cpus_.size()]);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop()); // 底层创建线程 绑定一个新的EventLoop 并返回该loop的地址
     }
 
+    // 按CPU建查表 每个CPU先找绑定在它上面的loop 再找同一package上编号最近的
+    // 同一个CPU上绑定了多个loop时取第一个
+    int numCpus = static_cast<int>(::sysconf(_SC_NPROCESSORS_CONF));
+    bool anyPinned = false;
+    for (const std::unique_ptr<EventLoopThread> &t : threads_)
+    {
+        if (t->cpu() >= 0)
+        {
+            anyPinned = true;
+            numCpus = std::max(numCpus, t->cpu() + 1);
+        }
+    }
+    if (anyPinned && numCpus > 0)
+    {
+        std::vector<int> packages(numCpus);
+        for (int cpu = 0; cpu < numCpus; ++cpu)
+        {
+            packages[cpu] = physicalPackageOf(cpu);
+        }
+        cpuLoops_.assign(numCpus, nullptr);
+        for (int cpu = 0; cpu < numCpus; ++cpu)
+        {
+            int bestDistance = numCpus + 1;
+            for (size_t i = 0; i < threads_.size(); ++i)
+            {
+                int loopCpu = threads_[i]->cpu();
+                if (loopCpu < 0 || packages[loopCpu] != packages[cpu])
+                {
+                    continue;
+                }
+                int distance = std::abs(loopCpu - cpu);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    cpuLoops_[cpu] = loops_[i];
+                }
+            }
+        }
+        LOG_INFO("EventLoopThreadPool::start[%s] - %d cpus mapped to pinned loops\n", name_.c_str(), numCpus);
+    }
+
     if (numThreads_ == 0 && cb) // 整个服务端只有一个线程运行baseLoop
     {
         cb(baseLoop_);
@@ -57,6 +125,15 @@ EventLoop *EventLoopThreadPool::getNextLoop()
 
 
 
+EventLoop *EventLoopThreadPool::getLoopForCpu(int cpu) const
+{
+    if (cpu < 0 || cpu >= static_cast<int>(cpuLoops_.size()))
+    {
+        return nullptr;
+    }
+    return cpuLoops_[cpu];
+}
+
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
 {
     if (loops_.empty())
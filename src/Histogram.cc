@@ -0,0 +1,120 @@
+#include <algorithm>
+
+#include "Histogram.h"
+
+const int Histogram::kSubBucketBits;
+const int64_t Histogram::kSubBuckets;
+
+namespace
+{
+const int64_t kHalfBuckets = Histogram::kSubBuckets / 2;
+}
+
+// 下标0~kSubBuckets-1精确对应值本身
+// 之后每个2的幂区间[2^(k+kSubBucketBits-1), 2^(k+kSubBucketBits))占kHalfBuckets个桶 每个桶宽2^k
+size_t Histogram::bucketIndex(int64_t value)
+{
+    uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+    if (v < static_cast<uint64_t>(kSubBuckets))
+    {
+        return static_cast<size_t>(v);
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - (kSubBucketBits - 1);
+    uint64_t sub = v >> shift; // [kHalfBuckets, kSubBuckets)
+    return static_cast<size_t>(kSubBuckets + (shift - 1) * kHalfBuckets + static_cast<int64_t>(sub) - kHalfBuckets);
+}
+
+int64_t Histogram::lowerBound(size_t index)
+{
+    if (index < static_cast<size_t>(kSubBuckets))
+    {
+        return static_cast<int64_t>(index);
+    }
+    int64_t offset = static_cast<int64_t>(index) - kSubBuckets;
+    int shift = static_cast<int>(offset / kHalfBuckets) + 1;
+    int64_t sub = offset % kHalfBuckets + kHalfBuckets;
+    return static_cast<int64_t>(static_cast<uint64_t>(sub) << shift);
+}
+
+int64_t Histogram::upperBound(size_t index)
+{
+    if (index + 1 >= bucketCount())
+    {
+        return INT64_MAX;
+    }
+    return lowerBound(index + 1) - 1;
+}
+
+size_t Histogram::bucketCount()
+{
+    return bucketIndex(INT64_MAX) + 1;
+}
+
+Histogram::Histogram()
+    : counts_(bucketCount(), 0)
+    , count_(0)
+    , sum_(0)
+    , min_(INT64_MAX)
+    , max_(0)
+{
+}
+
+void Histogram::recordN(int64_t value, int64_t count)
+{
+    if (value < 0)
+    {
+        value = 0;
+    }
+    counts_[bucketIndex(value)] += count;
+    count_ += count;
+    sum_ += value * count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    if (other.count_ == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void Histogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    sum_ = 0;
+    min_ = INT64_MAX;
+    max_ = 0;
+}
+
+int64_t Histogram::percentile(double p) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    // 第rank个样本(从1开始)所在的桶
+    int64_t rank = static_cast<int64_t>(p * static_cast<double>(count_) + 0.5);
+    rank = std::max<int64_t>(1, std::min(rank, count_));
+    int64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+        {
+            return std::min(upperBound(i), max_);
+        }
+    }
+    return max_;
+}
@@ -0,0 +1,298 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "HttpContext.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+HttpContext::HttpContext(const TcpConnectionPtr &conn, const HttpCallback &callback,
+                         size_t maxHeaderBytes, size_t maxBodyBytes)
+    : conn_(conn)
+    , loop_(conn->getLoop())
+    , callback_(callback)
+    , parser_(maxHeaderBytes, maxBodyBytes)
+    , output_(4096)
+    , requests_(0)
+    , pauseThreshold_(maxHeaderBytes + maxBodyBytes)
+    , processing_(false)
+    , waiting_(false)
+    , deferredDone_(false)
+    , closing_(false)
+    , continueSent_(false)
+    , headRequest_(false)
+    , readPaused_(false)
+{
+}
+
+void HttpContext::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    receiveTime_ = receiveTime;
+    if (closing_)
+    {
+        buf->retrieveAll(); // 已经决定关闭 后面的请求不再处理
+        return;
+    }
+    if (waiting_)
+    {
+        // 数据先留在inputBuffer里 积压太多时停止读 等前面的响应完成
+        if (!readPaused_ && buf->readableBytes() > pauseThreshold_)
+        {
+            conn->stopRead();
+            readPaused_ = true;
+        }
+        return;
+    }
+    process(conn, buf);
+}
+
+void HttpContext::process(const TcpConnectionPtr &conn, Buffer *buf)
+{
+    processing_ = true;
+    while (!waiting_ && !closing_ && buf->readableBytes() > 0)
+    {
+        HttpParser::Result result = parser_.parse(buf, &request_);
+        if (result == HttpParser::kIncomplete)
+        {
+            if (parser_.expectingBody() && request_.expectContinue() &&
+                request_.version() == HttpRequest::kHttp11 && !continueSent_)
+            {
+                output_.append("HTTP/1.1 100 Continue\r\n\r\n", 25);
+                continueSent_ = true;
+            }
+            break;
+        }
+        if (result == HttpParser::kError)
+        {
+            LOG_DEBUG("HttpContext %s bad request, status %d\n", conn->name().c_str(), parser_.errorStatus());
+            sendError(parser_.errorStatus());
+            break;
+        }
+
+        ++requests_;
+        headRequest_ = request_.method() == HttpRequest::kHead;
+        request_.setReceiveTime(receiveTime_);
+        response_.context_ = this;
+        response_.reset(!request_.keepAlive(), request_.version() == HttpRequest::kHttp10);
+        callback_(request_, &response_);
+
+        // 请求的视图到这里失效
+        buf->retrieve(parser_.consumed());
+        parser_.reset();
+        continueSent_ = false;
+
+        if (response_.deferred())
+        {
+            if (!deferredDone_)
+            {
+                waiting_ = true;
+                break;
+            }
+            deferredDone_ = false; // 回调里已经finish 响应已经在output_里
+            if (response_.closeConnection())
+            {
+                closing_ = true;
+            }
+            continue;
+        }
+        completeResponse(conn);
+    }
+    processing_ = false;
+    flush(conn);
+}
+
+void HttpContext::completeResponse(const TcpConnectionPtr &conn)
+{
+    if (response_.hasFile() && !headRequest_)
+    {
+        response_.appendHeaders(&output_);
+        conn->send(&output_); // 头部和前面的响应必须先于文件内容发出
+        if (response_.closeConnection())
+        {
+            closing_ = true;
+        }
+
+        int fd = response_.fileFd_;
+        bool closeFile = response_.closeFile_;
+        response_.releaseFile();
+        waiting_ = true;
+        std::weak_ptr<HttpContext> weakSelf(shared_from_this());
+        conn->sendFile(fd, response_.fileOffset_, response_.fileCount_,
+                       [weakSelf, fd, closeFile](bool ok) {
+                           if (closeFile)
+                           {
+                               ::close(fd);
+                           }
+                           std::shared_ptr<HttpContext> self(weakSelf.lock());
+                           if (ok && self)
+                           {
+                               self->onFileSent();
+                           }
+                       });
+        return;
+    }
+    response_.appendToBuffer(&output_, headRequest_); // HEAD请求带文件时 文件在下次reset时关闭
+    if (response_.closeConnection())
+    {
+        closing_ = true;
+    }
+}
+
+void HttpContext::sendError(int status)
+{
+    response_.context_ = this;
+    response_.reset(true, false);
+    response_.setStatusCode(status);
+    response_.setContentType("text/plain");
+    response_.appendBody(HttpResponse::statusMessage(status), strlen(HttpResponse::statusMessage(status)));
+    response_.appendBody("\n", 1);
+    response_.appendToBuffer(&output_, false);
+    closing_ = true;
+}
+
+void HttpContext::flush(const TcpConnectionPtr &conn)
+{
+    if (output_.readableBytes() > 0)
+    {
+        conn->send(&output_);
+    }
+    if (closing_ && !waiting_)
+    {
+        conn->shutdown(); // outputBuffer_发完之后再关闭写端
+    }
+}
+
+std::shared_ptr<HttpResponseWriter> HttpContext::makeWriter()
+{
+    return std::make_shared<HttpResponseWriter>(shared_from_this());
+}
+
+void HttpContext::onDeferredFinished()
+{
+    if (processing_)
+    {
+        deferredDone_ = true; // 在回调里直接finish了 由process继续
+        return;
+    }
+    waiting_ = false;
+    if (response_.closeConnection())
+    {
+        closing_ = true;
+    }
+    resume();
+}
+
+void HttpContext::onFileSent()
+{
+    waiting_ = false;
+    if (!processing_) // sendFile可能在process里同步发完
+    {
+        resume();
+    }
+}
+
+void HttpContext::resume()
+{
+    TcpConnectionPtr conn(conn_.lock());
+    if (!conn || !conn->connected())
+    {
+        return;
+    }
+    if (readPaused_)
+    {
+        conn->startRead();
+        readPaused_ = false;
+    }
+    process(conn, conn->inputBuffer());
+}
+
+HttpResponseWriter::HttpResponseWriter(const std::shared_ptr<HttpContext> &context)
+    : context_(context)
+    , headersSent_(false)
+    , finished_(false)
+{
+}
+
+HttpResponseWriter::~HttpResponseWriter()
+{
+    if (!finished_)
+    {
+        finish();
+    }
+}
+
+bool HttpResponseWriter::connected() const
+{
+    TcpConnectionPtr conn(context_->conn_.lock());
+    return conn && conn->connected();
+}
+
+void HttpResponseWriter::write(const StringPiece &data)
+{
+    HttpResponse &response = context_->response_;
+    if (finished_ || data.empty())
+    {
+        return;
+    }
+    if (!response.chunked())
+    {
+        response.appendBody(data.data(), data.size());
+        return;
+    }
+    TcpConnectionPtr conn(context_->conn_.lock());
+    if (!conn || !conn->connected())
+    {
+        return;
+    }
+    Buffer *output = &context_->output_;
+    if (!headersSent_)
+    {
+        response.appendHeaders(output);
+        headersSent_ = true;
+    }
+    if (!context_->headRequest_)
+    {
+        if (response.http10_)
+        {
+            output->append(data.data(), data.size()); // HTTP/1.0以关闭连接结束响应体
+        }
+        else
+        {
+            HttpResponse::appendChunk(output, data.data(), data.size());
+        }
+    }
+    if (!context_->processing_)
+    {
+        conn->send(output);
+    }
+}
+
+void HttpResponseWriter::finish()
+{
+    if (finished_)
+    {
+        return;
+    }
+    finished_ = true;
+    HttpResponse &response = context_->response_;
+    Buffer *output = &context_->output_;
+    bool head = context_->headRequest_;
+    if (!headersSent_)
+    {
+        response.appendToBuffer(output, head);
+    }
+    else if (!head && response.http10_)
+    {
+        output->append(response.body_.peek(), response.body_.readableBytes());
+    }
+    else if (!head)
+    {
+        if (response.body_.readableBytes() > 0)
+        {
+            HttpResponse::appendChunk(output, response.body_.peek(), response.body_.readableBytes());
+        }
+        output->append("0\r\n\r\n", 5);
+    }
+    response.body_.retrieveAll();
+    context_->onDeferredFinished();
+}
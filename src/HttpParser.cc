@@ -0,0 +1,518 @@
+#include <algorithm>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "HttpParser.h"
+#include "Buffer.h"
+
+static const size_t kMaxChunkLine = 1024; // 块大小那一行(含扩展)的最大长度
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static StringPiece trim(const char *begin, const char *end)
+{
+    while (begin < end && isSpace(*begin))
+    {
+        ++begin;
+    }
+    while (end > begin && isSpace(end[-1]))
+    {
+        --end;
+    }
+    return StringPiece(begin, static_cast<size_t>(end - begin));
+}
+
+// 逗号分隔的列表里是否有token(不区分大小写) 例如Connection: keep-alive, Upgrade
+static bool hasToken(const StringPiece &value, const StringPiece &token)
+{
+    const char *p = value.begin();
+    const char *end = value.end();
+    while (p < end)
+    {
+        const char *comma = static_cast<const char *>(memchr(p, ',', end - p));
+        const char *itemEnd = comma != nullptr ? comma : end;
+        if (trim(p, itemEnd).equalsIgnoreCase(token))
+        {
+            return true;
+        }
+        p = itemEnd + 1;
+    }
+    return false;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+HttpParser::HttpParser(size_t maxHeaderBytes, size_t maxBodyBytes)
+    : maxHeaderBytes_(maxHeaderBytes)
+    , maxBodyBytes_(maxBodyBytes)
+{
+    reset();
+}
+
+void HttpParser::reset()
+{
+    state_ = kExpectHeaders;
+    scanned_ = 0;
+    headerBytes_ = 0;
+    bodyBytes_ = 0;
+    chunkScan_ = 0;
+    chunkRemaining_ = 0;
+    consumed_ = 0;
+    errorStatus_ = 0;
+    connectionClose_ = false;
+    connectionKeepAlive_ = false;
+}
+
+const char *HttpParser::findHeaderEnd(const char *begin, const char *end)
+{
+    const char *p = begin;
+#if defined(__SSE2__)
+    // 错开0~3个字节各加载16字节 四个比较结果相与 第i位为1说明p+i处是"\r\n\r\n"
+    // 每16字节只有一次分支 不用逐个确认每一行结尾的'\r'
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16 + 3)
+    {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+        __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2));
+        __m128i b3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 3));
+        __m128i m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, cr), _mm_cmpeq_epi8(b1, lf)),
+                                  _mm_and_si128(_mm_cmpeq_epi8(b2, cr), _mm_cmpeq_epi8(b3, lf)));
+        int mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+#endif
+    for (; end - p >= 4; ++p)
+    {
+        if (p[0] == '\r' && p[1] == '\n' && p[2] == '\r' && p[3] == '\n')
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+const char *HttpParser::findCrlf(const char *begin, const char *end)
+{
+    // glibc的memchr本身就是向量化的 行内一般只有一个'\r'
+    const char *p = begin;
+    while (end - p >= 2)
+    {
+        const char *cr = static_cast<const char *>(memchr(p, '\r', end - p - 1));
+        if (cr == nullptr)
+        {
+            return nullptr;
+        }
+        if (cr[1] == '\n')
+        {
+            return cr;
+        }
+        p = cr + 1;
+    }
+    return nullptr;
+}
+
+HttpParser::Result HttpParser::parse(Buffer *buf, HttpRequest *request)
+{
+    if (state_ == kExpectHeaders && scanned_ == 0)
+    {
+        // 请求之间多余的空行要忽略(RFC 7230 3.5) 有的客户端在POST请求体后面多发一个CRLF
+        while (buf->readableBytes() >= 2 && buf->peek()[0] == '\r' && buf->peek()[1] == '\n')
+        {
+            buf->retrieve(2);
+        }
+    }
+    const char *begin = buf->peek();
+    const size_t readable = buf->readableBytes();
+
+    if (state_ == kExpectHeaders)
+    {
+        const char *end = findHeaderEnd(begin + scanned_, begin + readable);
+        if (end == nullptr)
+        {
+            if (readable > maxHeaderBytes_)
+            {
+                return fail(431);
+            }
+            scanned_ = readable > 3 ? readable - 3 : 0; // 结尾可能是"\r\n\r"的一部分
+            return kIncomplete;
+        }
+        headerBytes_ = static_cast<size_t>(end - begin) + 4;
+        if (headerBytes_ > maxHeaderBytes_)
+        {
+            return fail(431);
+        }
+        request->reset();
+        if (!parseHeaders(begin, end, request))
+        {
+            return kError;
+        }
+        if (request->chunked_)
+        {
+            state_ = kExpectChunkSize;
+            chunkScan_ = headerBytes_;
+        }
+        else
+        {
+            state_ = kExpectBody;
+        }
+    }
+
+    if (state_ == kExpectBody)
+    {
+        size_t length = request->contentLength_ > 0 ? static_cast<size_t>(request->contentLength_) : 0;
+        if (readable < headerBytes_ + length)
+        {
+            return kIncomplete;
+        }
+        request->body_ = HttpRequest::Span{static_cast<uint32_t>(headerBytes_), static_cast<uint32_t>(length)};
+        request->contentLength_ = static_cast<int64_t>(length);
+        consumed_ = headerBytes_ + length;
+    }
+    else
+    {
+        // 就地解码要改写Buffer的可读区域 这段内存本来就归这个连接所有
+        Result result = parseChunked(const_cast<char *>(begin), readable, request);
+        if (result != kComplete)
+        {
+            return result;
+        }
+    }
+    request->base_ = begin;
+    return kComplete;
+}
+
+bool HttpParser::parseHeaders(const char *begin, const char *end, HttpRequest *request)
+{
+    const char *blockEnd = end + 2; // 最后一行头部的CRLF也算在内
+    const char *lineEnd = findCrlf(begin, blockEnd);
+    if (!parseRequestLine(begin, lineEnd, request))
+    {
+        return false;
+    }
+
+    const char *p = lineEnd + 2;
+    while (p < blockEnd)
+    {
+        const char *eol = findCrlf(p, blockEnd);
+        if (isSpace(*p))
+        {
+            errorStatus_ = 400; // 不支持已经废弃的头部折行
+            return false;
+        }
+        const char *colon = static_cast<const char *>(memchr(p, ':', eol - p));
+        if (colon == nullptr || colon == p || isSpace(colon[-1]))
+        {
+            errorStatus_ = 400;
+            return false;
+        }
+        if (request->headerCount_ == HttpRequest::kMaxHeaders)
+        {
+            errorStatus_ = 431;
+            return false;
+        }
+        StringPiece name(p, static_cast<size_t>(colon - p));
+        StringPiece value = trim(colon + 1, eol);
+        HttpRequest::HeaderSpan &span = request->headers_[request->headerCount_++];
+        span.name = HttpRequest::Span{static_cast<uint32_t>(p - begin), static_cast<uint32_t>(name.size())};
+        span.value = HttpRequest::Span{static_cast<uint32_t>(value.data() - begin), static_cast<uint32_t>(value.size())};
+        if (!onHeader(name, value, request))
+        {
+            return false;
+        }
+        p = eol + 2;
+    }
+
+    if (request->chunked_ && request->contentLength_ >= 0)
+    {
+        errorStatus_ = 400; // 两者同时出现可能是请求走私 直接拒绝
+        return false;
+    }
+    if (request->version_ == HttpRequest::kHttp11)
+    {
+        request->keepAlive_ = !connectionClose_;
+    }
+    else
+    {
+        request->keepAlive_ = connectionKeepAlive_ && !connectionClose_;
+    }
+    return true;
+}
+
+bool HttpParser::parseRequestLine(const char *begin, const char *end, HttpRequest *request)
+{
+    errorStatus_ = 400;
+    const char *space = static_cast<const char *>(memchr(begin, ' ', end - begin));
+    if (space == nullptr)
+    {
+        return false;
+    }
+    StringPiece method(begin, static_cast<size_t>(space - begin));
+    switch (method.size())
+    {
+    case 3:
+        if (method == "GET")
+            request->method_ = HttpRequest::kGet;
+        else if (method == "PUT")
+            request->method_ = HttpRequest::kPut;
+        break;
+    case 4:
+        if (method == "POST")
+            request->method_ = HttpRequest::kPost;
+        else if (method == "HEAD")
+            request->method_ = HttpRequest::kHead;
+        break;
+    case 5:
+        if (method == "PATCH")
+            request->method_ = HttpRequest::kPatch;
+        else if (method == "TRACE")
+            request->method_ = HttpRequest::kTrace;
+        break;
+    case 6:
+        if (method == "DELETE")
+            request->method_ = HttpRequest::kDelete;
+        break;
+    case 7:
+        if (method == "OPTIONS")
+            request->method_ = HttpRequest::kOptions;
+        else if (method == "CONNECT")
+            request->method_ = HttpRequest::kConnect;
+        break;
+    default:
+        break;
+    }
+    if (request->method_ == HttpRequest::kInvalid)
+    {
+        errorStatus_ = method.empty() ? 400 : 501;
+        return false;
+    }
+
+    const char *target = space + 1;
+    space = static_cast<const char *>(memchr(target, ' ', end - target));
+    if (space == nullptr || space == target)
+    {
+        return false;
+    }
+    const char *question = static_cast<const char *>(memchr(target, '?', space - target));
+    const char *pathEnd = question != nullptr ? question : space;
+    request->path_ = HttpRequest::Span{static_cast<uint32_t>(target - begin), static_cast<uint32_t>(pathEnd - target)};
+    if (question != nullptr)
+    {
+        request->query_ = HttpRequest::Span{static_cast<uint32_t>(question + 1 - begin),
+                                            static_cast<uint32_t>(space - question - 1)};
+    }
+
+    StringPiece version(space + 1, static_cast<size_t>(end - space - 1));
+    if (version == "HTTP/1.1")
+    {
+        request->version_ = HttpRequest::kHttp11;
+    }
+    else if (version == "HTTP/1.0")
+    {
+        request->version_ = HttpRequest::kHttp10;
+    }
+    else
+    {
+        errorStatus_ = version.startsWith("HTTP/") ? 505 : 400;
+        return false;
+    }
+    errorStatus_ = 0;
+    return true;
+}
+
+bool HttpParser::onHeader(const StringPiece &name, const StringPiece &value, HttpRequest *request)
+{
+    // 先按长度过滤 绝大多数头部只比较一次长度
+    switch (name.size())
+    {
+    case 14:
+        if (name.equalsIgnoreCase("Content-Length"))
+        {
+            if (value.empty())
+            {
+                errorStatus_ = 400;
+                return false;
+            }
+            int64_t length = 0;
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i] < '0' || value[i] > '9')
+                {
+                    errorStatus_ = 400;
+                    return false;
+                }
+                length = length * 10 + (value[i] - '0');
+                if (static_cast<uint64_t>(length) > maxBodyBytes_)
+                {
+                    errorStatus_ = 413;
+                    return false;
+                }
+            }
+            if (request->contentLength_ >= 0 && request->contentLength_ != length)
+            {
+                errorStatus_ = 400;
+                return false;
+            }
+            request->contentLength_ = length;
+        }
+        break;
+    case 17:
+        if (name.equalsIgnoreCase("Transfer-Encoding"))
+        {
+            // 只支持chunked作为最后一层编码 gzip等交给上层的代理处理
+            const char *comma = value.end();
+            while (comma > value.begin() && comma[-1] != ',')
+            {
+                --comma;
+            }
+            if (!trim(comma, value.end()).equalsIgnoreCase("chunked"))
+            {
+                errorStatus_ = 501;
+                return false;
+            }
+            request->chunked_ = true;
+        }
+        break;
+    case 10:
+        if (name.equalsIgnoreCase("Connection"))
+        {
+            if (hasToken(value, "close"))
+            {
+                connectionClose_ = true;
+            }
+            if (hasToken(value, "keep-alive"))
+            {
+                connectionKeepAlive_ = true;
+            }
+        }
+        break;
+    case 6:
+        if (name.equalsIgnoreCase("Expect") && value.equalsIgnoreCase("100-continue"))
+        {
+            request->expectContinue_ = true;
+        }
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+HttpParser::Result HttpParser::parseChunked(char *base, size_t readable, HttpRequest *request)
+{
+    // 分帧开销按最坏情况放宽一些 防止对端用无穷多的空扩展或trailer撑爆Buffer
+    if (readable > headerBytes_ + 2 * maxBodyBytes_ + maxHeaderBytes_)
+    {
+        return fail(413);
+    }
+    for (;;)
+    {
+        if (state_ == kExpectChunkData)
+        {
+            // 数据块往前搬到已解码数据的后面 可以只搬收到的那一部分
+            size_t avail = std::min(chunkRemaining_, readable - chunkScan_);
+            if (avail > 0)
+            {
+                memmove(base + headerBytes_ + bodyBytes_, base + chunkScan_, avail);
+                bodyBytes_ += avail;
+                chunkScan_ += avail;
+                chunkRemaining_ -= avail;
+            }
+            if (chunkRemaining_ > 0 || readable - chunkScan_ < 2)
+            {
+                return kIncomplete;
+            }
+            if (base[chunkScan_] != '\r' || base[chunkScan_ + 1] != '\n')
+            {
+                return fail(400);
+            }
+            chunkScan_ += 2;
+            state_ = kExpectChunkSize;
+            continue;
+        }
+
+        const char *line = base + chunkScan_;
+        const char *eol = findCrlf(line, base + readable);
+        if (eol == nullptr)
+        {
+            size_t pending = readable - chunkScan_;
+            if (state_ == kExpectChunkSize ? pending > kMaxChunkLine : pending > maxHeaderBytes_)
+            {
+                return fail(state_ == kExpectChunkSize ? 400 : 431);
+            }
+            return kIncomplete;
+        }
+        chunkScan_ = static_cast<size_t>(eol - base) + 2;
+
+        if (state_ == kExpectTrailers)
+        {
+            if (eol == line) // 空行 请求结束 trailer里的字段直接丢弃
+            {
+                consumed_ = chunkScan_;
+                request->body_ = HttpRequest::Span{static_cast<uint32_t>(headerBytes_), static_cast<uint32_t>(bodyBytes_)};
+                request->contentLength_ = static_cast<int64_t>(bodyBytes_);
+                return kComplete;
+            }
+            continue;
+        }
+
+        // 块大小 后面可以跟;扩展
+        size_t size = 0;
+        const char *p = line;
+        for (; p < eol; ++p)
+        {
+            int v = hexValue(*p);
+            if (v < 0)
+            {
+                break;
+            }
+            size = size * 16 + static_cast<size_t>(v);
+            if (size > maxBodyBytes_)
+            {
+                return fail(413);
+            }
+        }
+        if (p == line || (p < eol && *p != ';' && !isSpace(*p)))
+        {
+            return fail(400);
+        }
+        if (bodyBytes_ + size > maxBodyBytes_)
+        {
+            return fail(413);
+        }
+        if (size == 0)
+        {
+            state_ = kExpectTrailers;
+        }
+        else
+        {
+            chunkRemaining_ = size;
+            state_ = kExpectChunkData;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#include "HttpRequest.h"
+
+void HttpRequest::reset()
+{
+    base_ = nullptr;
+    method_ = kInvalid;
+    version_ = kUnknown;
+    path_ = Span{0, 0};
+    query_ = Span{0, 0};
+    body_ = Span{0, 0};
+    headerCount_ = 0;
+    keepAlive_ = false;
+    chunked_ = false;
+    expectContinue_ = false;
+    contentLength_ = -1;
+    receiveTime_ = Timestamp::invalid();
+}
+
+const char *HttpRequest::methodString() const
+{
+    switch (method_)
+    {
+    case kGet:
+        return "GET";
+    case kHead:
+        return "HEAD";
+    case kPost:
+        return "POST";
+    case kPut:
+        return "PUT";
+    case kDelete:
+        return "DELETE";
+    case kOptions:
+        return "OPTIONS";
+    case kPatch:
+        return "PATCH";
+    case kConnect:
+        return "CONNECT";
+    case kTrace:
+        return "TRACE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+StringPiece HttpRequest::getHeader(const StringPiece &name) const
+{
+    for (int i = 0; i < headerCount_; ++i)
+    {
+        if (headers_[i].name.length == name.size() && view(headers_[i].name).equalsIgnoreCase(name))
+        {
+            return view(headers_[i].value);
+        }
+    }
+    return StringPiece();
+}
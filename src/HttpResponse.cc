@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "HttpResponse.h"
+#include "HttpContext.h"
+
+// Date头部每秒格式化一次 同一秒内的响应直接拷贝
+static void appendDate(Buffer *output)
+{
+    thread_local time_t t_lastSecond = -1;
+    thread_local char t_date[64];
+    thread_local size_t t_dateLen = 0;
+
+    time_t now = ::time(nullptr);
+    if (now != t_lastSecond)
+    {
+        struct tm tm;
+        ::gmtime_r(&now, &tm);
+        t_dateLen = ::strftime(t_date, sizeof t_date, "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        t_lastSecond = now;
+    }
+    output->append(t_date, t_dateLen);
+}
+
+HttpResponse::HttpResponse()
+    : context_(nullptr)
+    , statusCode_(200)
+    , closeConnection_(false)
+    , http10_(false)
+    , chunked_(false)
+    , deferred_(false)
+    , headers_(256)
+    , body_(1024)
+    , fileFd_(-1)
+    , fileOffset_(0)
+    , fileCount_(0)
+    , closeFile_(false)
+{
+}
+
+HttpResponse::~HttpResponse()
+{
+    closeFileIfOwned();
+}
+
+void HttpResponse::reset(bool closeConnection, bool http10)
+{
+    closeFileIfOwned();
+    statusCode_ = 200;
+    closeConnection_ = closeConnection;
+    http10_ = http10;
+    chunked_ = false;
+    deferred_ = false;
+    headers_.retrieveAll();
+    body_.retrieveAll();
+}
+
+void HttpResponse::addHeader(const StringPiece &name, const StringPiece &value)
+{
+    headers_.append(name.data(), name.size());
+    headers_.append(": ", 2);
+    headers_.append(value.data(), value.size());
+    headers_.append("\r\n", 2);
+}
+
+void HttpResponse::setBody(const StringPiece &body)
+{
+    body_.retrieveAll();
+    body_.append(body.data(), body.size());
+}
+
+void HttpResponse::setFile(int fd, off_t offset, size_t count, bool closeFile)
+{
+    closeFileIfOwned();
+    fileFd_ = fd;
+    fileOffset_ = offset;
+    fileCount_ = count;
+    closeFile_ = closeFile;
+}
+
+void HttpResponse::closeFileIfOwned()
+{
+    if (fileFd_ >= 0 && closeFile_)
+    {
+        ::close(fileFd_);
+    }
+    fileFd_ = -1;
+}
+
+std::shared_ptr<HttpResponseWriter> HttpResponse::defer()
+{
+    deferred_ = true;
+    return context_->makeWriter();
+}
+
+void HttpResponse::appendHeaders(Buffer *output)
+{
+    char line[64];
+    int n = snprintf(line, sizeof line, "HTTP/1.1 %d %s\r\n", statusCode_, statusMessage(statusCode_));
+    output->append(line, static_cast<size_t>(n));
+    output->append(headers_.peek(), headers_.readableBytes());
+    appendDate(output);
+
+    // 1xx/204/304不能带响应体 也不发长度
+    if (statusCode_ >= 200 && statusCode_ != 204 && statusCode_ != 304)
+    {
+        if (chunked_ && !http10_)
+        {
+            output->append("Transfer-Encoding: chunked\r\n", 28);
+        }
+        else if (chunked_ && deferred_)
+        {
+            closeConnection_ = true; // HTTP/1.0不认识chunked 流式响应只能靠关闭连接来结束
+        }
+        else
+        {
+            size_t length = hasFile() ? fileCount_ : body_.readableBytes();
+            n = snprintf(line, sizeof line, "Content-Length: %zu\r\n", length);
+            output->append(line, static_cast<size_t>(n));
+        }
+    }
+    if (closeConnection_)
+    {
+        output->append("Connection: close\r\n\r\n", 21);
+    }
+    else
+    {
+        output->append("Connection: keep-alive\r\n\r\n", 26);
+    }
+}
+
+void HttpResponse::appendToBuffer(Buffer *output, bool omitBody)
+{
+    appendHeaders(output);
+    if (omitBody || hasFile() || statusCode_ < 200 || statusCode_ == 204 || statusCode_ == 304)
+    {
+        return;
+    }
+    if (chunked_ && !http10_)
+    {
+        if (body_.readableBytes() > 0)
+        {
+            appendChunk(output, body_.peek(), body_.readableBytes());
+        }
+        output->append("0\r\n\r\n", 5);
+    }
+    else
+    {
+        output->append(body_.peek(), body_.readableBytes());
+    }
+}
+
+void HttpResponse::appendChunk(Buffer *output, const char *data, size_t len)
+{
+    char line[32];
+    int n = snprintf(line, sizeof line, "%zx\r\n", len);
+    output->append(line, static_cast<size_t>(n));
+    output->append(data, len);
+    output->append("\r\n", 2);
+}
+
+const char *HttpResponse::statusMessage(int code)
+{
+    switch (code)
+    {
+    case 100: return "Continue";
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 416: return "Range Not Satisfiable";
+    case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Unknown";
+    }
+}
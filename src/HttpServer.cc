@@ -0,0 +1,54 @@
+#include <functional>
+
+#include "HttpServer.h"
+#include "Logger.h"
+
+static void defaultHttpCallback(const HttpRequest &, HttpResponse *response)
+{
+    response->setStatusCode(404);
+    response->setContentType("text/plain");
+    response->setBody("Not Found\n");
+}
+
+HttpServer::HttpServer(EventLoop *loop,
+                       const InetAddress &listenAddr,
+                       const std::string &name,
+                       TcpServer::Option option)
+    : loop_(loop)
+    , server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+{
+    server_.setConnectionCallback(
+        std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&HttpServer::onMessage, this, std::placeholders::_1,
+                  std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer starts listening, max header %zu bytes, max body %zu bytes\n",
+             options_.maxHeaderBytes, options_.maxBodyBytes);
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true); // 响应已经在应用层合并过了 不需要再等Nagle
+        conn->setContext(std::make_shared<HttpContext>(conn, httpCallback_,
+                                                       options_.maxHeaderBytes, options_.maxBodyBytes));
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+    if (context == nullptr)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    context->onMessage(conn, buf, receiveTime);
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <stddef.h>
+#include <stdio.h>
 #include <strings.h>
 #include <string.h>
 
@@ -5,41 +8,148 @@
 
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
-    ::memset(&addr_, 0, sizeof(addr_));
-    addr_.sin_family = AF_INET;
-    addr_.sin_port = ::htons(port); // 本地字节序转为网络字节序
-    addr_.sin_addr.s_addr = ::inet_addr(ip.c_str());
+    ::memset(&unix_, 0, sizeof(unix_));
+    if (ip.find(':') != std::string::npos)
+    {
+        addr6_.sin6_family = AF_INET6;
+        addr6_.sin6_port = ::htons(port);
+        ::inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr);
+        len_ = sizeof(sockaddr_in6);
+    }
+    else
+    {
+        addr_.sin_family = AF_INET;
+        addr_.sin_port = ::htons(port); // 本地字节序转为网络字节序
+        addr_.sin_addr.s_addr = ::inet_addr(ip.c_str());
+        len_ = sizeof(sockaddr_in);
+    }
+}
+
+InetAddress::InetAddress(const sockaddr_in &addr)
+{
+    setSockAddr(addr);
+}
+
+InetAddress::InetAddress(const sockaddr_in6 &addr)
+{
+    setSockAddr(reinterpret_cast<const sockaddr *>(&addr), sizeof addr);
+}
+
+InetAddress::InetAddress(const sockaddr *addr, socklen_t len)
+{
+    setSockAddr(addr, len);
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string &path)
+{
+    sockaddr_un addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    size_t n = std::min(path.size(), sizeof(addr.sun_path) - 1);
+    ::memcpy(addr.sun_path, path.data(), n);
+    // 路径地址的长度包含结尾的'\0'
+    return InetAddress(reinterpret_cast<const sockaddr *>(&addr),
+                       static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + n + 1));
+}
+
+InetAddress InetAddress::fromAbstract(const std::string &name)
+{
+    sockaddr_un addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    size_t n = std::min(name.size(), sizeof(addr.sun_path) - 1);
+    ::memcpy(addr.sun_path + 1, name.data(), n);
+    // 抽象命名以'\0'开头 长度必须精确 后面多出来的'\0'也会被当成名字的一部分
+    return InetAddress(reinterpret_cast<const sockaddr *>(&addr),
+                       static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + n));
+}
+
+void InetAddress::setSockAddr(const sockaddr_in &addr)
+{
+    ::memset(&unix_, 0, sizeof(unix_));
+    addr_ = addr;
+    len_ = sizeof(sockaddr_in);
+}
+
+void InetAddress::setSockAddr(const sockaddr *addr, socklen_t len)
+{
+    ::memset(&unix_, 0, sizeof(unix_));
+    len = std::min(len, static_cast<socklen_t>(sizeof(unix_)));
+    ::memcpy(&unix_, addr, len);
+    len_ = len;
+    if (len_ < sizeof(sa_family_t))
+    {
+        // 对端是未命名的Unix域socket时 accept可能只返回地址族
+        unix_.sun_family = addr->sa_family;
+        len_ = sizeof(sa_family_t);
+    }
+}
+
+bool InetAddress::isAbstract() const
+{
+    return isUnix() && (len_ <= offsetof(sockaddr_un, sun_path) || unix_.sun_path[0] == '\0');
 }
 
 std::string InetAddress::toIp() const
 {
-    // addr_
-    char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
-    return buf;
+    char buf[INET6_ADDRSTRLEN] = {0};
+    switch (family())
+    {
+    case AF_INET:
+        ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+        return buf;
+    case AF_INET6:
+        ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, sizeof buf);
+        return buf;
+    case AF_UNIX:
+    {
+        size_t pathLen = len_ > offsetof(sockaddr_un, sun_path) ? len_ - offsetof(sockaddr_un, sun_path) : 0;
+        if (pathLen == 0)
+        {
+            return "@"; // 未命名
+        }
+        if (unix_.sun_path[0] == '\0')
+        {
+            return "@" + std::string(unix_.sun_path + 1, pathLen - 1);
+        }
+        return std::string(unix_.sun_path, ::strnlen(unix_.sun_path, pathLen));
+    }
+    default:
+        return "";
+    }
 }
 
 std::string InetAddress::toIpPort() const
 {
     // ip:port
     char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
-    size_t end = ::strlen(buf);
-    uint16_t port = ::ntohs(addr_.sin_port);
-    sprintf(buf+end, ":%u", port);
-    return buf;
+    switch (family())
+    {
+    case AF_INET:
+        ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+        snprintf(buf + ::strlen(buf), sizeof buf - ::strlen(buf), ":%u", toPort());
+        return buf;
+    case AF_INET6:
+        buf[0] = '[';
+        ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf + 1, sizeof buf - 1);
+        snprintf(buf + ::strlen(buf), sizeof buf - ::strlen(buf), "]:%u", toPort());
+        return buf;
+    case AF_UNIX:
+        return "unix:" + toIp();
+    default:
+        return "";
+    }
 }
 
 uint16_t InetAddress::toPort() const
 {
-    return ::ntohs(addr_.sin_port);
-}
-
-#if 0
-#include <iostream>
-int main()
-{
-    InetAddress addr(8080);
-    std::cout << addr.toIpPort() << std::endl;
+    switch (family())
+    {
+    case AF_INET:
+        return ::ntohs(addr_.sin_port);
+    case AF_INET6:
+        return ::ntohs(addr6_.sin6_port);
+    default:
+        return 0;
+    }
 }
-#endif
\ No newline at end of file
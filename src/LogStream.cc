@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "LogStream.h"
+
+namespace
+{
+const char kDigits[] = "9876543210123456789";
+const char *const kZero = kDigits + 9; // 指向'0' 负数的余数也可以直接查表
+const char kDigitsHex[] = "0123456789abcdef";
+
+// 整数转字符串 比snprintf快很多 返回写入的长度
+template <typename T>
+size_t convert(char buf[], T value)
+{
+    T i = value;
+    char *p = buf;
+    do
+    {
+        int lsd = static_cast<int>(i % 10);
+        i /= 10;
+        *p++ = kZero[lsd];
+    } while (i != 0);
+
+    if (value < 0)
+    {
+        *p++ = '-';
+    }
+    *p = '\0';
+    std::reverse(buf, p);
+    return static_cast<size_t>(p - buf);
+}
+
+size_t convertHex(char buf[], uintptr_t value)
+{
+    uintptr_t i = value;
+    char *p = buf;
+    do
+    {
+        int lsd = static_cast<int>(i % 16);
+        i /= 16;
+        *p++ = kDigitsHex[lsd];
+    } while (i != 0);
+    *p = '\0';
+    std::reverse(buf, p);
+    return static_cast<size_t>(p - buf);
+}
+
+const size_t kMaxNumericSize = 48;
+} // namespace
+
+template <typename T>
+LogStream &LogStream::formatInteger(T v)
+{
+    if (avail() >= kMaxNumericSize)
+    {
+        add(convert(cur_, v));
+    }
+    return *this;
+}
+
+LogStream &LogStream::operator<<(int v) { return formatInteger(v); }
+LogStream &LogStream::operator<<(unsigned int v) { return formatInteger(v); }
+LogStream &LogStream::operator<<(long v) { return formatInteger(v); }
+LogStream &LogStream::operator<<(unsigned long v) { return formatInteger(v); }
+LogStream &LogStream::operator<<(long long v) { return formatInteger(v); }
+LogStream &LogStream::operator<<(unsigned long long v) { return formatInteger(v); }
+
+LogStream &LogStream::operator<<(double v)
+{
+    if (avail() >= kMaxNumericSize)
+    {
+        add(static_cast<size_t>(snprintf(cur_, kMaxNumericSize, "%.12g", v)));
+    }
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const void *p)
+{
+    if (avail() >= kMaxNumericSize)
+    {
+        cur_[0] = '0';
+        cur_[1] = 'x';
+        add(convertHex(cur_ + 2, reinterpret_cast<uintptr_t>(p)) + 2);
+    }
+    return *this;
+}
@@ -1,8 +1,112 @@
-#include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 #include "Logger.h"
 #include "Timestamp.h"
 
+std::atomic<int> g_logLevel(INFO);
+
+namespace
+{
+const char *const kLevelNames[NUM_LOG_LEVELS] = {"[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]"};
+const size_t kLevelNameLens[NUM_LOG_LEVELS] = {7, 6, 7, 7};
+
+// LogMessage嵌套的最大层数 超过之后共用最后一块缓冲区 内容可能被覆盖但不会越界
+const int kMaxNesting = 4;
+
+thread_local char t_lineBuffers[kMaxNesting + 1][Logger::kMaxLineSize];
+thread_local int t_depth = 0;
+
+// 所有LogModule的注册表 只在注册、注销和修改阈值时加锁 写日志的路径上不访问
+struct ModuleRegistry
+{
+    std::mutex mutex;
+    std::vector<LogModule *> modules;
+};
+
+ModuleRegistry &registry()
+{
+    static ModuleRegistry r;
+    return r;
+}
+
+int parseLevel(const char *name)
+{
+    for (int i = 0; i < NUM_LOG_LEVELS; ++i)
+    {
+        // 去掉kLevelNames里的方括号再比较
+        if (::strncasecmp(name, kLevelNames[i] + 1, kLevelNameLens[i] - 2) == 0 &&
+            name[kLevelNameLens[i] - 2] == '\0')
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 启动时读取环境变量 MUDUO_LOG_LEVEL
+struct LogLevelFromEnv
+{
+    LogLevelFromEnv()
+    {
+        const char *env = ::getenv("MUDUO_LOG_LEVEL");
+        int level = env ? parseLevel(env) : -1;
+        if (level >= 0)
+        {
+            Logger::setLogLevel(level);
+        }
+    }
+} s_logLevelFromEnv;
+} // namespace
+
+LogModule::LogModule(const char *name)
+    : name_(name)
+    , level_(g_logLevel.load(std::memory_order_relaxed))
+    , overridden_(false)
+{
+    ModuleRegistry &r = registry();
+    std::unique_lock<std::mutex> lock(r.mutex);
+    r.modules.push_back(this);
+    // 注册期间全局阈值可能被修改过 以加锁后的值为准
+    level_.store(g_logLevel.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+LogModule::~LogModule()
+{
+    ModuleRegistry &r = registry();
+    std::unique_lock<std::mutex> lock(r.mutex);
+    r.modules.erase(std::remove(r.modules.begin(), r.modules.end(), this), r.modules.end());
+}
+
+void LogModule::setLevel(int level)
+{
+    std::unique_lock<std::mutex> lock(registry().mutex);
+    overridden_ = true;
+    level_.store(level, std::memory_order_relaxed);
+}
+
+void LogModule::followGlobal()
+{
+    std::unique_lock<std::mutex> lock(registry().mutex);
+    overridden_ = false;
+    level_.store(g_logLevel.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+static void defaultOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+    ::fflush(stdout);
+}
+
 // 获取日志唯一的实例对象 单例
 Logger &Logger::instance()
 {
@@ -10,34 +114,133 @@ Logger &Logger::instance()
     return logger;
 }
 
-// 设置日志级别
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
+
+// 设置全局日志级别 同步到没有单独设置过阈值的模块
 void Logger::setLogLevel(int level)
 {
-    logLevel_ = level;
+    ModuleRegistry &r = registry();
+    std::unique_lock<std::mutex> lock(r.mutex);
+    g_logLevel.store(level, std::memory_order_relaxed);
+    for (LogModule *module : r.modules)
+    {
+        if (!module->overridden_)
+        {
+            module->level_.store(level, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Logger::setModuleLevel(const std::string &name, int level)
+{
+    std::vector<LogModule *> matched;
+    {
+        ModuleRegistry &r = registry();
+        std::unique_lock<std::mutex> lock(r.mutex);
+        for (LogModule *module : r.modules)
+        {
+            if (name == module->name())
+            {
+                matched.push_back(module);
+            }
+        }
+    }
+    for (LogModule *module : matched)
+    {
+        module->setLevel(level);
+    }
+    return !matched.empty();
+}
+
+const char *Logger::levelName(int level)
+{
+    return level >= 0 && level < NUM_LOG_LEVELS ? kLevelNames[level] : "[UNKNOWN]";
+}
+
+// [级别信息]time :
+size_t Logger::formatPrefix(int level, char *buf, size_t size)
+{
+    if (size < 64 || level < 0 || level >= NUM_LOG_LEVELS)
+    {
+        return 0;
+    }
+    size_t n = kLevelNameLens[level];
+    ::memcpy(buf, kLevelNames[level], n);
+    n += Timestamp::now().formatTo(buf + n, size - n); // 年月日时分秒按秒缓存 每行只拼微秒
+    ::memcpy(buf + n, " : ", 3);
+    return n + 3;
+}
+
+// 写日志 [级别信息]time : msg
+void Logger::logf(int level, const char *fmt, ...)
+{
+    // 借用LogMessage的线程局部缓冲区 logf内部不会再写日志 不需要修改嵌套层数
+    char *line = t_lineBuffers[std::min(t_depth, kMaxNesting)];
+    size_t len = formatPrefix(level, line, kMaxLineSize);
+
+    // 一行是一个整体交给output_ 末尾至少留出换行符的位置
+    va_list args;
+    va_start(args, fmt);
+    int n = ::vsnprintf(line + len, kMaxLineSize - len - 1, fmt, args);
+    va_end(args);
+    if (n > 0)
+    {
+        len += std::min(static_cast<size_t>(n), kMaxLineSize - len - 2);
+    }
+    if (len == 0 || line[len - 1] != '\n')
+    {
+        line[len++] = '\n';
+    }
+    output_(line, len);
 }
 
-// 写日志 [级别信息] time : msg
-void Logger::log(std::string msg)
+void Logger::flush()
 {
-    std::string pre = "";
-    switch (logLevel_)
+    if (flush_)
     {
-    case INFO:
-        pre = "[INFO]";
-        break;
-    case ERROR:
-        pre = "[ERROR]";
-        break;
-    case FATAL:
-        pre = "[FATAL]";
-        break;
-    case DEBUG:
-        pre = "[DEBUG]";
-        break;
-    default:
-        break;
+        flush_();
     }
+}
+
+char *LogMessage::acquireBuffer()
+{
+    return t_lineBuffers[std::min(t_depth++, kMaxNesting)];
+}
+
+void LogMessage::releaseBuffer()
+{
+    --t_depth;
+}
 
-    // 打印时间和msg
-    std::cout << pre + Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+LogMessage::LogMessage(int level, const char *file, int line)
+    : level_(level)
+    , file_(file)
+    , line_(line)
+    , stream_(acquireBuffer(), Logger::kMaxLineSize - 1) // 留一个字节给结尾的换行
+{
+    stream_.add(Logger::formatPrefix(level, stream_.current(), stream_.avail()));
+}
+
+LogMessage::~LogMessage()
+{
+    // ERROR和FATAL附上源文件位置
+    if (level_ >= ERROR)
+    {
+        const char *slash = ::strrchr(file_, '/');
+        stream_ << " - " << (slash ? slash + 1 : file_) << ':' << line_;
+    }
+    char *end = stream_.current();
+    *end = '\n';
+    Logger &logger = Logger::instance();
+    logger.output(stream_.data(), stream_.length() + 1);
+    releaseBuffer();
+    if (level_ == FATAL)
+    {
+        logger.flush();
+        ::exit(-1);
+    }
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "LoopWatchdog.h"
+#include "CurrentThread.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+namespace
+{
+const int kMaxFrames = 64;
+
+// 同一时刻只抓一个线程的调用栈 由captureMutex保护 信号处理函数只访问这里的原子变量和数组
+struct StackCapture
+{
+    std::atomic<int> tid{0};
+    std::atomic<int> depth{-1};
+    void *frames[kMaxFrames];
+};
+
+StackCapture g_capture;
+std::mutex g_captureMutex;
+
+void captureStackHandler(int)
+{
+    int savedErrno = errno;
+    if (g_capture.tid.load(std::memory_order_acquire) == CurrentThread::tid())
+    {
+        int depth = ::backtrace(g_capture.frames, kMaxFrames);
+        g_capture.depth.store(depth, std::memory_order_release);
+    }
+    errno = savedErrno;
+}
+} // namespace
+
+LoopWatchdog::LoopWatchdog(double threshold, double interval)
+    : threshold_(threshold)
+    , interval_(interval > 0 ? interval : threshold / 4)
+    , captureStack_(false)
+    , stackSignal_(SIGURG)
+    , stalls_(0)
+    , stallsMetric_(metrics::Registry::instance().counter(
+          "muduo_eventloop_stalls_total", "Event loop stalls reported by LoopWatchdog."))
+    , running_(false)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop *loop)
+{
+    Watched w;
+    w.activity = loop->activity();
+    w.seq = 0;
+    w.sinceNs = 0;
+    w.reported = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    watched_.push_back(w);
+}
+
+void LoopWatchdog::setCaptureStack(bool on, int stackSignal)
+{
+    captureStack_ = on;
+    if (stackSignal > 0)
+    {
+        stackSignal_ = stackSignal;
+    }
+}
+
+void LoopWatchdog::start()
+{
+    if (captureStack_)
+    {
+        // backtrace第一次调用时会加载libgcc 在信号处理函数里做不安全 先在这里调用一次
+        void *frames[2];
+        ::backtrace(frames, 2);
+        struct sigaction sa;
+        ::memset(&sa, 0, sizeof sa);
+        sa.sa_handler = captureStackHandler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (::sigaction(stackSignal_, &sa, nullptr) < 0)
+        {
+            LOG_ERROR("LoopWatchdog::start sigaction(%d) err:%d\n", stackSignal_, errno);
+            captureStack_ = false;
+        }
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        running_ = true;
+        thread_ = std::thread(&LoopWatchdog::threadFunc, this);
+    }
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_all();
+    }
+    thread_.join();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(interval_ * 1e6)));
+        if (!running_)
+        {
+            break;
+        }
+        // 只有看门狗还持有的LoopActivity说明loop已经析构了
+        watched_.erase(std::remove_if(watched_.begin(), watched_.end(),
+                                      [](const Watched &w) { return w.activity.use_count() == 1; }),
+                       watched_.end());
+        std::vector<Watched> watched;
+        watched.swap(watched_);
+        lock.unlock(); // 报告回调和抓调用栈可能比较慢 不能挡住watch()
+        int64_t nowNs = MonotonicTime::now().nanoSeconds();
+        for (Watched &w : watched)
+        {
+            check(&w, nowNs);
+        }
+        lock.lock();
+        watched.insert(watched.end(), watched_.begin(), watched_.end()); // 检查期间新加入的
+        watched_.swap(watched);
+    }
+}
+
+void LoopWatchdog::check(Watched *w, int64_t nowNs)
+{
+    LoopActivity *activity = w->activity.get();
+    uint64_t seq = activity->seq.load(std::memory_order_acquire);
+    int kind = activity->kind.load(std::memory_order_relaxed);
+    if (seq != w->seq || (seq & 1) != 0 || kind == LoopActivity::kPolling || kind == LoopActivity::kNotLooping)
+    {
+        w->seq = seq;
+        w->sinceNs = nowNs;
+        w->reported = false;
+        return;
+    }
+    if (w->reported || nowNs - w->sinceNs < static_cast<int64_t>(threshold_ * 1e9))
+    {
+        return;
+    }
+
+    Stall stall;
+    stall.tid = activity->tid;
+    stall.kind = LoopActivity::kindName(kind);
+    stall.fd = activity->fd.load(std::memory_order_relaxed);
+    stall.seconds = static_cast<double>(nowNs - w->sinceNs) / 1e9;
+    // 名字是loop线程拷贝在LoopActivity里的 不会访问已经销毁的连接
+    char label[LoopActivity::kLabelSize];
+    if (!activity->readLabel(seq, label))
+    {
+        return; // 读的期间回调已经返回了 不算卡住
+    }
+    stall.label = label;
+    if (captureStack_)
+    {
+        // 信号可能让回调里的sleep/poll等调用提前返回EINTR 所以放在确认卡住之后
+        stall.stack = captureStack(stall.tid);
+    }
+    w->reported = true;
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+    stallsMetric_.inc();
+
+    if (stallCallback_)
+    {
+        stallCallback_(stall);
+        return;
+    }
+    LOG_ERROR("LoopWatchdog: loop thread %d stuck in %s fd=%d %s for %.3f s\n", stall.tid, stall.kind.c_str(),
+              stall.fd, stall.label.c_str(), stall.seconds);
+    for (const std::string &frame : stall.stack)
+    {
+        LOG_ERROR("    %s\n", frame.c_str());
+    }
+}
+
+std::vector<std::string> LoopWatchdog::captureStack(int tid)
+{
+    std::vector<std::string> stack;
+    std::unique_lock<std::mutex> lock(g_captureMutex);
+    g_capture.depth.store(-1, std::memory_order_relaxed);
+    g_capture.tid.store(tid, std::memory_order_release);
+    if (::syscall(SYS_tgkill, ::getpid(), tid, stackSignal_) < 0)
+    {
+        g_capture.tid.store(0, std::memory_order_relaxed);
+        return stack;
+    }
+    int depth = -1;
+    for (int i = 0; i < 100 && (depth = g_capture.depth.load(std::memory_order_acquire)) < 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    g_capture.tid.store(0, std::memory_order_relaxed);
+    if (depth <= 0)
+    {
+        return stack; // 线程在100ms内没有处理信号 例如屏蔽了这个信号
+    }
+    char **symbols = ::backtrace_symbols(g_capture.frames, depth);
+    if (symbols == nullptr)
+    {
+        return stack;
+    }
+    // 前两帧是信号处理函数和内核的信号跳板
+    for (int i = std::min(depth, 2); i < depth; ++i)
+    {
+        stack.push_back(symbols[i]);
+    }
+    ::free(symbols);
+    return stack;
+}
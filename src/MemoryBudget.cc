@@ -0,0 +1,169 @@
+#include <algorithm>
+
+#include "MemoryBudget.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+MemoryBudget::MemoryBudget(size_t limitBytes, int policy, size_t batchBytes)
+    : limit_(limitBytes)
+    , hardLimit_(static_cast<int64_t>(limitBytes + limitBytes / 4))
+    , policy_(policy)
+    , batchBytes_(std::max<size_t>(1, std::min(batchBytes, limitBytes / 64))) // 预算很小时缩小批量 避免误差淹没预算本身
+    , usage_(0)
+    , pausing_(false)
+    , rejected_(0)
+    , paused_(0)
+    , closed_(0)
+{
+}
+
+MemoryBudget::~MemoryBudget()
+{
+}
+
+std::shared_ptr<LoopMemoryAccount> MemoryBudget::createAccount(EventLoop *loop)
+{
+    std::shared_ptr<LoopMemoryAccount> account(new LoopMemoryAccount(loop, shared_from_this()));
+    std::unique_lock<std::mutex> lock(mutex_);
+    accounts_.push_back(account); // 这里只保存weak_ptr 避免和LoopMemoryAccount::budget_形成循环引用
+    return account;
+}
+
+void MemoryBudget::addUsage(int64_t delta)
+{
+    int64_t now = usage_.fetch_add(delta, std::memory_order_relaxed) + delta;
+    // 只有把pausing_从true翻转为false的那个线程负责广播恢复
+    if (now < resumeMark() && pausing_.load(std::memory_order_relaxed) && pausing_.exchange(false))
+    {
+        resumeAll();
+    }
+}
+
+void MemoryBudget::resumeAll()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const std::weak_ptr<LoopMemoryAccount> &weak : accounts_)
+    {
+        std::shared_ptr<LoopMemoryAccount> account = weak.lock();
+        if (account)
+        {
+            // 每个loop只能在自己的线程里恢复自己的连接
+            account->loop()->queueInLoop([account]() { account->resumeReading(); });
+        }
+    }
+}
+
+LoopMemoryAccount::LoopMemoryAccount(EventLoop *loop, const std::shared_ptr<MemoryBudget> &budget)
+    : loop_(loop)
+    , budget_(budget)
+    , pending_(0)
+{
+}
+
+void LoopMemoryAccount::add(TcpConnection *conn)
+{
+    connections_.insert(conn);
+}
+
+void LoopMemoryAccount::remove(TcpConnection *conn)
+{
+    int64_t held = static_cast<int64_t>(conn->bufferedBytes());
+    connections_.erase(conn);
+    paused_.erase(conn);
+    if (held != 0)
+    {
+        update(-held);
+    }
+}
+
+void LoopMemoryAccount::update(int64_t delta)
+{
+    pending_ += delta;
+    const int64_t batch = static_cast<int64_t>(budget_->batchBytes());
+    if (pending_ >= batch || pending_ <= -batch)
+    {
+        flush();
+    }
+}
+
+void LoopMemoryAccount::flush()
+{
+    budget_->addUsage(pending_);
+    pending_ = 0;
+    if (budget_->overBudget())
+    {
+        enforce();
+    }
+}
+
+// 超出预算时 从本loop占用最多的连接开始处理 直到处理掉的连接所持有的字节数覆盖超出的部分
+void LoopMemoryAccount::enforce()
+{
+    const int64_t overrun = budget_->usage() - static_cast<int64_t>(budget_->limit());
+    const bool pause = budget_->hasPolicy(MemoryBudget::kPauseReading);
+    const bool close = budget_->hasPolicy(MemoryBudget::kCloseLargest) && (!pause || budget_->overHardLimit());
+    if (overrun <= 0 || (!pause && !close))
+    {
+        return;
+    }
+
+    std::vector<TcpConnection *> candidates;
+    for (TcpConnection *conn : connections_)
+    {
+        // 已经暂停的连接不会再增长 除非需要关闭连接 否则不用再挑它
+        if (conn->connected() && conn->bufferedBytes() > 0 && (close || paused_.count(conn) == 0))
+        {
+            candidates.push_back(conn);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](TcpConnection *a, TcpConnection *b) { return a->bufferedBytes() > b->bufferedBytes(); });
+
+    int64_t covered = 0;
+    int count = 0;
+    for (TcpConnection *conn : candidates)
+    {
+        if (covered >= overrun)
+        {
+            break;
+        }
+        covered += static_cast<int64_t>(conn->bufferedBytes());
+        ++count;
+        if (close)
+        {
+            LOG_ERROR("LoopMemoryAccount::enforce close [%s] buffered=%lu usage=%ld\n",
+                      conn->name().c_str(), conn->bufferedBytes(), budget_->usage());
+            conn->forceClose();
+        }
+        else
+        {
+            conn->stopRead();
+            paused_.insert(conn);
+        }
+    }
+
+    if (count > 0)
+    {
+        if (close)
+        {
+            budget_->countClosed(count);
+        }
+        else
+        {
+            budget_->countPaused(count);
+        }
+    }
+}
+
+void LoopMemoryAccount::resumeReading()
+{
+    for (TcpConnection *conn : paused_)
+    {
+        if (conn->connected())
+        {
+            conn->startRead();
+        }
+    }
+    paused_.clear();
+}
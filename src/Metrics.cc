@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "Metrics.h"
+#include "Logger.h"
+
+namespace metrics
+{
+
+namespace detail
+{
+thread_local std::atomic<int64_t> *t_cells = nullptr;
+
+namespace
+{
+// 线程退出时把本线程的计数单元交还给注册表
+// t_cells本身是平凡类型 热路径上访问它不需要thread_local的初始化检查 只有这个对象带析构函数
+struct ThreadCells
+{
+    ~ThreadCells()
+    {
+        if (cells != nullptr)
+        {
+            t_cells = nullptr;
+            Registry::instance().detach(cells);
+            delete[] cells;
+        }
+    }
+
+    std::atomic<int64_t> *cells = nullptr;
+};
+
+thread_local ThreadCells t_threadCells;
+} // namespace
+
+std::atomic<int64_t> *attachThread()
+{
+    std::atomic<int64_t> *cells = new std::atomic<int64_t>[kMaxCells];
+    for (size_t i = 0; i < kMaxCells; ++i)
+    {
+        cells[i].store(0, std::memory_order_relaxed);
+    }
+    Registry::instance().attach(cells);
+    t_threadCells.cells = cells;
+    t_cells = cells;
+    return cells;
+}
+} // namespace detail
+
+int64_t Counter::value() const
+{
+    return slot_ == 0 ? 0 : Registry::instance().sum(slot_);
+}
+
+int64_t Gauge::value() const
+{
+    return slot_ == 0 ? 0 : Registry::instance().sum(slot_);
+}
+
+int64_t Histogram::count() const
+{
+    int64_t total = 0;
+    if (bounds_ != nullptr)
+    {
+        for (size_t i = 0; i <= bounds_->size(); ++i)
+        {
+            total += Registry::instance().sum(slot_ + i);
+        }
+    }
+    return total;
+}
+
+int64_t Histogram::sum() const
+{
+    return bounds_ == nullptr ? 0 : Registry::instance().sum(slot_ + bounds_->size() + 1);
+}
+
+Registry &Registry::instance()
+{
+    // 故意不释放 其他静态对象析构和线程退出时仍然可能更新指标
+    static Registry *registry = new Registry;
+    return *registry;
+}
+
+Registry::Registry()
+    : retired_(kMaxCells, 0)
+    , nextSlot_(1)
+    , nextFunctionId_(1)
+{
+}
+
+Registry::Family *Registry::findFamily(const std::string &name, const std::string &help, Type type)
+{
+    auto it = familyIndex_.find(name);
+    if (it != familyIndex_.end())
+    {
+        if (it->second->type != type)
+        {
+            LOG_ERROR("metrics::Registry %s registered again with another type\n", name.c_str());
+            return nullptr;
+        }
+        return it->second;
+    }
+    std::unique_ptr<Family> family(new Family);
+    family->name = name;
+    family->help = help;
+    family->type = type;
+    Family *raw = family.get();
+    families_.push_back(std::move(family));
+    familyIndex_[name] = raw;
+    return raw;
+}
+
+Registry::Series *Registry::findSeries(Family *family, const std::string &labels, size_t width)
+{
+    for (Series &series : family->series)
+    {
+        if (series.labels == labels && series.functionId == 0)
+        {
+            return &series;
+        }
+    }
+    if (nextSlot_ + width > kMaxCells)
+    {
+        LOG_ERROR("metrics::Registry out of cells, %s{%s} is not exported\n", family->name.c_str(), labels.c_str());
+        return nullptr;
+    }
+    family->series.emplace_back();
+    Series &series = family->series.back();
+    series.labels = labels;
+    series.slot = nextSlot_;
+    series.scale = 1.0;
+    series.functionId = 0;
+    nextSlot_ += width;
+    return &series;
+}
+
+Counter Registry::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Family *family = findFamily(name, help, kCounter);
+    Series *series = family != nullptr ? findSeries(family, labels, 1) : nullptr;
+    return series != nullptr ? Counter(series->slot) : Counter();
+}
+
+Gauge Registry::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Family *family = findFamily(name, help, kGauge);
+    Series *series = family != nullptr ? findSeries(family, labels, 1) : nullptr;
+    return series != nullptr ? Gauge(series->slot) : Gauge();
+}
+
+Histogram Registry::histogram(const std::string &name, const std::string &help, const std::vector<int64_t> &bounds,
+                              double scale, const std::string &labels)
+{
+    if (bounds.empty() || !std::is_sorted(bounds.begin(), bounds.end()))
+    {
+        LOG_ERROR("metrics::Registry histogram %s needs ascending bounds\n", name.c_str());
+        return Histogram();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    Family *family = findFamily(name, help, kHistogram);
+    Series *series = family != nullptr ? findSeries(family, labels, bounds.size() + 2) : nullptr;
+    if (series == nullptr)
+    {
+        return Histogram();
+    }
+    if (!series->bounds)
+    {
+        series->bounds.reset(new std::vector<int64_t>(bounds));
+        series->scale = scale;
+    }
+    else if (*series->bounds != bounds)
+    {
+        LOG_ERROR("metrics::Registry histogram %s{%s} registered again with other bounds\n",
+                  name.c_str(), labels.c_str());
+    }
+    return Histogram(series->slot, series->bounds.get());
+}
+
+int Registry::addGaugeFunction(const std::string &name, const std::string &help, const std::string &labels,
+                               const GaugeFunction &fn)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Family *family = findFamily(name, help, kGauge);
+    if (family == nullptr)
+    {
+        return 0;
+    }
+    family->series.emplace_back();
+    Series &series = family->series.back();
+    series.labels = labels;
+    series.slot = 0;
+    series.scale = 1.0;
+    series.functionId = nextFunctionId_++;
+    series.function = fn;
+    return series.functionId;
+}
+
+void Registry::removeGaugeFunction(int id)
+{
+    if (id == 0)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto &family : families_)
+    {
+        std::vector<Series> &series = family->series;
+        for (auto it = series.begin(); it != series.end(); ++it)
+        {
+            if (it->functionId == id)
+            {
+                series.erase(it);
+                return;
+            }
+        }
+    }
+}
+
+void Registry::attach(std::atomic<int64_t> *cells)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    threads_.push_back(cells);
+}
+
+void Registry::detach(std::atomic<int64_t> *cells)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < kMaxCells; ++i)
+    {
+        retired_[i] += cells[i].load(std::memory_order_relaxed);
+    }
+    threads_.erase(std::remove(threads_.begin(), threads_.end(), cells), threads_.end());
+}
+
+int64_t Registry::sumLocked(size_t slot) const
+{
+    int64_t total = retired_[slot];
+    for (std::atomic<int64_t> *cells : threads_)
+    {
+        total += cells[slot].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int64_t Registry::sum(size_t slot)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return sumLocked(slot);
+}
+
+std::string Registry::label(const std::string &key, const std::string &value)
+{
+    std::string text = key + "=\"";
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+        {
+            text += '\\';
+            text += c;
+        }
+        else if (c == '\n')
+        {
+            text += "\\n";
+        }
+        else
+        {
+            text += c;
+        }
+    }
+    text += '"';
+    return text;
+}
+
+// name{labels,extra} value
+static void appendSample(std::string *out, const std::string &name, const std::string &labels,
+                         const std::string &extra, const char *value)
+{
+    out->append(name);
+    if (!labels.empty() || !extra.empty())
+    {
+        out->push_back('{');
+        out->append(labels);
+        if (!labels.empty() && !extra.empty())
+        {
+            out->push_back(',');
+        }
+        out->append(extra);
+        out->push_back('}');
+    }
+    out->push_back(' ');
+    out->append(value);
+    out->push_back('\n');
+}
+
+void Registry::appendFamily(std::string *out, const Family &family) const
+{
+    static const char *kTypeNames[] = {"counter", "gauge", "histogram"};
+    char value[64];
+    out->append("# HELP ").append(family.name).append(" ").append(family.help).append("\n");
+    out->append("# TYPE ").append(family.name).append(" ").append(kTypeNames[family.type]).append("\n");
+    for (const Series &series : family.series)
+    {
+        if (series.function)
+        {
+            snprintf(value, sizeof value, "%.17g", series.function());
+            appendSample(out, family.name, series.labels, std::string(), value);
+        }
+        else if (family.type != kHistogram)
+        {
+            snprintf(value, sizeof value, "%lld", static_cast<long long>(sumLocked(series.slot)));
+            appendSample(out, family.name, series.labels, std::string(), value);
+        }
+        else if (series.bounds)
+        {
+            // Prometheus的桶是累计的: le="x"包含所有不大于x的值
+            const std::vector<int64_t> &bounds = *series.bounds;
+            int64_t cumulative = 0;
+            char le[64];
+            for (size_t i = 0; i <= bounds.size(); ++i)
+            {
+                cumulative += sumLocked(series.slot + i);
+                if (i < bounds.size())
+                {
+                    snprintf(le, sizeof le, "le=\"%.9g\"", static_cast<double>(bounds[i]) * series.scale);
+                }
+                else
+                {
+                    snprintf(le, sizeof le, "le=\"+Inf\"");
+                }
+                snprintf(value, sizeof value, "%lld", static_cast<long long>(cumulative));
+                appendSample(out, family.name + "_bucket", series.labels, le, value);
+            }
+            snprintf(value, sizeof value, "%.17g",
+                     static_cast<double>(sumLocked(series.slot + bounds.size() + 1)) * series.scale);
+            appendSample(out, family.name + "_sum", series.labels, std::string(), value);
+            snprintf(value, sizeof value, "%lld", static_cast<long long>(cumulative));
+            appendSample(out, family.name + "_count", series.labels, std::string(), value);
+        }
+    }
+}
+
+std::string Registry::exposition()
+{
+    std::string out;
+    out.reserve(16 * 1024);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto &family : families_)
+    {
+        if (!family->series.empty())
+        {
+            appendFamily(&out, *family);
+        }
+    }
+    return out;
+}
+
+} // namespace metrics
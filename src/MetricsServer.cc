@@ -0,0 +1,26 @@
+#include <functional>
+
+#include "MetricsServer.h"
+#include "Metrics.h"
+
+MetricsServer::MetricsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name)
+    : server_(loop, listenAddr, name)
+{
+    server_.setHttpCallback(
+        std::bind(&MetricsServer::onRequest, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void MetricsServer::onRequest(const HttpRequest &req, HttpResponse *resp)
+{
+    if (req.path() == "/metrics" && (req.method() == HttpRequest::kGet || req.method() == HttpRequest::kHead))
+    {
+        resp->setContentType("text/plain; version=0.0.4");
+        resp->setBody(metrics::Registry::instance().exposition());
+    }
+    else
+    {
+        resp->setStatusCode(404);
+        resp->setContentType("text/plain");
+        resp->setBody("Not Found\n");
+    }
+}
@@ -0,0 +1,172 @@
+#include <functional>
+
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+RpcClient::RpcClient(EventLoop *loop,
+                     const InetAddress &serverAddr,
+                     const std::string &name,
+                     double timeoutResolution)
+    : loop_(loop)
+    , client_(loop, serverAddr, name)
+    , maxFrameBytes_(64 * 1024 * 1024)
+    , nextId_(1)
+    , scratch_(256, RpcCodec::kPrependSize)
+    , output_(4096)
+    , flushQueued_(false)
+    , timeouts_(0)
+    , alive_(std::make_shared<char>(0))
+{
+    client_.setConnectionCallback(
+        std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(
+        std::bind(&RpcClient::onMessage, this, std::placeholders::_1,
+                  std::placeholders::_2, std::placeholders::_3));
+    timeoutTimer_ = loop_->runEvery(timeoutResolution, std::bind(&RpcClient::checkTimeouts, this));
+}
+
+RpcClient::~RpcClient()
+{
+    loop_->cancel(timeoutTimer_);
+    failAll(kRpcDisconnected);
+}
+
+void RpcClient::call(const StringPiece &method, const StringPiece &request, int timeoutMs, const RpcCallback &cb)
+{
+    if (loop_->isInLoopThread())
+    {
+        callInLoop(method, request, timeoutMs, cb);
+    }
+    else
+    {
+        std::string methodCopy(method.data(), method.size());
+        std::string requestCopy(request.data(), request.size());
+        loop_->runInLoop([this, methodCopy, requestCopy, timeoutMs, cb]() {
+            callInLoop(methodCopy, requestCopy, timeoutMs, cb);
+        });
+    }
+}
+
+void RpcClient::callInLoop(const StringPiece &method, const StringPiece &request, int timeoutMs, const RpcCallback &cb)
+{
+    if (!connection_ || !connection_->connected())
+    {
+        cb(kRpcDisconnected, StringPiece());
+        return;
+    }
+    uint64_t id = nextId_++;
+    pending_[id].callback = cb;
+    if (timeoutMs > 0)
+    {
+        deadlines_.push(Deadline(MonotonicTime::now().nanoSeconds() + static_cast<int64_t>(timeoutMs) * 1000 * 1000, id));
+    }
+
+    scratch_.append(request.data(), request.size());
+    RpcCodec::encode(&scratch_, RpcFrame::kRequest, id, 0, method);
+    output_.append(scratch_.peek(), scratch_.readableBytes());
+    scratch_.retrieveAll();
+    if (!flushQueued_)
+    {
+        flushQueued_ = true;
+        std::weak_ptr<char> alive(alive_); // 排队期间RpcClient可能已经析构
+        loop_->queueInLoop([this, alive]() {
+            if (!alive.expired())
+            {
+                flush();
+            }
+        });
+    }
+}
+
+void RpcClient::flush()
+{
+    flushQueued_ = false;
+    if (connection_ && output_.readableBytes() > 0)
+    {
+        connection_->send(&output_);
+    }
+    output_.retrieveAll();
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        connection_ = conn;
+    }
+    else
+    {
+        connection_.reset();
+        output_.retrieveAll();
+        failAll(kRpcDisconnected);
+    }
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    RpcFrame frame;
+    for (;;)
+    {
+        RpcCodec::Result result = RpcCodec::decode(buf, maxFrameBytes_, &frame);
+        if (result == RpcCodec::kIncomplete)
+        {
+            break;
+        }
+        if (result == RpcCodec::kError || frame.type != RpcFrame::kResponse)
+        {
+            LOG_ERROR("RpcClient %s bad frame, closing\n", conn->name().c_str());
+            buf->retrieveAll();
+            conn->forceClose();
+            return;
+        }
+        auto it = pending_.find(frame.id);
+        if (it != pending_.end()) // 找不到说明已经超时了
+        {
+            RpcCallback cb;
+            cb.swap(it->second.callback);
+            pending_.erase(it);
+            cb(frame.status, frame.payload);
+        }
+        buf->retrieve(frame.frameBytes);
+    }
+}
+
+void RpcClient::checkTimeouts()
+{
+    if (deadlines_.empty())
+    {
+        return;
+    }
+    int64_t now = MonotonicTime::now().nanoSeconds();
+    while (!deadlines_.empty() && deadlines_.top().first <= now)
+    {
+        uint64_t id = deadlines_.top().second;
+        deadlines_.pop();
+        auto it = pending_.find(id);
+        if (it != pending_.end()) // 已经完成的调用在这里顺便出堆
+        {
+            RpcCallback cb;
+            cb.swap(it->second.callback);
+            pending_.erase(it);
+            timeouts_.fetch_add(1, std::memory_order_relaxed);
+            cb(kRpcTimeout, StringPiece());
+        }
+    }
+}
+
+void RpcClient::failAll(int status)
+{
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_); // 回调里可能发起新的调用
+    deadlines_ = decltype(deadlines_)();
+    for (auto &entry : pending)
+    {
+        entry.second.callback(status, StringPiece());
+    }
+}
@@ -0,0 +1,82 @@
+#include <endian.h>
+#include <string.h>
+
+#include "RpcCodec.h"
+#include "Buffer.h"
+
+const char *rpcStatusString(int status)
+{
+    switch (status)
+    {
+    case kRpcOk:
+        return "ok";
+    case kRpcNoMethod:
+        return "no such method";
+    case kRpcBadRequest:
+        return "bad request";
+    case kRpcAppError:
+        return "application error";
+    case kRpcTimeout:
+        return "timeout";
+    case kRpcDisconnected:
+        return "disconnected";
+    default:
+        return "unknown";
+    }
+}
+
+void RpcCodec::encode(Buffer *buf, RpcFrame::Type type, uint64_t id, int status, const StringPiece &method)
+{
+    buf->prepend(method.data(), method.size());
+
+    char header[kHeaderLen];
+    uint32_t length = htobe32(static_cast<uint32_t>(kHeaderLen - 4 + buf->readableBytes()));
+    uint64_t beId = htobe64(id);
+    uint16_t methodLen = htobe16(static_cast<uint16_t>(method.size()));
+    ::memcpy(header, &length, 4);
+    ::memcpy(header + 4, &beId, 8);
+    header[12] = static_cast<char>(type);
+    header[13] = static_cast<char>(status);
+    ::memcpy(header + 14, &methodLen, 2);
+    buf->prepend(header, kHeaderLen);
+}
+
+RpcCodec::Result RpcCodec::decode(const Buffer *buf, size_t maxFrameBytes, RpcFrame *frame)
+{
+    if (buf->readableBytes() < kHeaderLen)
+    {
+        return kIncomplete;
+    }
+    const char *p = buf->peek();
+    uint32_t length = 0;
+    ::memcpy(&length, p, 4);
+    length = be32toh(length);
+    if (length < kHeaderLen - 4 || length + 4 > maxFrameBytes)
+    {
+        return kError;
+    }
+    if (buf->readableBytes() < length + 4)
+    {
+        return kIncomplete;
+    }
+    uint64_t id = 0;
+    uint16_t methodLen = 0;
+    ::memcpy(&id, p + 4, 8);
+    ::memcpy(&methodLen, p + 14, 2);
+    methodLen = be16toh(methodLen);
+    if (kHeaderLen + methodLen > length + 4)
+    {
+        return kError;
+    }
+    frame->id = be64toh(id);
+    frame->type = static_cast<uint8_t>(p[12]);
+    frame->status = static_cast<uint8_t>(p[13]);
+    if (frame->type != RpcFrame::kRequest && frame->type != RpcFrame::kResponse)
+    {
+        return kError;
+    }
+    frame->method.set(p + kHeaderLen, methodLen);
+    frame->payload.set(p + kHeaderLen + methodLen, length + 4 - kHeaderLen - methodLen);
+    frame->frameBytes = length + 4;
+    return kFrame;
+}
@@ -0,0 +1,163 @@
+#include <functional>
+
+#include "RpcServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+namespace
+{
+
+// 挂在TcpConnection上的RPC状态 只在连接所属的loop线程中访问
+struct RpcConnection
+{
+    RpcConnection()
+        : scratch(256, RpcCodec::kPrependSize), replyScratch(256, RpcCodec::kPrependSize), output(4096), flushQueued(false)
+    {
+    }
+
+    Buffer scratch;      // 编码一个响应 方法把负载写进来 之后帧头prepend到前面
+    Buffer replyScratch; // 延迟回复用的 方法执行中途也可能调用reply
+    Buffer output;  // 这一轮要发送的所有响应
+    bool flushQueued;
+};
+
+RpcConnection *rpcConnectionOf(const TcpConnectionPtr &conn)
+{
+    return static_cast<RpcConnection *>(conn->getContext().get());
+}
+
+void appendResponse(Buffer *scratch, Buffer *output, uint64_t id, int status)
+{
+    RpcCodec::encode(scratch, RpcFrame::kResponse, id, status, StringPiece());
+    output->append(scratch->peek(), scratch->readableBytes());
+    scratch->retrieveAll();
+}
+
+void flushConnection(const TcpConnectionPtr &conn)
+{
+    RpcConnection *rpc = rpcConnectionOf(conn);
+    if (rpc != nullptr)
+    {
+        rpc->flushQueued = false;
+        if (rpc->output.readableBytes() > 0)
+        {
+            conn->send(&rpc->output);
+        }
+    }
+}
+
+} // namespace
+
+RpcServer::RpcServer(EventLoop *loop,
+                     const InetAddress &listenAddr,
+                     const std::string &name,
+                     TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , maxFrameBytes_(64 * 1024 * 1024)
+    , calls_(0)
+{
+    server_.setConnectionCallback(
+        std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&RpcServer::onMessage, this, std::placeholders::_1,
+                  std::placeholders::_2, std::placeholders::_3));
+}
+
+void RpcServer::registerMethod(const std::string &name, const RpcMethod &method)
+{
+    methods_[name] = method;
+}
+
+void RpcServer::start()
+{
+    LOG_INFO("RpcServer starts with %zu methods\n", methods_.size());
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn->setContext(std::make_shared<RpcConnection>());
+    }
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    RpcConnection *rpc = rpcConnectionOf(conn);
+    if (rpc == nullptr)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    RpcFrame frame;
+    int64_t calls = 0;
+    for (;;)
+    {
+        RpcCodec::Result result = RpcCodec::decode(buf, maxFrameBytes_, &frame);
+        if (result == RpcCodec::kIncomplete)
+        {
+            break;
+        }
+        if (result == RpcCodec::kError || frame.type != RpcFrame::kRequest)
+        {
+            LOG_ERROR("RpcServer %s bad frame, closing\n", conn->name().c_str());
+            buf->retrieveAll();
+            conn->forceClose();
+            return;
+        }
+        ++calls;
+        // 方法名一般不超过15字节 std::string用内部的短字符串缓冲 查找不分配内存
+        auto it = methods_.find(std::string(frame.method.data(), frame.method.size()));
+        int status = kRpcNoMethod;
+        if (it != methods_.end())
+        {
+            RpcCall call{conn, frame.id, frame.method, frame.payload};
+            status = it->second(call, &rpc->scratch);
+        }
+        if (status == kRpcDeferred)
+        {
+            rpc->scratch.retrieveAll();
+        }
+        else
+        {
+            appendResponse(&rpc->scratch, &rpc->output, frame.id, status);
+        }
+        buf->retrieve(frame.frameBytes);
+    }
+    calls_.fetch_add(calls, std::memory_order_relaxed);
+    if (!rpc->flushQueued)
+    {
+        flushConnection(conn);
+    }
+}
+
+void RpcServer::reply(const TcpConnectionPtr &conn, uint64_t id, int status, const StringPiece &response)
+{
+    EventLoop *loop = conn->getLoop();
+    auto doReply = [conn, id, status](const char *data, size_t len) {
+        RpcConnection *rpc = rpcConnectionOf(conn);
+        if (rpc == nullptr || !conn->connected())
+        {
+            return;
+        }
+        rpc->replyScratch.append(data, len);
+        appendResponse(&rpc->replyScratch, &rpc->output, id, status);
+        // 同一轮里的其他回复追加到同一个output 下一轮开始前一起发出
+        if (!rpc->flushQueued)
+        {
+            rpc->flushQueued = true;
+            conn->getLoop()->queueInLoop(std::bind(flushConnection, conn));
+        }
+    };
+    if (loop->isInLoopThread())
+    {
+        doReply(response.data(), response.size());
+    }
+    else
+    {
+        std::string copy(response.data(), response.size());
+        loop->runInLoop([doReply, copy]() { doReply(copy.data(), copy.size()); });
+    }
+}
@@ -3,7 +3,8 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
-#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#include <errno.h>
 
 #include "Socket.h"
 #include "Logger.h"
@@ -16,15 +17,15 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr)
 {
-    if (0 != ::bind(sockfd_, (sockaddr *)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    if (0 != ::bind(sockfd_, localaddr.getSockAddr(), localaddr.getSockLen()))
     {
-        LOG_FATAL("bind sockfd:%d fail\n", sockfd_);
+        LOG_FATAL("bind sockfd:%d to %s fail err:%d\n", sockfd_, localaddr.toIpPort().c_str(), errno);
     }
 }
 
-void Socket::listen()
+void Socket::listen(int backlog)
 {
-    if (0 != ::listen(sockfd_, 1024)) //全连接队列最大长度1024
+    if (0 != ::listen(sockfd_, backlog))
     {
         LOG_FATAL("listen sockfd:%d fail\n", sockfd_);
     }
@@ -38,14 +39,14 @@ int Socket::accept(InetAddress *peeraddr)
      * Reactor模型 one loop per thread
      * poller + non-blocking IO
      **/
-    sockaddr_in addr;
+    sockaddr_storage addr; // IPv4/IPv6/Unix域的地址都放得下
     socklen_t len = sizeof(addr);
     ::memset(&addr, 0, sizeof(addr));
     // fixed : int connfd = ::accept(sockfd_, (sockaddr *)&addr, &len);
     int connfd = ::accept4(sockfd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (connfd >= 0)
     {
-        peeraddr->setSockAddr(addr);
+        peeraddr->setSockAddr((const sockaddr *)&addr, len);
     }
     return connfd;
 }
@@ -90,4 +91,174 @@ void Socket::setKeepAlive(bool on)
     // 这对于检测网络中失效的对等方非常有用。
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
-}
\ No newline at end of file
+}
+
+int sockets::createNonblockingOrDie(sa_family_t family)
+{
+    // Unix域socket没有TCP协议 协议号填0
+    int protocol = family == AF_UNIX ? 0 : IPPROTO_TCP;
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("sockets::createNonblockingOrDie err:%d\n", errno);
+    }
+    return sockfd;
+}
+
+int sockets::connect(int sockfd, const InetAddress &addr)
+{
+    return ::connect(sockfd, addr.getSockAddr(), addr.getSockLen());
+}
+
+int sockets::getSocketError(int sockfd)
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+int sockets::getIncomingCpu(int sockfd)
+{
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t optlen = sizeof cpu;
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) == 0)
+    {
+        return cpu;
+    }
+#endif
+    return -1;
+}
+
+InetAddress sockets::getLocalAddr(int sockfd)
+{
+    sockaddr_storage local;
+    ::memset(&local, 0, sizeof local);
+    socklen_t addrlen = sizeof local;
+    if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getLocalAddr err:%d\n", errno);
+    }
+    return InetAddress((const sockaddr *)&local, addrlen);
+}
+
+InetAddress sockets::getPeerAddr(int sockfd)
+{
+    sockaddr_storage peer;
+    ::memset(&peer, 0, sizeof peer);
+    socklen_t addrlen = sizeof peer;
+    if (::getpeername(sockfd, (sockaddr *)&peer, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getPeerAddr err:%d\n", errno);
+    }
+    return InetAddress((const sockaddr *)&peer, addrlen);
+}
+
+bool sockets::isSelfConnect(int sockfd)
+{
+    InetAddress local = getLocalAddr(sockfd);
+    InetAddress peer = getPeerAddr(sockfd);
+    if (local.family() != peer.family())
+    {
+        return false;
+    }
+    if (local.family() == AF_INET)
+    {
+        const sockaddr_in *l = (const sockaddr_in *)local.getSockAddr();
+        const sockaddr_in *r = (const sockaddr_in *)peer.getSockAddr();
+        return l->sin_port == r->sin_port && l->sin_addr.s_addr == r->sin_addr.s_addr;
+    }
+    if (local.family() == AF_INET6)
+    {
+        const sockaddr_in6 *l = (const sockaddr_in6 *)local.getSockAddr();
+        const sockaddr_in6 *r = (const sockaddr_in6 *)peer.getSockAddr();
+        return l->sin6_port == r->sin6_port && ::memcmp(&l->sin6_addr, &r->sin6_addr, sizeof l->sin6_addr) == 0;
+    }
+    // Unix域socket不会连上自己
+    return false;
+}
+
+// 设置一个int类型的选项 失败只记录日志 不影响连接
+static void setIntOption(int sockfd, int level, int name, int value, const char *what)
+{
+    if (::setsockopt(sockfd, level, name, &value, sizeof value) < 0)
+    {
+        LOG_ERROR("setsockopt %s=%d on fd=%d err:%d\n", what, value, sockfd, errno);
+    }
+}
+
+void sockets::applyListenOptions(int sockfd, sa_family_t family, const SocketOptions &options)
+{
+    // 监听socket上的缓冲区大小会被accept出来的连接继承 必须在listen之前设置才能影响窗口扩大因子
+    if (options.recvBufferSize > 0)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_RCVBUF, options.recvBufferSize, "SO_RCVBUF");
+    }
+    if (options.sendBufferSize > 0)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_SNDBUF, options.sendBufferSize, "SO_SNDBUF");
+    }
+    if (family == AF_UNIX)
+    {
+        return;
+    }
+    if (options.deferAcceptSeconds > 0)
+    {
+        setIntOption(sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAcceptSeconds, "TCP_DEFER_ACCEPT");
+    }
+    if (options.fastOpenQueue > 0)
+    {
+        setIntOption(sockfd, IPPROTO_TCP, TCP_FASTOPEN, options.fastOpenQueue, "TCP_FASTOPEN");
+    }
+}
+
+void sockets::applyConnectionOptions(int sockfd, sa_family_t family, const SocketOptions &options)
+{
+    if (options.recvBufferSize > 0)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_RCVBUF, options.recvBufferSize, "SO_RCVBUF");
+    }
+    if (options.sendBufferSize > 0)
+    {
+        setIntOption(sockfd, SOL_SOCKET, SO_SNDBUF, options.sendBufferSize, "SO_SNDBUF");
+    }
+    setIntOption(sockfd, SOL_SOCKET, SO_KEEPALIVE, options.keepAlive ? 1 : 0, "SO_KEEPALIVE");
+    if (family == AF_UNIX)
+    {
+        return;
+    }
+    setIntOption(sockfd, IPPROTO_TCP, TCP_NODELAY, options.tcpNoDelay ? 1 : 0, "TCP_NODELAY");
+    if (options.quickAck)
+    {
+        setIntOption(sockfd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+    }
+    if (options.keepAlive)
+    {
+        if (options.keepIdleSeconds > 0)
+        {
+            setIntOption(sockfd, IPPROTO_TCP, TCP_KEEPIDLE, options.keepIdleSeconds, "TCP_KEEPIDLE");
+        }
+        if (options.keepIntervalSeconds > 0)
+        {
+            setIntOption(sockfd, IPPROTO_TCP, TCP_KEEPINTVL, options.keepIntervalSeconds, "TCP_KEEPINTVL");
+        }
+        if (options.keepCount > 0)
+        {
+            setIntOption(sockfd, IPPROTO_TCP, TCP_KEEPCNT, options.keepCount, "TCP_KEEPCNT");
+        }
+    }
+    if (options.notSentLowat > 0)
+    {
+        setIntOption(sockfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notSentLowat, "TCP_NOTSENT_LOWAT");
+    }
+    if (options.rxTimestamps)
+    {
+        // 只要软件时间戳 内核在协议栈收包时打上CLOCK_REALTIME 不需要网卡支持
+        setIntOption(sockfd, SOL_SOCKET, SO_TIMESTAMPING, SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE,
+                     "SO_TIMESTAMPING");
+    }
+}
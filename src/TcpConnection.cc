@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <string>
 #include <errno.h>
@@ -14,6 +15,9 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "MemoryBudget.h"
+#include "TlsStream.h"
+#include "Probes.h"
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -24,6 +28,9 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
+const size_t TcpConnection::kTlsFileHighMark;
+const size_t TcpConnection::kTlsFileLowMark;
+
 TcpConnection::TcpConnection(EventLoop *loop,
                              const std::string &nameArg,
                              int sockfd,
@@ -33,11 +40,15 @@ TcpConnection::TcpConnection(EventLoop *loop,
     , name_(nameArg)
     , state_(kConnecting)
     , reading_(true)
+    , quickAck_(false)
+    , rxTimestamps_(false)
+    , notSentLowat_(0)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024) // 64M
+    , accountedBytes_(0)
 {
     // 下面给channel设置相应的回调函数 poller给channel通知感兴趣的事件发生了 channel会回调相应的回调函数
     channel_->setReadCallback(
@@ -49,6 +60,8 @@ TcpConnection::TcpConnection(EventLoop *loop,
     channel_->setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
 
+    channel_->setLabel(name_.c_str());
+
     LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
     socket_->setKeepAlive(true);
 }
@@ -58,6 +71,21 @@ TcpConnection::~TcpConnection()
     LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), channel_->fd(), (int)state_);
 }
 
+int TcpConnection::fd() const
+{
+    return socket_->fd();
+}
+
+void TcpConnection::setCpuTag(int tag)
+{
+    channel_->setCpuTag(tag);
+}
+
+bool TcpConnection::sampleTcpInfo()
+{
+    return sockets::getTcpInfo(socket_->fd(), &tcpInfo_);
+}
+
 void TcpConnection::send(const std::string &buf)
 {
     if (state_ == kConnected)
@@ -80,6 +108,41 @@ void TcpConnection::send(const std::string &buf)
     }
 }
 
+void TcpConnection::send(const void *data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            std::string copy(static_cast<const char *>(data), len);
+            loop_->runInLoop(
+                [this, copy]() { this->sendInLoop(copy.data(), copy.size()); });
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            std::string copy(buf->retrieveAllAsString());
+            loop_->runInLoop(
+                [this, copy]() { this->sendInLoop(copy.data(), copy.size()); });
+        }
+    }
+}
+
 /**
  * 发送数据 应用写的快 而内核发送数据慢 需要把待发送数据写入缓冲区，而且设置了水位回调
  **/
@@ -92,16 +155,19 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     if (state_ == kDisconnected) // 之前调用过该connection的shutdown 不能再进行发送了
     {
         LOG_ERROR("disconnected, give up writing");
+        return;
     }
 
     // 只有同时满足两个条件，才尝试直接写：
     // 1. !channel_->isWriting(): 当前没有在监听 EPOLLOUT 事件（说明之前的数据都发完了，或者没发过数据）。
     // 2. outputBuffer_.readableBytes() == 0: 应用层缓冲区是空的（TCP 是流式协议，如果有旧数据没发完，必须先发旧的，不能插队）。
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // 3. TLS连接的握手已经完成 握手期间的数据先放进outputBuffer_
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && (!tls_ || tls_->handshakeDone()))
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        nwrote = writeSocket(data, len);
         if (nwrote >= 0)
         {
+            metrics_.bytesSent.inc(nwrote);
             remaining = len - nwrote;
             if (remaining == 0 && writeCompleteCallback_)
             {
@@ -130,6 +196,7 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
      * channel的writeCallback_实际上就是TcpConnection设置的handleWrite回调，
      * 把发送缓冲区outputBuffer_的内容全部发送完成
      **/
+    MUDUO_PROBE4(conn_send, channel_->fd(), len, nwrote, faultError ? 0 : remaining);
     if (!faultError && remaining > 0)
     {
         // 目前发送缓冲区剩余的待发送的数据的长度
@@ -148,6 +215,7 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         {
             channel_->enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
         }
+        updateMemoryUsage();
     }
 }
 
@@ -166,18 +234,179 @@ void TcpConnection::shutdownInLoop()
     // 只有当outputBuffer_中的数据全部发送完成后，才能关闭写端
     if (!channel_->isWriting()) // 说明当前outputBuffer_的数据全部向外发送完成
     {
+        if (tls_)
+        {
+            tls_->shutdown(); // 先发close_notify
+        }
         socket_->shutdownWrite();
     }
     //否则：等 handleWrite() 把 outputBuffer 写空后，再来 shutdown
     // （通常是写空后判断 state_==kDisconnecting 再调用 shutdownInLoop）
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 总是放到队列中执行 调用者可能正处在本连接的回调里
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose(); // 和对端关闭连接走同一条路径
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::setSocketOptions(const SocketOptions &options)
+{
+    sockets::applyConnectionOptions(socket_->fd(), localAddr_.family(), options);
+    quickAck_ = options.quickAck && !localAddr_.isUnix();
+    rxTimestamps_ = options.rxTimestamps && !localAddr_.isUnix();
+    notSentLowat_ = localAddr_.isUnix() ? 0 : options.notSentLowat;
+}
+
+void TcpConnection::startTls(const std::shared_ptr<TlsContext> &context, const std::string &serverName)
+{
+    // 客户端按服务端名字和地址缓存会话 服务端的key只用于日志
+    std::string peerKey = serverName.empty() ? peerAddr_.toIpPort() : serverName + "@" + peerAddr_.toIpPort();
+    tls_.reset(new TlsStream(context, loop_, socket_->fd(), peerKey, serverName));
+}
+
+bool TcpConnection::userspaceTls() const
+{
+    return tls_ && !tls_->ktlsSend();
+}
+
+ssize_t TcpConnection::writeSocket(const void *data, size_t len)
+{
+    if (userspaceTls())
+    {
+        int savedErrno = 0;
+        ssize_t n = tls_->write(data, len, &savedErrno);
+        if (n < 0)
+        {
+            errno = savedErrno;
+        }
+        return n;
+    }
+    // 明文连接 或者kTLS已经接管了发送方向的加密
+    return ::write(channel_->fd(), data, len);
+}
+
+void TcpConnection::handleHandshake()
+{
+    int ret = tls_->handshake();
+    if (ret < 0)
+    {
+        handleClose();
+        return;
+    }
+    if (ret == 0)
+    {
+        // 握手数据没有写完就等可写 否则等对端的下一段握手数据
+        if (tls_->wantWrite())
+        {
+            if (!channel_->isWriting())
+            {
+                channel_->enableWriting();
+            }
+        }
+        else if (channel_->isWriting())
+        {
+            channel_->disableWriting();
+        }
+        return;
+    }
+    // 握手完成 握手期间send的数据还在outputBuffer_里
+    if (outputBuffer_.readableBytes() > 0)
+    {
+        if (!channel_->isWriting())
+        {
+            channel_->enableWriting();
+        }
+    }
+    else if (channel_->isWriting())
+    {
+        channel_->disableWriting();
+    }
+    connectionCallback_(shared_from_this());
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    if (!reading_ || !channel_->isReading())
+    {
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if (reading_ || channel_->isReading())
+    {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
+void TcpConnection::updateMemoryUsage()
+{
+    size_t buffered = inputBuffer_.readableBytes() + outputBuffer_.readableBytes();
+    if (buffered != accountedBytes_)
+    {
+        int64_t delta = static_cast<int64_t>(buffered) - static_cast<int64_t>(accountedBytes_);
+        accountedBytes_ = buffered;
+        metrics_.bufferedBytes.add(delta);
+        if (memoryAccount_)
+        {
+            memoryAccount_->update(delta);
+        }
+    }
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
+    MUDUO_PROBE1(conn_established, channel_->fd());
     setState(kConnected);
     channel_->tie(shared_from_this());
     channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    if (memoryAccount_)
+    {
+        memoryAccount_->add(this);
+    }
+    if (tcpInfoSampler_)
+    {
+        tcpInfoSampler_->add(this);
+    }
+
+    if (tls_)
+    {
+        handleHandshake(); // 握手完成后再回调ConnectionCallback
+        return;
+    }
 
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
@@ -189,25 +418,88 @@ void TcpConnection::connectDestroyed()
     {
         setState(kDisconnected);
         channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
-        connectionCallback_(shared_from_this());
+        if (!tls_ || tls_->handshakeDone()) // 握手没完成时用户没有见过这个连接
+        {
+            connectionCallback_(shared_from_this());
+        }
     }
     channel_->remove(); // 把channel从poller中删除掉
+    if (memoryAccount_)
+    {
+        memoryAccount_->remove(this); // 归还本连接占用的预算
+        memoryAccount_.reset();
+    }
+    if (tcpInfoSampler_)
+    {
+        tcpInfoSampler_->remove(this);
+        tcpInfoSampler_.reset();
+    }
+    metrics_.bufferedBytes.add(-static_cast<int64_t>(accountedBytes_));
+    accountedBytes_ = 0;
+    if (pendingFile_)
+    {
+        SendFileCallback done = pendingFile_->done;
+        pendingFile_.reset();
+        if (done)
+        {
+            done(false);
+        }
+    }
 }
 
 // 读是相对服务器而言的 当对端客户端有数据到达 服务器端检测到EPOLLIN 就会触发该fd上的回调 handleRead取读走对端发来的数据
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if (tls_ && !tls_->handshakeDone())
+    {
+        handleHandshake();
+        if (!tls_->handshakeDone() || state_ != kConnected)
+        {
+            return;
+        }
+        // 握手的最后一段可能和应用数据一起到达 继续读
+    }
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    int64_t kernelNs = 0;
+    ssize_t n = 0;
+    if (tls_)
+    {
+        n = tls_->read(&inputBuffer_, &savedErrno);
+    }
+    else if (rxTimestamps_)
+    {
+        n = inputBuffer_.readFd(channel_->fd(), &savedErrno, &kernelNs);
+    }
+    else
+    {
+        n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    }
+    MUDUO_PROBE3(conn_read, channel_->fd(), n, inputBuffer_.readableBytes());
     if (n > 0) // 有数据到达
     {
+        metrics_.bytesReceived.inc(n);
+        if (quickAck_)
+        {
+            // 内核在延迟确认模式和快速确认模式之间自动切换 每次读完都要重新打开
+            int on = 1;
+            ::setsockopt(channel_->fd(), IPPROTO_TCP, TCP_QUICKACK, &on, sizeof on);
+        }
+        if (rxTimestamps_)
+        {
+            recordReceiveTimes(kernelNs, receiveTime);
+        }
         // 已建立连接的用户有可读事件发生了 调用用户传入的回调操作onMessage shared_from_this就是获取了TcpConnection的智能指针
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        updateMemoryUsage(); // 用户回调中没有取走的数据仍然占用预算
     }
     else if (n == 0) // 客户端断开
     {
         handleClose();
     }
+    else if (tls_ && savedErrno == EAGAIN)
+    {
+        // 只收到了TLS的控制记录(例如NewSessionTicket) 没有应用数据
+    }
     else // 出错了
     {
         errno = savedErrno;
@@ -216,33 +508,89 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
+void TcpConnection::recordReceiveTimes(int64_t kernelNs, Timestamp receiveTime)
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    receiveTimes_.kernelNs = kernelNs;
+    receiveTimes_.pollNs = receiveTime.microSecondsSinceEpoch() * 1000;
+    receiveTimes_.callbackNs = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    // receiveTime只精确到微秒 差值可能略小于0
+    if (kernelNs > 0)
+    {
+        metrics_.kernelToPoll.observe(std::max<int64_t>(0, receiveTimes_.pollNs - kernelNs));
+    }
+    metrics_.pollToCallback.observe(std::max<int64_t>(0, receiveTimes_.callbackNs - receiveTimes_.pollNs));
+}
+
 void TcpConnection::handleWrite()
 {
+    if (tls_ && !tls_->handshakeDone())
+    {
+        handleHandshake();
+        return;
+    }
     if (channel_->isWriting())
     {
-        int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-        if (n > 0)
+        if (outputBuffer_.readableBytes() > 0)
         {
-            outputBuffer_.retrieve(n);//从缓冲区读取reable区域的数据移动readindex下标
-            if (outputBuffer_.readableBytes() == 0)
+            int savedErrno = 0;
+            ssize_t n = 0;
+            if (userspaceTls())
             {
-                channel_->disableWriting();
-                if (writeCompleteCallback_)
-                {
-                    // TcpConnection对象在其所在的subloop中 向pendingFunctors_中加入回调
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ == kDisconnecting) // 说明之前调用过shutdown,与showdown配合使用
-                {
-                    shutdownInLoop(); // 在当前所属的loop中把TcpConnection删除掉
-                }
+                n = writeSocket(outputBuffer_.peek(), outputBuffer_.readableBytes());
+                savedErrno = errno;
+            }
+            else
+            {
+                n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+            }
+            if (n > 0)
+            {
+                metrics_.bytesSent.inc(n);
+                outputBuffer_.retrieve(n);//从缓冲区读取reable区域的数据移动readindex下标
+                MUDUO_PROBE3(conn_write, channel_->fd(), n, outputBuffer_.readableBytes());
+                updateMemoryUsage();
+            }
+            else if (n < 0 && savedErrno == EAGAIN)
+            {
+                // 内核发送缓冲区满 或者TLS需要先读到对端的数据(WANT_READ) 等下一次事件
+                return;
+            }
+            else
+            {
+                errno = savedErrno;
+                LOG_ERROR("TcpConnection::handleWrite errno:%d\n", savedErrno);
+                return;
             }
         }
-        else
+        if (pendingFile_ && (userspaceTls() ? outputBuffer_.readableBytes() < kTlsFileLowMark
+                                             : outputBuffer_.readableBytes() == 0))
         {
-            LOG_ERROR("TcpConnection::handleWrite");
+            // 明文等outputBuffer_写空再sendfile 用户态TLS积压的数据发出去一半就继续读文件 新读的数据排在后面
+            std::unique_ptr<PendingFile> file(std::move(pendingFile_));
+            if (userspaceTls())
+            {
+                sendFileThroughTls(file->fd, file->offset, file->count, file->done);
+            }
+            else
+            {
+                sendFileBySendfile(file->fd, file->offset, file->count, file->done);
+            }
+        }
+        if (outputBuffer_.readableBytes() == 0 && !pendingFile_)
+        {
+            channel_->disableWriting();
+            if (writeCompleteCallback_)
+            {
+                // TcpConnection对象在其所在的subloop中 向pendingFunctors_中加入回调
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+            if (state_ == kDisconnecting) // 说明之前调用过shutdown,与showdown配合使用
+            {
+                shutdownInLoop(); // 在当前所属的loop中把TcpConnection删除掉
+            }
         }
     }
     else
@@ -254,78 +602,153 @@ void TcpConnection::handleWrite()
 void TcpConnection::handleClose()
 {
     LOG_INFO("TcpConnection::handleClose fd=%d state=%d\n", channel_->fd(), (int)state_);
+    MUDUO_PROBE2(conn_close, channel_->fd(), state_.load());
     setState(kDisconnected);
     channel_->disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this()); //续命，难点，
-    connectionCallback_(connPtr); // 连接回调
+    if (!tls_ || tls_->handshakeDone()) // TLS握手失败的连接没有回调过建立
+    {
+        connectionCallback_(connPtr); // 连接回调
+    }
     closeCallback_(connPtr);      // 执行关闭连接的回调 执行的是TcpServer::removeConnection回调方法   // must be the last line
 }
 
 void TcpConnection::handleError()
 {
-    int optval;
-    socklen_t optlen = sizeof optval;
-    int err = 0;
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
-    {
-        err = errno;
-    }
-    else
-    {
-        err = optval;
-    }
+    int err = sockets::getSocketError(channel_->fd());
     LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d\n", name_.c_str(), err);
 }
 
 // 新增的零拷贝发送函数
 void TcpConnection::sendFile(int fileDescriptor, off_t offset, size_t count) {
+    sendFile(fileDescriptor, offset, count, SendFileCallback());
+}
+
+void TcpConnection::sendFile(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done) {
     if (connected()) {
         if (loop_->isInLoopThread()) { // 判断当前线程是否是loop循环的线程
-            sendFileInLoop(fileDescriptor, offset, count);
+            sendFileInLoop(fileDescriptor, offset, count, done);
         }else{ // 如果不是，则唤醒运行这个TcpConnection的线程执行Loop循环
             loop_->runInLoop(
-                std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileDescriptor, offset, count));
+                std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileDescriptor, offset, count, done));
         }
     } else {
         LOG_ERROR("TcpConnection::sendFile - not connected");
+        if (done) {
+            done(false);
+        }
     }
 }
 
-// 致命缺陷：忙等待 (Busy Loop)
 // 在事件循环中执行sendfile
-void TcpConnection::sendFileInLoop(int fileDescriptor, off_t offset, size_t count) {
-    ssize_t bytesSent = 0; // 发送了多少字节数
-    size_t remaining = count; // 还要多少数据要发送
-    bool faultError = false; // 错误的标志位
-
-    if (state_ == kDisconnecting) { // 表示此时连接已经断开就不需要发送数据了
+void TcpConnection::sendFileInLoop(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done) {
+    if (state_ == kDisconnecting || state_ == kDisconnected) { // 表示此时连接已经断开就不需要发送数据了
         LOG_ERROR("disconnected, give up writing");
+        if (done) {
+            done(false);
+        }
         return;
     }
+    if (userspaceTls()) {
+        sendFileThroughTls(fileDescriptor, offset, count, done);
+        return;
+    }
+    // 明文连接和开启了kTLS的连接都直接sendfile 后者由内核加密
 
-    // 表示Channel第一次开始写数据或者outputBuffer缓冲区中没有数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        bytesSent = sendfile(socket_->fd(), fileDescriptor, &offset, remaining);
-        if (bytesSent >= 0) {
-            remaining -= bytesSent;
-            if (remaining == 0 && writeCompleteCallback_) {
-                // remaining为0意味着数据正好全部发送完，就不需要给其设置写事件的监听。
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    if (channel_->isWriting() || outputBuffer_.readableBytes() > 0) {
+        // outputBuffer_里还有先send的数据 文件排在它们后面 等handleWrite写空之后再sendfile
+        parkFile(fileDescriptor, offset, count, done);
+        return;
+    }
+    sendFileBySendfile(fileDescriptor, offset, count, done);
+    if (!pendingFile_ && outputBuffer_.readableBytes() == 0 && writeCompleteCallback_) {
+        // 数据正好全部发送完，就不需要给其设置写事件的监听。
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+}
+
+void TcpConnection::sendFileBySendfile(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done)
+{
+    while (count > 0)
+    {
+        ssize_t n = ::sendfile(socket_->fd(), fileDescriptor, &offset, count);
+        if (n > 0)
+        {
+            metrics_.bytesSent.inc(n);
+            count -= static_cast<size_t>(n);
+        }
+        else if (n < 0 && errno == EWOULDBLOCK)
+        {
+            // 内核发送缓冲区满 不能重新排队轮询(对端慢时会让loop空转) 等可写事件由handleWrite继续
+            parkFile(fileDescriptor, offset, count, done);
+            return;
+        }
+        else
+        {
+            if (n == 0) // 文件比count短 到了文件末尾 重试也读不到数据
+            {
+                LOG_ERROR("TcpConnection::sendFileBySendfile fd=%d reached EOF with %zu bytes left\n",
+                          fileDescriptor, count);
             }
-        } else { // bytesSent < 0
-            if (errno != EWOULDBLOCK) { // 如果是非阻塞没有数据返回错误这个是正常显现等同于EAGAIN，否则就异常情况
-                LOG_ERROR("TcpConnection::sendFileInLoop");
+            else // EPIPE/ECONNRESET/EBADF等 重试也不会成功
+            {
+                LOG_ERROR("TcpConnection::sendFileBySendfile errno:%d\n", errno);
             }
-            if (errno == EPIPE || errno == ECONNRESET) {
-                faultError = true;
+            if (done)
+            {
+                done(false);
             }
+            return;
         }
     }
-    // 处理剩余数据
-    if (!faultError && remaining > 0) {
-        // 继续发送剩余数据
-        loop_->queueInLoop(
-            std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileDescriptor, offset, remaining));
+    if (done)
+    {
+        done(true);
     }
-}
\ No newline at end of file
+}
+
+void TcpConnection::sendFileThroughTls(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done)
+{
+    static const size_t kChunkSize = 64 * 1024;
+    char buf[kChunkSize];
+    while (count > 0 && state_ == kConnected && outputBuffer_.readableBytes() < kTlsFileHighMark)
+    {
+        ssize_t n = ::pread(fileDescriptor, buf, std::min(count, kChunkSize), offset);
+        if (n <= 0)
+        {
+            LOG_ERROR("TcpConnection::sendFileThroughTls pread fd=%d offset=%ld err:%d\n",
+                      fileDescriptor, static_cast<long>(offset), errno);
+            if (done)
+            {
+                done(false);
+            }
+            return;
+        }
+        sendInLoop(buf, static_cast<size_t>(n));
+        offset += n;
+        count -= static_cast<size_t>(n);
+    }
+    if (count > 0 && state_ == kConnected)
+    {
+        // outputBuffer_积压满了 等handleWrite发出一部分后再继续
+        parkFile(fileDescriptor, offset, count, done);
+    }
+    else if (done)
+    {
+        done(count == 0); // 剩下的数据都在outputBuffer_里 后续send的数据排在它们后面
+    }
+}
+
+void TcpConnection::parkFile(int fileDescriptor, off_t offset, size_t count, const SendFileCallback &done)
+{
+    pendingFile_.reset(new PendingFile);
+    pendingFile_->fd = fileDescriptor;
+    pendingFile_->offset = offset;
+    pendingFile_->count = count;
+    pendingFile_->done = done;
+    if (!channel_->isWriting())
+    {
+        channel_->enableWriting();
+    }
+}
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/tcp.h> // glibc的<netinet/tcp.h>里的tcp_info没有4.x之后新增的字段
+
+#include "TcpInfo.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+bool sockets::getTcpInfo(int sockfd, TcpInfo *info)
+{
+    struct tcp_info ti;
+    ::memset(&ti, 0, sizeof ti); // 老内核只填充前面的部分
+    socklen_t len = static_cast<socklen_t>(sizeof ti);
+    if (::getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0)
+    {
+        return false;
+    }
+    info->when = Timestamp::now();
+    info->state = ti.tcpi_state;
+    info->rttUs = ti.tcpi_rtt;
+    info->rttVarUs = ti.tcpi_rttvar;
+    info->minRttUs = ti.tcpi_min_rtt;
+    info->sndMss = ti.tcpi_snd_mss;
+    info->sndCwnd = ti.tcpi_snd_cwnd;
+    info->retransmits = ti.tcpi_retransmits;
+    info->totalRetrans = ti.tcpi_total_retrans;
+    info->unacked = ti.tcpi_unacked;
+    info->lost = ti.tcpi_lost;
+    info->notsentBytes = ti.tcpi_notsent_bytes;
+    info->bytesAcked = ti.tcpi_bytes_acked;
+    info->deliveryRate = ti.tcpi_delivery_rate;
+    return true;
+}
+
+LoopTcpInfoSampler::LoopTcpInfoSampler(EventLoop *loop, const TcpInfoOptions &options,
+                                       const SlowConsumerCallback &cb, const Metrics &metrics)
+    : loop_(loop)
+    , options_(options)
+    , slowConsumerCallback_(cb)
+    , metrics_(metrics)
+    , next_(0)
+    , carry_(0)
+    , stopped_(false)
+{
+}
+
+void LoopTcpInfoSampler::add(TcpConnection *conn)
+{
+    Entry entry;
+    entry.conn = conn;
+    entry.totalRetrans = 0;
+    entry.overSinceNs = 0;
+    entry.reported = false;
+    index_[conn] = entries_.size();
+    entries_.push_back(entry);
+
+    // 第一个连接到来时才启动定时器 没有连接的loop不会被唤醒
+    if (!timer_.valid() && !stopped_)
+    {
+        std::weak_ptr<LoopTcpInfoSampler> weak(shared_from_this());
+        timer_ = loop_->runEvery(options_.tick, [weak]() {
+            std::shared_ptr<LoopTcpInfoSampler> sampler(weak.lock());
+            if (sampler)
+            {
+                sampler->tick();
+            }
+        });
+    }
+}
+
+void LoopTcpInfoSampler::remove(TcpConnection *conn)
+{
+    auto it = index_.find(conn);
+    if (it == index_.end())
+    {
+        return;
+    }
+    // 和最后一个交换后删除 轮转的位置可能因此跳过或者重复一个连接 无关紧要
+    size_t i = it->second;
+    index_.erase(it);
+    if (i + 1 != entries_.size())
+    {
+        entries_[i] = entries_.back();
+        index_[entries_[i].conn] = i;
+    }
+    entries_.pop_back();
+}
+
+void LoopTcpInfoSampler::stop()
+{
+    stopped_ = true;
+    if (timer_.valid())
+    {
+        loop_->cancel(timer_);
+        timer_ = TimerId();
+    }
+}
+
+void LoopTcpInfoSampler::tick()
+{
+    if (entries_.empty())
+    {
+        carry_ = 0;
+        return;
+    }
+    carry_ += static_cast<double>(entries_.size()) * options_.tick / options_.interval;
+    size_t count = std::min(entries_.size(), static_cast<size_t>(carry_));
+    carry_ = std::min(carry_ - static_cast<double>(count), 1.0); // interval比tick还短时每次都全部采样
+
+    int64_t nowNs = MonotonicTime::now().nanoSeconds();
+    std::vector<TcpConnectionPtr> slow;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (next_ >= entries_.size())
+        {
+            next_ = 0;
+        }
+        Entry &entry = entries_[next_++];
+        if (sample(&entry, nowNs))
+        {
+            slow.push_back(entry.conn->shared_from_this());
+        }
+    }
+    // 回调可能关闭连接 等遍历完entries_之后再调用
+    for (const TcpConnectionPtr &conn : slow)
+    {
+        slowConsumerCallback_(conn, conn->tcpInfo());
+    }
+}
+
+bool LoopTcpInfoSampler::sample(Entry *entry, int64_t nowNs)
+{
+    TcpConnection *conn = entry->conn;
+    if (!conn->sampleTcpInfo())
+    {
+        return false;
+    }
+    const TcpInfo &info = conn->tcpInfo();
+    metrics_.rtt.observe(info.rttUs);
+    if (info.totalRetrans > entry->totalRetrans)
+    {
+        metrics_.retransmits.inc(info.totalRetrans - entry->totalRetrans);
+    }
+    entry->totalRetrans = info.totalRetrans;
+
+    if (options_.slowConsumerBytes == 0 || !slowConsumerCallback_)
+    {
+        return false;
+    }
+    size_t queued = conn->outputBufferBytes() + info.notsentBytes;
+    if (queued <= options_.slowConsumerBytes)
+    {
+        entry->overSinceNs = 0;
+        entry->reported = false;
+        return false;
+    }
+    if (entry->overSinceNs == 0)
+    {
+        entry->overSinceNs = nowNs;
+    }
+    if (entry->reported || !conn->connected() ||
+        nowNs - entry->overSinceNs < static_cast<int64_t>(options_.slowConsumerSeconds * 1e9))
+    {
+        return false;
+    }
+    LOG_INFO("LoopTcpInfoSampler - slow consumer [%s] %zu bytes queued for %.1f s rtt=%u us cwnd=%u\n",
+             conn->name().c_str(), queued, static_cast<double>(nowNs - entry->overSinceNs) / 1e9,
+             info.rttUs, info.sndCwnd);
+    entry->reported = true;
+    metrics_.slowConsumers.inc();
+    return true;
+}
@@ -1,9 +1,19 @@
 #include <functional>
 #include <string.h>
+#include <unistd.h>
 
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "CpuAccounting.h"
+
+namespace
+{
+void defaultSlowConsumerCallback(const TcpConnectionPtr &conn, const TcpInfo &)
+{
+    conn->forceClose(); // 放弃还没有发出的数据 释放outputBuffer_
+}
+} // namespace
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -27,7 +37,28 @@ TcpServer::TcpServer(EventLoop *loop,
     , messageCallback_()
     , nextConnId_(1)
     , started_(0)
+    , incomingCpuDispatch_(false)
+    , incomingCpuHits_(0)
+    , incomingCpuMisses_(0)
+    , tcpInfoSampling_(false)
+    , budgetMetricId_(0)
+    , cpuTag_(CpuAccounting::kUntagged)
 {
+    metrics::Registry &registry = metrics::Registry::instance();
+    std::string labels = metrics::Registry::label("server", name_);
+    connectionsMetric_ = registry.counter("muduo_tcp_connections_total",
+                                          "Connections accepted and handed to an io loop.", labels);
+    rejectedMetric_ = registry.counter("muduo_tcp_connections_rejected_total",
+                                       "Connections closed on accept because of the memory budget.", labels);
+    activeMetric_ = registry.gauge("muduo_tcp_connections_active", "Connections currently open.", labels);
+    connectionMetrics_.bytesReceived = registry.counter("muduo_tcp_bytes_received_total",
+                                                        "Bytes read from connections.", labels);
+    connectionMetrics_.bytesSent = registry.counter("muduo_tcp_bytes_sent_total",
+                                                    "Bytes written to connections.", labels);
+    connectionMetrics_.bufferedBytes = registry.gauge("muduo_tcp_buffered_bytes",
+                                                      "Bytes held in connection input and output buffers.", labels);
+    acceptor_->setMetricLabels(labels);
+
     // 当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生，执行handleRead()调用TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(
         std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
@@ -35,6 +66,14 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
+    metrics::Registry::instance().removeGaugeFunction(budgetMetricId_);
+    activeMetric_.add(-static_cast<int64_t>(connections_.size()));
+    for (auto &item : tcpInfoSamplers_)
+    {
+        // 剩下的连接仍然持有采样器 这里只停掉定时器
+        std::shared_ptr<LoopTcpInfoSampler> sampler = item.second;
+        item.first->runInLoop([sampler]() { sampler->stop(); });
+    }
     for(auto &item : connections_)
     {
         TcpConnectionPtr conn(item.second);
@@ -52,12 +91,87 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads_);
 }
 
+void TcpServer::setSocketOptions(const SocketOptions &options)
+{
+    socketOptions_ = options;
+    acceptor_->setSocketOptions(options);
+}
+
+void TcpServer::setCpuTag(const std::string &name)
+{
+    cpuTag_ = CpuAccounting::tag(name);
+}
+
+void TcpServer::setTcpInfoSampling(const TcpInfoOptions &options)
+{
+    tcpInfoSampling_ = true;
+    tcpInfoOptions_ = options;
+}
+
+void TcpServer::setMemoryBudget(size_t limitBytes, int policy)
+{
+    memoryBudget_.reset(new MemoryBudget(limitBytes, policy));
+}
+
 // 开启服务器监听
 void TcpServer::start()
 {
     if (started_.fetch_add(1) == 0)    // 防止一个TcpServer对象被start多次
     {
         threadPool_->start(threadInitCallback_);    // 启动底层的loop线程池
+        if (memoryBudget_)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                memoryAccounts_[ioLoop] = memoryBudget_->createAccount(ioLoop);
+            }
+            std::shared_ptr<MemoryBudget> budget = memoryBudget_;
+            budgetMetricId_ = metrics::Registry::instance().addGaugeFunction(
+                "muduo_tcp_memory_budget_usage_bytes", "Bytes counted against the server memory budget.",
+                metrics::Registry::label("server", name_),
+                [budget]() { return static_cast<double>(budget->usage()); });
+        }
+        if (socketOptions_.rxTimestamps)
+        {
+            // 接收延迟按loop分开 一个忙的loop不会被其他loop平均掉
+            static const std::vector<int64_t> kBounds = {1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+                                                         500000, 1000000, 2500000, 10000000, 100000000};
+            metrics::Registry &registry = metrics::Registry::instance();
+            std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+            for (size_t i = 0; i < loops.size(); ++i)
+            {
+                std::string labels = metrics::Registry::label("server", name_) + "," +
+                                     metrics::Registry::label("loop", std::to_string(i));
+                ConnectionMetrics loopMetrics = connectionMetrics_;
+                loopMetrics.kernelToPoll = registry.histogram(
+                    "muduo_tcp_rx_kernel_to_poll_seconds",
+                    "Kernel receive timestamp to epoll_wait return, per io loop.", kBounds, 1e-9, labels);
+                loopMetrics.pollToCallback = registry.histogram(
+                    "muduo_tcp_rx_poll_to_callback_seconds",
+                    "epoll_wait return to MessageCallback start, per io loop.", kBounds, 1e-9, labels);
+                loopConnectionMetrics_[loops[i]] = loopMetrics;
+            }
+        }
+        if (tcpInfoSampling_)
+        {
+            metrics::Registry &registry = metrics::Registry::instance();
+            std::string labels = metrics::Registry::label("server", name_);
+            LoopTcpInfoSampler::Metrics samplerMetrics;
+            samplerMetrics.rtt = registry.histogram(
+                "muduo_tcp_rtt_seconds", "Smoothed RTT from sampled TCP_INFO.",
+                {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000},
+                1e-6, labels);
+            samplerMetrics.retransmits = registry.counter(
+                "muduo_tcp_retransmits_total", "Retransmitted segments seen by TCP_INFO sampling.", labels);
+            samplerMetrics.slowConsumers = registry.counter(
+                "muduo_tcp_slow_consumers_total", "Connections reported as slow consumers.", labels);
+            SlowConsumerCallback cb = slowConsumerCallback_ ? slowConsumerCallback_ : defaultSlowConsumerCallback;
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                tcpInfoSamplers_[ioLoop] = std::make_shared<LoopTcpInfoSampler>(ioLoop, tcpInfoOptions_, cb,
+                                                                                samplerMetrics);
+            }
+        }
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
@@ -65,8 +179,35 @@ void TcpServer::start()
 // 有一个新用户连接，acceptor会执行这个回调操作，负责将mainLoop接收到的请求连接(acceptChannel_会有读事件发生)通过回调轮询分发给subLoop去处理
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
-   // 轮询算法 选择一个subLoop 来管理connfd对应的channel
-    EventLoop *ioLoop = threadPool_->getNextLoop();
+    // 缓冲区占用已经超出预算 新连接只会让情况更糟 直接拒绝
+    if (memoryBudget_ && memoryBudget_->shouldReject())
+    {
+        LOG_ERROR("TcpServer::newConnection [%s] - reject %s, buffered %ld bytes over budget %lu\n",
+                  name_.c_str(), peerAddr.toIpPort().c_str(), memoryBudget_->usage(), memoryBudget_->limit());
+        memoryBudget_->countRejected();
+        rejectedMetric_.inc();
+        ::close(sockfd);
+        return;
+    }
+
+    EventLoop *ioLoop = nullptr;
+    if (incomingCpuDispatch_)
+    {
+        ioLoop = threadPool_->getLoopForCpu(sockets::getIncomingCpu(sockfd));
+        if (ioLoop != nullptr)
+        {
+            incomingCpuHits_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            incomingCpuMisses_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (ioLoop == nullptr)
+    {
+        // 轮询算法 选择一个subLoop 来管理connfd对应的channel
+        ioLoop = threadPool_->getNextLoop();
+    }
     char buf[64] = {0};
     snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
     ++nextConnId_;  // 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
@@ -76,25 +217,34 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
              name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
     
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
-    sockaddr_in local;
-    ::memset(&local, 0, sizeof(local));
-    socklen_t addrlen = sizeof(local);
-    if(::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
-    {
-        LOG_ERROR("sockets::getLocalAddr");
-    }
-
-    InetAddress localAddr(local);
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
     TcpConnectionPtr conn(new TcpConnection(ioLoop,
                                             connName,
                                             sockfd,
                                             localAddr,
                                             peerAddr));
+    conn->setSocketOptions(socketOptions_);
+    conn->setMetrics(socketOptions_.rxTimestamps ? loopConnectionMetrics_[ioLoop] : connectionMetrics_);
+    conn->setCpuTag(cpuTag_);
+    if (tlsContext_)
+    {
+        conn->startTls(tlsContext_);
+    }
     connections_[connName] = conn;
+    connectionsMetric_.inc();
+    activeMetric_.inc();
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (memoryBudget_)
+    {
+        conn->setMemoryAccount(memoryAccounts_[ioLoop]);
+    }
+    if (tcpInfoSampling_)
+    {
+        conn->setTcpInfoSampler(tcpInfoSamplers_[ioLoop]);
+    }
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
@@ -118,7 +268,10 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
              name_.c_str(), conn->name().c_str());
 
-    connections_.erase(conn->name()); 
+    if (connections_.erase(conn->name()) > 0)
+    {
+        activeMetric_.dec();
+    }
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn)); //回到 conn 所在的 SubLoop 去销毁连接
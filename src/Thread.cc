@@ -36,6 +36,7 @@ void Thread::start()  // 一个Thread对象 记录的就是一个新线程的详
         tid_ = CurrentThread::tid();  // 查询线程的tid值
         sem_post(&sem);
         func_();  //one loop per thread
+    }));
 
     // 这里必须等待获取上面新创建的线程的tid值
     sem_wait(&sem);
@@ -1,4 +1,5 @@
-#include <time.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "Timestamp.h"
 
@@ -13,24 +14,61 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    // clock_gettime走vDSO 不陷入内核
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
 }
+
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
-    return buf;
+    return toFormattedString(true);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64];
+    size_t len = formatTo(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, len);
 }
 
-// #include <iostream>
-// int main() {
-//     std::cout << Timestamp::now().toString() << std::endl;
-//     return 0;
-// }
\ No newline at end of file
+size_t Timestamp::formatTo(char *buf, size_t size, bool showMicroseconds) const
+{
+    // 每个线程缓存最近一次格式化的秒 日志等场景下同一秒内的时间只需要拼上微秒
+    thread_local time_t t_lastSecond = -1;
+    thread_local char t_secondPrefix[32];
+    thread_local size_t t_prefixLen = 0;
+
+    time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        int n = snprintf(t_secondPrefix, sizeof t_secondPrefix, "%4d/%02d/%02d %02d:%02d:%02d",
+                         tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                         tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+        t_prefixLen = static_cast<size_t>(n);
+        t_lastSecond = seconds;
+    }
+
+    if (size < 32)
+    {
+        return 0;
+    }
+    ::memcpy(buf, t_secondPrefix, t_prefixLen);
+    size_t len = t_prefixLen;
+    if (showMicroseconds)
+    {
+        // 手工转换6位微秒 比snprintf快
+        int micro = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        buf[len++] = '.';
+        for (int i = 5; i >= 0; --i)
+        {
+            buf[len + i] = static_cast<char>('0' + micro % 10);
+            micro /= 10;
+        }
+        len += 6;
+    }
+    buf[len] = '\0';
+    return len;
+}
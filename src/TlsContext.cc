@@ -0,0 +1,347 @@
+#include <iterator>
+#include <string>
+#include <time.h>
+
+#include "TlsContext.h"
+#include "TlsStream.h"
+#include "Logger.h"
+
+#ifdef MUDUO_HAS_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+std::string tls::sslErrors()
+{
+    std::string result;
+    char buf[256];
+    unsigned long err = 0;
+    while ((err = ERR_get_error()) != 0)
+    {
+        ERR_error_string_n(err, buf, sizeof buf);
+        if (!result.empty())
+        {
+            result += "; ";
+        }
+        result += buf;
+    }
+    return result;
+}
+
+static TlsSessionCache *cacheOf(SSL *ssl)
+{
+    TlsStream *stream = static_cast<TlsStream *>(SSL_get_app_data(ssl));
+    return stream != nullptr ? stream->sessionCache() : nullptr;
+}
+
+// 服务端生成了新会话 按会话ID存入本loop的缓存 返回1表示接管了引用
+static int serverNewSession(SSL *ssl, SSL_SESSION *session)
+{
+    TlsSessionCache *cache = cacheOf(ssl);
+    if (cache == nullptr)
+    {
+        return 0;
+    }
+    unsigned int len = 0;
+    const unsigned char *id = SSL_SESSION_get_id(session, &len);
+    cache->put(std::string(reinterpret_cast<const char *>(id), len), session);
+    return 1;
+}
+
+static SSL_SESSION *serverGetSession(SSL *ssl, const unsigned char *id, int len, int *copy)
+{
+    *copy = 1; // 缓存继续持有引用 OpenSSL自己再加一个
+    TlsSessionCache *cache = cacheOf(ssl);
+    if (cache == nullptr)
+    {
+        return nullptr;
+    }
+    return cache->get(std::string(reinterpret_cast<const char *>(id), static_cast<size_t>(len)));
+}
+
+// 客户端收到服务端发来的会话(TLS1.3在握手之后才到) 按对端存入本loop的缓存
+static int clientNewSession(SSL *ssl, SSL_SESSION *session)
+{
+    TlsStream *stream = static_cast<TlsStream *>(SSL_get_app_data(ssl));
+    if (stream == nullptr || stream->sessionCache() == nullptr)
+    {
+        return 0;
+    }
+    stream->sessionCache()->put(stream->peerKey(), session);
+    return 1;
+}
+
+TlsContext::TlsContext(Mode mode, const Options &options)
+    : mode_(mode)
+    , options_(options)
+    , ctx_(nullptr)
+{
+    SSL_CTX *ctx = SSL_CTX_new(mode == kServer ? TLS_server_method() : TLS_client_method());
+    if (ctx == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d SSL_CTX_new err:%s\n", __FILE__, __FUNCTION__, __LINE__, tls::sslErrors().c_str());
+    }
+    ctx_ = ctx;
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    // 非阻塞socket上SSL_write可能只写出一部分 剩余的数据留在outputBuffer_里 下次重试时地址可能已经变了
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                                SSL_MODE_RELEASE_BUFFERS);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // 对端没发close_notify直接关闭时当作正常关闭 和普通TCP连接的行为一致
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (options_.ktls)
+    {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+#else
+    if (options_.ktls)
+    {
+        LOG_INFO("TlsContext - OpenSSL built without kTLS, falling back to SSL_write\n");
+    }
+#endif
+    if (!options_.cipherList.empty() && SSL_CTX_set_cipher_list(ctx, options_.cipherList.c_str()) != 1)
+    {
+        LOG_FATAL("%s:%s:%d bad cipher list %s\n", __FILE__, __FUNCTION__, __LINE__, options_.cipherList.c_str());
+    }
+    if (!options_.cipherSuites.empty() && SSL_CTX_set_ciphersuites(ctx, options_.cipherSuites.c_str()) != 1)
+    {
+        LOG_FATAL("%s:%s:%d bad ciphersuites %s\n", __FILE__, __FUNCTION__, __LINE__, options_.cipherSuites.c_str());
+    }
+
+    loadCertificates();
+
+    if (mode_ == kServer)
+    {
+        static const unsigned char kSessionIdContext[] = "muduo";
+        SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof kSessionIdContext - 1);
+        if (!options_.sessionTickets)
+        {
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        }
+        if (options_.sessionCacheSize > 0)
+        {
+            // 不用OpenSSL内部带锁的缓存 改用每个loop一个的外部缓存
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+            SSL_CTX_sess_set_new_cb(ctx, serverNewSession);
+            SSL_CTX_sess_set_get_cb(ctx, serverGetSession);
+        }
+        else
+        {
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        }
+        SSL_CTX_set_timeout(ctx, options_.sessionTimeoutSeconds);
+    }
+    else if (options_.sessionCacheSize > 0)
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, clientNewSession);
+    }
+}
+
+TlsContext::~TlsContext()
+{
+    caches_.clear(); // 先释放缓存中的会话
+    SSL_CTX_free(static_cast<SSL_CTX *>(ctx_));
+}
+
+bool TlsContext::available()
+{
+    return true;
+}
+
+void TlsContext::loadCertificates()
+{
+    SSL_CTX *ctx = static_cast<SSL_CTX *>(ctx_);
+    if (!options_.certFile.empty())
+    {
+        if (SSL_CTX_use_certificate_chain_file(ctx, options_.certFile.c_str()) != 1 ||
+            SSL_CTX_use_PrivateKey_file(ctx, (options_.keyFile.empty() ? options_.certFile : options_.keyFile).c_str(),
+                                          SSL_FILETYPE_PEM) != 1 ||
+            SSL_CTX_check_private_key(ctx) != 1)
+        {
+            LOG_FATAL("%s:%s:%d load %s err:%s\n", __FILE__, __FUNCTION__, __LINE__,
+                      options_.certFile.c_str(), tls::sslErrors().c_str());
+        }
+    }
+    else if (mode_ == kServer)
+    {
+        LOG_FATAL("%s:%s:%d server TlsContext needs a certificate\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+
+    if (options_.verifyPeer)
+    {
+        int ok = options_.caFile.empty() ? SSL_CTX_set_default_verify_paths(ctx)
+                                         : SSL_CTX_load_verify_locations(ctx, options_.caFile.c_str(), nullptr);
+        if (ok != 1)
+        {
+            LOG_FATAL("%s:%s:%d load CA %s err:%s\n", __FILE__, __FUNCTION__, __LINE__,
+                      options_.caFile.c_str(), tls::sslErrors().c_str());
+        }
+        SSL_CTX_set_verify(ctx, mode_ == kServer ? SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT : SSL_VERIFY_PEER,
+                             nullptr);
+    }
+    else
+    {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+    }
+}
+
+TlsSessionCache *TlsContext::sessionCache(EventLoop *loop)
+{
+    if (options_.sessionCacheSize == 0)
+    {
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_ptr<TlsSessionCache> &cache = caches_[loop];
+    if (!cache)
+    {
+        cache.reset(new TlsSessionCache(options_.sessionCacheSize, options_.sessionTimeoutSeconds));
+    }
+    return cache.get();
+}
+
+TlsSessionCache::TlsSessionCache(size_t capacity, long timeoutSeconds)
+    : capacity_(capacity)
+    , timeoutSeconds_(timeoutSeconds)
+    , hits_(0)
+    , misses_(0)
+{
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+    for (Entry &entry : entries_)
+    {
+        SSL_SESSION_free(entry.second);
+    }
+}
+
+void TlsSessionCache::put(const std::string &key, ssl_session_st *session)
+{
+    auto found = index_.find(key);
+    if (found != index_.end())
+    {
+        erase(found->second);
+    }
+    entries_.emplace_front(key, session);
+    index_[key] = entries_.begin();
+    while (entries_.size() > capacity_)
+    {
+        erase(std::prev(entries_.end()));
+    }
+}
+
+TlsSessionCache::EntryList::iterator TlsSessionCache::find(const std::string &key)
+{
+    auto found = index_.find(key);
+    if (found == index_.end())
+    {
+        ++misses_;
+        return entries_.end();
+    }
+    EntryList::iterator it = found->second;
+    SSL_SESSION *session = it->second;
+    long age = static_cast<long>(::time(nullptr)) - static_cast<long>(SSL_SESSION_get_time(session));
+    if (age > timeoutSeconds_ || age > SSL_SESSION_get_timeout(session))
+    {
+        erase(it);
+        ++misses_;
+        return entries_.end();
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it); // 移到头部 迭代器仍然有效
+    return it;
+}
+
+ssl_session_st *TlsSessionCache::get(const std::string &key)
+{
+    EntryList::iterator it = find(key);
+    return it != entries_.end() ? it->second : nullptr;
+}
+
+ssl_session_st *TlsSessionCache::take(const std::string &key)
+{
+    EntryList::iterator it = find(key);
+    if (it == entries_.end())
+    {
+        return nullptr;
+    }
+    SSL_SESSION *session = it->second;
+    index_.erase(it->first);
+    entries_.erase(it);
+    return session;
+}
+
+void TlsSessionCache::erase(EntryList::iterator it)
+{
+    SSL_SESSION_free(it->second);
+    index_.erase(it->first);
+    entries_.erase(it);
+}
+
+#else // MUDUO_HAS_OPENSSL
+
+std::string tls::sslErrors()
+{
+    return std::string();
+}
+
+// 没有OpenSSL时只保留接口 构造TlsContext直接退出
+TlsContext::TlsContext(Mode mode, const Options &options)
+    : mode_(mode)
+    , options_(options)
+    , ctx_(nullptr)
+{
+    LOG_FATAL("%s:%s:%d muduo was built without OpenSSL, TLS is unavailable\n", __FILE__, __FUNCTION__, __LINE__);
+}
+
+TlsContext::~TlsContext() = default;
+
+bool TlsContext::available()
+{
+    return false;
+}
+
+void TlsContext::loadCertificates()
+{
+}
+
+TlsSessionCache *TlsContext::sessionCache(EventLoop *)
+{
+    return nullptr;
+}
+
+TlsSessionCache::TlsSessionCache(size_t capacity, long timeoutSeconds)
+    : capacity_(capacity), timeoutSeconds_(timeoutSeconds), hits_(0), misses_(0)
+{
+}
+
+TlsSessionCache::~TlsSessionCache() = default;
+
+void TlsSessionCache::put(const std::string &, ssl_session_st *)
+{
+}
+
+ssl_session_st *TlsSessionCache::get(const std::string &)
+{
+    return nullptr;
+}
+
+ssl_session_st *TlsSessionCache::take(const std::string &)
+{
+    return nullptr;
+}
+
+TlsSessionCache::EntryList::iterator TlsSessionCache::find(const std::string &)
+{
+    return entries_.end();
+}
+
+void TlsSessionCache::erase(EntryList::iterator)
+{
+}
+
+#endif // MUDUO_HAS_OPENSSL
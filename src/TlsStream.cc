@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <errno.h>
+#include <stdint.h>
+#include <string>
+
+#include "TlsStream.h"
+#include "TlsContext.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#ifdef MUDUO_HAS_OPENSSL
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+static const size_t kTlsRecordSize = 16 * 1024; // TLS记录明文的最大长度
+
+TlsStream::TlsStream(const std::shared_ptr<TlsContext> &context, EventLoop *loop, int sockfd,
+                     const std::string &peerKey, const std::string &serverName)
+    : context_(context)
+    , cache_(context->sessionCache(loop))
+    , peerKey_(peerKey)
+    , ssl_(nullptr)
+    , handshakeDone_(false)
+    , wantWrite_(false)
+    , ktlsSend_(false)
+    , ktlsRecv_(false)
+    , resumed_(false)
+    , failed_(false)
+{
+    SSL *ssl = SSL_new(static_cast<SSL_CTX *>(context->nativeHandle()));
+    if (ssl == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d SSL_new err:%s\n", __FILE__, __FUNCTION__, __LINE__, tls::sslErrors().c_str());
+    }
+    ssl_ = ssl;
+    SSL_set_fd(ssl, sockfd);
+    SSL_set_app_data(ssl, this); // 会话缓存的回调通过它找到本loop的缓存
+    if (context->mode() == TlsContext::kServer)
+    {
+        SSL_set_accept_state(ssl);
+    }
+    else
+    {
+        SSL_set_connect_state(ssl);
+        if (!serverName.empty())
+        {
+            SSL_set_tlsext_host_name(ssl, serverName.c_str());
+            if (context->options().verifyPeer)
+            {
+                SSL_set1_host(ssl, serverName.c_str());
+            }
+        }
+        if (cache_ != nullptr)
+        {
+            SSL_SESSION *session = cache_->take(peerKey_);
+            if (session != nullptr)
+            {
+                SSL_set_session(ssl, session); // SSL自己持有一个引用
+                SSL_SESSION_free(session);
+            }
+        }
+    }
+}
+
+TlsStream::~TlsStream()
+{
+    SSL *ssl = static_cast<SSL *>(ssl_);
+    if (handshakeDone_ && !failed_)
+    {
+        // 没有发过close_notify的连接在SSL_free时会把会话标记为不可复用
+        // 对端先关闭、或者收到EOF时OpenSSL覆盖了关闭标志 都属于正常关闭 会话仍然可以复用
+        SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+    SSL_free(ssl);
+}
+
+int TlsStream::handshake()
+{
+    SSL *ssl = static_cast<SSL *>(ssl_);
+    ERR_clear_error();
+    int ret = SSL_do_handshake(ssl);
+    if (ret == 1)
+    {
+        onHandshakeDone();
+        return 1;
+    }
+    int err = SSL_get_error(ssl, ret);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    {
+        wantWrite_ = (err == SSL_ERROR_WANT_WRITE);
+        return 0;
+    }
+    failed_ = true;
+    context_->mutableStats().failed.fetch_add(1, std::memory_order_relaxed);
+    LOG_ERROR("TlsStream::handshake %s failed - ssl error %d errno %d %s\n",
+              peerKey_.c_str(), err, errno, tls::sslErrors().c_str());
+    return -1;
+}
+
+void TlsStream::onHandshakeDone()
+{
+    SSL *ssl = static_cast<SSL *>(ssl_);
+    handshakeDone_ = true;
+    wantWrite_ = false;
+    resumed_ = SSL_session_reused(ssl) == 1;
+#if !defined(OPENSSL_NO_KTLS) && defined(BIO_get_ktls_send)
+    // OpenSSL在握手完成时已经尝试过setsockopt(TCP_ULP, "tls") 这里只是查询结果
+    ktlsSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl)) != 0;
+    ktlsRecv_ = BIO_get_ktls_recv(SSL_get_rbio(ssl)) != 0;
+#endif
+    TlsContext::Stats &stats = context_->mutableStats();
+    stats.handshakes.fetch_add(1, std::memory_order_relaxed);
+    if (resumed_)
+    {
+        stats.resumed.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (ktlsSend_)
+    {
+        stats.ktlsSend.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (ktlsRecv_)
+    {
+        stats.ktlsRecv.fetch_add(1, std::memory_order_relaxed);
+    }
+    LOG_DEBUG("TlsStream %s handshake done %s %s resumed=%d ktls tx=%d rx=%d\n", peerKey_.c_str(),
+              version().c_str(), cipher().c_str(), resumed_, ktlsSend_, ktlsRecv_);
+}
+
+ssize_t TlsStream::read(Buffer *buffer, int *savedErrno)
+{
+    SSL *ssl = static_cast<SSL *>(ssl_);
+    ssize_t total = 0;
+    // 一次把socket里的记录读完 SSL内部缓存的明文也要取干净 否则不会再收到EPOLLIN
+    for (;;)
+    {
+        buffer->ensureWritableBytes(kTlsRecordSize);
+        ERR_clear_error();
+        int n = SSL_read(ssl, buffer->beginWrite(), static_cast<int>(buffer->writableBytes()));
+        if (n > 0)
+        {
+            buffer->hasWritten(static_cast<size_t>(n));
+            total += n;
+            continue;
+        }
+        int err = SSL_get_error(ssl, n);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+        {
+            wantWrite_ = (err == SSL_ERROR_WANT_WRITE);
+            if (total == 0)
+            {
+                *savedErrno = EAGAIN; // 例如只收到了TLS1.3的NewSessionTicket
+                return -1;
+            }
+            return total;
+        }
+        if (err == SSL_ERROR_ZERO_RETURN)
+        {
+            return total; // 对端发了close_notify 已读到的数据先交给用户 再次读时返回0
+        }
+        if (total > 0)
+        {
+            return total;
+        }
+        failed_ = true;
+        *savedErrno = (err == SSL_ERROR_SYSCALL && errno != 0) ? errno : EPROTO;
+        LOG_ERROR("TlsStream::read %s - ssl error %d %s\n", peerKey_.c_str(), err, tls::sslErrors().c_str());
+        return -1;
+    }
+}
+
+ssize_t TlsStream::write(const void *data, size_t len, int *savedErrno)
+{
+    SSL *ssl = static_cast<SSL *>(ssl_);
+    if (len == 0)
+    {
+        return 0;
+    }
+    ERR_clear_error();
+    int n = SSL_write(ssl, data, static_cast<int>(std::min(len, static_cast<size_t>(INT32_MAX))));
+    if (n > 0)
+    {
+        return n;
+    }
+    int err = SSL_get_error(ssl, n);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    {
+        wantWrite_ = (err == SSL_ERROR_WANT_WRITE);
+        *savedErrno = EAGAIN;
+        return -1;
+    }
+    failed_ = true;
+    *savedErrno = (err == SSL_ERROR_SYSCALL && errno != 0) ? errno : EPROTO;
+    LOG_ERROR("TlsStream::write %s - ssl error %d %s\n", peerKey_.c_str(), err, tls::sslErrors().c_str());
+    return -1;
+}
+
+void TlsStream::shutdown()
+{
+    if (handshakeDone_)
+    {
+        ERR_clear_error();
+        SSL_shutdown(static_cast<SSL *>(ssl_)); // 只发送close_notify 非阻塞socket上不等待对端
+        ERR_clear_error();
+    }
+}
+
+std::string TlsStream::version() const
+{
+    return SSL_get_version(static_cast<SSL *>(ssl_));
+}
+
+std::string TlsStream::cipher() const
+{
+    const char *name = SSL_get_cipher_name(static_cast<SSL *>(ssl_));
+    return name != nullptr ? name : "";
+}
+
+#else // MUDUO_HAS_OPENSSL
+
+// 没有OpenSSL时TlsContext无法构造 这里只是让链接通过
+TlsStream::TlsStream(const std::shared_ptr<TlsContext> &context, EventLoop *, int,
+                     const std::string &peerKey, const std::string &)
+    : context_(context), cache_(nullptr), peerKey_(peerKey), ssl_(nullptr), handshakeDone_(false),
+      wantWrite_(false), ktlsSend_(false), ktlsRecv_(false), resumed_(false), failed_(false)
+{
+}
+
+TlsStream::~TlsStream() = default;
+
+int TlsStream::handshake()
+{
+    return -1;
+}
+
+void TlsStream::onHandshakeDone()
+{
+}
+
+ssize_t TlsStream::read(Buffer *, int *savedErrno)
+{
+    *savedErrno = ENOTSUP;
+    return -1;
+}
+
+ssize_t TlsStream::write(const void *, size_t, int *savedErrno)
+{
+    *savedErrno = ENOTSUP;
+    return -1;
+}
+
+void TlsStream::shutdown()
+{
+}
+
+std::string TlsStream::version() const
+{
+    return "";
+}
+
+std::string TlsStream::cipher() const
+{
+    return "";
+}
+
+#endif // MUDUO_HAS_OPENSSL
@@ -0,0 +1,112 @@
+#include <functional>
+
+#include "UdpServer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+    if (loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null!\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop))
+    , listenAddr_(listenAddr)
+    , name_(nameArg)
+    , threadPool_(new EventLoopThreadPool(loop, name_))
+    , numThreads_(0)
+    , batchSize_(UdpSocket::kDefaultBatchSize)
+    , recvBufferSize_(0)
+    , gro_(false)
+    , started_(0)
+    , receivedPackets_(0)
+    , receivedBytes_(0)
+    , sentPackets_(0)
+    , droppedSends_(0)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    for (std::shared_ptr<Shard> &shard : shards_)
+    {
+        // Channel必须在所属loop中从Poller移除 lambda持有shared_ptr 移除之后Shard随之析构
+        std::shared_ptr<Shard> s(shard);
+        shard.reset();
+        s->loop->runInLoop([s]() {
+            s->channel->disableAll();
+            s->channel->remove();
+        });
+    }
+}
+
+void UdpServer::start()
+{
+    if (started_.fetch_add(1) == 0)
+    {
+        threadPool_->setThreadNum(numThreads_);
+        threadPool_->start(threadInitCallback_);
+        // 没有subloop时getAllLoops返回baseLoop 只有一个socket
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            startShard(ioLoop);
+        }
+        LOG_INFO("UdpServer::start[%s] - %zu sockets on %s%s\n", name_.c_str(), shards_.size(),
+                 listenAddr_.toIpPort().c_str(), gro_ ? " (GRO)" : "");
+    }
+}
+
+void UdpServer::startShard(EventLoop *loop)
+{
+    std::shared_ptr<Shard> shard(new Shard);
+    shard->loop = loop;
+    shard->socket.reset(new UdpSocket(batchSize_, UdpSocket::kDefaultSlotSize, listenAddr_.family()));
+    shard->socket->setReuseAddr(true);
+    shard->socket->setReusePort(true);
+    if (recvBufferSize_ > 0)
+    {
+        shard->socket->setRecvBufferSize(recvBufferSize_);
+    }
+    if (gro_)
+    {
+        shard->socket->enableGro(true);
+    }
+    shard->socket->bindAddress(listenAddr_);
+    shard->channel.reset(new Channel(loop, shard->socket->fd()));
+    Shard *raw = shard.get();
+    shard->channel->setReadCallback(std::bind(&UdpServer::handleRead, this, raw, std::placeholders::_1));
+    shards_.push_back(shard);
+    loop->runInLoop([raw]() { raw->channel->enableReading(); });
+}
+
+void UdpServer::handleRead(Shard *shard, Timestamp)
+{
+    UdpSocket *socket = shard->socket.get();
+    if (messageCallback_)
+    {
+        socket->receive([this, socket](const char *data, size_t len, const InetAddress &peer, Timestamp receiveTime) {
+            messageCallback_(socket, data, len, peer, receiveTime);
+        });
+    }
+    else
+    {
+        socket->receive([](const char *, size_t, const InetAddress &, Timestamp) {});
+    }
+    // 本轮回调里排队的回复一次发出
+    socket->flush();
+
+    // 把本分片的增量累加到全局计数 每轮一次 不在每个数据报上竞争原子变量
+    const UdpSocket::Stats &now = socket->stats();
+    UdpSocket::Stats &reported = shard->reported;
+    receivedPackets_.fetch_add(now.received - reported.received, std::memory_order_relaxed);
+    receivedBytes_.fetch_add(now.receivedBytes - reported.receivedBytes, std::memory_order_relaxed);
+    sentPackets_.fetch_add(now.sent - reported.sent, std::memory_order_relaxed);
+    droppedSends_.fetch_add(now.sendDropped - reported.sendDropped, std::memory_order_relaxed);
+    reported = now;
+}
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include "UdpSocket.h"
+#include "Logger.h"
+
+const int UdpSocket::kDefaultBatchSize;
+const size_t UdpSocket::kDefaultSlotSize;
+const size_t UdpSocket::kGroSlotSize;
+const int UdpSocket::kMaxGsoSegments;
+
+// 每个接收槽位的控制消息空间 只用来接收UDP_GRO的gso_size
+static const size_t kControlSize = CMSG_SPACE(sizeof(int));
+
+static int createNonblockingUdp(sa_family_t family)
+{
+    int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp socket create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+UdpSocket::UdpSocket(int batchSize, size_t slotSize, sa_family_t family)
+    : sockfd_(createNonblockingUdp(family))
+    , batchSize_(std::max(batchSize, 1))
+    , slotSize_(slotSize)
+    , sendSlotSize_(slotSize)
+    , gro_(false)
+    , gsoSupported_(true)
+    , sendBuffer_(static_cast<size_t>(batchSize_) * slotSize)
+    , sendMsgs_(static_cast<size_t>(batchSize_))
+    , sendIovecs_(static_cast<size_t>(batchSize_))
+    , sendAddrs_(static_cast<size_t>(batchSize_))
+    , pendingSends_(0)
+{
+    setupRecvArena();
+}
+
+UdpSocket::~UdpSocket()
+{
+    ::close(sockfd_);
+}
+
+void UdpSocket::setupRecvArena()
+{
+    const size_t n = static_cast<size_t>(batchSize_);
+    recvBuffer_.assign(n * slotSize_, 0);
+    recvMsgs_.assign(n, mmsghdr());
+    recvIovecs_.assign(n, iovec());
+    recvAddrs_.assign(n, sockaddr_in6());
+    recvControl_.assign(n * kControlSize, 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvBuffer_[i * slotSize_];
+        recvIovecs_[i].iov_len = slotSize_;
+        msghdr &hdr = recvMsgs_[i].msg_hdr;
+        hdr.msg_iov = &recvIovecs_[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_name = &recvAddrs_[i];
+        hdr.msg_namelen = sizeof(sockaddr_in6);
+        hdr.msg_control = &recvControl_[i * kControlSize];
+        hdr.msg_controllen = kControlSize;
+    }
+}
+
+void UdpSocket::bindAddress(const InetAddress &addr)
+{
+    if (0 != ::bind(sockfd_, addr.getSockAddr(), addr.getSockLen()))
+    {
+        LOG_FATAL("bind udp sockfd:%d to %s fail err:%d\n", sockfd_, addr.toIpPort().c_str(), errno);
+    }
+}
+
+void UdpSocket::setReuseAddr(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+}
+
+void UdpSocket::setReusePort(bool on)
+{
+    // 多个socket绑定同一个端口 内核按四元组哈希把数据报分给不同的socket 每个loop一个socket
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+}
+
+void UdpSocket::setRecvBufferSize(int bytes)
+{
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+}
+
+void UdpSocket::setSendBufferSize(int bytes)
+{
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+}
+
+bool UdpSocket::enableGro(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, IPPROTO_UDP, UDP_GRO, &optval, sizeof(optval)) < 0)
+    {
+        LOG_INFO("UdpSocket::enableGro - UDP_GRO not supported err:%d\n", errno);
+        return false;
+    }
+    gro_ = on;
+    // 合并后的消息可能接近64KB 槽位太小会被截断
+    size_t wanted = on ? std::max(slotSize_, kGroSlotSize) : slotSize_;
+    if (wanted != slotSize_)
+    {
+        slotSize_ = wanted;
+        setupRecvArena();
+    }
+    return true;
+}
+
+int UdpSocket::receive(const DatagramCallback &cb, int maxBatches)
+{
+    int delivered = 0;
+    for (int round = 0; round < maxBatches; ++round)
+    {
+        // 上一轮recvmmsg改写了namelen和controllen 重新设置
+        for (int i = 0; i < batchSize_; ++i)
+        {
+            recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+            recvMsgs_[i].msg_hdr.msg_controllen = gro_ ? kControlSize : 0;
+        }
+        int n = ::recvmmsg(sockfd_, recvMsgs_.data(), static_cast<unsigned>(batchSize_), MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpSocket::receive recvmmsg err:%d\n", errno);
+            }
+            break;
+        }
+        ++stats_.recvCalls;
+        Timestamp receiveTime = Timestamp::now();
+        for (int i = 0; i < n; ++i)
+        {
+            const msghdr &hdr = recvMsgs_[i].msg_hdr;
+            const char *data = static_cast<const char *>(recvIovecs_[i].iov_base);
+            size_t len = recvMsgs_[i].msg_len;
+            if (hdr.msg_flags & MSG_TRUNC)
+            {
+                ++stats_.truncated;
+            }
+
+            size_t segment = len;
+            if (gro_)
+            {
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg))
+                {
+                    if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        int gsoSize = 0;
+                        ::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+                        if (gsoSize > 0)
+                        {
+                            segment = static_cast<size_t>(gsoSize);
+                        }
+                    }
+                }
+            }
+
+            InetAddress peer(reinterpret_cast<const sockaddr *>(&recvAddrs_[i]), hdr.msg_namelen);
+            // GRO合并的消息里除了最后一个 每个数据报都是segment字节 空数据报也回调一次
+            size_t offset = 0;
+            do
+            {
+                size_t piece = std::min(segment, len - offset);
+                cb(data + offset, piece, peer, receiveTime);
+                offset += piece;
+                ++delivered;
+                ++stats_.received;
+                stats_.receivedBytes += static_cast<int64_t>(piece);
+            } while (offset < len);
+        }
+        if (n < batchSize_)
+        {
+            break; // 已经收空了 不必再调用一次拿EAGAIN
+        }
+    }
+    return delivered;
+}
+
+bool UdpSocket::sendTo(const void *data, size_t len, const InetAddress &peer)
+{
+    ++stats_.sendCalls;
+    ssize_t n = ::sendto(sockfd_, data, len, 0, peer.getSockAddr(), peer.getSockLen());
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+        {
+            LOG_ERROR("UdpSocket::sendTo %s err:%d\n", peer.toIpPort().c_str(), errno);
+        }
+        ++stats_.sendDropped;
+        return false;
+    }
+    ++stats_.sent;
+    return true;
+}
+
+void UdpSocket::queueSendTo(const void *data, size_t len, const InetAddress &peer)
+{
+    if (len > sendSlotSize_)
+    {
+        sendTo(data, len, peer);
+        return;
+    }
+    if (pendingSends_ == batchSize_)
+    {
+        flush();
+    }
+    size_t i = static_cast<size_t>(pendingSends_++);
+    char *slot = &sendBuffer_[i * sendSlotSize_];
+    ::memcpy(slot, data, len);
+    sendIovecs_[i].iov_base = slot;
+    sendIovecs_[i].iov_len = len;
+    ::memcpy(&sendAddrs_[i], peer.getSockAddr(), std::min(static_cast<size_t>(peer.getSockLen()), sizeof(sockaddr_in6)));
+    msghdr &hdr = sendMsgs_[i].msg_hdr;
+    ::memset(&hdr, 0, sizeof hdr);
+    hdr.msg_iov = &sendIovecs_[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_name = &sendAddrs_[i];
+    hdr.msg_namelen = peer.getSockLen();
+}
+
+int UdpSocket::flush()
+{
+    int sentCount = 0;
+    while (sentCount < pendingSends_)
+    {
+        ++stats_.sendCalls;
+        int n = ::sendmmsg(sockfd_, &sendMsgs_[sentCount], static_cast<unsigned>(pendingSends_ - sentCount), 0);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+            {
+                LOG_ERROR("UdpSocket::flush sendmmsg err:%d\n", errno);
+            }
+            // 发送缓冲区满 剩下的数据报丢弃 sendmmsg从出错的那个数据报开始重试没有意义
+            stats_.sendDropped += pendingSends_ - sentCount;
+            break;
+        }
+        sentCount += n;
+    }
+    stats_.sent += sentCount;
+    pendingSends_ = 0;
+    return sentCount;
+}
+
+bool UdpSocket::sendSegmented(const void *data, size_t len, size_t segmentSize, const InetAddress &peer)
+{
+    if (segmentSize == 0)
+    {
+        return false;
+    }
+    const char *p = static_cast<const char *>(data);
+    if (!gsoSupported_ || len <= segmentSize)
+    {
+        // 先发出之前排队的数据报 之后sendDropped的增量(包括队列满时自动flush丢弃的)都是这次调用的分段
+        if (pendingSends_ > 0)
+        {
+            flush();
+        }
+        int64_t droppedBefore = stats_.sendDropped;
+        for (size_t offset = 0; offset < len; offset += segmentSize)
+        {
+            queueSendTo(p + offset, std::min(segmentSize, len - offset), peer);
+        }
+        flush();
+        return stats_.sendDropped == droppedBefore; // 和GSO一样 全部分段都交给内核才算成功
+    }
+
+    // 一次sendmsg最多kMaxGsoSegments个分段 总长度不超过一个IP包的上限
+    size_t perCall = std::min(static_cast<size_t>(kMaxGsoSegments), 65000 / segmentSize) * segmentSize;
+    if (perCall == 0)
+    {
+        perCall = segmentSize;
+    }
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    bool ok = true;
+    for (size_t offset = 0; offset < len; offset += perCall)
+    {
+        size_t chunk = std::min(perCall, len - offset);
+        iovec iov;
+        iov.iov_base = const_cast<char *>(p + offset);
+        iov.iov_len = chunk;
+        msghdr hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = const_cast<sockaddr *>(peer.getSockAddr());
+        hdr.msg_namelen = peer.getSockLen();
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof control;
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = IPPROTO_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gsoSize = static_cast<uint16_t>(segmentSize);
+        ::memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof gsoSize);
+
+        int64_t segments = static_cast<int64_t>((chunk + segmentSize - 1) / segmentSize);
+        ++stats_.sendCalls;
+        if (::sendmsg(sockfd_, &hdr, 0) < 0)
+        {
+            int savedErrno = errno;
+            if (savedErrno == EINVAL || savedErrno == EIO || savedErrno == ENOPROTOOPT || savedErrno == EOPNOTSUPP)
+            {
+                // 内核或者网卡不支持UDP GSO 以后都走sendmmsg
+                LOG_INFO("UdpSocket::sendSegmented - UDP_SEGMENT not supported err:%d, fallback to sendmmsg\n", savedErrno);
+                gsoSupported_ = false;
+                return sendSegmented(p + offset, len - offset, segmentSize, peer) && ok;
+            }
+            if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK && savedErrno != ENOBUFS)
+            {
+                LOG_ERROR("UdpSocket::sendSegmented %s err:%d\n", peer.toIpPort().c_str(), savedErrno);
+            }
+            stats_.sendDropped += segments;
+            ok = false;
+            continue;
+        }
+        stats_.sent += segments;
+    }
+    return ok;
+}
@@ -0,0 +1,109 @@
+/**
+ * 二进制日志按大小滚动之后 每个文件都必须能单独解码
+ * rollSize很小 每隔一秒从一个新的调用点写一条 每一批都会触发滚动
+ * 每个文件都要以文件头和全部调用点定义开始 用BinaryLogDecoder逐个在进程内解码
+ **/
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "AsyncLogging.h"
+#include "BinaryLog.h"
+#include "BinaryLogDecoder.h"
+
+static const int kRounds = 4;
+
+static bool readFile(const char *path, std::vector<char> *data)
+{
+    FILE *fp = ::fopen(path, "rb");
+    if (!fp)
+    {
+        return false;
+    }
+    char buf[4096];
+    size_t n = 0;
+    while ((n = ::fread(buf, 1, sizeof buf, fp)) > 0)
+    {
+        data->insert(data->end(), buf, buf + n);
+    }
+    bool ok = !::ferror(fp);
+    ::fclose(fp);
+    return ok;
+}
+
+int main()
+{
+    char dir[] = "/tmp/muduo-binlog-roll-XXXXXX";
+    if (::mkdtemp(dir) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string basename = std::string(dir) + "/roll";
+    {
+        AsyncLogging rollLog(basename, 64, 1);
+        BinaryLog::attach(&rollLog);
+        rollLog.start();
+        // 每一轮一个新的调用点 新的定义和记录在同一批写出 写完超过rollSize
+        // 文件名精确到秒 同一秒内不会再滚动 所以每轮间隔一秒多
+        for (int round = 0; round < kRounds; ++round)
+        {
+            switch (round)
+            {
+            case 0: BLOG_INFO("roll round %d first site", round); break;
+            case 1: BLOG_INFO("roll round %d second site fd=%d", round, 7); break;
+            case 2: BLOG_INFO("roll round %d third site %s", round, std::string("abc")); break;
+            default: BLOG_INFO("roll round %d last site seq=%ld", round, (long)round); break;
+            }
+            rollLog.flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        }
+        BinaryLog::instance().setOutput(BinaryLog::OutputFunc());
+        rollLog.stop();
+    }
+
+    glob_t files;
+    std::string pattern = basename + ".*.log";
+    int failed = 0;
+    size_t count = 0;
+    int64_t roundLines = 0;
+    if (::glob(pattern.c_str(), 0, nullptr, &files) == 0)
+    {
+        count = files.gl_pathc;
+        for (size_t i = 0; i < files.gl_pathc; ++i)
+        {
+            const char *path = files.gl_pathv[i];
+            std::vector<char> data;
+            int errors = 0;
+            BinaryLogDecoder decoder(
+                [&roundLines](const std::string &line) {
+                    if (line.find("roll round") != std::string::npos)
+                    {
+                        ++roundLines;
+                    }
+                },
+                [path, &errors](const std::string &message) {
+                    fprintf(stderr, "%s: %s\n", path, message.c_str());
+                    ++errors;
+                });
+            if (!readFile(path, &data) || !decoder.decode(data.data(), data.size()) || errors > 0)
+            {
+                fprintf(stderr, "%s: failed to decode on its own\n", path);
+                ++failed;
+            }
+            ::unlink(path);
+        }
+        ::globfree(&files);
+    }
+    ::rmdir(dir);
+
+    printf("size roll: %zu files, %d failed to decode, %lld of %d lines found\n", count, failed,
+           static_cast<long long>(roundLines), kRounds);
+    // 至少要滚动过一次才算检查到了
+    return failed == 0 && count >= 2 && roundLines == kRounds ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/**
+ * UdpSocket::sendSegmented在没有GSO时(queueSendTo + flush)的返回值
+ * 发送队列只有4个槽位 分段多于4个时调用中途会自动flush 返回值和投递的个数都要只算这次调用的分段
+ * 发往端口0的数据报内核直接返回EINVAL 用来制造确定的发送失败
+ **/
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "UdpSocket.h"
+#include "Timestamp.h"
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                                   \
+    do                                                                                \
+    {                                                                                 \
+        if (!(cond))                                                                  \
+        {                                                                             \
+            fprintf(stderr, "%s:%d CHECK failed: %s\n", __FILE__, __LINE__, #cond);  \
+            ++g_failures;                                                             \
+        }                                                                             \
+    } while (0)
+
+static const int kBatchSize = 4;
+static const size_t kSlotSize = 512;
+
+// 绑定127.0.0.1上内核分配的端口 收取并计数
+class Receiver
+{
+public:
+    Receiver() : socket_(64, 2048)
+    {
+        socket_.setRecvBufferSize(1024 * 1024);
+        socket_.bindAddress(InetAddress(0));
+        sockaddr_in addr;
+        socklen_t len = static_cast<socklen_t>(sizeof addr);
+        ::getsockname(socket_.fd(), reinterpret_cast<sockaddr *>(&addr), &len);
+        addr_ = InetAddress(addr);
+    }
+
+    const InetAddress &address() const { return addr_; }
+
+    // 回环上sendmmsg返回时数据报已经在接收队列里 多收一会儿是为了确认没有多出来的
+    int drain()
+    {
+        int count = 0;
+        int64_t deadline = MonotonicTime::now().nanoSeconds() + 100 * 1000 * 1000;
+        while (MonotonicTime::now().nanoSeconds() < deadline)
+        {
+            count += socket_.receive([](const char *, size_t, const InetAddress &, Timestamp) {});
+        }
+        return count;
+    }
+
+private:
+    UdpSocket socket_;
+    InetAddress addr_;
+};
+
+static void testAutoFlushAllSent(Receiver *receiver)
+{
+    UdpSocket sender(kBatchSize, kSlotSize);
+    sender.disableGso();
+    std::string data(10 * 100, 'a');
+    CHECK(sender.sendSegmented(data.data(), data.size(), 100, receiver->address()));
+    CHECK(sender.stats().sent == 10);
+    CHECK(sender.stats().sendDropped == 0);
+    CHECK(sender.pendingSends() == 0);
+    CHECK(receiver->drain() == 10);
+}
+
+static void testEarlierFailureNotCounted(Receiver *receiver)
+{
+    // 之前排队的坏数据报排在队首时 自动flush的sendmmsg一开始就失败 会把同一批的分段一起丢掉
+    UdpSocket sender(kBatchSize, kSlotSize);
+    sender.disableGso();
+    sender.queueSendTo("x", 1, InetAddress(0));
+    std::string data(10 * 100, 'b');
+    CHECK(sender.sendSegmented(data.data(), data.size(), 100, receiver->address()));
+    CHECK(sender.stats().sent == 10);
+    CHECK(sender.stats().sendDropped == 1);
+    CHECK(receiver->drain() == 10);
+}
+
+static void testOwnFailureAfterEarlierSuccess(Receiver *receiver)
+{
+    // 之前排队的好数据报在自动flush中发出 这次的分段全部失败 不能因为有数据报发出就返回true
+    UdpSocket sender(kBatchSize, kSlotSize);
+    sender.disableGso();
+    sender.queueSendTo("x", 1, receiver->address());
+    std::string data(10 * 100, 'c');
+    CHECK(!sender.sendSegmented(data.data(), data.size(), 100, InetAddress(0)));
+    CHECK(sender.stats().sent == 1);
+    CHECK(sender.stats().sendDropped == 10);
+    CHECK(receiver->drain() == 1);
+}
+
+static void testOversizedSegments(Receiver *receiver)
+{
+    // 分段比发送槽位大时queueSendTo直接sendTo 最后flush的队列是空的
+    UdpSocket sender(kBatchSize, kSlotSize);
+    sender.disableGso();
+    std::string data(3 * 1000, 'd');
+    CHECK(sender.sendSegmented(data.data(), data.size(), 1000, receiver->address()));
+    CHECK(sender.stats().sent == 3);
+    CHECK(receiver->drain() == 3);
+}
+
+static void testEmpty(Receiver *receiver)
+{
+    UdpSocket sender(kBatchSize, kSlotSize);
+    sender.disableGso();
+    CHECK(sender.sendSegmented("", 0, 100, receiver->address()));
+    CHECK(sender.stats().sendCalls == 0);
+    CHECK(receiver->drain() == 0);
+}
+
+int main()
+{
+    Receiver receiver;
+    testAutoFlushAllSent(&receiver);
+    testEarlierFailureNotCounted(&receiver);
+    testOwnFailureAfterEarlierSuccess(&receiver);
+    testOversizedSegments(&receiver);
+    testEmpty(&receiver);
+    if (g_failures == 0)
+    {
+        printf("udp_socket_test passed\n");
+    }
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+/**
+ * 二进制日志解码工具 把BinaryLog写出的文件还原成和Logger相同格式的文本
+ * [INFO]2024/01/01 12:00:00.123456789 12345 : msg
+ * 时间后面是写日志的线程id 时间精确到纳秒 解码逻辑在BinaryLogDecoder中
+ *
+ * 用法: logdecoder [file...]   不指定文件时从标准输入读取 多个文件按顺序解码
+ **/
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "BinaryLogDecoder.h"
+
+static bool readAll(FILE *fp, std::vector<char> *data)
+{
+    char buf[64 * 1024];
+    size_t n = 0;
+    while ((n = ::fread(buf, 1, sizeof buf, fp)) > 0)
+    {
+        data->insert(data->end(), buf, buf + n);
+    }
+    return !::ferror(fp);
+}
+
+// 调用点id只在同一个进程写出的文件中有效 每个文件单独解码
+static bool decodeFile(const std::string &name, const std::vector<char> &data)
+{
+    BinaryLogDecoder decoder(
+        [](const std::string &line) { fwrite(line.data(), 1, line.size(), stdout); },
+        [&name](const std::string &message) { fprintf(stderr, "%s: %s\n", name.c_str(), message.c_str()); });
+    return decoder.decode(data.data(), data.size());
+}
+
+int main(int argc, char *argv[])
+{
+    int failed = 0;
+    if (argc < 2)
+    {
+        std::vector<char> data;
+        if (!readAll(stdin, &data) || !decodeFile("<stdin>", data))
+        {
+            ++failed;
+        }
+        return failed;
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        FILE *fp = ::fopen(argv[i], "rb");
+        if (!fp)
+        {
+            fprintf(stderr, "%s: %s\n", argv[i], ::strerror(errno));
+            ++failed;
+            continue;
+        }
+        std::vector<char> data;
+        bool ok = readAll(fp, &data);
+        ::fclose(fp);
+        if (!ok || !decodeFile(argv[i], data))
+        {
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}